@@ -6,6 +6,12 @@
 #include <assert.h>
 #include <stdint.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86 1
+#include <ccan/cpuid/cpuid.h>
+#include <immintrin.h>
+#endif
+
 /**
  * sixbit_to_b64 - maps a 6-bit value to the base64 alphabet
  * @param map A base 64 map (see base64_init_map)
@@ -85,6 +91,160 @@ void base64_encode_tail_using_maps(const base64_maps_t *maps, char dest[4],
 	memset(dest+1+srclen, '=', 3-srclen);
 }
 
+/*
+ * Bulk encoding: all of these encode n whole triplets from src into
+ * 4*n characters at dest, with exactly the same output as calling
+ * base64_encode_triplet_using_maps() on each.
+ */
+static void encode_triplets_generic(const base64_maps_t *maps, char *dest,
+				    const char *src, size_t n)
+{
+	const unsigned char *s = (const unsigned char *)src;
+	const char *map = maps->encode_map;
+
+	for (; n; n--, s += 3, dest += 4) {
+		uint32_t v = ((uint32_t)s[0] << 16) | ((uint32_t)s[1] << 8) | s[2];
+
+		dest[0] = map[v >> 18];
+		dest[1] = map[(v >> 12) & 0x3f];
+		dest[2] = map[(v >> 6) & 0x3f];
+		dest[3] = map[v & 0x3f];
+	}
+}
+
+#ifdef BASE64_X86
+/*
+ * The vector code follows Wojciech Muła's base64 work, except that the
+ * alphabet is never assumed: encode_map is looked up as four 16-byte
+ * tables and decode_map as up to sixteen, selected by the top bits of
+ * the index or character.  So any alphabet from base64_init_maps()
+ * works, including ones using characters above 127.
+ */
+
+/* Spread 12 bytes (3 per 32-bit lane) into 16 six-bit indices. */
+#define ENCODE_SEXTETS(_p, _bits, _x)					\
+	_p##or_si##_bits(						\
+		_p##mulhi_epu16(_p##and_si##_bits((_x),			\
+					_p##set1_epi32(0x0fc0fc00)),	\
+				_p##set1_epi32(0x04000040)),		\
+		_p##mullo_epi16(_p##and_si##_bits((_x),			\
+					_p##set1_epi32(0x003f03f0)),	\
+				_p##set1_epi32(0x01000010)))
+
+__attribute__((target("ssse3")))
+static void encode_triplets_ssse3(const base64_maps_t *maps, char *dest,
+				  const char *src, size_t n)
+{
+	const __m128i shuf = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+					   7, 6, 8, 7, 10, 9, 11, 10);
+	__m128i lut[4];
+	int k;
+
+	for (k = 0; k < 4; k++)
+		lut[k] = _mm_loadu_si128((const void *)(maps->encode_map + 16*k));
+
+	/* We load 16 bytes to consume 12, so stop short of the end. */
+	while (n >= 6) {
+		__m128i x, idx, hi, out;
+
+		x = _mm_shuffle_epi8(_mm_loadu_si128((const void *)src), shuf);
+		idx = ENCODE_SEXTETS(_mm_, 128, x);
+		hi = _mm_and_si128(_mm_srli_epi16(idx, 4), _mm_set1_epi8(3));
+		out = _mm_setzero_si128();
+		for (k = 0; k < 4; k++)
+			out = _mm_or_si128(out, _mm_and_si128(
+				_mm_shuffle_epi8(lut[k], idx),
+				_mm_cmpeq_epi8(hi, _mm_set1_epi8(k))));
+		_mm_storeu_si128((void *)dest, out);
+		src += 12;
+		dest += 16;
+		n -= 4;
+	}
+	encode_triplets_generic(maps, dest, src, n);
+}
+
+__attribute__((target("avx2")))
+static void encode_triplets_avx2(const base64_maps_t *maps, char *dest,
+				 const char *src, size_t n)
+{
+	const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+					      7, 6, 8, 7, 10, 9, 11, 10,
+					      1, 0, 2, 1, 4, 3, 5, 4,
+					      7, 6, 8, 7, 10, 9, 11, 10);
+	__m256i lut[4];
+	int k;
+
+	for (k = 0; k < 4; k++)
+		lut[k] = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const void *)(maps->encode_map + 16*k)));
+
+	/* Each lane loads 16 bytes to consume 12: the last reads src[12..27]. */
+	while (n >= 10) {
+		__m256i x, idx, hi, out;
+
+		x = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const void *)src)),
+			_mm_loadu_si128((const void *)(src + 12)), 1);
+		x = _mm256_shuffle_epi8(x, shuf);
+		idx = ENCODE_SEXTETS(_mm256_, 256, x);
+		hi = _mm256_and_si256(_mm256_srli_epi16(idx, 4),
+				      _mm256_set1_epi8(3));
+		out = _mm256_setzero_si256();
+		for (k = 0; k < 4; k++)
+			out = _mm256_or_si256(out, _mm256_and_si256(
+				_mm256_shuffle_epi8(lut[k], idx),
+				_mm256_cmpeq_epi8(hi, _mm256_set1_epi8(k))));
+		_mm256_storeu_si256((void *)dest, out);
+		src += 24;
+		dest += 32;
+		n -= 8;
+	}
+	encode_triplets_ssse3(maps, dest, src, n);
+}
+#endif /* BASE64_X86 */
+
+/*
+ * Each dispatcher replaces itself with the best implementation on first
+ * use.  Threads may race to do so, but they all store the same pointer,
+ * so relaxed atomics are enough.
+ */
+#ifdef __GNUC__
+#define IMPL_LOAD(impl) __atomic_load_n(&(impl), __ATOMIC_RELAXED)
+#define IMPL_STORE(impl, fn) __atomic_store_n(&(impl), (fn), __ATOMIC_RELAXED)
+#else
+#define IMPL_LOAD(impl) (impl)
+#define IMPL_STORE(impl, fn) ((impl) = (fn))
+#endif
+
+static void encode_triplets_dispatch(const base64_maps_t *maps, char *dest,
+				     const char *src, size_t n);
+static void (*encode_triplets_impl)(const base64_maps_t *, char *,
+				    const char *, size_t)
+	= encode_triplets_dispatch;
+
+static void encode_triplets_dispatch(const base64_maps_t *maps, char *dest,
+				     const char *src, size_t n)
+{
+	void (*impl)(const base64_maps_t *, char *, const char *, size_t);
+
+#ifdef BASE64_X86
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2) && cpuid_os_has_avx())
+		impl = encode_triplets_avx2;
+	else if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3))
+		impl = encode_triplets_ssse3;
+	else
+#endif
+		impl = encode_triplets_generic;
+	IMPL_STORE(encode_triplets_impl, impl);
+	impl(maps, dest, src, n);
+}
+
+static void encode_triplets(const base64_maps_t *maps, char *dest,
+			    const char *src, size_t n)
+{
+	IMPL_LOAD(encode_triplets_impl)(maps, dest, src, n);
+}
+
 ssize_t base64_encode_using_maps(const base64_maps_t *maps,
 				 char *dest, const size_t destlen,
 				 const char *src, const size_t srclen)
@@ -97,11 +257,9 @@ ssize_t base64_encode_using_maps(const base64_maps_t *maps,
 		return -1;
 	}
 
-	while (srclen - src_offset >= 3) {
-		base64_encode_triplet_using_maps(maps, &dest[dest_offset], &src[src_offset]);
-		src_offset += 3;
-		dest_offset += 4;
-	}
+	encode_triplets(maps, dest, src, srclen / 3);
+	src_offset = srclen / 3 * 3;
+	dest_offset = srclen / 3 * 4;
 
 	if (src_offset < srclen) {
 		base64_encode_tail_using_maps(maps, &dest[dest_offset], &src[src_offset], srclen-src_offset);
@@ -172,6 +330,201 @@ int base64_decode_tail_using_maps(const base64_maps_t *maps, char dest[3],
 	return insize - 1;
 }
 
+/*
+ * Bulk decoding: these decode up to n whole quartets from src into
+ * dest, stopping at the first quartet with a character that isn't in
+ * the alphabet.  They return the number of quartets decoded; the
+ * caller goes back to base64_decode_quartet_using_maps() from there,
+ * so errors are reported exactly as before.
+ */
+static size_t decode_quartets_generic(const base64_maps_t *maps, char *dest,
+				      const char *src, size_t n)
+{
+	const unsigned char *s = (const unsigned char *)src;
+	const unsigned char *map = (const unsigned char *)maps->decode_map;
+	size_t i;
+
+	for (i = 0; i < n; i++, s += 4, dest += 3) {
+		uint32_t a = map[s[0]], b = map[s[1]], c = map[s[2]], d = map[s[3]];
+		uint32_t v;
+
+		/* One test catches 0xff (invalid) in any of the four. */
+		if ((a | b | c | d) & 0xc0)
+			break;
+		v = (a << 18) | (b << 12) | (c << 6) | d;
+		dest[0] = v >> 16;
+		dest[1] = v >> 8;
+		dest[2] = v;
+	}
+	return i;
+}
+
+#ifdef BASE64_X86
+/*
+ * decode_map split by high nibble, inverted so that characters outside
+ * the alphabet come out as 0 whichever way they miss.  Tables with no
+ * valid characters are skipped (for rfc4648 only 6 of 16 are needed).
+ */
+struct decode_luts {
+	int num;
+	unsigned char nibble[16];
+	__m128i lut[16];
+};
+
+__attribute__((target("ssse3")))
+static void decode_luts_init(struct decode_luts *l, const base64_maps_t *maps)
+{
+	int h;
+
+	l->num = 0;
+	for (h = 0; h < 16; h++) {
+		__m128i t = _mm_xor_si128(
+			_mm_loadu_si128((const void *)(maps->decode_map + 16*h)),
+			_mm_set1_epi8(-1));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(t, _mm_setzero_si128()))
+		    == 0xffff)
+			continue;
+		l->nibble[l->num] = h;
+		l->lut[l->num++] = t;
+	}
+}
+
+__attribute__((target("ssse3")))
+static size_t decode_quartets_ssse3(const base64_maps_t *maps, char *dest,
+				    const char *src, size_t n)
+{
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+					   14, 13, 12, -1, -1, -1, -1);
+	struct decode_luts l;
+	size_t i = 0;
+	int k;
+
+	if (n < 4)
+		return decode_quartets_generic(maps, dest, src, n);
+
+	decode_luts_init(&l, maps);
+	for (; n - i >= 4; i += 4, src += 16, dest += 12) {
+		__m128i c, lo, hi, v;
+		uint32_t last;
+
+		c = _mm_loadu_si128((const void *)src);
+		lo = _mm_and_si128(c, _mm_set1_epi8(0x0f));
+		hi = _mm_and_si128(_mm_srli_epi16(c, 4), _mm_set1_epi8(0x0f));
+		v = _mm_setzero_si128();
+		for (k = 0; k < l.num; k++)
+			v = _mm_or_si128(v, _mm_and_si128(
+				_mm_shuffle_epi8(l.lut[k], lo),
+				_mm_cmpeq_epi8(hi, _mm_set1_epi8(l.nibble[k]))));
+		v = _mm_xor_si128(v, _mm_set1_epi8(-1));
+		/* Anything with bit 6 or 7 set isn't a sextet. */
+		if (_mm_movemask_epi8(_mm_or_si128(v, _mm_slli_epi16(v, 1))))
+			break;
+
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, pack);
+		_mm_storel_epi64((void *)dest, v);
+		last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(dest + 8, &last, 4);
+	}
+	return i + decode_quartets_generic(maps, dest, src, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t decode_quartets_avx2(const base64_maps_t *maps, char *dest,
+				   const char *src, size_t n)
+{
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+					      14, 13, 12, -1, -1, -1, -1,
+					      2, 1, 0, 6, 5, 4, 10, 9, 8,
+					      14, 13, 12, -1, -1, -1, -1);
+	const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	struct decode_luts l;
+	__m256i lut[16];
+	size_t i = 0;
+	int k;
+
+	if (n < 8)
+		return decode_quartets_ssse3(maps, dest, src, n);
+
+	decode_luts_init(&l, maps);
+	for (k = 0; k < l.num; k++)
+		lut[k] = _mm256_broadcastsi128_si256(l.lut[k]);
+
+	for (; n - i >= 8; i += 8, src += 32, dest += 24) {
+		__m256i c, lo, hi, v;
+
+		c = _mm256_loadu_si256((const void *)src);
+		lo = _mm256_and_si256(c, _mm256_set1_epi8(0x0f));
+		hi = _mm256_and_si256(_mm256_srli_epi16(c, 4),
+				      _mm256_set1_epi8(0x0f));
+		v = _mm256_setzero_si256();
+		for (k = 0; k < l.num; k++)
+			v = _mm256_or_si256(v, _mm256_and_si256(
+				_mm256_shuffle_epi8(lut[k], lo),
+				_mm256_cmpeq_epi8(hi,
+					_mm256_set1_epi8(l.nibble[k]))));
+		v = _mm256_xor_si256(v, _mm256_set1_epi8(-1));
+		if (_mm256_movemask_epi8(_mm256_or_si256(v,
+					 _mm256_slli_epi16(v, 1))))
+			break;
+
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, pack);
+		/* 12 bytes in each lane: close the gap and store exactly 24. */
+		v = _mm256_permutevar8x32_epi32(v, gather);
+		_mm_storeu_si128((void *)dest, _mm256_castsi256_si128(v));
+		_mm_storel_epi64((void *)(dest + 16),
+				 _mm256_extracti128_si256(v, 1));
+	}
+	return i + decode_quartets_ssse3(maps, dest, src, n - i);
+}
+#endif /* BASE64_X86 */
+
+static size_t decode_quartets_dispatch(const base64_maps_t *maps, char *dest,
+				       const char *src, size_t n);
+static size_t (*decode_quartets_impl)(const base64_maps_t *, char *,
+				      const char *, size_t)
+	= decode_quartets_dispatch;
+
+static size_t decode_quartets_dispatch(const base64_maps_t *maps, char *dest,
+				       const char *src, size_t n)
+{
+	size_t (*impl)(const base64_maps_t *, char *, const char *, size_t);
+
+#ifdef BASE64_X86
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2) && cpuid_os_has_avx())
+		impl = decode_quartets_avx2;
+	else if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3))
+		impl = decode_quartets_ssse3;
+	else
+#endif
+		impl = decode_quartets_generic;
+	IMPL_STORE(decode_quartets_impl, impl);
+	return impl(maps, dest, src, n);
+}
+
+static size_t decode_quartets(const base64_maps_t *maps, char *dest,
+			      const char *src, size_t n)
+{
+	return IMPL_LOAD(decode_quartets_impl)(maps, dest, src, n);
+}
+
+/* Decode n quartets, none of which is the (possibly padded) tail. */
+static int decode_body(const base64_maps_t *maps, char *dest,
+		       const char *src, size_t n)
+{
+	size_t i;
+
+	for (i = decode_quartets(maps, dest, src, n); i < n; i++) {
+		if (base64_decode_quartet_using_maps(maps, dest + i*3,
+						     src + i*4) == -1)
+			return -1;
+	}
+	return 0;
+}
+
 ssize_t base64_decode_using_maps(const base64_maps_t *maps,
 				 char *dest, const size_t destlen,
 				 const char *src, const size_t srclen)
@@ -185,12 +538,12 @@ ssize_t base64_decode_using_maps(const base64_maps_t *maps,
 		return -1;
 	}
 
-	for(i=0; srclen - i > 4; i+=4) {
-		if (base64_decode_quartet_using_maps(maps, &dest[dest_offset], &src[i]) == -1) {
-			return -1;
-		}
-		dest_offset += 3;
-	}
+	/* Everything but the last 1-4 characters, which may be padded. */
+	i = srclen ? (srclen - 1) / 4 : 0;
+	if (decode_body(maps, dest, src, i) == -1)
+		return -1;
+	dest_offset = i * 3;
+	i *= 4;
 
 	more = base64_decode_tail_using_maps(maps, &dest[dest_offset], &src[i], srclen - i);
 	if (more == -1) {
@@ -203,6 +556,129 @@ ssize_t base64_decode_using_maps(const base64_maps_t *maps,
 	return dest_offset;
 }
 
+void base64_encode_init(struct base64_encode_ctx *ctx,
+			const base64_maps_t *maps)
+{
+	ctx->maps = maps;
+	ctx->n = 0;
+}
+
+ssize_t base64_encode_update(struct base64_encode_ctx *ctx,
+			     char *dest, size_t destlen,
+			     const char *src, size_t srclen)
+{
+	size_t total = ctx->n + srclen, off = 0, n;
+	char *d = dest;
+
+	if (destlen < total / 3 * 4) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (total < 3) {
+		memcpy(ctx->buf + ctx->n, src, srclen);
+		ctx->n = total;
+		return 0;
+	}
+
+	/* Complete the carried-over triplet first. */
+	if (ctx->n) {
+		off = 3 - ctx->n;
+		memcpy(ctx->buf + ctx->n, src, off);
+		base64_encode_triplet_using_maps(ctx->maps, d, ctx->buf);
+		d += 4;
+	}
+
+	n = (srclen - off) / 3;
+	encode_triplets(ctx->maps, d, src + off, n);
+	d += n * 4;
+	off += n * 3;
+
+	ctx->n = srclen - off;
+	memcpy(ctx->buf, src + off, ctx->n);
+	return d - dest;
+}
+
+ssize_t base64_encode_done(struct base64_encode_ctx *ctx,
+			   char *dest, size_t destlen)
+{
+	if (!ctx->n)
+		return 0;
+
+	if (destlen < 4) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	base64_encode_tail_using_maps(ctx->maps, dest, ctx->buf, ctx->n);
+	ctx->n = 0;
+	return 4;
+}
+
+void base64_decode_init(struct base64_decode_ctx *ctx,
+			const base64_maps_t *maps)
+{
+	ctx->maps = maps;
+	ctx->n = 0;
+}
+
+ssize_t base64_decode_update(struct base64_decode_ctx *ctx,
+			     char *dest, size_t destlen,
+			     const char *src, size_t srclen)
+{
+	size_t total = ctx->n + srclen, off = 0, n;
+	char *d = dest;
+
+	/* We always hold back the last 1-4 characters: they may be the tail. */
+	if (total <= 4) {
+		memcpy(ctx->buf + ctx->n, src, srclen);
+		ctx->n = total;
+		return 0;
+	}
+
+	n = (total - 1) / 4;
+	if (destlen < n * 3) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (ctx->n) {
+		off = 4 - ctx->n;
+		memcpy(ctx->buf + ctx->n, src, off);
+		if (base64_decode_quartet_using_maps(ctx->maps, d, ctx->buf) == -1)
+			return -1;
+		d += 3;
+		n--;
+	}
+
+	if (decode_body(ctx->maps, d, src + off, n) == -1)
+		return -1;
+	d += n * 3;
+	off += n * 4;
+
+	ctx->n = srclen - off;
+	memcpy(ctx->buf, src + off, ctx->n);
+	return d - dest;
+}
+
+ssize_t base64_decode_done(struct base64_decode_ctx *ctx,
+			   char *dest, size_t destlen)
+{
+	int ret;
+
+	if (!ctx->n)
+		return 0;
+
+	if (destlen < 3) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+	ret = base64_decode_tail_using_maps(ctx->maps, dest, ctx->buf, ctx->n);
+	if (ret == -1)
+		return -1;
+	ctx->n = 0;
+	return ret;
+}
+
 
 
 
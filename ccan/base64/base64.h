@@ -120,6 +120,117 @@ int base64_decode_tail_using_maps(const base64_maps_t *maps, char *dest,
 				  const char *src, size_t srclen);
 
 
+/**
+ * struct base64_encode_ctx - state for encoding a stream in pieces
+ *
+ * Holds the alphabet and up to two bytes carried over between calls
+ * to base64_encode_update().
+ */
+struct base64_encode_ctx {
+	const base64_maps_t *maps;
+	size_t n;
+	char buf[3];
+};
+
+/**
+ * base64_encode_init - start encoding a stream
+ * @param ctx The context to initialize
+ * @param maps Maps to use for encoding (see base64_init_maps)
+ */
+void base64_encode_init(struct base64_encode_ctx *ctx,
+			const base64_maps_t *maps);
+
+/**
+ * base64_encode_update - encode the next chunk of a stream
+ * @param ctx The context (see base64_encode_init)
+ * @param dest Buffer to encode into
+ * @param destlen Length of dest: base64_encoded_length(srclen) is enough
+ * @param src Next chunk of data to encode
+ * @param srclen Length of src
+ * @return Number of encoded bytes set in dest. -1 on error (and errno set)
+ * @note dest is not nul-padded or terminated
+ * @note sets errno = EOVERFLOW if destlen is too small
+ *
+ * Only whole triplets are encoded; any remaining bytes are kept in @ctx
+ * until the next call.  The concatenated output of the updates and
+ * base64_encode_done() is the same as base64_encode_using_maps() of
+ * the concatenated input.
+ */
+ssize_t base64_encode_update(struct base64_encode_ctx *ctx,
+			     char *dest, size_t destlen,
+			     const char *src, size_t srclen);
+
+/**
+ * base64_encode_done - finish encoding a stream
+ * @param ctx The context (see base64_encode_init)
+ * @param dest Buffer to encode into
+ * @param destlen Length of dest: 4 is enough
+ * @return Number of encoded bytes set in dest (0 or 4). -1 on error (and errno set)
+ * @note sets errno = EOVERFLOW if destlen is too small
+ *
+ * Encodes any carried-over bytes, with padding.  @ctx can then be
+ * reused for another stream with the same maps.
+ */
+ssize_t base64_encode_done(struct base64_encode_ctx *ctx,
+			   char *dest, size_t destlen);
+
+/**
+ * struct base64_decode_ctx - state for decoding a stream in pieces
+ *
+ * Holds the alphabet and up to four characters carried over between
+ * calls to base64_decode_update().
+ */
+struct base64_decode_ctx {
+	const base64_maps_t *maps;
+	size_t n;
+	char buf[4];
+};
+
+/**
+ * base64_decode_init - start decoding a stream
+ * @param ctx The context to initialize
+ * @param maps Maps to use for decoding (see base64_init_maps)
+ */
+void base64_decode_init(struct base64_decode_ctx *ctx,
+			const base64_maps_t *maps);
+
+/**
+ * base64_decode_update - decode the next chunk of a stream
+ * @param ctx The context (see base64_decode_init)
+ * @param dest Buffer to decode into
+ * @param destlen Length of dest: base64_decoded_length(srclen) is enough
+ * @param src Next chunk of base64 to decode
+ * @param srclen Length of src
+ * @return Number of decoded bytes set in dest. -1 on error (and errno set)
+ * @note dest is not nul-padded
+ * @note sets errno = EOVERFLOW if destlen is too small
+ * @note sets errno = EDOM if src contains invalid characters
+ *
+ * The last one to four characters seen are always kept in @ctx, since
+ * they may be the padded end of the stream.  After an error, @ctx must
+ * be reinitialized.
+ */
+ssize_t base64_decode_update(struct base64_decode_ctx *ctx,
+			     char *dest, size_t destlen,
+			     const char *src, size_t srclen);
+
+/**
+ * base64_decode_done - finish decoding a stream
+ * @param ctx The context (see base64_decode_init)
+ * @param dest Buffer to decode into
+ * @param destlen Length of dest: 3 is enough
+ * @return Number of decoded bytes set in dest. -1 on error (and errno set)
+ * @note sets errno = EOVERFLOW if destlen is too small
+ * @note sets errno = EDOM if the tail contains invalid characters
+ * @note sets errno = EINVAL if the tail is an invalid base64 tail
+ *
+ * Decodes the carried-over tail exactly as base64_decode_tail_using_maps()
+ * would.  @ctx can then be reused for another stream with the same maps.
+ */
+ssize_t base64_decode_done(struct base64_decode_ctx *ctx,
+			   char *dest, size_t destlen);
+
+
 /* the rfc4648 functions: */
 
 extern const base64_maps_t base64_maps_rfc4648;
@@ -0,0 +1,137 @@
+/* Test speed of each base64 encode and decode implementation across
+ * buffer sizes, with the rfc4648 and a url-safe alphabet.  Every result
+ * is checked against the triplet-at-a-time and quartet-at-a-time
+ * functions. */
+#include <ccan/base64/base64.c>
+#include <ccan/array_size/array_size.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct impl {
+	const char *name;
+	void (*encode)(const base64_maps_t *, char *, const char *, size_t);
+	size_t (*decode)(const base64_maps_t *, char *, const char *, size_t);
+	bool usable;
+};
+
+/* What base64_encode_using_maps() used to do. */
+static void encode_by_triplet(const base64_maps_t *maps, char *dest,
+			      const char *src, size_t n)
+{
+	for (; n; n--, src += 3, dest += 4)
+		base64_encode_triplet_using_maps(maps, dest, src);
+}
+
+static size_t decode_by_quartet(const base64_maps_t *maps, char *dest,
+				const char *src, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++, src += 4, dest += 3)
+		if (base64_decode_quartet_using_maps(maps, dest, src) == -1)
+			break;
+	return i;
+}
+
+static void encode_api(const base64_maps_t *maps, char *dest,
+		       const char *src, size_t n)
+{
+	base64_encode_using_maps(maps, dest, n * 4, src, n * 3);
+}
+
+static size_t decode_api(const base64_maps_t *maps, char *dest,
+			 const char *src, size_t n)
+{
+	return base64_decode_using_maps(maps, dest, n * 3, src, n * 4) / 3;
+}
+
+static double gbps(struct timeabs start, size_t bytes)
+{
+	return (double)bytes / time_to_nsec(time_between(time_now(), start));
+}
+
+static bool bench(const char *alg, const base64_maps_t *maps,
+		  const struct impl *impls, size_t n,
+		  const char *raw, char *enc, char *dec, size_t total)
+{
+	size_t size, i, j;
+
+	printf("%s:\n", alg);
+	for (size = 48; size <= 3 << 18; size *= 4) {
+		size_t trip = size / 3;
+
+		encode_by_triplet(maps, enc, raw, trip);
+		printf("  %zu bytes:\n", size);
+		for (i = 0; i < n; i++) {
+			struct timeabs start;
+			char out[64];
+
+			if (!impls[i].usable)
+				continue;
+			memset(dec, 0, size);
+			impls[i].encode(maps, dec + size, raw, trip);
+			if (memcmp(dec + size, enc, trip * 4) != 0
+			    || impls[i].decode(maps, dec, enc, trip) != trip
+			    || memcmp(dec, raw, size) != 0) {
+				printf("    %s: WRONG ANSWER\n", impls[i].name);
+				return false;
+			}
+
+			start = time_now();
+			for (j = 0; j < total / size; j++)
+				impls[i].encode(maps, dec + size, raw, trip);
+			sprintf(out, "%.2f", gbps(start, total / size * size));
+
+			start = time_now();
+			for (j = 0; j < total / size; j++)
+				impls[i].decode(maps, dec, enc, trip);
+			printf("    %s: encode %s GB/s, decode %.2f GB/s\n",
+			       impls[i].name, out,
+			       gbps(start, total / size * size));
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct impl impls[] = {
+		{ "by triplet", encode_by_triplet, decode_by_quartet, true },
+		{ "generic", encode_triplets_generic, decode_quartets_generic,
+		  true },
+#ifdef BASE64_X86
+		{ "ssse3", encode_triplets_ssse3, decode_quartets_ssse3,
+		  cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3) },
+		{ "avx2", encode_triplets_avx2, decode_quartets_avx2,
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		  && cpuid_os_has_avx() },
+#endif
+		{ "api", encode_api, decode_api, true },
+	};
+	size_t total = argv[1] ? atol(argv[1]) : 256 * 1024 * 1024;
+	size_t max = 3 << 18, i;
+	char *raw = malloc(max), *enc = malloc(max / 3 * 4);
+	char *dec = malloc(max + max / 3 * 4);
+	char alphabet[64];
+	base64_maps_t urlsafe;
+
+	for (i = 0; i < max; i++)
+		raw[i] = i * 7 + (i >> 8);
+
+	memcpy(alphabet, base64_maps_rfc4648.encode_map, 64);
+	alphabet[62] = '-';
+	alphabet[63] = '_';
+	base64_init_maps(&urlsafe, alphabet);
+
+	if (!bench("rfc4648", &base64_maps_rfc4648, impls, ARRAY_SIZE(impls),
+		   raw, enc, dec, total)
+	    || !bench("url-safe", &urlsafe, impls, ARRAY_SIZE(impls),
+		      raw, enc, dec, total))
+		return 1;
+
+	free(raw);
+	free(enc);
+	free(dec);
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ccan/base64/base64.h>
+#include <ccan/tap/tap.h>
+
+#include <ccan/base64/base64.c>
+
+#define MAX_TRIPLETS 100
+
+typedef void (*encode_fn)(const base64_maps_t *, char *, const char *, size_t);
+typedef size_t (*decode_fn)(const base64_maps_t *, char *, const char *, size_t);
+
+static const struct impl {
+	const char *name;
+	encode_fn encode;
+	decode_fn decode;
+} impls[] = {
+	{ "generic", encode_triplets_generic, decode_quartets_generic },
+#ifdef BASE64_X86
+	{ "ssse3", encode_triplets_ssse3, decode_quartets_ssse3 },
+	{ "avx2", encode_triplets_avx2, decode_quartets_avx2 },
+#endif
+};
+
+static bool impl_usable(const struct impl *impl)
+{
+#ifdef BASE64_X86
+	if (impl->encode == encode_triplets_ssse3)
+		return cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3);
+	if (impl->encode == encode_triplets_avx2)
+		return cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+			&& cpuid_os_has_avx();
+#endif
+	return true;
+}
+
+/* Does impl agree with the triplet/quartet functions for these maps? */
+static bool check_impl(const struct impl *impl, const base64_maps_t *maps)
+{
+	char src[MAX_TRIPLETS * 3], enc[MAX_TRIPLETS * 4], ref[MAX_TRIPLETS * 4];
+	char dec[MAX_TRIPLETS * 3];
+	size_t n, i, bad;
+
+	memset(src, 0, sizeof(src));
+	for (n = 0; n <= MAX_TRIPLETS; n++) {
+		for (i = 0; i < n * 3; i++)
+			src[i] = random();
+		for (i = 0; i < n; i++)
+			base64_encode_triplet_using_maps(maps, ref + i*4, src + i*3);
+		memset(enc, 0, sizeof(enc));
+		impl->encode(maps, enc, src, n);
+		if (memcmp(enc, ref, n * 4) != 0)
+			return false;
+
+		memset(dec, 0, sizeof(dec));
+		if (impl->decode(maps, dec, enc, n) != n)
+			return false;
+		if (memcmp(dec, src, n * 3) != 0)
+			return false;
+
+		/* Now break one character: it must stop at that quartet. */
+		if (!n)
+			continue;
+		bad = random() % (n * 4);
+		do {
+			enc[bad] = random();
+		} while (base64_char_in_alphabet(maps, enc[bad]));
+		memset(dec, 0, sizeof(dec));
+		if (impl->decode(maps, dec, enc, n) != bad / 4)
+			return false;
+		if (memcmp(dec, src, bad / 4 * 3) != 0)
+			return false;
+	}
+	return true;
+}
+
+int main(void)
+{
+	base64_maps_t safe, high;
+	char alphabet[64];
+	size_t i;
+
+	plan_tests(sizeof(impls) / sizeof(impls[0]) * 3 + 4);
+
+	memcpy(alphabet, base64_maps_rfc4648.encode_map, 64);
+	alphabet[62] = '-';
+	alphabet[63] = '_';
+	base64_init_maps(&safe, alphabet);
+
+	/* Scattered over all 16 high nibbles, most of them >= 128. */
+	for (i = 0; i < 64; i++)
+		alphabet[i] = (i * 67 + 5) & 0xff;
+	base64_init_maps(&high, alphabet);
+
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		if (!impl_usable(&impls[i])) {
+			skip(3, "%s not supported", impls[i].name);
+			continue;
+		}
+		ok(check_impl(&impls[i], &base64_maps_rfc4648),
+		   "%s: rfc4648", impls[i].name);
+		ok(check_impl(&impls[i], &safe), "%s: fs-safe", impls[i].name);
+		ok(check_impl(&impls[i], &high), "%s: high alphabet",
+		   impls[i].name);
+	}
+
+	/* Through the public functions, a long buffer round-trips... */
+	{
+		char src[1000], enc[1400], dec[1002];
+
+		for (i = 0; i < sizeof(src); i++)
+			src[i] = random();
+		ok1(base64_encode_using_maps(&high, enc, sizeof(enc),
+					     src, sizeof(src)) == 1336);
+		ok1(base64_decode_using_maps(&high, dec, sizeof(dec),
+					     enc, 1336) == 1000
+		    && memcmp(dec, src, 1000) == 0);
+
+		/* ... and an error in the middle is still EDOM. */
+		enc[700] = '!';
+		errno = 0;
+		ok1(base64_decode_using_maps(&high, dec, sizeof(dec),
+					     enc, 1336) == -1);
+		ok1(errno == EDOM);
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,117 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ccan/base64/base64.h>
+#include <ccan/tap/tap.h>
+
+#include <ccan/base64/base64.c>
+
+#define LEN 2000
+
+/* Feed src through ctx in random-sized pieces. */
+static ssize_t encode_chunked(char *dest, const char *src, size_t srclen)
+{
+	struct base64_encode_ctx ctx;
+	size_t off = 0, chunk;
+	ssize_t ret, total = 0;
+
+	base64_encode_init(&ctx, &base64_maps_rfc4648);
+	while (off < srclen) {
+		chunk = random() % 70;
+		if (chunk > srclen - off)
+			chunk = srclen - off;
+		ret = base64_encode_update(&ctx, dest + total,
+					   base64_encoded_length(chunk),
+					   src + off, chunk);
+		if (ret == -1)
+			return -1;
+		total += ret;
+		off += chunk;
+	}
+	ret = base64_encode_done(&ctx, dest + total, 4);
+	return ret == -1 ? -1 : total + ret;
+}
+
+static ssize_t decode_chunked(char *dest, const char *src, size_t srclen)
+{
+	struct base64_decode_ctx ctx;
+	size_t off = 0, chunk;
+	ssize_t ret, total = 0;
+
+	base64_decode_init(&ctx, &base64_maps_rfc4648);
+	while (off < srclen) {
+		chunk = random() % 70;
+		if (chunk > srclen - off)
+			chunk = srclen - off;
+		ret = base64_decode_update(&ctx, dest + total,
+					   base64_decoded_length(chunk),
+					   src + off, chunk);
+		if (ret == -1)
+			return -1;
+		total += ret;
+		off += chunk;
+	}
+	ret = base64_decode_done(&ctx, dest + total, 3);
+	return ret == -1 ? -1 : total + ret;
+}
+
+int main(void)
+{
+	char src[LEN], enc[LEN * 2], ref[LEN * 2], dec[LEN + 3];
+	bool enc_ok = true, dec_ok = true, err_ok = true;
+	size_t len, i;
+
+	plan_tests(7);
+
+	for (i = 0; i < LEN; i++)
+		src[i] = random();
+
+	for (len = 0; len < LEN; len += 1 + random() % 23) {
+		ssize_t n = base64_encode(ref, sizeof(ref), src, len);
+
+		if (encode_chunked(enc, src, len) != n
+		    || memcmp(enc, ref, n) != 0)
+			enc_ok = false;
+		if (decode_chunked(dec, ref, n) != len
+		    || memcmp(dec, src, len) != 0)
+			dec_ok = false;
+
+		/* Same failure as the one-shot, wherever the bad char lands. */
+		if (n) {
+			ref[random() % n] = '*';
+			errno = 0;
+			if (decode_chunked(dec, ref, n) != -1 || errno != EDOM)
+				err_ok = false;
+		}
+	}
+	ok1(enc_ok);
+	ok1(dec_ok);
+	ok1(err_ok);
+
+	/* A bad tail shows up at the end. */
+	{
+		struct base64_decode_ctx ctx;
+
+		base64_decode_init(&ctx, &base64_maps_rfc4648);
+		ok1(base64_decode_update(&ctx, dec, 3, "Zm9vA", 5) == 3);
+		errno = 0;
+		ok1(base64_decode_done(&ctx, dec, 3) == -1 && errno == EINVAL);
+	}
+
+	/* Too-small destinations. */
+	{
+		struct base64_encode_ctx ctx;
+
+		base64_encode_init(&ctx, &base64_maps_rfc4648);
+		errno = 0;
+		ok1(base64_encode_update(&ctx, enc, 3, "foo", 3) == -1
+		    && errno == EOVERFLOW);
+		ok1(base64_encode_update(&ctx, enc, 0, "fo", 2) == 0
+		    && base64_encode_done(&ctx, enc, 4) == 4
+		    && memcmp(enc, "Zm8=", 4) == 0);
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,120 @@
+/* Time header-parsing style scanning over a buffer of HTTP-like headers:
+ * spans of token characters, searches for delimiters and substrings, and
+ * splitting values one at a time and all at once.  The argument is the
+ * number of passes over the (1MB) buffer, default 100.
+ */
+#include <ccan/bytestring/bytestring.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BUFSIZE (1 << 20)
+
+static const char *headers[] = {
+	"Host: www.example.com",
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0",
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8",
+	"Accept-Language: en-US,en;q=0.5",
+	"Accept-Encoding: gzip, deflate, br",
+	"Connection: keep-alive",
+	"Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; lang=en",
+	"Cache-Control: max-age=0",
+};
+
+static struct bytestring buf;
+
+static void report(const char *what, struct timeabs start, unsigned int passes,
+		   size_t n)
+{
+	double secs = time_to_nsec(time_between(time_now(), start)) / 1e9;
+
+	printf("%s: %.0fMB/s (%zu)\n", what,
+	       (double)buf.len * passes / secs / 1e6, n);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int passes = argc > 1 ? atoi(argv[1]) : 100;
+	const struct bytestring token = BYTESTRING(
+		"!#$%&'*+-.^_`|~0123456789"
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz");
+	struct bytestring rest, tok, toks[64];
+	struct timeabs start;
+	unsigned int pass, i;
+	char *p = malloc(BUFSIZE);
+	size_t len = 0, n;
+
+	for (i = 0; len < BUFSIZE - 200; i++)
+		len += sprintf(p + len, "%s\r\n%s", headers[i % 8],
+			       i % 8 == 7 ? "\r\n" : "");
+	buf = bytestring(p, len);
+
+	/* Field names: spans of token characters, then ':'. */
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++) {
+		for (rest = buf; rest.len; n++) {
+			size_t skip = bytestring_spn(rest, token);
+
+			skip += bytestring_cspn(bytestring_slice(rest, skip,
+								 rest.len),
+						BYTESTRING("\r\n"));
+			rest = bytestring_slice(rest, skip + 1, rest.len);
+		}
+	}
+	report("spn + cspn", start, passes, n);
+
+	/* Lines: the next of any of "\r\n". */
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++) {
+		for (rest = buf; rest.len; n++)
+			rest = bytestring_slice(rest,
+				bytestring_cspn(rest, BYTESTRING("\r\n")) + 1,
+				rest.len);
+	}
+	report("cspn lines", start, passes, n);
+
+	/* Ends of headers. */
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++) {
+		for (rest = buf; (tok = bytestring_bytestring(rest,
+					BYTESTRING("\r\n\r\n"))).ptr; n++)
+			rest = bytestring_slice(rest, tok.ptr + tok.len
+						- rest.ptr, rest.len);
+	}
+	report("bytestring_bytestring \"\\r\\n\\r\\n\"", start, passes, n);
+
+	/* A rare long string. */
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++)
+		n += bytestring_bytestring(bytestring_slice(buf, pass % 16,
+							    buf.len),
+			BYTESTRING("Accept-Charset: utf-8")).ptr != NULL;
+	report("bytestring_bytestring (missing)", start, passes, n);
+
+	/* Splitting everything on header punctuation. */
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++)
+		bytestring_foreach_splitchrs(tok, buf, BYTESTRING(",; \r\n"))
+			n++;
+	report("bytestring_foreach_splitchrs", start, passes, n);
+
+	start = time_now();
+	for (n = pass = 0; pass < passes; pass++) {
+		size_t got = 64;
+
+		toks[63].ptr = NULL;
+		for (rest = buf; got == 64; n += got) {
+			got = bytestring_splitchrs_all(rest,
+						       BYTESTRING(",; \r\n"),
+						       toks, 64);
+			if (got == 64)
+				rest = bytestring_slice(rest,
+					toks[63].ptr + toks[63].len + 1
+					- rest.ptr, rest.len);
+		}
+	}
+	report("bytestring_splitchrs_all", start, passes, n);
+
+	free(p);
+	return 0;
+}
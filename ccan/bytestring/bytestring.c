@@ -1,28 +1,328 @@
 /* Licensed under LGPLv2+ - see LICENSE file for details */
 #include "config.h"
 
+#include <stdint.h>
+
 #include <ccan/bytestring/bytestring.h>
 
-size_t bytestring_spn(struct bytestring s, struct bytestring accept)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BYTESTRING_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * A set of bytes, as a 256-bit map: byte c is bit (c >> 4) & 7 of
+ * lo[c & 15] (if c < 128) or hi[c & 15].  That's laid out so a vector
+ * can be tested with three shuffles: one looking up each byte's low
+ * nibble in lo (which gives zero for c >= 128), one in hi (after flipping
+ * the top bit), and one turning the high nibble into its bit.
+ */
+struct byteset {
+	uint8_t lo[16], hi[16];
+};
+
+static const uint8_t nibble_bit[16] = {
+	1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+};
+
+static void byteset_init(struct byteset *set, struct bytestring bytes)
 {
 	size_t i;
 
-	for (i = 0; i < s.len; i++)
-		if (bytestring_index(accept, s.ptr[i]) == NULL)
+	memset(set, 0, sizeof(*set));
+	for (i = 0; i < bytes.len; i++) {
+		unsigned char c = bytes.ptr[i];
+
+		(c & 0x80 ? set->hi : set->lo)[c & 15] |= nibble_bit[c >> 4];
+	}
+}
+
+static inline bool byteset_has(const struct byteset *set, char ch)
+{
+	unsigned char c = ch;
+
+	return (c & 0x80 ? set->hi : set->lo)[c & 15] & nibble_bit[c >> 4];
+}
+
+/* Length of the initial segment of p with bytes in (or, if !in, not in)
+ * set. */
+static size_t span_generic(const char *p, size_t len,
+			   const struct byteset *set, bool in)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (byteset_has(set, p[i]) != in)
 			return i;
 
-	return s.len;
+	return len;
 }
 
-size_t bytestring_cspn(struct bytestring s, struct bytestring reject)
+/* Split whole from i onwards (the current token starting at start, with
+ * n tokens already in toks), ending with the last token. */
+static size_t split_generic_from(struct bytestring whole,
+				 const struct byteset *set,
+				 struct bytestring *toks, size_t max,
+				 size_t i, size_t start, size_t n)
 {
+	for (; i < whole.len; i++) {
+		if (!byteset_has(set, whole.ptr[i]))
+			continue;
+		toks[n++] = bytestring_slice(whole, start, i);
+		if (n == max)
+			return n;
+		start = i + 1;
+	}
+	toks[n++] = bytestring_slice(whole, start, whole.len);
+	return n;
+}
+
+static size_t split_generic(struct bytestring whole, const struct byteset *set,
+			    struct bytestring *toks, size_t max)
+{
+	return split_generic_from(whole, set, toks, max, 0, 0, 0);
+}
+
+/* needle is at least two bytes, and no longer than haystack. */
+static const char *find_generic(const char *h, size_t hlen,
+				const char *n, size_t nlen)
+{
+	return memmem(h, hlen, n, nlen);
+}
+
+/* What a CPU can do faster than the generic versions. */
+struct block_ops {
+	size_t (*span)(const char *p, size_t len, const struct byteset *set,
+		       bool in);
+	size_t (*split)(struct bytestring whole, const struct byteset *set,
+			struct bytestring *toks, size_t max);
+	const char *(*find)(const char *h, size_t hlen,
+			    const char *n, size_t nlen);
+};
+
+static const struct block_ops generic_ops = {
+	span_generic, split_generic, find_generic
+};
+
+#ifdef BYTESTRING_X86
+/*
+ * Each kernel works a vector of bytes at a time, getting a mask with a
+ * bit per byte, and leaves the tail to the generic version.  The byte
+ * set test is the three shuffles described above.
+ */
+#define DEFINE_BLOCK_OPS(_sfx, _attr, _vec, _w, _bcast, _set1, _load,	\
+			 _and, _or, _xor, _srli, _shuffle, _cmpeq,	\
+			 _movemask, _all)				\
+_attr static inline uint32_t member_##_sfx(const char *p,		\
+					   _vec lo, _vec hi, _vec bits) \
+{									\
+	_vec b = _load((const void *)p);				\
+	_vec row = _or(_shuffle(lo, b),					\
+		       _shuffle(hi, _xor(b, _set1((char)0x80))));	\
+	_vec col = _shuffle(bits, _and(_srli(b, 4), _set1(0x0f)));	\
+									\
+	return _movemask(_cmpeq(_and(row, col), col));			\
+}									\
+									\
+_attr static size_t span_##_sfx(const char *p, size_t len,		\
+				const struct byteset *set, bool in)	\
+{									\
+	_vec lo = _bcast(set->lo), hi = _bcast(set->hi);		\
+	_vec bits = _bcast(nibble_bit);					\
+	size_t i;							\
+									\
+	for (i = 0; i + _w <= len; i += _w) {				\
+		uint32_t stop = member_##_sfx(p + i, lo, hi, bits);	\
+									\
+		if (in)							\
+			stop ^= _all;					\
+		if (stop)						\
+			return i + __builtin_ctz(stop);			\
+	}								\
+	return i + span_generic(p + i, len - i, set, in);		\
+}									\
+									\
+_attr static size_t split_##_sfx(struct bytestring whole,		\
+				 const struct byteset *set,		\
+				 struct bytestring *toks, size_t max)	\
+{									\
+	_vec lo = _bcast(set->lo), hi = _bcast(set->hi);		\
+	_vec bits = _bcast(nibble_bit);					\
+	size_t i, start = 0, n = 0;					\
+									\
+	for (i = 0; i + _w <= whole.len; i += _w) {			\
+		uint32_t hits = member_##_sfx(whole.ptr + i, lo, hi, bits); \
+									\
+		while (hits) {						\
+			size_t end = i + __builtin_ctz(hits);		\
+									\
+			toks[n++] = bytestring_slice(whole, start, end); \
+			if (n == max)					\
+				return n;				\
+			start = end + 1;				\
+			hits &= hits - 1;				\
+		}							\
+	}								\
+	return split_generic_from(whole, set, toks, max, i, start, n);	\
+}									\
+									\
+_attr static const char *find_##_sfx(const char *h, size_t hlen,	\
+				     const char *n, size_t nlen)	\
+{									\
+	_vec first = _set1(n[0]), last = _set1(n[nlen - 1]);		\
+	size_t i, compared = 0;						\
+									\
+	for (i = 0; i + nlen - 1 + _w <= hlen; i += _w) {		\
+		uint32_t hits = _movemask(_and(				\
+			_cmpeq(first, _load((const void *)(h + i))),	\
+			_cmpeq(last, _load((const void *)(h + i + nlen - 1))))); \
+									\
+		while (hits) {						\
+			const char *p = h + i + __builtin_ctz(hits);	\
+									\
+			if (memcmp(p + 1, n + 1, nlen - 2) == 0)	\
+				return p;				\
+			hits &= hits - 1;				\
+			compared += nlen;				\
+		}							\
+		if (compared > 4 * i + 1024)				\
+			break;						\
+	}								\
+	return memmem(h + i, hlen - i, n, nlen);			\
+}									\
+									\
+static const struct block_ops _sfx##_ops = {				\
+	span_##_sfx, split_##_sfx, find_##_sfx				\
+};
+
+#define BCAST128(_t) _mm_loadu_si128((const void *)(_t))
+#define BCAST256(_t) _mm256_broadcastsi128_si256(BCAST128(_t))
+
+DEFINE_BLOCK_OPS(ssse3, __attribute__((target("ssse3"))),
+		 __m128i, 16, BCAST128, _mm_set1_epi8, _mm_loadu_si128,
+		 _mm_and_si128, _mm_or_si128, _mm_xor_si128, _mm_srli_epi16,
+		 _mm_shuffle_epi8, _mm_cmpeq_epi8, _mm_movemask_epi8, 0xffff)
+DEFINE_BLOCK_OPS(avx2, __attribute__((target("avx2"))),
+		 __m256i, 32, BCAST256, _mm256_set1_epi8, _mm256_loadu_si256,
+		 _mm256_and_si256, _mm256_or_si256, _mm256_xor_si256,
+		 _mm256_srli_epi16, _mm256_shuffle_epi8, _mm256_cmpeq_epi8,
+		 _mm256_movemask_epi8, 0xffffffff)
+
+/* Chosen on first use.  Racing threads all choose the same. */
+static const struct block_ops *chosen_ops;
+
+static const struct block_ops *block_ops(void)
+{
+	const struct block_ops *ops = __atomic_load_n(&chosen_ops,
+						      __ATOMIC_RELAXED);
+
+	if (!ops) {
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			ops = &avx2_ops;
+		else if (__builtin_cpu_supports("ssse3"))
+			ops = &ssse3_ops;
+		else
+			ops = &generic_ops;
+		__atomic_store_n(&chosen_ops, ops, __ATOMIC_RELAXED);
+	}
+	return ops;
+}
+#else
+#define block_ops() (&generic_ops)
+#endif /* BYTESTRING_X86 */
+
+/*
+ * Building a big set costs about as much as looking for a few bytes in
+ * it with memchr(), and spans are often short (eg. header names), so
+ * check the first few bytes that way first.
+ */
+static size_t span(struct bytestring s, struct bytestring set, bool in)
+{
+	struct byteset bytes;
 	size_t i;
 
-	for (i = 0; i < s.len; i++)
-		if (bytestring_index(reject, s.ptr[i]) != NULL)
+	for (i = 0; i < s.len && i < set.len / 8; i++)
+		if ((bytestring_index(set, s.ptr[i]) != NULL) != in)
 			return i;
+	if (i == s.len)
+		return i;
+
+	byteset_init(&bytes, set);
+	return i + block_ops()->span(s.ptr + i, s.len - i, &bytes, in);
+}
+
+size_t bytestring_spn(struct bytestring s, struct bytestring accept)
+{
+	return span(s, accept, true);
+}
+
+size_t bytestring_cspn(struct bytestring s, struct bytestring reject)
+{
+	const char *p;
+
+	if (reject.len == 1) {
+		p = bytestring_index(s, reject.ptr[0]);
+		return p ? (size_t)(p - s.ptr) : s.len;
+	}
+	return span(s, reject, false);
+}
+
+struct bytestring bytestring_bytestring(struct bytestring haystack,
+					struct bytestring needle)
+{
+	const char *p;
+
+	if (needle.len > haystack.len)
+		return bytestring_NULL;
+	if (needle.len == 1) {
+		p = bytestring_index(haystack, needle.ptr[0]);
+		return p ? bytestring(p, 1) : bytestring_NULL;
+	}
+
+	/*
+	 * Vector versions check the first and last bytes of needle at a
+	 * block of positions at once, and only compare the rest where both
+	 * match.  Should the comparing come to dominate (eg. "aaaa" in
+	 * "aaaaaaab"), they fall back to memmem(), which is linear.
+	 */
+	if (needle.len > 1)
+		p = block_ops()->find(haystack.ptr, haystack.len,
+				      needle.ptr, needle.len);
+	else
+		p = memmem(haystack.ptr, haystack.len, needle.ptr, needle.len);
+	if (p)
+		return bytestring(p, needle.len);
+	else
+		return bytestring_NULL;
+}
+
+size_t bytestring_splitchrs_all(struct bytestring whole,
+				struct bytestring delim,
+				struct bytestring *toks, size_t max)
+{
+	struct byteset set;
+	size_t start = 0, n = 0;
+	const char *p;
 
-	return s.len;
+	if (!whole.len || !max)
+		return 0;
+
+	if (delim.len == 1) {
+		while ((p = memchr(whole.ptr + start, delim.ptr[0],
+				   whole.len - start)) != NULL) {
+			toks[n++] = bytestring_slice(whole, start,
+						     p - whole.ptr);
+			if (n == max)
+				return n;
+			start = p - whole.ptr + 1;
+		}
+		toks[n++] = bytestring_slice(whole, start, whole.len);
+		return n;
+	}
+
+	byteset_init(&set, delim);
+	return block_ops()->split(whole, &set, toks, max);
 }
 
 static struct bytestring _splitchr(struct bytestring whole, char delim,
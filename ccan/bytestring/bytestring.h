@@ -200,16 +200,8 @@ static inline const char *bytestring_rindex(struct bytestring haystack,
  * @needle in @haystack, or bytestring_NULL if @needle is not found
  * within @haystack.
  */
-static inline struct bytestring bytestring_bytestring(struct bytestring haystack,
-						      struct bytestring needle)
-{
-	const char *p = memmem(haystack.ptr, haystack.len,
-			       needle.ptr, needle.len);
-	if (p)
-		return bytestring(p, needle.len);
-	else
-		return bytestring_NULL;
-}
+struct bytestring bytestring_bytestring(struct bytestring haystack,
+					struct bytestring needle);
 
 /**
  * bytestring_spn - search a bytestring for a set of bytes
@@ -287,6 +279,31 @@ struct bytestring bytestring_splitchrs_next(struct bytestring whole,
 	     (_s).ptr;					       \
 	     (_s) = bytestring_splitchrs_next((_w), (_delim), (_s)))
 
+/**
+ * bytestring_splitchrs_all - split a bytestring on a set of delimiter
+ *                            characters, all at once
+ * @whole: a bytestring
+ * @delim: delimiter characters
+ * @toks: array to fill with the substrings
+ * @max: number of elements in @toks
+ *
+ * Fills @toks with the substrings bytestring_foreach_splitchrs() would
+ * give, finding the delimiters in one pass.  Returns the number of
+ * substrings filled in.  If that's @max there may be more: they follow
+ * bytestring_splitchrs_next(@whole, @delim, @toks[@max - 1]).
+ *
+ * Example:
+ *	struct bytestring hdr = BYTESTRING("text/html; charset=utf-8");
+ *	struct bytestring parts[4];
+ *
+ *	assert(bytestring_splitchrs_all(hdr, BYTESTRING("; "),
+ *					parts, 4) == 3);
+ *	assert(bytestring_eq(parts[2], BYTESTRING("charset=utf-8")));
+ */
+size_t bytestring_splitchrs_all(struct bytestring whole,
+				struct bytestring delim,
+				struct bytestring *toks, size_t max);
+
 /**
  * bytestring_splitstr_first - split a bytestring on a delimiter string
  * @whole: a bytestring
@@ -0,0 +1,134 @@
+#include "config.h"
+
+#include <ccan/bytestring/bytestring.h>
+#include <ccan/tap/tap.h>
+
+#include <ccan/bytestring/bytestring.c>
+
+#define RUNS 1000
+#define MAXLEN 200
+
+/* The obvious versions, to check against. */
+static size_t ref_spn(struct bytestring s, struct bytestring set, bool in)
+{
+	size_t i;
+
+	for (i = 0; i < s.len; i++)
+		if ((memchr(set.ptr, s.ptr[i], set.len) != NULL) != in)
+			break;
+	return i;
+}
+
+static const char *ref_find(struct bytestring h, struct bytestring n)
+{
+	size_t i;
+
+	for (i = 0; i + n.len <= h.len; i++)
+		if (memcmp(h.ptr + i, n.ptr, n.len) == 0)
+			return h.ptr + i;
+	return NULL;
+}
+
+/* Random bytes from an alphabet of the given size, including \0 and
+ * bytes with the top bit set. */
+static struct bytestring random_bytes(char *buf, size_t len, int alphabet)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (random() % alphabet) * (256 / alphabet);
+	return bytestring(buf, len);
+}
+
+int main(void)
+{
+	char sbuf[MAXLEN], setbuf[8];
+	struct bytestring toks[MAXLEN + 1], tok;
+	unsigned int run;
+	bool spn_ok = true, find_ok = true, split_ok = true;
+	size_t i, n;
+
+	/* This is how many tests you plan to run */
+	plan_tests(3 + 6);
+
+	/* Every version this CPU can run, ending with the usual one. */
+#ifdef BYTESTRING_X86
+	__builtin_cpu_init();
+	chosen_ops = &generic_ops;
+	for (run = 0; run < RUNS * 3; run++) {
+		if (run == RUNS)
+			chosen_ops = __builtin_cpu_supports("ssse3")
+				? &ssse3_ops : NULL;
+		else if (run == RUNS * 2)
+			chosen_ops = NULL;
+#else
+	for (run = 0; run < RUNS; run++) {
+#endif
+		int alphabet = 2 + run % 7 * 10;
+		struct bytestring s = random_bytes(sbuf, random() % MAXLEN,
+						   alphabet);
+		struct bytestring set = random_bytes(setbuf, run % 8,
+						     alphabet);
+		struct bytestring needle;
+
+		/* Mostly-matching sets, to get long spans. */
+		if (run % 2 && set.len < s.len)
+			set = bytestring_slice(s, 0, set.len);
+		if (bytestring_spn(s, set) != ref_spn(s, set, true)
+		    || bytestring_cspn(s, set) != ref_spn(s, set, false))
+			spn_ok = false;
+
+		/* Needles from the haystack, and random ones. */
+		i = s.len ? random() % s.len : 0;
+		needle = run % 3 ? bytestring_slice(s, i, i + run % 40)
+			: set;
+		if (bytestring_bytestring(s, needle).ptr != ref_find(s, needle))
+			find_ok = false;
+
+		/* All at once is the same as one at a time. */
+		n = bytestring_splitchrs_all(s, set, toks, MAXLEN + 1);
+		i = 0;
+		bytestring_foreach_splitchrs(tok, s, set) {
+			if (i >= n || tok.ptr != toks[i].ptr
+			    || tok.len != toks[i].len)
+				split_ok = false;
+			i++;
+		}
+		if (i != n)
+			split_ok = false;
+	}
+	ok1(spn_ok);
+	ok1(find_ok);
+	ok1(split_ok);
+
+	/* Plenty of near misses don't make the search quadratic. */
+	{
+		static char h[100000];
+		char needle[1000];
+
+		memset(h, 'a', sizeof(h));
+		memset(needle, 'a', sizeof(needle));
+		needle[sizeof(needle) - 1] = 'b';
+		ok1(!bytestring_bytestring(bytestring(h, sizeof(h)),
+					   bytestring(needle,
+						      sizeof(needle))).ptr);
+		h[sizeof(h) - 1] = 'b';
+		ok1(bytestring_bytestring(bytestring(h, sizeof(h)),
+					  bytestring(needle, sizeof(needle))).ptr
+		    == h + sizeof(h) - sizeof(needle));
+	}
+
+	/* Running out of room, and carrying on. */
+	tok = BYTESTRING("a,b;;c,");
+	n = bytestring_splitchrs_all(tok, BYTESTRING(",;"), toks, 2);
+	ok1(n == 2 && bytestring_eq(toks[1], BYTESTRING("b")));
+	toks[2] = bytestring_splitchrs_next(tok, BYTESTRING(",;"), toks[1]);
+	ok1(bytestring_eq(toks[2], BYTESTRING("")));
+	ok1(bytestring_splitchrs_all(tok, BYTESTRING(",;"), toks, 10) == 5
+	    && bytestring_eq(toks[3], BYTESTRING("c"))
+	    && bytestring_eq(toks[4], BYTESTRING("")));
+	ok1(bytestring_splitchrs_all(bytestring_NULL, BYTESTRING(","),
+				     toks, 10) == 0);
+
+	return exit_status();
+}
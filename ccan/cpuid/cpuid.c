@@ -39,13 +39,22 @@ enum {
 #ifndef _MSC_VER
 static void get_cpuid(cpuid_t info, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
 {
+#if defined(__x86_64__)
+	/* xchg of the 32-bit registers would zero the top of %rbx.  */
+	__asm__(
+		"cpuid\n\t"
+		: "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+		: "0" (info), "2" (0)
+	);
+#else
 	__asm__(
 		"xchg %%ebx, %%edi\n\t" 	/* 32bit PIC: Don't clobber ebx.  */
 		"cpuid\n\t"
 		"xchg %%ebx, %%edi\n\t"
 		: "=a"(*eax), "=D"(*ebx), "=c"(*ecx), "=d"(*edx)
-		: "0" (info)
+		: "0" (info), "2" (0)
 	);
+#endif
 }
 #else
 #include <intrin.h>
@@ -53,7 +62,7 @@ static void get_cpuid(cpuid_t info, uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
 static void get_cpuid(cpuid_t info, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
 {
 	uint32_t registers[4];
-	__cpuid(registers, info);
+	__cpuidex(registers, info, 0);
 
 	*eax = registers[0];
 	*ebx = registers[1];
@@ -151,63 +160,41 @@ bool cpuid_test_feature(cpuid_t feature)
 	return (feature <= cpuid_highest_ext_func_supported());
 }
 
-#if defined(__GNUC__) || defined(__clang__)
-static uint32_t fetch_ecx(uint32_t what)
+/* The callers cache these per leaf, so don't cache here as well. */
+static uint32_t fetch_ebx(uint32_t what)
 {
-	static uint32_t ecx;
-	if (ecx == 0) {
-		asm volatile(
-			"cpuid\n\t"
-			: "=c" (ecx)
-			: "a" (what)
-		);
-	}
-
-	return ecx;
-}
+	uint32_t eax, ebx, ecx, edx;
 
-static uint32_t fetch_edx(uint32_t what)
-{
-	static uint32_t edx;
-	if (edx == 0) {
-		asm volatile(
-			"cpuid\n\t"
-			: "=d" (edx)
-			: "a" (what)
-		);
+	/* Leaf 7 only exists if the highest basic leaf is >= 7. */
+	if (what == CPUID_STRUCTURED_EXTENDED_FEATURES) {
+		get_cpuid(CPUID_VENDORID, &eax, &ebx, &ecx, &edx);
+		if (eax < what)
+			return 0;
 	}
-
-	return edx;
+	get_cpuid((cpuid_t)what, &eax, &ebx, &ecx, &edx);
+	return ebx;
 }
-#elif defined(_MSC_VER)
+
 static uint32_t fetch_ecx(uint32_t what)
 {
-	static uint32_t _ecx;
-	if (_ecx == 0) {
-		__asm {
-			mov eax, what
-			cpuid
-			mov _ecx, ecx
-		};
-	}
+	uint32_t eax, ebx, ecx, edx;
 
-	return _ecx;
+	if (what == CPUID_STRUCTURED_EXTENDED_FEATURES) {
+		get_cpuid(CPUID_VENDORID, &eax, &ebx, &ecx, &edx);
+		if (eax < what)
+			return 0;
+	}
+	get_cpuid((cpuid_t)what, &eax, &ebx, &ecx, &edx);
+	return ecx;
 }
 
 static uint32_t fetch_edx(uint32_t what)
 {
-	static uint32_t _edx;
-	if (_edx == 0) {
-		__asm {
-			mov eax, what
-			cpuid
-			mov _edx, edx
-		};
-	}
+	uint32_t eax, ebx, ecx, edx;
 
-	return _edx;
+	get_cpuid((cpuid_t)what, &eax, &ebx, &ecx, &edx);
+	return edx;
 }
-#endif
 
 #define DEFINE_FEATURE_FUNC(NAME, REGISTER, TYPE) \
 	bool cpuid_has_##NAME(int feature) \
@@ -224,8 +211,39 @@ DEFINE_FEATURE_FUNC(edxfeature, edx, CPUID_PROCINFO_AND_FEATUREBITS)
 DEFINE_FEATURE_FUNC(ecxfeature_ext, ecx, CPUID_EXTENDED_PROC_INFO_FEATURE_BITS)
 DEFINE_FEATURE_FUNC(edxfeature_ext, edx, CPUID_EXTENDED_PROC_INFO_FEATURE_BITS)
 
+DEFINE_FEATURE_FUNC(ebxfeature7, ebx, CPUID_STRUCTURED_EXTENDED_FEATURES)
+DEFINE_FEATURE_FUNC(ecxfeature7, ecx, CPUID_STRUCTURED_EXTENDED_FEATURES)
+
 #undef DEFINE_FEATURE_FUNC
 
+/* XCR0 says which register state the OS saves on context switch. */
+static uint64_t xgetbv0(void)
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t lo, hi;
+
+	/* xgetbv, spelt out for old assemblers. */
+	__asm__(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+bool cpuid_os_has_avx(void)
+{
+	/* SSE and AVX state. */
+	return cpuid_has_ecxfeature(CPUID_FEAT_ECX_OSXSAVE)
+		&& cpuid_has_ecxfeature(CPUID_FEAT_ECX_AVX)
+		&& (xgetbv0() & 0x6) == 0x6;
+}
+
+bool cpuid_os_has_avx512(void)
+{
+	/* As above, plus opmask, upper zmm0-15 and zmm16-31 state. */
+	return cpuid_os_has_avx() && (xgetbv0() & 0xe0) == 0xe0;
+}
+
 cputype_t cpuid_get_cpu_type(void)
 {
 	static cputype_t cputype;
@@ -319,6 +337,11 @@ void cpuid(cpuid_t request, uint32_t *buf)
 			buf[7] = (ebx >> 16) & 0xFF;
 			buf[8] = ebx >> 24;
 			break;
+		case CPUID_STRUCTURED_EXTENDED_FEATURES:
+			buf[0] = ebx;
+			buf[1] = ecx;
+			buf[2] = edx;
+			break;
 		case CPUID_CACHE_AND_TLBD_INFO:
 			buf[0] = eax;
 			buf[1] = ebx;
@@ -41,6 +41,9 @@
  * 	Cache and TLBD Information.
  * 	For AMD: Use CPUID_EXTENDED_L2_CACHE_FEATURES
  *
+ * %CPUID_STRUCTURED_EXTENDED_FEATURES:
+ * 	Structured extended feature flags (AVX2, SHA, etc.).
+ *
  * %CPUID_HIGHEST_EXTENDED_FUNCTION_SUPPORTED:
  * 	Highest extended function supported address.
  * 	Can be like 0x80000008.
@@ -69,6 +72,7 @@ typedef enum cpuid {
 	CPUID_VENDORID 					= 0,
 	CPUID_PROCINFO_AND_FEATUREBITS 			= 1,
 	CPUID_CACHE_AND_TLBD_INFO 			= 2,
+	CPUID_STRUCTURED_EXTENDED_FEATURES 		= 7,
 
 	CPUID_HIGHEST_EXTENDED_FUNCTION_SUPPORTED 	= 0x80000000,
 	CPUID_EXTENDED_PROC_INFO_FEATURE_BITS 		= 0x80000001,
@@ -213,6 +217,29 @@ enum {
 	CPUID_EXTFEAT_EDX_3DNOW 		= 1 << 31
 };
 
+/* Leaf 7 (subleaf 0) feature bits: see cpuid_has_ebxfeature7().  */
+enum {
+	CPUID_FEAT7_EBX_FSGSBASE 		= 1 << 0,
+	CPUID_FEAT7_EBX_BMI1 			= 1 << 3,
+	CPUID_FEAT7_EBX_AVX2 			= 1 << 5,
+	CPUID_FEAT7_EBX_BMI2 			= 1 << 8,
+	CPUID_FEAT7_EBX_ERMS 			= 1 << 9,
+	CPUID_FEAT7_EBX_AVX512F 		= 1 << 16,
+	CPUID_FEAT7_EBX_AVX512DQ 		= 1 << 17,
+	CPUID_FEAT7_EBX_RDSEED 			= 1 << 18,
+	CPUID_FEAT7_EBX_ADX 			= 1 << 19,
+	CPUID_FEAT7_EBX_AVX512CD 		= 1 << 28,
+	CPUID_FEAT7_EBX_SHA 			= 1 << 29,
+	CPUID_FEAT7_EBX_AVX512BW 		= 1 << 30,
+	CPUID_FEAT7_EBX_AVX512VL 		= 1u << 31,
+
+	CPUID_FEAT7_ECX_AVX512VBMI 		= 1 << 1,
+	CPUID_FEAT7_ECX_GFNI 			= 1 << 8,
+	CPUID_FEAT7_ECX_VAES 			= 1 << 9,
+	CPUID_FEAT7_ECX_VPCLMULQDQ 		= 1 << 10,
+	CPUID_FEAT7_ECX_AVX512VPOPCNTDQ 	= 1 << 14
+};
+
 typedef enum cputype {
 	CT_NONE,
 	CT_AMDK5,
@@ -425,6 +452,63 @@ bool cpuid_has_edxfeature(int feature);
 bool cpuid_has_ecxfeature_ext(int extfeature);
 bool cpuid_has_edxfeature_ext(int extfeature);
 
+/**
+ * cpuid_has_ebxfeature7 - Test if a structured extended @feature is supported
+ * @feature: the CPUID_FEAT7_EBX_* feature to test.
+ *
+ * Returns false if the CPU doesn't have leaf 7 at all.  Note that for
+ * AVX2 and AVX-512 the OS must also save the wider registers: see
+ * cpuid_os_has_avx().
+ *
+ * Example:
+ *	#include <ccan/cpuid/cpuid.h>
+ *	#include <stdio.h>
+ *
+ *	int main(void)
+ *	{
+ *		if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+ *		    && cpuid_os_has_avx())
+ *			printf("We can use AVX2\n");
+ *		return 0;
+ *	}
+ */
+bool cpuid_has_ebxfeature7(int feature);
+
+/**
+ * cpuid_has_ecxfeature7 - Test if a structured extended @feature is supported
+ * @feature: the CPUID_FEAT7_ECX_* feature to test.
+ *
+ * As cpuid_has_ebxfeature7(), for the features reported in ECX.
+ *
+ * Example:
+ *	#include <ccan/cpuid/cpuid.h>
+ *	#include <stdio.h>
+ *
+ *	int main(void)
+ *	{
+ *		if (cpuid_has_ecxfeature7(CPUID_FEAT7_ECX_VPCLMULQDQ))
+ *			printf("We have wide carry-less multiply\n");
+ *		return 0;
+ *	}
+ */
+bool cpuid_has_ecxfeature7(int feature);
+
+/**
+ * cpuid_os_has_avx - Test if the OS saves the AVX (ymm) registers
+ *
+ * The CPU may support AVX while the OS doesn't save the upper halves
+ * of the registers on context switch, in which case AVX instructions
+ * fault.  This checks OSXSAVE and the XCR0 register.
+ */
+bool cpuid_os_has_avx(void);
+
+/**
+ * cpuid_os_has_avx512 - Test if the OS saves the AVX-512 registers
+ *
+ * As cpuid_os_has_avx(), but also checks the opmask and zmm state.
+ */
+bool cpuid_os_has_avx512(void);
+
 #else
 #include <ccan/build_assert/build_assert.h>
 
@@ -441,6 +525,10 @@ bool cpuid_has_edxfeature_ext(int extfeature);
 #define cpuid_test_feature(feature) 			BUILD_ASSERT_OR_ZERO(0)
 #define cpuid_has_ecxfeature(feature) 			BUILD_ASSERT_OR_ZERO(0)
 #define cpuid_has_edxfeature(feature) 			BUILD_ASSERT_OR_ZERO(0)
+#define cpuid_has_ebxfeature7(feature) 			BUILD_ASSERT_OR_ZERO(0)
+#define cpuid_has_ecxfeature7(feature) 			BUILD_ASSERT_OR_ZERO(0)
+#define cpuid_os_has_avx() 				BUILD_ASSERT_OR_ZERO(0)
+#define cpuid_os_has_avx512() 				BUILD_ASSERT_OR_ZERO(0)
 
 #endif
 #endif
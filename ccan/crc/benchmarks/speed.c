@@ -0,0 +1,193 @@
+/* Test speed of each crc32c, crc32_ieee and crc64_iso implementation
+ * across buffer sizes, and of crc32c_parallel() on a large buffer.  Every
+ * result is checked against the one-byte-at-a-time table lookup. */
+#include <ccan/crc/crc.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+struct impl {
+	const char *name;
+	uint32_t (*crc)(uint32_t, const void *, size_t);
+	bool usable;
+};
+
+struct impl64 {
+	const char *name;
+	uint64_t (*crc)(uint64_t, const void *, size_t);
+	bool usable;
+};
+
+static uint32_t crc32c_bytewise(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32c_bytes(crc, buf, size);
+}
+
+static uint32_t crc32_ieee_bytewise(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32_ieee_bytes(crc, buf, size);
+}
+
+static uint64_t crc64_iso_bytewise(uint64_t crc, const void *buf, size_t size)
+{
+	return crc64_iso_bytes(crc, buf, size);
+}
+
+/* The same as crc32_ieee(), on the inverted crc like the others. */
+static uint32_t crc32_ieee_api(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32_ieee(crc ^ ~0U, buf, size) ^ ~0U;
+}
+
+static uint32_t ref32(const uint32_t *tab, const uint8_t *p, size_t size)
+{
+	uint32_t crc = 0;
+
+	while (size--)
+		crc = tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static uint64_t ref64(const uint64_t *tab, const uint8_t *p, size_t size)
+{
+	uint64_t crc = 0;
+
+	while (size--)
+		crc = tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static double mbps(struct timeabs start, size_t bytes)
+{
+	return (double)bytes / time_to_usec(time_between(time_now(), start));
+}
+
+static bool bench32(const char *alg, const struct impl *impls, size_t n,
+		    const uint32_t *tab, const uint8_t *buf, size_t total)
+{
+	size_t size, i, j;
+	uint32_t crc = 0;
+
+	printf("%s:\n", alg);
+	for (size = 64; size <= 1 << 20; size *= 4) {
+		uint32_t expect = ref32(tab, buf, size);
+
+		printf("  %zu bytes:\n", size);
+		for (i = 0; i < n; i++) {
+			struct timeabs start;
+
+			if (!impls[i].usable)
+				continue;
+			if (impls[i].crc(0, buf, size) != expect) {
+				printf("    %s: WRONG ANSWER\n", impls[i].name);
+				return false;
+			}
+			start = time_now();
+			for (j = 0; j < total / size; j++)
+				crc = impls[i].crc(crc, buf, size);
+			printf("    %s: %.0f MB/s\n", impls[i].name,
+			       mbps(start, total / size * size));
+		}
+	}
+	printf("  (crc = %08x)\n", crc);
+	return true;
+}
+
+static bool bench64(const char *alg, const struct impl64 *impls, size_t n,
+		    const uint64_t *tab, const uint8_t *buf, size_t total)
+{
+	size_t size, i, j;
+	uint64_t crc = 0;
+
+	printf("%s:\n", alg);
+	for (size = 64; size <= 1 << 20; size *= 4) {
+		uint64_t expect = ref64(tab, buf, size);
+
+		printf("  %zu bytes:\n", size);
+		for (i = 0; i < n; i++) {
+			struct timeabs start;
+
+			if (!impls[i].usable)
+				continue;
+			if (impls[i].crc(0, buf, size) != expect) {
+				printf("    %s: WRONG ANSWER\n", impls[i].name);
+				return false;
+			}
+			start = time_now();
+			for (j = 0; j < total / size; j++)
+				crc = impls[i].crc(crc, buf, size);
+			printf("    %s: %.0f MB/s\n", impls[i].name,
+			       mbps(start, total / size * size));
+		}
+	}
+	printf("  (crc = %016llx)\n", (unsigned long long)crc);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct impl impls32c[] = {
+		{ "bytewise", crc32c_bytewise, true },
+		{ "slicing-by-8", crc32c_sb8, true },
+#ifdef CRC_X86
+		{ "sse4.2", crc32c_sse42,
+		  cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_2) },
+		{ "pclmul", crc32c_pclmul, crc_have_pclmul() },
+#endif
+#ifdef CRC_ARM
+		{ "armv8", crc32c_arm, true },
+#endif
+		{ "crc32c()", crc32c, true },
+	};
+	struct impl impls32[] = {
+		{ "bytewise", crc32_ieee_bytewise, true },
+		{ "slicing-by-16", crc32_ieee_sb16, true },
+#ifdef CRC_X86
+		{ "pclmul", crc32_ieee_pclmul, crc_have_pclmul() },
+#endif
+#ifdef CRC_ARM
+		{ "armv8", crc32_ieee_arm, true },
+#endif
+		{ "crc32_ieee()", crc32_ieee_api, true },
+	};
+	struct impl64 impls64[] = {
+		{ "bytewise", crc64_iso_bytewise, true },
+		{ "slicing-by-8", crc64_iso_sb8, true },
+#ifdef CRC_X86
+		{ "pclmul", crc64_iso_pclmul, crc_have_pclmul() },
+#endif
+		{ "crc64_iso()", crc64_iso, true },
+	};
+	size_t total = argv[1] ? atol(argv[1]) : 256 * 1024 * 1024;
+	size_t size, i;
+	uint8_t *buf = malloc(1 << 20);
+	uint32_t expect;
+
+	for (i = 0; i < 1 << 20; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	if (!bench32("crc32c", impls32c, ARRAY_SIZE(impls32c),
+		     crc32c_table(), buf, total)
+	    || !bench32("crc32_ieee", impls32, ARRAY_SIZE(impls32),
+			crc32_ieee_table(), buf, total)
+	    || !bench64("crc64_iso", impls64, ARRAY_SIZE(impls64),
+			crc64_iso_table(), buf, total))
+		return 1;
+	free(buf);
+
+	size = 256 * 1024 * 1024;
+	buf = malloc(size);
+	memset(buf, 0x5A, size);
+	expect = crc32c(0, buf, size);
+	printf("%zu bytes, crc32c_parallel():\n", size);
+	for (i = 1; i <= 64; i *= 2) {
+		struct timeabs start = time_now();
+
+		if (crc32c_parallel(0, buf, size, i) != expect) {
+			printf("  %zu threads: WRONG ANSWER\n", i);
+			return 1;
+		}
+		printf("  %zu threads: %.0f MB/s\n", i, mbps(start, size));
+	}
+	free(buf);
+	return 0;
+}
@@ -24,284 +24,597 @@
  */
 
 #include "crc.h"
+#include "crc_tables.h"
 #include <ccan/array_size/array_size.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /*
- * This is the CRC-32C table
- * Generated with:
- * width = 32 bits
- * poly = 0x1EDC6F41
- * reflect input bytes = true
- * reflect output bytes = true
+ * CRC-32C has three implementations, picked the first time crc32c() is
+ * called:
+ *
+ * - On x86 with SSE4.2 and PCLMULQDQ, large buffers are folded 64 bytes
+ *   at a time with carry-less multiplies, as described in Intel's "Fast
+ *   CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * - On x86 with SSE4.2, the crc32 instruction does 8 bytes at a time.
+ *   (On ARMv8 with the CRC extension, so do the ACLE intrinsics.)
+ * - Otherwise we use slicing-by-8 over the tables in crc_tables.h.
+ *
+ * All of them give exactly the same results as the simple table lookup.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_X86 1
+#include <ccan/cpuid/cpuid.h>
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC_ARM 1
+#include <arm_acle.h>
+#endif
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t crc32c_bytes(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size--)
+		crc = crc32c_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Consumes 8 bytes per step, using tables for 0-7 following zero bytes. */
+static uint32_t crc32c_sb8(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size >= 8) {
+		crc ^= get_le32(p);
+		crc = crc32c_tab[7][crc & 0xFF]
+			^ crc32c_tab[6][(crc >> 8) & 0xFF]
+			^ crc32c_tab[5][(crc >> 16) & 0xFF]
+			^ crc32c_tab[4][crc >> 24]
+			^ crc32c_tab[3][p[4]]
+			^ crc32c_tab[2][p[5]]
+			^ crc32c_tab[1][p[6]]
+			^ crc32c_tab[0][p[7]];
+		p += 8;
+		size -= 8;
+	}
+	return crc32c_bytes(crc, p, size);
+}
+
+#ifdef CRC_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	/* Align, so the 8-byte loads don't straddle cache lines. */
+	while (size && ((uintptr_t)p & 7)) {
+		crc = _mm_crc32_u8(crc, *p++);
+		size--;
+	}
+#ifdef __x86_64__
+	while (size >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc = (uint32_t)_mm_crc32_u64(crc, v);
+		p += 8;
+		size -= 8;
+	}
+#endif
+	while (size >= 4) {
+		uint32_t v;
+		memcpy(&v, p, 4);
+		crc = _mm_crc32_u32(crc, v);
+		p += 4;
+		size -= 4;
+	}
+	while (size--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+
+/*
+ * Fold constants for a reflected 32-bit crc: x^(d+32) and x^(d-32) mod P,
+ * bit-reflected and shifted left one, for distances d of 512 and 128 bits.
  */
-static const uint32_t crc32c_tab[] = {
-	0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4,
-	0xC79A971F, 0x35F1141C, 0x26A1E7E8, 0xD4CA64EB,
-	0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
-	0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24,
-	0x105EC76F, 0xE235446C, 0xF165B798, 0x030E349B,
-	0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
-	0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54,
-	0x5D1D08BF, 0xAF768BBC, 0xBC267848, 0x4E4DFB4B,
-	0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
-	0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35,
-	0xAA64D611, 0x580F5512, 0x4B5FA6E6, 0xB93425E5,
-	0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
-	0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45,
-	0xF779DEAE, 0x05125DAD, 0x1642AE59, 0xE4292D5A,
-	0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
-	0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595,
-	0x417B1DBC, 0xB3109EBF, 0xA0406D4B, 0x522BEE48,
-	0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
-	0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687,
-	0x0C38D26C, 0xFE53516F, 0xED03A29B, 0x1F682198,
-	0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
-	0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38,
-	0xDBFC821C, 0x2997011F, 0x3AC7F2EB, 0xC8AC71E8,
-	0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
-	0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096,
-	0xA65C047D, 0x5437877E, 0x4767748A, 0xB50CF789,
-	0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
-	0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46,
-	0x7198540D, 0x83F3D70E, 0x90A324FA, 0x62C8A7F9,
-	0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
-	0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36,
-	0x3CDB9BDD, 0xCEB018DE, 0xDDE0EB2A, 0x2F8B6829,
-	0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
-	0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93,
-	0x082F63B7, 0xFA44E0B4, 0xE9141340, 0x1B7F9043,
-	0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
-	0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3,
-	0x55326B08, 0xA759E80B, 0xB4091BFF, 0x466298FC,
-	0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
-	0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033,
-	0xA24BB5A6, 0x502036A5, 0x4370C551, 0xB11B4652,
-	0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
-	0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D,
-	0xEF087A76, 0x1D63F975, 0x0E330A81, 0xFC588982,
-	0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
-	0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622,
-	0x38CC2A06, 0xCAA7A905, 0xD9F75AF1, 0x2B9CD9F2,
-	0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
-	0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530,
-	0x0417B1DB, 0xF67C32D8, 0xE52CC12C, 0x1747422F,
-	0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
-	0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0,
-	0xD3D3E1AB, 0x21B862A8, 0x32E8915C, 0xC083125F,
-	0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
-	0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90,
-	0x9E902E7B, 0x6CFBAD78, 0x7FAB5E8C, 0x8DC0DD8F,
-	0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
-	0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1,
-	0x69E9F0D5, 0x9B8273D6, 0x88D28022, 0x7AB90321,
-	0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
-	0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81,
-	0x34F4F86A, 0xC69F7B69, 0xD5CF889D, 0x27A40B9E,
-	0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
-	0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+struct crc_fold_consts {
+	uint64_t k512_lo, k512_hi, k128_lo, k128_hi;
 };
 
+static const struct crc_fold_consts crc32c_fold = {
+	0x740eef02, 0x9e4addf8, 0xf20c0dfe, 0x14cd00bd6
+};
+
+__attribute__((target("sse4.2,pclmul")))
+static inline __m128i fold_128(__m128i x, __m128i k, __m128i next)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+					   _mm_clmulepi64_si128(x, k, 0x11)),
+			     next);
+}
+
 /*
- * Steps through buffer one byte at at time, calculates reflected
- * crc using table.
+ * Fold a buffer of at least 64 bytes (with @init xored into the start)
+ * down to 16 bytes in @out with the same remainder.  Returns the number
+ * of bytes consumed; the crc of @out with a zero initial value, continued
+ * over the rest of the buffer, is the crc of the whole.
  */
-uint32_t crc32c(uint32_t crc, const void *buf, size_t size)
+__attribute__((target("sse4.2,pclmul")))
+static size_t crc_fold(const struct crc_fold_consts *c, __m128i init,
+		       const uint8_t *p, size_t size, uint8_t out[16])
+{
+	__m128i k512 = _mm_set_epi64x(c->k512_hi, c->k512_lo);
+	__m128i k128 = _mm_set_epi64x(c->k128_hi, c->k128_lo);
+	__m128i x0, x1, x2, x3;
+	size_t done = 64;
+
+	x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), init);
+	x1 = _mm_loadu_si128((const __m128i *)(p + 16));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 32));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 48));
+
+	while (size - done >= 64) {
+		const __m128i *q = (const __m128i *)(p + done);
+		x0 = fold_128(x0, k512, _mm_loadu_si128(q));
+		x1 = fold_128(x1, k512, _mm_loadu_si128(q + 1));
+		x2 = fold_128(x2, k512, _mm_loadu_si128(q + 2));
+		x3 = fold_128(x3, k512, _mm_loadu_si128(q + 3));
+		done += 64;
+	}
+
+	x1 = fold_128(x0, k128, x1);
+	x2 = fold_128(x1, k128, x2);
+	x3 = fold_128(x2, k128, x3);
+	while (size - done >= 16) {
+		x3 = fold_128(x3, k128,
+			      _mm_loadu_si128((const __m128i *)(p + done)));
+		done += 16;
+	}
+
+	_mm_storeu_si128((__m128i *)out, x3);
+	return done;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32c_pclmul(uint32_t crc, const void *buf, size_t size)
 {
 	const uint8_t *p = buf;
+	uint8_t folded[16];
+	size_t done;
 
-	while (size--)
-		crc = crc32c_tab[(crc ^ *p++) & 0xFFL] ^ (crc >> 8);
+	/* Below this, setting up the fold costs more than it saves. */
+	if (size < 256)
+		return crc32c_sse42(crc, buf, size);
 
+	done = crc_fold(&crc32c_fold, _mm_cvtsi32_si128(crc), p, size, folded);
+	crc = crc32c_sse42(0, folded, sizeof(folded));
+	return crc32c_sse42(crc, p + done, size - done);
+}
+#endif /* CRC_X86 */
+
+#ifdef CRC_ARM
+static uint32_t crc32c_arm(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size && ((uintptr_t)p & 7)) {
+		crc = __crc32cb(crc, *p++);
+		size--;
+	}
+	while (size >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc = __crc32cd(crc, v);
+		p += 8;
+		size -= 8;
+	}
+	while (size--)
+		crc = __crc32cb(crc, *p++);
 	return crc;
 }
+#endif /* CRC_ARM */
+
+/*
+ * Each dispatcher replaces itself with the best implementation on first
+ * use.  Threads (such as crc32c_parallel's) may race to do so, but they
+ * all store the same pointer, so relaxed atomics are enough.
+ */
+#ifdef __GNUC__
+#define IMPL_LOAD(impl) __atomic_load_n(&(impl), __ATOMIC_RELAXED)
+#define IMPL_STORE(impl, fn) __atomic_store_n(&(impl), (fn), __ATOMIC_RELAXED)
+#else
+#define IMPL_LOAD(impl) (impl)
+#define IMPL_STORE(impl, fn) ((impl) = (fn))
+#endif
+
+static uint32_t crc32c_dispatch(uint32_t crc, const void *buf, size_t size);
+static uint32_t (*crc32c_impl)(uint32_t, const void *, size_t)
+	= crc32c_dispatch;
+
+static uint32_t crc32c_dispatch(uint32_t crc, const void *buf, size_t size)
+{
+	uint32_t (*impl)(uint32_t, const void *, size_t);
+
+#if defined(CRC_X86)
+	if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_2)) {
+		if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_PCLMUL))
+			impl = crc32c_pclmul;
+		else
+			impl = crc32c_sse42;
+	} else
+		impl = crc32c_sb8;
+#elif defined(CRC_ARM)
+	impl = crc32c_arm;
+#else
+	impl = crc32c_sb8;
+#endif
+	IMPL_STORE(crc32c_impl, impl);
+	return impl(crc, buf, size);
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t size)
+{
+	return IMPL_LOAD(crc32c_impl)(crc, buf, size);
+}
 
 const uint32_t *crc32c_table(void)
 {
-	return crc32c_tab;
-}
-
-static const uint32_t crc32_ieee_tab[] = {
-	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
-	0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
-	0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-	0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-	0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9,
-	0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-	0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c,
-	0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-	0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-	0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924,
-	0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d, 0x76dc4190, 0x01db7106,
-	0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-	0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d,
-	0x91646c97, 0xe6635c01, 0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e,
-	0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-	0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-	0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7,
-	0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-	0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa,
-	0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-	0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-	0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a,
-	0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84,
-	0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-	0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb,
-	0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc,
-	0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-	0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-	0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55,
-	0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-	0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28,
-	0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-	0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-	0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38,
-	0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242,
-	0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-	0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69,
-	0x616bffd3, 0x166ccf45, 0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2,
-	0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-	0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-	0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693,
-	0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+	return crc32c_tab[0];
+}
+
+/*
+ * CRC-32 (IEEE) and CRC-64 (ISO) use PCLMULQDQ folding on x86 where
+ * available, like crc32c (and CRC-32 uses the ARMv8 CRC extension), and
+ * otherwise slicing-by-16 and slicing-by-8 respectively over the tables
+ * in crc_tables.h.  Internally crc32_ieee
+ * works on the inverted crc, as the tables do.
+ */
+static inline uint64_t get_le64(const uint8_t *p)
+{
+	return get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+static uint32_t crc32_ieee_bytes(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size--)
+		crc = crc32_ieee_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Consumes 16 bytes per step, using tables for 0-15 following zero bytes. */
+static uint32_t crc32_ieee_sb16(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size >= 16) {
+		crc ^= get_le32(p);
+		crc = crc32_ieee_tab[15][crc & 0xFF]
+			^ crc32_ieee_tab[14][(crc >> 8) & 0xFF]
+			^ crc32_ieee_tab[13][(crc >> 16) & 0xFF]
+			^ crc32_ieee_tab[12][crc >> 24]
+			^ crc32_ieee_tab[11][p[4]]
+			^ crc32_ieee_tab[10][p[5]]
+			^ crc32_ieee_tab[9][p[6]]
+			^ crc32_ieee_tab[8][p[7]]
+			^ crc32_ieee_tab[7][p[8]]
+			^ crc32_ieee_tab[6][p[9]]
+			^ crc32_ieee_tab[5][p[10]]
+			^ crc32_ieee_tab[4][p[11]]
+			^ crc32_ieee_tab[3][p[12]]
+			^ crc32_ieee_tab[2][p[13]]
+			^ crc32_ieee_tab[1][p[14]]
+			^ crc32_ieee_tab[0][p[15]];
+		p += 16;
+		size -= 16;
+	}
+	return crc32_ieee_bytes(crc, p, size);
+}
+
+static uint64_t crc64_iso_bytes(uint64_t crc, const uint8_t *p, size_t size)
+{
+	while (size--)
+		crc = crc64_iso_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Consumes 8 bytes per step, using tables for 0-7 following zero bytes. */
+static uint64_t crc64_iso_sb8(uint64_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size >= 8) {
+		crc ^= get_le64(p);
+		crc = crc64_iso_tab[7][crc & 0xFF]
+			^ crc64_iso_tab[6][(crc >> 8) & 0xFF]
+			^ crc64_iso_tab[5][(crc >> 16) & 0xFF]
+			^ crc64_iso_tab[4][(crc >> 24) & 0xFF]
+			^ crc64_iso_tab[3][(crc >> 32) & 0xFF]
+			^ crc64_iso_tab[2][(crc >> 40) & 0xFF]
+			^ crc64_iso_tab[1][(crc >> 48) & 0xFF]
+			^ crc64_iso_tab[0][crc >> 56];
+		p += 8;
+		size -= 8;
+	}
+	return crc64_iso_bytes(crc, p, size);
+}
+
+#ifdef CRC_X86
+static const struct crc_fold_consts crc32_ieee_fold = {
+	0x154442bd4, 0x1c6e41596, 0x1751997d0, 0xccaa009e
 };
 
-uint32_t crc32_ieee(uint32_t crc, const void *buf, size_t size)
+/*
+ * A 64-bit crc needs no spare bit for the product, so these are just
+ * x^(d+63) and x^(d-1) mod P, bit-reflected.
+ */
+static const struct crc_fold_consts crc64_iso_fold = {
+	0x01b001b1b0000001ULL, 0xb100010100000001ULL,
+	0x6b70000000000001ULL, 0xf500000000000001ULL
+};
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t crc32_ieee_pclmul(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	uint8_t folded[16];
+	size_t done;
+
+	if (size < 256)
+		return crc32_ieee_sb16(crc, buf, size);
+
+	done = crc_fold(&crc32_ieee_fold, _mm_cvtsi32_si128(crc), p, size,
+			folded);
+	crc = crc32_ieee_sb16(0, folded, sizeof(folded));
+	return crc32_ieee_sb16(crc, p + done, size - done);
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint64_t crc64_iso_pclmul(uint64_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p;
+	const uint8_t *p = buf;
+	uint8_t folded[16];
+	size_t done;
+
+	if (size < 256)
+		return crc64_iso_sb8(crc, buf, size);
 
-	p = buf;
-	crc ^= ~0U;
+	done = crc_fold(&crc64_iso_fold, _mm_set_epi64x(0, crc), p, size,
+			folded);
+	crc = crc64_iso_sb8(0, folded, sizeof(folded));
+	return crc64_iso_sb8(crc, p + done, size - done);
+}
 
+static bool crc_have_pclmul(void)
+{
+	return cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_2)
+		&& cpuid_has_ecxfeature(CPUID_FEAT_ECX_PCLMUL);
+}
+#endif /* CRC_X86 */
+
+#ifdef CRC_ARM
+/* The plain ACLE crc32 intrinsics are CRC-32 (IEEE). */
+static uint32_t crc32_ieee_arm(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size && ((uintptr_t)p & 7)) {
+		crc = __crc32b(crc, *p++);
+		size--;
+	}
+	while (size >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc = __crc32d(crc, v);
+		p += 8;
+		size -= 8;
+	}
 	while (size--)
-		crc = crc32_ieee_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		crc = __crc32b(crc, *p++);
+	return crc;
+}
+#endif /* CRC_ARM */
+
+static uint32_t crc32_ieee_dispatch(uint32_t crc, const void *buf,
+				    size_t size);
+static uint32_t (*crc32_ieee_impl)(uint32_t, const void *, size_t)
+	= crc32_ieee_dispatch;
+
+static uint64_t crc64_iso_dispatch(uint64_t crc, const void *buf,
+				   size_t size);
+static uint64_t (*crc64_iso_impl)(uint64_t, const void *, size_t)
+	= crc64_iso_dispatch;
 
-	return crc ^ ~0U;
+static uint32_t crc32_ieee_dispatch(uint32_t crc, const void *buf,
+				    size_t size)
+{
+	uint32_t (*impl)(uint32_t, const void *, size_t);
+
+#if defined(CRC_X86)
+	if (crc_have_pclmul())
+		impl = crc32_ieee_pclmul;
+	else
+		impl = crc32_ieee_sb16;
+#elif defined(CRC_ARM)
+	impl = crc32_ieee_arm;
+#else
+	impl = crc32_ieee_sb16;
+#endif
+	IMPL_STORE(crc32_ieee_impl, impl);
+	return impl(crc, buf, size);
+}
+
+static uint64_t crc64_iso_dispatch(uint64_t crc, const void *buf,
+				   size_t size)
+{
+	uint64_t (*impl)(uint64_t, const void *, size_t);
+
+#if defined(CRC_X86)
+	if (crc_have_pclmul())
+		impl = crc64_iso_pclmul;
+	else
+		impl = crc64_iso_sb8;
+#else
+	impl = crc64_iso_sb8;
+#endif
+	IMPL_STORE(crc64_iso_impl, impl);
+	return impl(crc, buf, size);
+}
+
+uint32_t crc32_ieee(uint32_t crc, const void *buf, size_t size)
+{
+	return IMPL_LOAD(crc32_ieee_impl)(crc ^ ~0U, buf, size) ^ ~0U;
 }
 
 const uint32_t *crc32_ieee_table(void)
 {
-	return crc32_ieee_tab;
-}
-
-/* We only keep the upper 16 bits of the table: the lower 48 are always 0 */
-static uint16_t crc64_tab[] = {
-    0x0000, 0x01b0, 0x0360,
-    0x02d0, 0x06c0, 0x0770,
-    0x05a0, 0x0410, 0x0d80,
-    0x0c30, 0x0ee0, 0x0f50,
-    0x0b40, 0x0af0, 0x0820,
-    0x0990, 0x1b00, 0x1ab0,
-    0x1860, 0x19d0, 0x1dc0,
-    0x1c70, 0x1ea0, 0x1f10,
-    0x1680, 0x1730, 0x15e0,
-    0x1450, 0x1040, 0x11f0,
-    0x1320, 0x1290, 0x3600,
-    0x37b0, 0x3560, 0x34d0,
-    0x30c0, 0x3170, 0x33a0,
-    0x3210, 0x3b80, 0x3a30,
-    0x38e0, 0x3950, 0x3d40,
-    0x3cf0, 0x3e20, 0x3f90,
-    0x2d00, 0x2cb0, 0x2e60,
-    0x2fd0, 0x2bc0, 0x2a70,
-    0x28a0, 0x2910, 0x2080,
-    0x2130, 0x23e0, 0x2250,
-    0x2640, 0x27f0, 0x2520,
-    0x2490, 0x6c00, 0x6db0,
-    0x6f60, 0x6ed0, 0x6ac0,
-    0x6b70, 0x69a0, 0x6810,
-    0x6180, 0x6030, 0x62e0,
-    0x6350, 0x6740, 0x66f0,
-    0x6420, 0x6590, 0x7700,
-    0x76b0, 0x7460, 0x75d0,
-    0x71c0, 0x7070, 0x72a0,
-    0x7310, 0x7a80, 0x7b30,
-    0x79e0, 0x7850, 0x7c40,
-    0x7df0, 0x7f20, 0x7e90,
-    0x5a00, 0x5bb0, 0x5960,
-    0x58d0, 0x5cc0, 0x5d70,
-    0x5fa0, 0x5e10, 0x5780,
-    0x5630, 0x54e0, 0x5550,
-    0x5140, 0x50f0, 0x5220,
-    0x5390, 0x4100, 0x40b0,
-    0x4260, 0x43d0, 0x47c0,
-    0x4670, 0x44a0, 0x4510,
-    0x4c80, 0x4d30, 0x4fe0,
-    0x4e50, 0x4a40, 0x4bf0,
-    0x4920, 0x4890, 0xd800,
-    0xd9b0, 0xdb60, 0xdad0,
-    0xdec0, 0xdf70, 0xdda0,
-    0xdc10, 0xd580, 0xd430,
-    0xd6e0, 0xd750, 0xd340,
-    0xd2f0, 0xd020, 0xd190,
-    0xc300, 0xc2b0, 0xc060,
-    0xc1d0, 0xc5c0, 0xc470,
-    0xc6a0, 0xc710, 0xce80,
-    0xcf30, 0xcde0, 0xcc50,
-    0xc840, 0xc9f0, 0xcb20,
-    0xca90, 0xee00, 0xefb0,
-    0xed60, 0xecd0, 0xe8c0,
-    0xe970, 0xeba0, 0xea10,
-    0xe380, 0xe230, 0xe0e0,
-    0xe150, 0xe540, 0xe4f0,
-    0xe620, 0xe790, 0xf500,
-    0xf4b0, 0xf660, 0xf7d0,
-    0xf3c0, 0xf270, 0xf0a0,
-    0xf110, 0xf880, 0xf930,
-    0xfbe0, 0xfa50, 0xfe40,
-    0xfff0, 0xfd20, 0xfc90,
-    0xb400, 0xb5b0, 0xb760,
-    0xb6d0, 0xb2c0, 0xb370,
-    0xb1a0, 0xb010, 0xb980,
-    0xb830, 0xbae0, 0xbb50,
-    0xbf40, 0xbef0, 0xbc20,
-    0xbd90, 0xaf00, 0xaeb0,
-    0xac60, 0xadd0, 0xa9c0,
-    0xa870, 0xaaa0, 0xab10,
-    0xa280, 0xa330, 0xa1e0,
-    0xa050, 0xa440, 0xa5f0,
-    0xa720, 0xa690, 0x8200,
-    0x83b0, 0x8160, 0x80d0,
-    0x84c0, 0x8570, 0x87a0,
-    0x8610, 0x8f80, 0x8e30,
-    0x8ce0, 0x8d50, 0x8940,
-    0x88f0, 0x8a20, 0x8b90,
-    0x9900, 0x98b0, 0x9a60,
-    0x9bd0, 0x9fc0, 0x9e70,
-    0x9ca0, 0x9d10, 0x9480,
-    0x9530, 0x97e0, 0x9650,
-    0x9240, 0x93f0, 0x9120,
-    0x9090
-};
+	return crc32_ieee_tab[0];
+}
 
 uint64_t crc64_iso(uint64_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p = buf;
+	return IMPL_LOAD(crc64_iso_impl)(crc, buf, size);
+}
 
-	while (size--) {
-		uint64_t tabval = crc64_tab[(crc ^ *p++) & 0xFFL];
-		tabval <<= 48;
-		crc = tabval ^ (crc >> 8);
+const uint64_t *crc64_iso_table(void)
+{
+	return crc64_iso_tab[0];
+}
+
+/*
+ * Combining: the crc of A||B is the crc of A shifted by len(B) bytes,
+ * xored with the crc of B.  That shift is a multiplication by
+ * x^(8*len(B)) mod P, which we build from the tables of x^(8*2^k).
+ */
+static uint32_t multmodp32(uint32_t a, uint32_t b, uint32_t poly)
+{
+	uint32_t m = (uint32_t)1 << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ poly : b >> 1;
 	}
+	return p;
+}
+
+static uint64_t multmodp64(uint64_t a, uint64_t b, uint64_t poly)
+{
+	uint64_t m = (uint64_t)1 << 63, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+	}
+	return p;
+}
+
+static uint32_t crc32_shift(uint32_t crc, size_t len,
+			    const uint32_t x2n[64], uint32_t poly)
+{
+	unsigned int k;
+
+	for (k = 0; len; k++, len >>= 1)
+		if (len & 1)
+			crc = multmodp32(x2n[k], crc, poly);
 	return crc;
 }
 
-const uint64_t *crc64_iso_table(void)
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	return crc32_shift(crc1, len2, crc32c_x2n, 0x82F63B78) ^ crc2;
+}
+
+uint32_t crc32_ieee_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	/* The pre- and post-inversions cancel out. */
+	return crc32_shift(crc1, len2, crc32_ieee_x2n, 0xEDB88320) ^ crc2;
+}
+
+uint64_t crc64_iso_combine(uint64_t crc1, uint64_t crc2, size_t len2)
 {
-	static uint64_t *fulltab = NULL;
-	unsigned int i;
+	unsigned int k;
 
-	if (fulltab)
-		return fulltab;
+	for (k = 0; len2; k++, len2 >>= 1)
+		if (len2 & 1)
+			crc1 = multmodp64(crc64_iso_x2n[k], crc1,
+					  0xD800000000000000ULL);
+	return crc1 ^ crc2;
+}
 
-	fulltab = malloc(sizeof(uint64_t)*ARRAY_SIZE(crc64_tab));
-	if (!fulltab)
-		return NULL;
+/*
+ * Parallel versions: checksum equal chunks concurrently from zero, then
+ * combine them in order.  Chunks below this aren't worth a thread.
+ */
+#define CRC_PARALLEL_MIN_CHUNK (256 * 1024)
 
-	for (i = 0; i < ARRAY_SIZE(crc64_tab); i++)
-		fulltab[i] = (uint64_t)crc64_tab[i] << 48;
+static size_t crc_parallel_chunks(size_t size, unsigned int threads)
+{
+	size_t chunks;
 
-	return fulltab;
+#ifdef _OPENMP
+	if (threads == 0)
+		threads = omp_get_max_threads();
+#else
+	threads = 1;
+#endif
+	chunks = size / CRC_PARALLEL_MIN_CHUNK;
+	if (chunks > threads)
+		chunks = threads;
+	return chunks ? chunks : 1;
 }
+
+#define DEFINE_CRC_PARALLEL(NAME, TYPE)					\
+	TYPE NAME##_parallel(TYPE crc, const void *buf, size_t size,	\
+			     unsigned int threads)			\
+	{								\
+		const uint8_t *p = buf;					\
+		size_t i, chunks = crc_parallel_chunks(size, threads);	\
+		size_t chunk = size / chunks;				\
+		TYPE *parts;						\
+									\
+		if (chunks == 1)					\
+			return NAME(crc, buf, size);			\
+		parts = malloc(sizeof(*parts) * chunks);		\
+		if (!parts)						\
+			return NAME(crc, buf, size);			\
+									\
+		CRC_PARALLEL_FOR					\
+		for (i = 0; i < chunks; i++) {				\
+			size_t len = i == chunks-1			\
+				? size - chunk * i : chunk;		\
+			parts[i] = NAME(0, p + chunk * i, len);		\
+		}							\
+									\
+		for (i = 0; i < chunks; i++)				\
+			crc = NAME##_combine(crc, parts[i],		\
+				i == chunks-1 ? size - chunk * i : chunk); \
+		free(parts);						\
+		return crc;						\
+	}
+
+#ifdef _OPENMP
+#define CRC_PARALLEL_FOR _Pragma("omp parallel for num_threads(chunks)")
+#else
+#define CRC_PARALLEL_FOR
+#endif
+
+DEFINE_CRC_PARALLEL(crc32c, uint32_t)
+DEFINE_CRC_PARALLEL(crc32_ieee, uint32_t)
+DEFINE_CRC_PARALLEL(crc64_iso, uint64_t)
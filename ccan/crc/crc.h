@@ -72,8 +72,10 @@ const uint32_t *crc32c_table(void);
  *
  * 32 bit CRC checksum using polynomial
  * X^32+X^26+X^23+X^22+X^16+X^12+X^11+X^10+X^8+X^7+X^5+X^4+X^2+X^1+X^0.
+ * This is the crc used by zlib, PNG and Ethernet.
  *
- * See crc32c() for details.
+ * Like crc32c(), this picks the fastest implementation for the CPU the
+ * first time it's called.  See crc32c() for details.
  */
 uint32_t crc32_ieee(uint32_t start_crc, const void *buf, size_t size);
 
@@ -93,7 +95,8 @@ const uint32_t *crc32_ieee_table(void);
  * 64 bit CRC checksum using polynomial
  * X^64 + X^4 + X^3 + X^1 + X^0
  *
- * See crc32c() for details.
+ * Like crc32c(), this picks the fastest implementation for the CPU the
+ * first time it's called.  See crc32c() for details.
  */
 uint64_t crc64_iso(uint64_t start_crc, const void *buf, size_t size);
 
@@ -104,4 +107,91 @@ uint64_t crc64_iso(uint64_t start_crc, const void *buf, size_t size);
  */
 const uint64_t *crc64_iso_table(void);
 
+/**
+ * crc32c_combine - crc32c of two buffers joined together
+ * @crc1: the crc32c() of the first buffer
+ * @crc2: the crc32c() of the second buffer, starting from 0
+ * @len2: the length of the second buffer
+ *
+ * This returns the same as crc32c(@crc1, buf2, @len2), without needing
+ * buf2.  It takes time proportional to the number of bits set in @len2,
+ * so it's cheap even for huge buffers.
+ *
+ * Example:
+ *	// Checksum two halves separately, and put the results together.
+ *	static uint32_t crc_halves(const char *buf, size_t len)
+ *	{
+ *		uint32_t a = crc32c(0, buf, len / 2);
+ *		uint32_t b = crc32c(0, buf + len / 2, len - len / 2);
+ *		return crc32c_combine(a, b, len - len / 2);
+ *	}
+ */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+/**
+ * crc32_ieee_combine - crc32_ieee of two buffers joined together
+ * @crc1: the crc32_ieee() of the first buffer
+ * @crc2: the crc32_ieee() of the second buffer, starting from 0
+ * @len2: the length of the second buffer
+ *
+ * See crc32c_combine() for details.
+ */
+uint32_t crc32_ieee_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+/**
+ * crc64_iso_combine - crc64_iso of two buffers joined together
+ * @crc1: the crc64_iso() of the first buffer
+ * @crc2: the crc64_iso() of the second buffer, starting from 0
+ * @len2: the length of the second buffer
+ *
+ * See crc32c_combine() for details.
+ */
+uint64_t crc64_iso_combine(uint64_t crc1, uint64_t crc2, size_t len2);
+
+/**
+ * crc32c_parallel - crc32c() using multiple threads
+ * @start_crc: the initial crc (usually 0)
+ * @buf: pointer to bytes
+ * @size: length of buffer
+ * @threads: the most threads to use, or 0 for the OpenMP default.
+ *
+ * Large buffers are split into chunks of at least 256k, which are
+ * checksummed concurrently and then merged using crc32c_combine().
+ * The result is identical to crc32c().
+ *
+ * If the module was not built with OpenMP, this is just crc32c().
+ *
+ * Example:
+ *	static bool check_object(uint32_t expected, const void *obj, size_t len)
+ *	{
+ *		return crc32c_parallel(0, obj, len, 0) == expected;
+ *	}
+ */
+uint32_t crc32c_parallel(uint32_t start_crc, const void *buf, size_t size,
+			 unsigned int threads);
+
+/**
+ * crc32_ieee_parallel - crc32_ieee() using multiple threads
+ * @start_crc: the initial crc (usually 0)
+ * @buf: pointer to bytes
+ * @size: length of buffer
+ * @threads: the most threads to use, or 0 for the OpenMP default.
+ *
+ * See crc32c_parallel() for details.
+ */
+uint32_t crc32_ieee_parallel(uint32_t start_crc, const void *buf, size_t size,
+			     unsigned int threads);
+
+/**
+ * crc64_iso_parallel - crc64_iso() using multiple threads
+ * @start_crc: the initial crc (usually 0)
+ * @buf: pointer to bytes
+ * @size: length of buffer
+ * @threads: the most threads to use, or 0 for the OpenMP default.
+ *
+ * See crc32c_parallel() for details.
+ */
+uint64_t crc64_iso_parallel(uint64_t start_crc, const void *buf, size_t size,
+			    unsigned int threads);
+
 #endif /* CCAN_CRC_H */
@@ -0,0 +1,56 @@
+#include <ccan/crc/crc.c>
+#include <ccan/tap/tap.h>
+#include <string.h>
+
+#define BUFSIZE (8 * 1024 * 1024 + 13)
+
+int main(void)
+{
+	uint8_t *buf = malloc(BUFSIZE);
+	static const size_t splits[] = { 0, 1, 7, 64, 1000, 65536, 1000003 };
+	static const unsigned int threads[] = { 0, 1, 2, 3, 8 };
+	size_t i, len;
+	uint32_t x = 1;
+	bool ok32c = true, ok32 = true, ok64 = true;
+
+	plan_tests(3 + 3 * ARRAY_SIZE(threads));
+
+	for (i = 0; i < BUFSIZE; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(splits); i++) {
+		for (len = 0; len < 2000000; len = len * 3 + 1) {
+			const uint8_t *a = buf, *b = buf + splits[i];
+			size_t alen = splits[i];
+
+			if (crc32c_combine(crc32c(5, a, alen), crc32c(0, b, len),
+					   len) != crc32c(5, a, alen + len))
+				ok32c = false;
+			if (crc32_ieee_combine(crc32_ieee(5, a, alen),
+					       crc32_ieee(0, b, len), len)
+			    != crc32_ieee(5, a, alen + len))
+				ok32 = false;
+			if (crc64_iso_combine(crc64_iso(5, a, alen),
+					      crc64_iso(0, b, len), len)
+			    != crc64_iso(5, a, alen + len))
+				ok64 = false;
+		}
+	}
+	ok1(ok32c);
+	ok1(ok32);
+	ok1(ok64);
+
+	for (i = 0; i < ARRAY_SIZE(threads); i++) {
+		ok1(crc32c_parallel(7, buf, BUFSIZE, threads[i])
+		    == crc32c(7, buf, BUFSIZE));
+		ok1(crc32_ieee_parallel(7, buf, BUFSIZE, threads[i])
+		    == crc32_ieee(7, buf, BUFSIZE));
+		ok1(crc64_iso_parallel(7, buf, BUFSIZE, threads[i])
+		    == crc64_iso(7, buf, BUFSIZE));
+	}
+
+	free(buf);
+	return exit_status();
+}
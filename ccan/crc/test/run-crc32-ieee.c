@@ -0,0 +1,76 @@
+#include <ccan/crc/crc.c>
+#include <ccan/tap/tap.h>
+#include <string.h>
+
+/* The simple one-byte-at-a-time version, on the inverted crc. */
+static uint32_t crc32_ieee_ref(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	const uint32_t *tab = crc32_ieee_table();
+
+	while (size--)
+		crc = tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Every length up to 1100 and some larger, at every alignment up to 8. */
+static bool check_impl(uint32_t (*crc)(uint32_t, const void *, size_t),
+		       const uint8_t *buf)
+{
+	size_t len, align;
+	static const size_t big[] = { 4095, 4096, 65536 + 17, 1 << 20 };
+
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < 1100; len++) {
+			uint32_t init = len * 0x9E3779B9;
+			if (crc(init, buf + align, len)
+			    != crc32_ieee_ref(init, buf + align, len))
+				return false;
+		}
+	}
+	for (len = 0; len < ARRAY_SIZE(big); len++)
+		if (crc(len, buf + 3, big[len])
+		    != crc32_ieee_ref(len, buf + 3, big[len]))
+			return false;
+	return true;
+}
+
+/* crc32_ieee() itself, undoing its pre and post inversion. */
+static uint32_t crc32_ieee_raw(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32_ieee(crc ^ ~0U, buf, size) ^ ~0U;
+}
+
+int main(void)
+{
+	uint8_t *buf = malloc((1 << 20) + 8);
+	size_t i;
+	uint32_t x = 1;
+
+	plan_tests(5);
+
+	for (i = 0; i < (1 << 20) + 8; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+
+	ok1(check_impl(crc32_ieee_sb16, buf));
+	ok1(check_impl(crc32_ieee_raw, buf));
+	/* The usual check value (as used by zlib and PNG). */
+	ok1(crc32_ieee(0, "123456789", 9) == 0xCBF43926);
+#ifdef CRC_X86
+	if (crc_have_pclmul())
+		ok1(check_impl(crc32_ieee_pclmul, buf));
+	else
+		pass("No PCLMULQDQ on this CPU");
+	pass("Not ARM");
+#elif defined(CRC_ARM)
+	pass("Not x86");
+	ok1(check_impl(crc32_ieee_arm, buf));
+#else
+	pass("Not x86");
+	pass("Not ARM");
+#endif
+	free(buf);
+	return exit_status();
+}
@@ -0,0 +1,73 @@
+#include <ccan/crc/crc.c>
+#include <ccan/tap/tap.h>
+#include <string.h>
+
+/* The simple one-byte-at-a-time version. */
+static uint32_t crc32c_ref(uint32_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+
+	while (size--)
+		crc = crc32c_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Every length up to 1100 and some larger, at every alignment up to 8. */
+static bool check_impl(uint32_t (*crc)(uint32_t, const void *, size_t),
+		       const uint8_t *buf)
+{
+	size_t len, align;
+	static const size_t big[] = { 4095, 4096, 65536 + 17, 1 << 20 };
+
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < 1100; len++) {
+			uint32_t init = len * 0x9E3779B9;
+			if (crc(init, buf + align, len)
+			    != crc32c_ref(init, buf + align, len))
+				return false;
+		}
+	}
+	for (len = 0; len < ARRAY_SIZE(big); len++)
+		if (crc(len, buf + 3, big[len])
+		    != crc32c_ref(len, buf + 3, big[len]))
+			return false;
+	return true;
+}
+
+int main(void)
+{
+	uint8_t *buf = malloc((1 << 20) + 8);
+	size_t i;
+	uint32_t x = 1;
+
+	plan_tests(5);
+
+	for (i = 0; i < (1 << 20) + 8; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+
+	ok1(check_impl(crc32c_sb8, buf));
+	ok1(check_impl(crc32c, buf));
+	/* Check value from RFC 3720 (with its pre and post inversion). */
+	ok1((crc32c(0xFFFFFFFF, "123456789", 9) ^ 0xFFFFFFFF) == 0xE3069283);
+#ifdef CRC_X86
+	if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_2))
+		ok1(check_impl(crc32c_sse42, buf));
+	else
+		pass("No SSE4.2 on this CPU");
+	if (cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_2)
+	    && cpuid_has_ecxfeature(CPUID_FEAT_ECX_PCLMUL))
+		ok1(check_impl(crc32c_pclmul, buf));
+	else
+		pass("No PCLMULQDQ on this CPU");
+#elif defined(CRC_ARM)
+	ok1(check_impl(crc32c_arm, buf));
+	pass("Not x86");
+#else
+	pass("No hardware crc32c");
+	pass("Not x86");
+#endif
+	free(buf);
+	return exit_status();
+}
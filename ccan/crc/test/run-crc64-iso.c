@@ -0,0 +1,65 @@
+#include <ccan/crc/crc.c>
+#include <ccan/tap/tap.h>
+#include <string.h>
+
+/* The simple one-byte-at-a-time version. */
+static uint64_t crc64_iso_ref(uint64_t crc, const void *buf, size_t size)
+{
+	const uint8_t *p = buf;
+	const uint64_t *tab = crc64_iso_table();
+
+	while (size--)
+		crc = tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+/* Every length up to 1100 and some larger, at every alignment up to 8. */
+static bool check_impl(uint64_t (*crc)(uint64_t, const void *, size_t),
+		       const uint8_t *buf)
+{
+	size_t len, align;
+	static const size_t big[] = { 4095, 4096, 65536 + 17, 1 << 20 };
+
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < 1100; len++) {
+			uint64_t init = len * 0x9E3779B97F4A7C15ULL;
+			if (crc(init, buf + align, len)
+			    != crc64_iso_ref(init, buf + align, len))
+				return false;
+		}
+	}
+	for (len = 0; len < ARRAY_SIZE(big); len++)
+		if (crc(len, buf + 3, big[len])
+		    != crc64_iso_ref(len, buf + 3, big[len]))
+			return false;
+	return true;
+}
+
+int main(void)
+{
+	uint8_t *buf = malloc((1 << 20) + 8);
+	size_t i;
+	uint32_t x = 1;
+
+	plan_tests(4);
+
+	for (i = 0; i < (1 << 20) + 8; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = x >> 16;
+	}
+
+	ok1(check_impl(crc64_iso_sb8, buf));
+	ok1(check_impl(crc64_iso, buf));
+	/* The table is still the one-byte table. */
+	ok1(crc64_iso_table()[1] == 0x01B0000000000000ULL);
+#ifdef CRC_X86
+	if (crc_have_pclmul())
+		ok1(check_impl(crc64_iso_pclmul, buf));
+	else
+		pass("No PCLMULQDQ on this CPU");
+#else
+	pass("Not x86");
+#endif
+	free(buf);
+	return exit_status();
+}
@@ -0,0 +1,132 @@
+/* Generate the slicing-by-N tables in ../crc_tables.h */
+#include <stdint.h>
+#include <stdio.h>
+
+/* table[k][n] is the crc of byte n followed by k zero bytes. */
+static void gen32(const char *name, uint32_t poly, int slices)
+{
+	uint32_t table[16][256];
+	int k, n, bit;
+
+	for (n = 0; n < 256; n++) {
+		uint32_t crc = n;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+		table[0][n] = crc;
+	}
+	for (k = 1; k < slices; k++)
+		for (n = 0; n < 256; n++)
+			table[k][n] = (table[k-1][n] >> 8)
+				^ table[0][table[k-1][n] & 0xFF];
+
+	printf("static const uint32_t %s[%i][256] = {\n", name, slices);
+	for (k = 0; k < slices; k++) {
+		printf("\t{\n");
+		for (n = 0; n < 256; n++)
+			printf("%s0x%08X,%s", n % 6 ? " " : "\t\t", table[k][n],
+			       n % 6 == 5 || n == 255 ? "\n" : "");
+		printf("\t},\n");
+	}
+	printf("};\n");
+}
+
+static void gen64(const char *name, uint64_t poly, int slices)
+{
+	uint64_t table[16][256];
+	int k, n, bit;
+
+	for (n = 0; n < 256; n++) {
+		uint64_t crc = n;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+		table[0][n] = crc;
+	}
+	for (k = 1; k < slices; k++)
+		for (n = 0; n < 256; n++)
+			table[k][n] = (table[k-1][n] >> 8)
+				^ table[0][table[k-1][n] & 0xFF];
+
+	printf("static const uint64_t %s[%i][256] = {\n", name, slices);
+	for (k = 0; k < slices; k++) {
+		printf("\t{\n");
+		for (n = 0; n < 256; n++)
+			printf("%s0x%016llXULL,%s", n % 3 ? " " : "\t\t",
+			       (unsigned long long)table[k][n],
+			       n % 3 == 2 || n == 255 ? "\n" : "");
+		printf("\t},\n");
+	}
+	printf("};\n");
+}
+
+/* Reflected a*b mod poly, where x^0 is the top bit. */
+static uint64_t multmodp(uint64_t a, uint64_t b, uint64_t poly, int width)
+{
+	uint64_t m = (uint64_t)1 << (width - 1), p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+	}
+	return p;
+}
+
+/* table[k] is x^(8 * 2^k) mod poly: shifting a crc by 2^k bytes. */
+static void gen_x2n(const char *name, uint64_t poly, int width)
+{
+	uint64_t p = (uint64_t)1 << (width - 2);	/* x^1 */
+	int k;
+
+	/* x^8 */
+	for (k = 0; k < 3; k++)
+		p = multmodp(p, p, poly, width);
+
+	printf("static const uint%i_t %s[64] = {\n", width, name);
+	for (k = 0; k < 64; k++) {
+		if (width == 32)
+			printf("%s0x%08X,%s", k % 6 ? " " : "\t", (uint32_t)p,
+			       k % 6 == 5 || k == 63 ? "\n" : "");
+		else
+			printf("%s0x%016llXULL,%s", k % 3 ? " " : "\t",
+			       (unsigned long long)p,
+			       k % 3 == 2 || k == 63 ? "\n" : "");
+		p = multmodp(p, p, poly, width);
+	}
+	printf("};\n");
+}
+
+int main(void)
+{
+	printf("/* Licensed under GPLv2+ - see LICENSE file for details */\n"
+	       "/* Generated by tools/gentables.c: do not edit! */\n"
+	       "#ifndef CCAN_CRC_TABLES_H\n"
+	       "#define CCAN_CRC_TABLES_H\n"
+	       "#include <stdint.h>\n\n");
+
+	/* CRC-32C, poly = 0x1EDC6F41, reflected. */
+	gen32("crc32c_tab", 0x82F63B78, 8);
+	printf("\n");
+
+	/* CRC-32 (IEEE 802.3), poly = 0x04C11DB7, reflected. */
+	gen32("crc32_ieee_tab", 0xEDB88320, 16);
+	printf("\n");
+
+	/* CRC-64 (ISO 3309), poly = 0x000000000000001B, reflected. */
+	gen64("crc64_iso_tab", 0xD800000000000000ULL, 8);
+	printf("\n");
+
+	/* For the *_combine functions. */
+	gen_x2n("crc32c_x2n", 0x82F63B78, 32);
+	printf("\n");
+	gen_x2n("crc32_ieee_x2n", 0xEDB88320, 32);
+	printf("\n");
+	gen_x2n("crc64_iso_x2n", 0xD800000000000000ULL, 64);
+	printf("\n");
+
+	printf("#endif /* CCAN_CRC_TABLES_H */\n");
+	return 0;
+}
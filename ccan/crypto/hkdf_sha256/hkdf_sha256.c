@@ -4,16 +4,11 @@
 #include <assert.h>
 #include <string.h>
 
-void hkdf_sha256(void *okm, size_t okm_size,
-		 const void *s, size_t ssize,
-		 const void *k, size_t ksize,
-		 const void *info, size_t isize)
+void hkdf_sha256_extract(struct hmac_sha256_key *prk,
+			 const void *s, size_t ssize,
+			 const void *k, size_t ksize)
 {
-	struct hmac_sha256 prk, t;
-	struct hmac_sha256_ctx ctx;
-	unsigned char c;
-
-	assert(okm_size < 255 * sizeof(t));
+	struct hmac_sha256 prk_bytes;
 
 	/* RFC 5869:
 	 *
@@ -37,7 +32,22 @@ void hkdf_sha256(void *okm, size_t okm_size,
 	 *
 	 *    PRK = HMAC-Hash(salt, IKM)
 	 */
-	hmac_sha256(&prk, s, ssize, k, ksize);
+	hmac_sha256(&prk_bytes, s, ssize, k, ksize);
+
+	/* Every expand step uses PRK as the HMAC key: set it up once. */
+	hmac_sha256_key_init(prk, &prk_bytes, sizeof(prk_bytes));
+	memset(&prk_bytes, 0, sizeof(prk_bytes));
+}
+
+void hkdf_sha256_expand(void *okm, size_t okm_size,
+			const struct hmac_sha256_key *prk,
+			const void *info, size_t isize)
+{
+	struct hmac_sha256 t;
+	struct hmac_sha256_ctx ctx;
+	unsigned char c;
+
+	assert(okm_size < 255 * sizeof(t));
 
 	/*
 	 * 2.3.  Step 2: Expand
@@ -76,7 +86,7 @@ void hkdf_sha256(void *okm, size_t okm_size,
 	 *    single octet.)
 	 */
 	c = 1;
-	hmac_sha256_init(&ctx, &prk, sizeof(prk));
+	hmac_sha256_init_key(&ctx, prk);
 	hmac_sha256_update(&ctx, info, isize);
 	hmac_sha256_update(&ctx, &c, 1);
 	hmac_sha256_done(&ctx, &t);
@@ -87,7 +97,7 @@ void hkdf_sha256(void *okm, size_t okm_size,
 		okm_size -= sizeof(t);
 
 		c++;
-		hmac_sha256_init(&ctx, &prk, sizeof(prk));
+		hmac_sha256_init_key(&ctx, prk);
 		hmac_sha256_update(&ctx, &t, sizeof(t));
 		hmac_sha256_update(&ctx, info, isize);
 		hmac_sha256_update(&ctx, &c, 1);
@@ -95,3 +105,16 @@ void hkdf_sha256(void *okm, size_t okm_size,
 	}
 	memcpy(okm, &t, okm_size);
 }
+
+void hkdf_sha256(void *okm, size_t okm_size,
+		 const void *s, size_t ssize,
+		 const void *k, size_t ksize,
+		 const void *info, size_t isize)
+{
+	struct hmac_sha256_key prk;
+
+	assert(okm_size < 255 * sizeof(struct hmac_sha256));
+
+	hkdf_sha256_extract(&prk, s, ssize, k, ksize);
+	hkdf_sha256_expand(okm, okm_size, &prk, info, isize);
+}
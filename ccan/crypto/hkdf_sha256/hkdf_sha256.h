@@ -3,6 +3,7 @@
 /* BSD-MIT - see LICENSE file for details */
 #include "config.h"
 #include <stdlib.h>
+#include <ccan/crypto/hmac_sha256/hmac_sha256.h>
 
 /**
  * hkdf_sha256 - generate a derived key
@@ -19,4 +20,46 @@ void hkdf_sha256(void *okm, size_t okm_size,
 		 const void *s, size_t ssize,
 		 const void *k, size_t ksize,
 		 const void *info, size_t isize);
+
+/**
+ * hkdf_sha256_extract - the HKDF-Extract step, as a reusable key
+ * @prk: the pseudorandom key to fill in
+ * @s: salt
+ * @ssize: the number of bytes pointed to by @s
+ * @k: pointer to input key
+ * @ksize: the number of bytes pointed to by @k
+ *
+ * The PRK is kept as a precomputed HMAC key, since it is only ever
+ * used to key hkdf_sha256_expand().  hkdf_sha256() is simply this
+ * followed by hkdf_sha256_expand(), but deriving several keys from the
+ * same input keying material (with different @info) only needs to
+ * extract once.
+ */
+void hkdf_sha256_extract(struct hmac_sha256_key *prk,
+			 const void *s, size_t ssize,
+			 const void *k, size_t ksize);
+
+/**
+ * hkdf_sha256_expand - the HKDF-Expand step
+ * @okm: where to output the key
+ * @okm_size: the number of bytes pointed to by @okm (must be less than 255*32)
+ * @prk: the pseudorandom key from hkdf_sha256_extract()
+ * @info: pointer to info
+ * @isize: the number of bytes pointed to by @info
+ *
+ * Example:
+ * static void derive_keys(const void *secret, size_t len,
+ *			   unsigned char send_key[32],
+ *			   unsigned char recv_key[32])
+ * {
+ *	struct hmac_sha256_key prk;
+ *
+ *	hkdf_sha256_extract(&prk, NULL, 0, secret, len);
+ *	hkdf_sha256_expand(send_key, 32, &prk, "send", 4);
+ *	hkdf_sha256_expand(recv_key, 32, &prk, "recv", 4);
+ * }
+ */
+void hkdf_sha256_expand(void *okm, size_t okm_size,
+			const struct hmac_sha256_key *prk,
+			const void *info, size_t isize);
 #endif /* CCAN_CRYPTO_HKDF_SHA256_H */
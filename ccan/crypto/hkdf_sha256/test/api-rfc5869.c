@@ -76,11 +76,12 @@ int main(void)
 {
 	size_t i;
 
-	plan_tests(sizeof(tests) / sizeof(tests[0]));
+	plan_tests(sizeof(tests) / sizeof(tests[0]) * 2);
 
 	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
 		size_t ksize, ssize, isize, okmsize;
 		void *k, *s, *info, *expect, *okm;
+		struct hmac_sha256_key prk;
 
 		k = fromhex(tests[i].ikm, &ksize);
 		s = fromhex(tests[i].salt, &ssize);
@@ -90,6 +91,12 @@ int main(void)
 		hkdf_sha256(okm, okmsize, s, ssize, k, ksize, info, isize);
 		ok1(memcmp(okm, expect, okmsize) == 0);
 
+		/* Split extract/expand must agree. */
+		memset(okm, 0, okmsize);
+		hkdf_sha256_extract(&prk, s, ssize, k, ksize);
+		hkdf_sha256_expand(okm, okmsize, &prk, info, isize);
+		ok1(memcmp(okm, expect, okmsize) == 0);
+
 		free(k);
 		free(s);
 		free(info);
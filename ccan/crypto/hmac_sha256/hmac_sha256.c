@@ -15,12 +15,11 @@ static inline void xor_block(uint64_t block[BLOCK_U64S], uint64_t pad)
 		block[i] ^= pad;
 }
 
-void hmac_sha256_init(struct hmac_sha256_ctx *ctx,
-		      const void *k, size_t ksize)
+void hmac_sha256_key_init(struct hmac_sha256_key *key,
+			  const void *k, size_t ksize)
 {
 	struct sha256 hashed_key;
-	/* We use k_opad as k_ipad temporarily. */
-	uint64_t *k_ipad = ctx->k_opad;
+	uint64_t k_pad[BLOCK_U64S];
 
 	/* (keys longer than B bytes are first hashed using H) */
 	if (ksize > HMAC_SHA256_BLOCKSIZE) {
@@ -35,14 +34,14 @@ void hmac_sha256_init(struct hmac_sha256_ctx *ctx,
 	 *  (e.g., if K is of length 20 bytes and B=64, then K will be
 	 *   appended with 44 zero bytes 0x00)
 	 */
-	memcpy(k_ipad, k, ksize);
-	memset((char *)k_ipad + ksize, 0, HMAC_SHA256_BLOCKSIZE - ksize);
+	memcpy(k_pad, k, ksize);
+	memset((char *)k_pad + ksize, 0, HMAC_SHA256_BLOCKSIZE - ksize);
 
 	/*
 	 * (2) XOR (bitwise exclusive-OR) the B byte string computed
 	 * in step (1) with ipad
 	 */
-	xor_block(k_ipad, IPAD);
+	xor_block(k_pad, IPAD);
 
 	/*
 	 * We start (4) here, appending text later:
@@ -51,14 +50,39 @@ void hmac_sha256_init(struct hmac_sha256_ctx *ctx,
 	 * from step (2)
 	 * (4) apply H to the stream generated in step (3)
 	 */
-	sha256_init(&ctx->sha);
-	sha256_update(&ctx->sha, k_ipad, HMAC_SHA256_BLOCKSIZE);
+	sha256_init(&key->inner);
+	sha256_update(&key->inner, k_pad, HMAC_SHA256_BLOCKSIZE);
 
 	/*
 	 * (5) XOR (bitwise exclusive-OR) the B byte string computed in
 	 * step (1) with opad
+	 *
+	 * We also start (7) here, since the opad block is always the
+	 * first thing hashed there: that way hmac_sha256_done() only has
+	 * to hash the inner result.
 	 */
-	xor_block(ctx->k_opad, IPAD^OPAD);
+	xor_block(k_pad, IPAD^OPAD);
+	sha256_init(&key->outer);
+	sha256_update(&key->outer, k_pad, HMAC_SHA256_BLOCKSIZE);
+
+	/* Don't leave key material lying around on the stack. */
+	memset(k_pad, 0, sizeof(k_pad));
+}
+
+void hmac_sha256_init_key(struct hmac_sha256_ctx *ctx,
+			  const struct hmac_sha256_key *key)
+{
+	ctx->sha = key->inner;
+	ctx->outer = key->outer;
+}
+
+void hmac_sha256_init(struct hmac_sha256_ctx *ctx,
+		      const void *k, size_t ksize)
+{
+	struct hmac_sha256_key key;
+
+	hmac_sha256_key_init(&key, k, ksize);
+	hmac_sha256_init_key(ctx, &key);
 }
 
 void hmac_sha256_update(struct hmac_sha256_ctx *ctx, const void *p, size_t size)
@@ -84,10 +108,19 @@ void hmac_sha256_done(struct hmac_sha256_ctx *ctx,
 	 * (7) apply H to the stream generated in step (6) and output
 	 * the result
 	 */
-	sha256_init(&ctx->sha);
-	sha256_update(&ctx->sha, ctx->k_opad, sizeof(ctx->k_opad));
-	sha256_update(&ctx->sha, &hmac->sha, sizeof(hmac->sha));
-	sha256_done(&ctx->sha, &hmac->sha);
+	sha256_update(&ctx->outer, &hmac->sha, sizeof(hmac->sha));
+	sha256_done(&ctx->outer, &hmac->sha);
+}
+
+void hmac_sha256_keyed(struct hmac_sha256 *hmac,
+		       const struct hmac_sha256_key *key,
+		       const void *d, size_t dsize)
+{
+	struct hmac_sha256_ctx ctx;
+
+	hmac_sha256_init_key(&ctx, key);
+	hmac_sha256_update(&ctx, d, dsize);
+	hmac_sha256_done(&ctx, hmac);
 }
 
 #if 1
@@ -33,9 +33,63 @@ void hmac_sha256(struct hmac_sha256 *hmac,
  */
 struct hmac_sha256_ctx {
 	struct sha256_ctx sha;
-	uint64_t k_opad[HMAC_SHA256_BLOCKSIZE / sizeof(uint64_t)];
+	struct sha256_ctx outer;
 };
 
+/**
+ * struct hmac_sha256_key - a precomputed HMAC_SHA256 key.
+ *
+ * This holds the SHA256 states after hashing the inner and outer key
+ * blocks, so each message signed with it costs two fewer SHA256
+ * compressions than calling hmac_sha256() directly.  It contains no
+ * pointers, so it can be copied freely, and is never modified after
+ * hmac_sha256_key_init().
+ */
+struct hmac_sha256_key {
+	struct sha256_ctx inner;
+	struct sha256_ctx outer;
+};
+
+/**
+ * hmac_sha256_key_init - precompute an HMAC_SHA256 key.
+ * @key: the hmac_sha256_key to initialize
+ * @k: pointer to the key,
+ * @ksize: the number of bytes pointed to by @k
+ *
+ * Example:
+ * static struct hmac_sha256_key signing_key;
+ *
+ * static void set_signing_key(const char *secret)
+ * {
+ *	hmac_sha256_key_init(&signing_key, secret, strlen(secret));
+ * }
+ */
+void hmac_sha256_key_init(struct hmac_sha256_key *key,
+			  const void *k, size_t ksize);
+
+/**
+ * hmac_sha256_keyed - return hmac of an object with a precomputed key.
+ * @hmac: the hmac to fill in
+ * @key: the key from hmac_sha256_key_init()
+ * @d: pointer to memory,
+ * @dsize: the number of bytes pointed to by @d
+ *
+ * This gives the same result as hmac_sha256() with the original key.
+ *
+ * Example:
+ * static void sign_all(const struct hmac_sha256_key *key,
+ *			const char **msgs, struct hmac_sha256 *sigs)
+ * {
+ *	size_t i;
+ *
+ *	for (i = 0; msgs[i]; i++)
+ *		hmac_sha256_keyed(&sigs[i], key, msgs[i], strlen(msgs[i]));
+ * }
+ */
+void hmac_sha256_keyed(struct hmac_sha256 *hmac,
+		       const struct hmac_sha256_key *key,
+		       const void *d, size_t dsize);
+
 /**
  * hmac_sha256_init - initialize an HMAC_SHA256 context.
  * @ctx: the hmac_sha256_ctx to initialize
@@ -63,6 +117,17 @@ struct hmac_sha256_ctx {
 void hmac_sha256_init(struct hmac_sha256_ctx *ctx,
 		      const void *k, size_t ksize);
 
+/**
+ * hmac_sha256_init_key - initialize an HMAC_SHA256 context from a key.
+ * @ctx: the hmac_sha256_ctx to initialize
+ * @key: the key from hmac_sha256_key_init()
+ *
+ * This is equivalent to hmac_sha256_init() with the original key, but
+ * only copies the precomputed state.
+ */
+void hmac_sha256_init_key(struct hmac_sha256_ctx *ctx,
+			  const struct hmac_sha256_key *key);
+
 /**
  * hmac_sha256_update - include some memory in the hash.
  * @ctx: the hmac_sha256_ctx to use
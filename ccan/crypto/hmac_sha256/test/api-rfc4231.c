@@ -129,12 +129,13 @@ int main(void)
 	size_t i;
 	struct hmac_sha256 hmac;
 
-	plan_tests(sizeof(tests) / sizeof(tests[0]) * 2);
+	plan_tests(sizeof(tests) / sizeof(tests[0]) * 4);
 
 	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
 		size_t ksize, dsize, hmacsize;
 		void *k, *d, *expect;
 		struct hmac_sha256_ctx ctx;
+		struct hmac_sha256_key key;
 
 		k = fromhex(tests[i].key, &ksize);
 		d = fromhex(tests[i].data, &dsize);
@@ -150,6 +151,17 @@ int main(void)
 		hmac_sha256_done(&ctx, &hmac);
 		ok1(memcmp(&hmac, expect, hmacsize) == 0);
 
+		/* Precomputed key, used twice to check it isn't consumed. */
+		hmac_sha256_key_init(&key, k, ksize);
+		hmac_sha256_keyed(&hmac, &key, d, dsize);
+		ok1(memcmp(&hmac, expect, hmacsize) == 0);
+
+		hmac_sha256_init_key(&ctx, &key);
+		hmac_sha256_update(&ctx, d, dsize / 2);
+		hmac_sha256_update(&ctx, (char *)d + dsize/2, dsize - dsize/2);
+		hmac_sha256_done(&ctx, &hmac);
+		ok1(memcmp(&hmac, expect, hmacsize) == 0);
+
 		free(k);
 		free(d);
 		free(expect);
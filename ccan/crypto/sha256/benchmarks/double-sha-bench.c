@@ -3,10 +3,75 @@
 #include <ccan/time/time.h>
 #include <stdio.h>
 
+#ifdef INTEL_ASM
 void sha256_avx(void *input_data, uint32_t digest[8], uint64_t num_blks);
 void sha256_rorx(void *input_data, uint32_t digest[8], uint64_t num_blks);
 void sha256_rorx_x8ms(void *input_data, uint32_t digest[8], uint64_t num_blks);
 void sha256_sse4(void *input_data, uint32_t digest[8], uint64_t num_blks);
+#endif
+
+struct impl {
+	const char *name;
+	void (*transform)(uint32_t *s, const unsigned char *data, size_t blocks);
+	bool usable;
+};
+
+/* Time each of the library's block transforms: double-SHA of a 32-byte
+ * value (as Bitcoin does), and bulk throughput on a large buffer. */
+static void bench_impls(size_t n)
+{
+	struct impl impls[] = {
+		{ "generic", transform_generic, true },
+#ifdef SHA256_X86
+		{ "sse4", transform_sse4,
+		  cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3)
+		  && cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_1) },
+		{ "avx2", transform_avx2,
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		  && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+		  && cpuid_os_has_avx() },
+		{ "sha-ni", transform_shani,
+		  cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_1)
+		  && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_SHA) },
+#endif
+	};
+	size_t bulk = 1 << 20, i, j, runs = n / 1000 + 1;
+	unsigned char *buf = calloc(bulk, 1);
+	struct sha256 h;
+
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		struct timeabs start;
+		struct timerel diff;
+
+		if (!impls[i].usable) {
+			printf("Library %s: unsupported on this CPU\n",
+			       impls[i].name);
+			continue;
+		}
+		transform_impl = impls[i].transform;
+
+		memset(&h, 0, sizeof(h));
+		start = time_now();
+		for (j = 0; j < n; j++) {
+			sha256(&h, &h, sizeof(h));
+			sha256(&h, &h, sizeof(h));
+		}
+		diff = time_divide(time_between(time_now(), start), n);
+		printf("Library %s double-SHA gave %02x%02x%02x%02x%02x%02x... in %llu nsec",
+		       impls[i].name,
+		       h.u.u8[0], h.u.u8[1], h.u.u8[2],
+		       h.u.u8[3], h.u.u8[4], h.u.u8[5],
+		       (unsigned long long)time_to_nsec(diff));
+
+		start = time_now();
+		for (j = 0; j < runs; j++)
+			sha256(&h, buf, bulk);
+		diff = time_between(time_now(), start);
+		printf(", bulk %.0f MB/s\n",
+		       (double)bulk * runs / time_to_usec(diff));
+	}
+	free(buf);
+}
 
 int main(int argc, char *argv[])
 {
@@ -54,6 +119,9 @@ int main(int argc, char *argv[])
 	       block.h.u.u8[3], block.h.u.u8[4], block.h.u.u8[5],
 	       (unsigned long long)time_to_nsec(diff));
 
+	bench_impls(n);
+
+#ifdef INTEL_ASM
 	/* Now, assembler variants */
 	sha256(&block.h, &n, sizeof(n));
 
@@ -117,6 +185,8 @@ int main(int argc, char *argv[])
 	       block.h.u.u8[3], block.h.u.u8[4], block.h.u.u8[5],
 	       (unsigned long long)time_to_nsec(diff));
 
+#endif
+
 	return 0;
 }
 	
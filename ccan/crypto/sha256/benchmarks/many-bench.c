@@ -0,0 +1,90 @@
+/* Compare one-at-a-time SHA256 with the multi-buffer versions, on
+ * 64-byte messages (Merkle nodes) and on short variable-length ones. */
+#include <ccan/crypto/sha256/sha256.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+#define NUM 4096
+
+struct lanes_impl {
+	const char *name;
+	struct sha256_lanes_impl impl;
+	bool usable;
+};
+
+static double nsec_per(struct timeabs start, size_t n)
+{
+	return (double)time_to_nsec(time_between(time_now(), start)) / n;
+}
+
+int main(int argc, char *argv[])
+{
+	struct lanes_impl impls[] = {
+		{ "single", { NULL, 1 }, true },
+#ifdef __GNUC__
+		{ "4 lanes", { sha256_lanes4, 4 }, true },
+#endif
+#ifdef SHA256_X86
+		{ "8 lanes avx2", { sha256_lanes8_avx2, 8 },
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		  && cpuid_os_has_avx() },
+		{ "16 lanes avx512", { sha256_lanes16_avx512, 16 },
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX512F)
+		  && cpuid_os_has_avx512() },
+#endif
+	};
+	size_t rounds = argv[1] ? atol(argv[1]) : 200;
+	unsigned char *data = malloc(NUM * 64);
+	struct sha256 *h = malloc(NUM * sizeof(*h));
+	const void *msgs[NUM];
+	size_t lens[NUM], i, r;
+	struct timeabs start;
+
+	for (i = 0; i < NUM * 64; i++)
+		data[i] = i * 7 + (i >> 8);
+	for (i = 0; i < NUM; i++) {
+		msgs[i] = data + i * 16;
+		lens[i] = 20 + i % 16;
+	}
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			sha256(&h[i], data + i * 64, 64);
+	printf("sha256() on 64 bytes: %.1f ns/msg\n", nsec_per(start, rounds * NUM));
+
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		if (!impls[i].usable) {
+			printf("%s: unsupported on this CPU\n", impls[i].name);
+			continue;
+		}
+		lanes_impl = &impls[i].impl;
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			sha256_many_64(h, data, NUM);
+		printf("%s: sha256_many_64 %.1f ns/msg", impls[i].name,
+		       nsec_per(start, rounds * NUM));
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			sha256_many(h, msgs, lens, NUM);
+		printf(", sha256_many (20-35 bytes) %.1f ns/msg",
+		       nsec_per(start, rounds * NUM));
+
+		start = time_now();
+		for (r = 0; r < rounds; r++) {
+			size_t n = NUM;
+			memcpy(h, data, NUM * sizeof(*h));
+			while (n > 1) {
+				sha256_merkle_layer(h, h, n);
+				n = (n + 1) / 2;
+			}
+		}
+		printf(", merkle root of %u: %.1f us\n", NUM,
+		       nsec_per(start, rounds) / 1000);
+	}
+	free(h);
+	free(data);
+	return 0;
+}
@@ -48,6 +48,50 @@ void sha256_done(struct sha256_ctx *ctx, struct sha256 *res)
 	SHA256_Final(res->u.u8, &ctx->c);
 	invalidate_sha256(ctx);
 }
+
+void sha256_many(struct sha256 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sha256(&hashes[i], msgs[i], lens[i]);
+}
+
+void sha256_many_64(struct sha256 *hashes, const void *in, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sha256(&hashes[i], (const char *)in + i * 64, 64);
+}
+
+void sha256_multi_init(struct sha256_multi_ctx *ctx, size_t lanes)
+{
+	size_t i;
+
+	assert(lanes <= SHA256_MULTI_LANES);
+	ctx->lanes = lanes;
+	for (i = 0; i < lanes; i++)
+		sha256_init(&ctx->ctx[i]);
+}
+
+void sha256_multi_update(struct sha256_multi_ctx *ctx,
+			 const void *const p[], size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->lanes; i++)
+		sha256_update(&ctx->ctx[i], p[i], size);
+}
+
+void sha256_multi_done(struct sha256_multi_ctx *ctx, struct sha256 res[])
+{
+	size_t i;
+
+	for (i = 0; i < ctx->lanes; i++)
+		sha256_done(&ctx->ctx[i], &res[i]);
+}
 #else
 static uint32_t Ch(uint32_t x, uint32_t y, uint32_t z)
 {
@@ -176,6 +220,299 @@ static bool alignment_ok(const void *p UNUSED, size_t n UNUSED)
 #endif
 }
 
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/* Process @blocks 64-byte chunks at @data (any alignment). */
+static void transform_generic(uint32_t *s, const unsigned char *data,
+			      size_t blocks)
+{
+	for (; blocks; blocks--, data += 64) {
+		if (alignment_ok(data, sizeof(uint32_t)))
+			Transform(s, (const uint32_t *)data);
+		else {
+			uint32_t chunk[16];
+			memcpy(chunk, data, sizeof(chunk));
+			Transform(s, chunk);
+		}
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86 1
+#include <ccan/cpuid/cpuid.h>
+#include <immintrin.h>
+
+/*
+ * The SSE4 and AVX2 versions vectorize the message schedule (which is a
+ * quarter of the work), storing W[i] + K[i] so the scalar rounds only
+ * have a single add.  AVX2 schedules two blocks at once, one per
+ * 128-bit lane, and lets the compiler use BMI2's rorx for the rounds.
+ */
+static inline void rounds_wk(uint32_t *s, const uint32_t *wk)
+{
+	uint32_t a = s[0], b = s[1], c = s[2], d = s[3];
+	uint32_t e = s[4], f = s[5], g = s[6], h = s[7];
+	size_t i;
+
+	for (i = 0; i < 64; i += 8) {
+		Round(a, b, c, &d, e, f, g, &h, wk[i + 0], 0);
+		Round(h, a, b, &c, d, e, f, &g, wk[i + 1], 0);
+		Round(g, h, a, &b, c, d, e, &f, wk[i + 2], 0);
+		Round(f, g, h, &a, b, c, d, &e, wk[i + 3], 0);
+		Round(e, f, g, &h, a, b, c, &d, wk[i + 4], 0);
+		Round(d, e, f, &g, h, a, b, &c, wk[i + 5], 0);
+		Round(c, d, e, &f, g, h, a, &b, wk[i + 6], 0);
+		Round(b, c, d, &e, f, g, h, &a, wk[i + 7], 0);
+	}
+	s[0] += a;
+	s[1] += b;
+	s[2] += c;
+	s[3] += d;
+	s[4] += e;
+	s[5] += f;
+	s[6] += g;
+	s[7] += h;
+}
+
+/* Rotate right each 32-bit lane (SSE/AVX2 have no rotate instruction). */
+#define ROR128(x, n) \
+	_mm_or_si128(_mm_srli_epi32((x), (n)), _mm_slli_epi32((x), 32 - (n)))
+#define ROR256(x, n) \
+	_mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+/*
+ * W[t..t+3] from the previous 16 words in X0..X3.  sigma1 depends on
+ * W[t-2] and W[t-1], so lanes 2 and 3 need lanes 0 and 1 of the result:
+ * we do the low half first, then shift it up and do the high half
+ * (sigma1(0) == 0, so the zeroed lanes add nothing).
+ */
+#define SCHED(V, ADD, ALIGNR, SRLI, SLLI, SRL, SLL, XOR, ROR,		\
+	      X0, X1, X2, X3, OUT)						\
+	do {								\
+		V w15 = ALIGNR(X1, X0, 4), w7 = ALIGNR(X3, X2, 4), w2;	\
+		V s0 = XOR(XOR(ROR(w15, 7), ROR(w15, 18)), SRL(w15, 3)); \
+		OUT = ADD(ADD(X0, s0), w7);				\
+		w2 = SRLI(X3, 8);					\
+		OUT = ADD(OUT, XOR(XOR(ROR(w2, 17), ROR(w2, 19)),	\
+				   SRL(w2, 10)));			\
+		w2 = SLLI(OUT, 8);					\
+		OUT = ADD(OUT, XOR(XOR(ROR(w2, 17), ROR(w2, 19)),	\
+				   SRL(w2, 10)));			\
+	} while (0)
+
+#define SCHED128(X0, X1, X2, X3, OUT)					\
+	SCHED(__m128i, _mm_add_epi32, _mm_alignr_epi8, _mm_srli_si128,	\
+	      _mm_slli_si128, _mm_srli_epi32, _mm_slli_epi32,		\
+	      _mm_xor_si128, ROR128, X0, X1, X2, X3, OUT)
+#define SCHED256(X0, X1, X2, X3, OUT)					\
+	SCHED(__m256i, _mm256_add_epi32, _mm256_alignr_epi8,		\
+	      _mm256_srli_si256, _mm256_slli_si256, _mm256_srli_epi32,	\
+	      _mm256_slli_epi32, _mm256_xor_si256, ROR256,		\
+	      X0, X1, X2, X3, OUT)
+
+__attribute__((target("ssse3,sse4.1")))
+static void schedule_sse4(uint32_t wk[64], const unsigned char *data)
+{
+	const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+					   4, 5, 6, 7, 0, 1, 2, 3);
+	__m128i x[4], next;
+	size_t i;
+
+	for (i = 0; i < 4; i++) {
+		x[i] = _mm_loadu_si128((const __m128i *)(data + i * 16));
+		x[i] = _mm_shuffle_epi8(x[i], bswap);
+		_mm_storeu_si128((__m128i *)(wk + i * 4),
+				 _mm_add_epi32(x[i], _mm_loadu_si128((const __m128i *)(K256 + i * 4))));
+	}
+	for (i = 16; i < 64; i += 4) {
+		SCHED128(x[0], x[1], x[2], x[3], next);
+		x[0] = x[1];
+		x[1] = x[2];
+		x[2] = x[3];
+		x[3] = next;
+		_mm_storeu_si128((__m128i *)(wk + i),
+				 _mm_add_epi32(next, _mm_loadu_si128((const __m128i *)(K256 + i))));
+	}
+}
+
+__attribute__((target("ssse3,sse4.1")))
+static void transform_sse4(uint32_t *s, const unsigned char *data,
+			   size_t blocks)
+{
+	uint32_t wk[64];
+
+	for (; blocks; blocks--, data += 64) {
+		schedule_sse4(wk, data);
+		rounds_wk(s, wk);
+	}
+}
+
+__attribute__((target("avx2,bmi2")))
+static void transform_avx2(uint32_t *s, const unsigned char *data,
+			   size_t blocks)
+{
+	const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+					      4, 5, 6, 7, 0, 1, 2, 3,
+					      12, 13, 14, 15, 8, 9, 10, 11,
+					      4, 5, 6, 7, 0, 1, 2, 3);
+	uint32_t wk[2][64];
+	__m256i x[4], next, k;
+	size_t i;
+
+	for (; blocks >= 2; blocks -= 2, data += 128) {
+		/* Block one in the low lanes, block two in the high. */
+		for (i = 0; i < 4; i++) {
+			x[i] = _mm256_loadu2_m128i((const __m128i *)(data + 64 + i * 16),
+						   (const __m128i *)(data + i * 16));
+			x[i] = _mm256_shuffle_epi8(x[i], bswap);
+			k = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(K256 + i * 4)));
+			_mm256_storeu2_m128i((__m128i *)(wk[1] + i * 4),
+					     (__m128i *)(wk[0] + i * 4),
+					     _mm256_add_epi32(x[i], k));
+		}
+		for (i = 16; i < 64; i += 4) {
+			SCHED256(x[0], x[1], x[2], x[3], next);
+			x[0] = x[1];
+			x[1] = x[2];
+			x[2] = x[3];
+			x[3] = next;
+			k = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(K256 + i)));
+			_mm256_storeu2_m128i((__m128i *)(wk[1] + i),
+					     (__m128i *)(wk[0] + i),
+					     _mm256_add_epi32(next, k));
+		}
+		rounds_wk(s, wk[0]);
+		rounds_wk(s, wk[1]);
+	}
+	if (blocks) {
+		schedule_sse4(wk[0], data);
+		rounds_wk(s, wk[0]);
+	}
+}
+
+/* Four rounds using the SHA extensions.  M[] holds the message words for
+ * rounds 4*G onwards; msg1/msg2 compute the schedule a few steps ahead. */
+#define SHANI_ROUNDS(G, M0, M1, M2, M3)					\
+	do {								\
+		msg = _mm_add_epi32(M0, _mm_loadu_si128((const __m128i *)(K256 + (G) * 4))); \
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);	\
+		if ((G) >= 3 && (G) < 15) {				\
+			tmp = _mm_alignr_epi8(M0, M3, 4);		\
+			M1 = _mm_add_epi32(M1, tmp);			\
+			M1 = _mm_sha256msg2_epu32(M1, M0);		\
+		}							\
+		msg = _mm_shuffle_epi32(msg, 0x0E);			\
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);	\
+		if ((G) >= 1 && (G) < 13)				\
+			M3 = _mm_sha256msg1_epu32(M3, M0);		\
+	} while (0)
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void transform_shani(uint32_t *s, const unsigned char *data,
+			    size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+					   4, 5, 6, 7, 0, 1, 2, 3);
+	__m128i state0, state1, msg, tmp, m0, m1, m2, m3, abef, cdgh;
+
+	/* The instructions want the state as ABEF and CDGH. */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)s), 0xB1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(s + 4)), 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	for (; blocks; blocks--, data += 64) {
+		abef = state0;
+		cdgh = state1;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), bswap);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), bswap);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), bswap);
+
+		SHANI_ROUNDS(0, m0, m1, m2, m3);
+		SHANI_ROUNDS(1, m1, m2, m3, m0);
+		SHANI_ROUNDS(2, m2, m3, m0, m1);
+		SHANI_ROUNDS(3, m3, m0, m1, m2);
+		SHANI_ROUNDS(4, m0, m1, m2, m3);
+		SHANI_ROUNDS(5, m1, m2, m3, m0);
+		SHANI_ROUNDS(6, m2, m3, m0, m1);
+		SHANI_ROUNDS(7, m3, m0, m1, m2);
+		SHANI_ROUNDS(8, m0, m1, m2, m3);
+		SHANI_ROUNDS(9, m1, m2, m3, m0);
+		SHANI_ROUNDS(10, m2, m3, m0, m1);
+		SHANI_ROUNDS(11, m3, m0, m1, m2);
+		SHANI_ROUNDS(12, m0, m1, m2, m3);
+		SHANI_ROUNDS(13, m1, m2, m3, m0);
+		SHANI_ROUNDS(14, m2, m3, m0, m1);
+		SHANI_ROUNDS(15, m3, m0, m1, m2);
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)s, state0);
+	_mm_storeu_si128((__m128i *)(s + 4), state1);
+}
+
+static void transform_dispatch(uint32_t *s, const unsigned char *data,
+			       size_t blocks);
+
+/* Replaced by the best transform on first use.  Threads may race to do
+ * so, but they all store the same pointer. */
+static void (*transform_impl)(uint32_t *s, const unsigned char *data,
+			      size_t blocks) = transform_dispatch;
+
+static void transform_dispatch(uint32_t *s, const unsigned char *data,
+			       size_t blocks)
+{
+	bool sse4 = cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3)
+		&& cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_1);
+	void (*impl)(uint32_t *, const unsigned char *, size_t);
+
+	if (sse4 && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_SHA))
+		impl = transform_shani;
+	else if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		 && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+		 && cpuid_os_has_avx())
+		impl = transform_avx2;
+	else if (sse4)
+		impl = transform_sse4;
+	else
+		impl = transform_generic;
+	__atomic_store_n(&transform_impl, impl, __ATOMIC_RELAXED);
+	impl(s, data, blocks);
+}
+
+static void transform(uint32_t *s, const unsigned char *data, size_t blocks)
+{
+	__atomic_load_n(&transform_impl, __ATOMIC_RELAXED)(s, data, blocks);
+}
+#else
+#define transform transform_generic
+#endif
+
 static void add(struct sha256_ctx *ctx, const void *p, size_t len)
 {
 	const unsigned char *data = p;
@@ -187,23 +524,20 @@ static void add(struct sha256_ctx *ctx, const void *p, size_t len)
 		ctx->bytes += 64 - bufsize;
 		data += 64 - bufsize;
 		len -= 64 - bufsize;
-		Transform(ctx->s, ctx->buf.u32);
+		transform(ctx->s, ctx->buf.u8, 1);
 		bufsize = 0;
 	}
 
-	while (len >= 64) {
+	if (len >= 64) {
 		/* Process full chunks directly from the source. */
-		if (alignment_ok(data, sizeof(uint32_t)))
-			Transform(ctx->s, (const uint32_t *)data);
-		else {
-			memcpy(ctx->buf.u8, data, sizeof(ctx->buf));
-			Transform(ctx->s, ctx->buf.u32);
-		}
-		ctx->bytes += 64;
-		data += 64;
-		len -= 64;
+		size_t blocks = len / 64;
+
+		transform(ctx->s, data, blocks);
+		ctx->bytes += blocks * 64;
+		data += blocks * 64;
+		len -= blocks * 64;
 	}
-	    
+
 	if (len) {
 		/* Fill the buffer with what remains. */
 		memcpy(ctx->buf.u8 + bufsize, data, len);
@@ -238,8 +572,385 @@ void sha256_done(struct sha256_ctx *ctx, struct sha256 *res)
 		res->u.u32[i] = cpu_to_be32(ctx->s[i]);
 	invalidate_sha256(ctx);
 }
+/*
+ * Multi-buffer hashing: the state of lane l is s[0..7][l], so the same
+ * word of every lane is adjacent and loads straight into a vector.  The
+ * SIMD kernels process one block in each of their lanes; anything left
+ * over goes through the single-message transform.
+ */
+typedef uint32_t sha256_lanes_t[8][SHA256_MULTI_LANES];
+
+/* The second block of any 64-byte message: 0x80, zeroes, then the
+ * length (512 bits).  pad64_wk[] is its message schedule plus K. */
+static const unsigned char pad64[64] = { 0x80, [62] = 0x02 };
+static const uint32_t pad64_wk[64] = {
+	0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+	0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254,
+	0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+	0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7,
+	0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+	0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd,
+	0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+	0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537,
+	0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+	0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7,
+	0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+	0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c,
+	0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76
+};
+
+/* Lanes [off, off + LANES) each get one block: blocks[i] for lane
+ * off + i, or the pad64 block for all of them if blocks is NULL. */
+typedef void (*sha256_lanes_fn)(sha256_lanes_t s, size_t off,
+				const unsigned char *const *blocks);
+
+#if defined(__GNUC__)
+#define SHA256_VEC_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define SHA256_VEC_ROUND(a, b, c, d, e, f, g, h, wk)			\
+	do {								\
+		VEC t1_ = h + (SHA256_VEC_ROR(e, 6) ^ SHA256_VEC_ROR(e, 11) \
+			       ^ SHA256_VEC_ROR(e, 25))			\
+			+ (g ^ (e & (f ^ g))) + (wk);			\
+		VEC t2_ = (SHA256_VEC_ROR(a, 2) ^ SHA256_VEC_ROR(a, 13)	\
+			   ^ SHA256_VEC_ROR(a, 22))			\
+			+ ((a & b) | (c & (a | b)));			\
+		d += t1_;						\
+		h = t1_ + t2_;						\
+	} while (0)
+
+#define DEFINE_SHA256_LANES(NAME, LANES, ATTR)				\
+typedef uint32_t NAME##_vec __attribute__((vector_size((LANES) * 4)));	\
+ATTR static void NAME(sha256_lanes_t s, size_t off,			\
+		      const unsigned char *const *blocks)		\
+{									\
+	typedef NAME##_vec VEC;						\
+	VEC w[64], st[8], a, b, c, d, e, f, g, h;			\
+	size_t i, l;							\
+									\
+	if (blocks) {							\
+		/* The blocks may have any alignment. */		\
+		for (l = 0; l < (LANES); l++) {				\
+			beint32_t chunk[16];				\
+			memcpy(chunk, blocks[l], sizeof(chunk));	\
+			for (i = 0; i < 16; i++)			\
+				w[i][l] = be32_to_cpu(chunk[i]);	\
+		}							\
+		for (i = 16; i < 64; i++) {				\
+			VEC w15 = w[i - 15], w2 = w[i - 2];		\
+			w[i] = w[i - 16] + w[i - 7]			\
+				+ (SHA256_VEC_ROR(w15, 7)		\
+				   ^ SHA256_VEC_ROR(w15, 18) ^ (w15 >> 3)) \
+				+ (SHA256_VEC_ROR(w2, 17)		\
+				   ^ SHA256_VEC_ROR(w2, 19) ^ (w2 >> 10)); \
+		}							\
+		for (i = 0; i < 64; i++)				\
+			w[i] += K256[i];				\
+	} else {							\
+		for (i = 0; i < 64; i++)				\
+			w[i] = (VEC){ 0 } + pad64_wk[i];		\
+	}								\
+									\
+	for (i = 0; i < 8; i++)						\
+		memcpy(&st[i], &s[i][off], sizeof(VEC));		\
+	a = st[0]; b = st[1]; c = st[2]; d = st[3];			\
+	e = st[4]; f = st[5]; g = st[6]; h = st[7];			\
+	for (i = 0; i < 64; i += 8) {					\
+		SHA256_VEC_ROUND(a, b, c, d, e, f, g, h, w[i + 0]);	\
+		SHA256_VEC_ROUND(h, a, b, c, d, e, f, g, w[i + 1]);	\
+		SHA256_VEC_ROUND(g, h, a, b, c, d, e, f, w[i + 2]);	\
+		SHA256_VEC_ROUND(f, g, h, a, b, c, d, e, w[i + 3]);	\
+		SHA256_VEC_ROUND(e, f, g, h, a, b, c, d, w[i + 4]);	\
+		SHA256_VEC_ROUND(d, e, f, g, h, a, b, c, w[i + 5]);	\
+		SHA256_VEC_ROUND(c, d, e, f, g, h, a, b, w[i + 6]);	\
+		SHA256_VEC_ROUND(b, c, d, e, f, g, h, a, w[i + 7]);	\
+	}								\
+	st[0] += a; st[1] += b; st[2] += c; st[3] += d;			\
+	st[4] += e; st[5] += f; st[6] += g; st[7] += h;			\
+	for (i = 0; i < 8; i++)						\
+		memcpy(&s[i][off], &st[i], sizeof(VEC));		\
+}
+
+/* SSE2 on x86-64, NEON on ARM, or whatever the compiler can do. */
+DEFINE_SHA256_LANES(sha256_lanes4, 4, )
+#endif
+
+#ifdef SHA256_X86
+DEFINE_SHA256_LANES(sha256_lanes8_avx2, 8, __attribute__((target("avx2"))))
+DEFINE_SHA256_LANES(sha256_lanes16_avx512, 16, __attribute__((target("avx512f"))))
+#endif
+
+/* A lanes kernel, or NULL to do one lane at a time, and its width. */
+struct sha256_lanes_impl {
+	sha256_lanes_fn fn;
+	size_t width;
+};
+
+#if defined(SHA256_X86) || !defined(__GNUC__)
+static const struct sha256_lanes_impl lanes_one = { NULL, 1 };
+#endif
+#if defined(__GNUC__)
+static const struct sha256_lanes_impl lanes_vec4 = { sha256_lanes4, 4 };
+#endif
+#ifdef SHA256_X86
+static const struct sha256_lanes_impl lanes_avx2 = { sha256_lanes8_avx2, 8 };
+static const struct sha256_lanes_impl lanes_avx512 = {
+	sha256_lanes16_avx512, 16
+};
+#endif
+
+/* NULL until the first multi-buffer hash picks one. */
+static const struct sha256_lanes_impl *lanes_impl;
+
+static const struct sha256_lanes_impl *lanes_select(void)
+{
+#ifdef SHA256_X86
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX512F)
+	    && cpuid_os_has_avx512())
+		return &lanes_avx512;
+	/* The SHA extensions beat 8 lanes of AVX2. */
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_SHA))
+		return &lanes_one;
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+	    && cpuid_os_has_avx())
+		return &lanes_avx2;
+	return &lanes_vec4;
+#elif defined(__GNUC__)
+	return &lanes_vec4;
+#else
+	return &lanes_one;
+#endif
+}
+
+/* Threads may race to pick, but they all pick the same. */
+static const struct sha256_lanes_impl *lanes_get(void)
+{
+#if defined(__GNUC__)
+	const struct sha256_lanes_impl *impl
+		= __atomic_load_n(&lanes_impl, __ATOMIC_RELAXED);
+
+	if (!impl) {
+		impl = lanes_select();
+		__atomic_store_n(&lanes_impl, impl, __ATOMIC_RELAXED);
+	}
+	return impl;
+#else
+	return lanes_impl ? lanes_impl : lanes_select();
+#endif
+}
+
+/* One block for each of lanes [0, n): blocks[] as for sha256_lanes_fn. */
+static void lanes_blocks(sha256_lanes_t s, size_t n,
+			 const unsigned char *const *blocks)
+{
+	const struct sha256_lanes_impl *impl = lanes_get();
+	size_t off = 0, i;
+
+	if (impl->fn) {
+		for (; off + impl->width <= n; off += impl->width)
+			impl->fn(s, off, blocks ? blocks + off : NULL);
+	}
+	for (; off < n; off++) {
+		uint32_t one[8];
+
+		for (i = 0; i < 8; i++)
+			one[i] = s[i][off];
+		transform(one, blocks ? blocks[off] : pad64, 1);
+		for (i = 0; i < 8; i++)
+			s[i][off] = one[i];
+	}
+}
+
+static void lanes_init(sha256_lanes_t s, size_t n)
+{
+	const struct sha256_ctx init = SHA256_INIT;
+	size_t i, l;
+
+	for (i = 0; i < 8; i++)
+		for (l = 0; l < n; l++)
+			s[i][l] = init.s[i];
+}
+
+static void lanes_result(const sha256_lanes_t s, size_t lane,
+			 struct sha256 *res)
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		res->u.u32[i] = cpu_to_be32(s[i][lane]);
+}
+
+void sha256_many_64(struct sha256 *hashes, const void *in, size_t n)
+{
+	const unsigned char *p = in;
+	sha256_lanes_t s;
+
+	while (n) {
+		const unsigned char *blocks[SHA256_MULTI_LANES];
+		size_t i, num = n < SHA256_MULTI_LANES ? n : SHA256_MULTI_LANES;
+
+		for (i = 0; i < num; i++)
+			blocks[i] = p + i * 64;
+		lanes_init(s, num);
+		lanes_blocks(s, num, blocks);
+		lanes_blocks(s, num, NULL);
+		for (i = 0; i < num; i++)
+			lanes_result(s, i, &hashes[i]);
+		hashes += num;
+		p += num * 64;
+		n -= num;
+	}
+}
+
+/* Message padding: the final one or two blocks of a message of @len
+ * bytes, whose last (len % 64) bytes are at @tail.  Returns blocks. */
+static size_t final_blocks(unsigned char buf[128], const void *tail,
+			   uint64_t len)
+{
+	size_t rem = len % 64, num = rem < 56 ? 1 : 2;
+	beint64_t bits = cpu_to_be64(len << 3);
+
+	memcpy(buf, tail, rem);
+	buf[rem] = 0x80;
+	memset(buf + rem + 1, 0, num * 64 - rem - 1 - 8);
+	memcpy(buf + num * 64 - 8, &bits, 8);
+	return num;
+}
+
+void sha256_many(struct sha256 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n)
+{
+	sha256_lanes_t s;
+	unsigned char tails[SHA256_MULTI_LANES][128];
+
+	while (n) {
+		const unsigned char *blocks[SHA256_MULTI_LANES];
+		size_t nblocks[SHA256_MULTI_LANES], max = 0, b, i;
+		size_t num = n < SHA256_MULTI_LANES ? n : SHA256_MULTI_LANES;
+
+		for (i = 0; i < num; i++) {
+			nblocks[i] = lens[i] / 64
+				+ final_blocks(tails[i],
+					       (const char *)msgs[i]
+					       + lens[i] / 64 * 64, lens[i]);
+			if (nblocks[i] > max)
+				max = nblocks[i];
+		}
+
+		/* Lanes which have finished just hash their padding again:
+		 * we've already saved their result. */
+		lanes_init(s, num);
+		for (b = 0; b < max; b++) {
+			for (i = 0; i < num; i++) {
+				size_t full = lens[i] / 64;
+				size_t blk = b < nblocks[i] ? b : nblocks[i] - 1;
+
+				if (blk < full)
+					blocks[i] = (const unsigned char *)msgs[i]
+						+ blk * 64;
+				else
+					blocks[i] = tails[i] + (blk - full) * 64;
+			}
+			lanes_blocks(s, num, blocks);
+			for (i = 0; i < num; i++)
+				if (b + 1 == nblocks[i])
+					lanes_result(s, i, &hashes[i]);
+		}
+		hashes += num;
+		msgs += num;
+		lens += num;
+		n -= num;
+	}
+}
+
+void sha256_multi_init(struct sha256_multi_ctx *ctx, size_t lanes)
+{
+	assert(lanes <= SHA256_MULTI_LANES);
+	ctx->lanes = lanes;
+	ctx->bytes = 0;
+	lanes_init(ctx->s, lanes);
+}
+
+void sha256_multi_update(struct sha256_multi_ctx *ctx,
+			 const void *const p[], size_t size)
+{
+	const unsigned char *blocks[SHA256_MULTI_LANES];
+	size_t bufsize = ctx->bytes % 64, off = 0, i;
+
+	assert(ctx->bytes != (size_t)-1);
+	if (bufsize + size >= 64 && bufsize) {
+		/* Fill the buffers, and process them. */
+		off = 64 - bufsize;
+		for (i = 0; i < ctx->lanes; i++) {
+			memcpy(ctx->buf[i] + bufsize, p[i], off);
+			blocks[i] = ctx->buf[i];
+		}
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+		bufsize = 0;
+	}
+
+	/* Process full blocks directly from the source. */
+	for (; size - off >= 64 && bufsize == 0; off += 64) {
+		for (i = 0; i < ctx->lanes; i++)
+			blocks[i] = (const unsigned char *)p[i] + off;
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+	}
+
+	if (size > off) {
+		for (i = 0; i < ctx->lanes; i++)
+			memcpy(ctx->buf[i] + bufsize,
+			       (const unsigned char *)p[i] + off, size - off);
+	}
+	ctx->bytes += size;
+}
+
+void sha256_multi_done(struct sha256_multi_ctx *ctx, struct sha256 res[])
+{
+	unsigned char tails[SHA256_MULTI_LANES][128];
+	const unsigned char *blocks[SHA256_MULTI_LANES];
+	size_t num = 0, b, i;
+
+	assert(ctx->bytes != (size_t)-1);
+	for (i = 0; i < ctx->lanes; i++)
+		num = final_blocks(tails[i], ctx->buf[i], ctx->bytes);
+	for (b = 0; b < num; b++) {
+		for (i = 0; i < ctx->lanes; i++)
+			blocks[i] = tails[i] + b * 64;
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+	}
+	for (i = 0; i < ctx->lanes; i++)
+		lanes_result(ctx->s, i, &res[i]);
+	ctx->bytes = (size_t)-1;
+}
 #endif
 
+void sha256_merkle_layer(struct sha256 *parents,
+			 const struct sha256 *children, size_t num_children)
+{
+	struct sha256 out[SHA256_MULTI_LANES];
+	size_t i = 0;
+
+	/* In batches, so it's safe for parents to overwrite children. */
+	while (num_children - i * 2 >= 2) {
+		size_t num = (num_children - i * 2) / 2;
+
+		if (num > SHA256_MULTI_LANES)
+			num = SHA256_MULTI_LANES;
+		sha256_many_64(out, children + i * 2, num);
+		memcpy(parents + i, out, num * sizeof(out[0]));
+		i += num;
+	}
+	if (num_children % 2) {
+		struct sha256 pair[2];
+
+		pair[0] = pair[1] = children[num_children - 1];
+		sha256_many_64(&parents[i], pair, 1);
+	}
+}
+
 void sha256(struct sha256 *sha, const void *p, size_t size)
 {
 	struct sha256_ctx ctx;
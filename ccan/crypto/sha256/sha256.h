@@ -144,4 +144,141 @@ void sha256_le64(struct sha256_ctx *ctx, uint64_t v);
 void sha256_be16(struct sha256_ctx *ctx, uint16_t v);
 void sha256_be32(struct sha256_ctx *ctx, uint32_t v);
 void sha256_be64(struct sha256_ctx *ctx, uint64_t v);
+
+/**
+ * sha256_many - SHA256 of many independent messages
+ * @hashes: array of @n hashes to fill in
+ * @msgs: array of @n pointers to the messages
+ * @lens: array of @n message lengths
+ * @n: the number of messages
+ *
+ * This sets hashes[i] to sha256() of @msgs[i], but hashes several
+ * messages at once in SIMD lanes (4 with SSE2 or NEON, 8 with AVX2, 16
+ * with AVX-512), which is much faster than one-at-a-time on many short
+ * messages.  Messages are grouped in order, so it works best if
+ * neighbouring messages have similar lengths.
+ *
+ * Example:
+ *	#include <ccan/crypto/sha256/sha256.h>
+ *	#include <string.h>
+ *
+ *	static void hash_strings(struct sha256 *hashes, const char *strs[],
+ *				 size_t n)
+ *	{
+ *		size_t i, lens[n];
+ *
+ *		for (i = 0; i < n; i++)
+ *			lens[i] = strlen(strs[i]);
+ *		sha256_many(hashes, (const void *const *)strs, lens, n);
+ *	}
+ */
+void sha256_many(struct sha256 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n);
+
+/**
+ * sha256_many_64 - SHA256 of many 64-byte messages
+ * @hashes: array of @n hashes to fill in
+ * @in: @n 64-byte messages, one after another
+ * @n: the number of messages
+ *
+ * A fast path for the common case of hashing a pair of hashes (eg.
+ * Merkle tree nodes): hashes[i] is sha256() of the 64 bytes at
+ * @in + i * 64.  The padding block is the same for every message, so
+ * its message schedule is precomputed.
+ */
+void sha256_many_64(struct sha256 *hashes, const void *in, size_t n);
+
+/**
+ * sha256_merkle_layer - hash a layer of a Merkle tree
+ * @parents: the array of (@num_children + 1) / 2 parents to fill in
+ * @children: the array of @num_children child hashes
+ * @num_children: the number of children
+ *
+ * Sets each parents[i] to the SHA256 of children[2i] followed by
+ * children[2i+1].  If @num_children is odd, the last child is paired
+ * with itself (as Bitcoin does).  @parents may be the same as @children,
+ * so a whole tree can be built in place.
+ *
+ * Example:
+ *	#include <ccan/crypto/sha256/sha256.h>
+ *
+ *	// Destroys @leaves, leaving the root in leaves[0].
+ *	static void merkle_root(struct sha256 *leaves, size_t n)
+ *	{
+ *		while (n > 1) {
+ *			sha256_merkle_layer(leaves, leaves, n);
+ *			n = (n + 1) / 2;
+ *		}
+ *	}
+ */
+void sha256_merkle_layer(struct sha256 *parents,
+			 const struct sha256 *children, size_t num_children);
+
+/**
+ * SHA256_MULTI_LANES - maximum number of messages in a sha256_multi_ctx
+ */
+#define SHA256_MULTI_LANES 16
+
+/**
+ * struct sha256_multi_ctx - running context for several equal-length SHA256s
+ *
+ * This hashes up to SHA256_MULTI_LANES messages in parallel, as long as
+ * they are all fed the same number of bytes at a time.
+ */
+struct sha256_multi_ctx {
+#ifdef CCAN_CRYPTO_SHA256_USE_OPENSSL
+	struct sha256_ctx ctx[SHA256_MULTI_LANES];
+#else
+	uint32_t s[8][SHA256_MULTI_LANES];
+	unsigned char buf[SHA256_MULTI_LANES][64];
+	size_t bytes;
+#endif
+	size_t lanes;
+};
+
+/**
+ * sha256_multi_init - initialize a multi-lane SHA256 context
+ * @ctx: the sha256_multi_ctx to initialize
+ * @lanes: the number of messages, up to SHA256_MULTI_LANES.
+ *
+ * Example:
+ *	#include <ccan/crypto/sha256/sha256.h>
+ *
+ *	// Hash four equal-length streams at once.
+ *	static void hash4(const unsigned char *s[4], size_t len,
+ *			  struct sha256 res[4])
+ *	{
+ *		struct sha256_multi_ctx ctx;
+ *		const void *p[4];
+ *		size_t i, off;
+ *
+ *		sha256_multi_init(&ctx, 4);
+ *		for (off = 0; off < len; off += 100) {
+ *			size_t chunk = len - off < 100 ? len - off : 100;
+ *			for (i = 0; i < 4; i++)
+ *				p[i] = s[i] + off;
+ *			sha256_multi_update(&ctx, p, chunk);
+ *		}
+ *		sha256_multi_done(&ctx, res);
+ *	}
+ */
+void sha256_multi_init(struct sha256_multi_ctx *ctx, size_t lanes);
+
+/**
+ * sha256_multi_update - add the same length to each message
+ * @ctx: the sha256_multi_ctx to use
+ * @p: array of pointers, one for each lane
+ * @size: the number of bytes to add from each of @p
+ */
+void sha256_multi_update(struct sha256_multi_ctx *ctx,
+			 const void *const p[], size_t size);
+
+/**
+ * sha256_multi_done - finish all the SHA256s
+ * @ctx: the sha256_multi_ctx to complete
+ * @res: array of hashes to return, one per lane.
+ *
+ * As with sha256_done(), @ctx must be reinitialized after this.
+ */
+void sha256_multi_done(struct sha256_multi_ctx *ctx, struct sha256 res[]);
 #endif /* CCAN_CRYPTO_SHA256_H */
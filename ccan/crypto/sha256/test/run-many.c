@@ -0,0 +1,148 @@
+#include <ccan/crypto/sha256/sha256.h>
+/* Include the C files directly. */
+#include <ccan/crypto/sha256/sha256.c>
+#include <ccan/tap/tap.h>
+
+#define NUM 37
+
+static unsigned char data[NUM * 200];
+
+#if !defined(CCAN_CRYPTO_SHA256_USE_OPENSSL)
+static const struct sha256_lanes_impl one_at_a_time = { NULL, 1 };
+#endif
+
+static bool check_many(void)
+{
+	struct sha256 h[NUM], expect;
+	const void *msgs[NUM];
+	size_t lens[NUM], i;
+
+	/* All sorts of lengths, including 55/56/64 padding edges. */
+	for (i = 0; i < NUM; i++) {
+		lens[i] = (i * 29) % 200;
+		msgs[i] = data + i * 7;
+	}
+	lens[0] = 55;
+	lens[1] = 56;
+	lens[2] = 64;
+	lens[3] = 0;
+	sha256_many(h, msgs, lens, NUM);
+	for (i = 0; i < NUM; i++) {
+		sha256(&expect, msgs[i], lens[i]);
+		if (memcmp(&h[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool check_many_64(void)
+{
+	struct sha256 h[NUM], expect;
+	size_t i;
+
+	sha256_many_64(h, data + 1, NUM);
+	for (i = 0; i < NUM; i++) {
+		sha256(&expect, data + 1 + i * 64, 64);
+		if (memcmp(&h[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool check_merkle(size_t n)
+{
+	struct sha256 layer[NUM], parents[NUM], expect;
+	size_t i;
+
+	memcpy(layer, data, sizeof(layer));
+	sha256_merkle_layer(parents, layer, n);
+	for (i = 0; i < (n + 1) / 2; i++) {
+		struct sha256 pair[2];
+
+		pair[0] = layer[i * 2];
+		pair[1] = i * 2 + 1 < n ? layer[i * 2 + 1] : layer[i * 2];
+		sha256(&expect, pair, sizeof(pair));
+		if (memcmp(&parents[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	/* In place gives the same answer. */
+	sha256_merkle_layer(layer, layer, n);
+	return memcmp(layer, parents, (n + 1) / 2 * sizeof(layer[0])) == 0;
+}
+
+static bool check_multi(size_t lanes)
+{
+	struct sha256_multi_ctx mctx;
+	struct sha256 h[SHA256_MULTI_LANES], expect;
+	const void *p[SHA256_MULTI_LANES];
+	size_t total = 300, off = 0, chunk = 1, i;
+
+	sha256_multi_init(&mctx, lanes);
+	/* Growing chunks cover every buffering case. */
+	while (off < total) {
+		if (chunk > total - off)
+			chunk = total - off;
+		for (i = 0; i < lanes; i++)
+			p[i] = data + i * 100 + off;
+		sha256_multi_update(&mctx, p, chunk);
+		off += chunk;
+		chunk = chunk * 2 + 1;
+	}
+	sha256_multi_done(&mctx, h);
+	for (i = 0; i < lanes; i++) {
+		sha256(&expect, data + i * 100, total);
+		if (memcmp(&h[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool check_all(void)
+{
+	return check_many() && check_many_64()
+		&& check_merkle(1) && check_merkle(2) && check_merkle(NUM)
+		&& check_multi(1) && check_multi(5)
+		&& check_multi(SHA256_MULTI_LANES);
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 11 + (i >> 8);
+
+	plan_tests(4);
+
+	/* Whatever the CPU gives us. */
+	ok1(check_all());
+
+#if !defined(CCAN_CRYPTO_SHA256_USE_OPENSSL)
+	/* Force one at a time. */
+	lanes_impl = &one_at_a_time;
+	ok1(check_all());
+#else
+	pass("OpenSSL");
+#endif
+
+#if !defined(CCAN_CRYPTO_SHA256_USE_OPENSSL) && defined(__GNUC__)
+	lanes_impl = &lanes_vec4;
+	ok1(check_all());
+#else
+	pass("No vector extensions");
+#endif
+
+#ifdef SHA256_X86
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2) && cpuid_os_has_avx()) {
+		lanes_impl = &lanes_avx2;
+		ok1(check_all());
+	} else
+		pass("No AVX2");
+	/* AVX-512 is covered above when the CPU has it. */
+#else
+	pass("No AVX2");
+#endif
+
+	/* This exits depending on whether all tests passed */
+	return exit_status();
+}
@@ -0,0 +1,78 @@
+#include <ccan/crypto/sha256/sha256.h>
+/* Include the C files directly. */
+#include <ccan/crypto/sha256/sha256.c>
+#include <ccan/tap/tap.h>
+
+#if defined(SHA256_X86) && !defined(CCAN_CRYPTO_SHA256_USE_OPENSSL)
+/* Feed each length at various alignments and chunkings, compare. */
+static bool matches_generic(void (*fn)(uint32_t *, const unsigned char *,
+				       size_t))
+{
+	static unsigned char data[1024 + 8];
+	size_t len, off, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 13 + (i >> 7);
+
+	for (len = 0; len <= 1024; len++) {
+		for (off = 0; off < 8; off += 3) {
+			struct sha256_ctx ctx = SHA256_INIT;
+			uint32_t s[8];
+			struct sha256 h1, h2;
+
+			/* Raw blocks. */
+			memcpy(s, ctx.s, sizeof(s));
+			fn(s, data + off, len / 64);
+			transform_generic(ctx.s, data + off, len / 64);
+			if (memcmp(s, ctx.s, sizeof(s)) != 0)
+				return false;
+
+			/* Through the API, in two uneven pieces. */
+			transform_impl = fn;
+			sha256_init(&ctx);
+			sha256_update(&ctx, data + off, len / 3);
+			sha256_update(&ctx, data + off + len / 3, len - len / 3);
+			sha256_done(&ctx, &h1);
+			transform_impl = transform_generic;
+			sha256(&h2, data + off, len);
+			if (memcmp(&h1, &h2, sizeof(h1)) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+#endif
+
+int main(void)
+{
+	plan_tests(3);
+
+#if defined(SHA256_X86) && !defined(CCAN_CRYPTO_SHA256_USE_OPENSSL)
+	{
+		bool sse4 = cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSSE3)
+			&& cpuid_has_ecxfeature(CPUID_FEAT_ECX_SSE4_1);
+
+		if (sse4)
+			ok1(matches_generic(transform_sse4));
+		else
+			pass("No SSE4");
+		if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		    && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+		    && cpuid_os_has_avx())
+			ok1(matches_generic(transform_avx2));
+		else
+			pass("No AVX2");
+		if (sse4 && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_SHA))
+			ok1(matches_generic(transform_shani));
+		else
+			pass("No SHA extensions");
+	}
+#else
+	pass("No SSE4");
+	pass("No AVX2");
+	pass("No SHA extensions");
+#endif
+
+	/* This exits depending on whether all tests passed */
+	return exit_status();
+}
@@ -0,0 +1,105 @@
+/* Compare the SHA512 block transforms on long buffers, and one-at-a-time
+ * sha512() with the multi-buffer versions on short messages. */
+#include <ccan/crypto/sha512/sha512.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+#define BIG (1024 * 1024)
+#define NUM 4096
+
+struct transform_impl {
+	const char *name;
+	void (*fn)(uint64_t *s, const unsigned char *data, size_t blocks);
+	bool usable;
+};
+
+struct lanes_impl {
+	const char *name;
+	struct sha512_lanes_impl impl;
+	bool usable;
+};
+
+static double nsec_per(struct timeabs start, size_t n)
+{
+	return (double)time_to_nsec(time_between(time_now(), start)) / n;
+}
+
+int main(int argc, char *argv[])
+{
+	struct transform_impl transforms[] = {
+		{ "generic", transform_generic, true },
+#ifdef SHA512_X86
+		{ "avx2", transform_avx2,
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		  && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+		  && cpuid_os_has_avx() },
+#endif
+	};
+	struct lanes_impl impls[] = {
+		{ "single", { NULL, 1 }, true },
+#ifdef SHA512_X86
+		{ "4 lanes avx2", { sha512_lanes4_avx2, 4 },
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+		  && cpuid_os_has_avx() },
+		{ "8 lanes avx512", { sha512_lanes8_avx512, 8 },
+		  cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX512F)
+		  && cpuid_os_has_avx512() },
+#endif
+	};
+	size_t rounds = argv[1] ? atol(argv[1]) : 100;
+	unsigned char *data = malloc(BIG);
+	struct sha512 *h = malloc(NUM * sizeof(*h));
+	const void *msgs[NUM];
+	size_t lens[NUM], i, r;
+	struct timeabs start;
+
+	for (i = 0; i < BIG; i++)
+		data[i] = i * 7 + (i >> 8);
+	for (i = 0; i < NUM; i++) {
+		msgs[i] = data + i * 64;
+		lens[i] = 32 + i % 64;
+	}
+
+	for (i = 0; i < sizeof(transforms) / sizeof(transforms[0]); i++) {
+		struct sha512_ctx ctx = SHA512_INIT;
+		double ns;
+
+		if (!transforms[i].usable) {
+			printf("%s: unsupported on this CPU\n",
+			       transforms[i].name);
+			continue;
+		}
+		start = time_now();
+		for (r = 0; r < rounds / 10 + 1; r++)
+			transforms[i].fn(ctx.s, data, BIG / 128);
+		ns = nsec_per(start, (rounds / 10 + 1) * (size_t)BIG);
+		printf("transform %s: %.0f MB/s\n", transforms[i].name,
+		       1000.0 / ns);
+	}
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			sha512(&h[i], msgs[i], lens[i]);
+	printf("sha512() (32-95 bytes): %.1f ns/msg\n",
+	       nsec_per(start, rounds * NUM));
+
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		if (!impls[i].usable) {
+			printf("%s: unsupported on this CPU\n", impls[i].name);
+			continue;
+		}
+#ifdef SHA512_X86
+		lanes_impl = &impls[i].impl;
+#endif
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			sha512_many(h, msgs, lens, NUM);
+		printf("%s: sha512_many (32-95 bytes) %.1f ns/msg\n",
+		       impls[i].name, nsec_per(start, rounds * NUM));
+	}
+	free(h);
+	free(data);
+	return 0;
+}
@@ -48,6 +48,42 @@ void sha512_done(struct sha512_ctx *ctx, struct sha512 *res)
 	SHA512_Final(res->u.u8, &ctx->c);
 	invalidate_sha512(ctx);
 }
+
+void sha512_many(struct sha512 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sha512(&hashes[i], msgs[i], lens[i]);
+}
+
+void sha512_multi_init(struct sha512_multi_ctx *ctx, size_t lanes)
+{
+	size_t i;
+
+	assert(lanes <= SHA512_MULTI_LANES);
+	ctx->lanes = lanes;
+	for (i = 0; i < lanes; i++)
+		sha512_init(&ctx->ctx[i]);
+}
+
+void sha512_multi_update(struct sha512_multi_ctx *ctx,
+			 const void *const p[], size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->lanes; i++)
+		sha512_update(&ctx->ctx[i], p[i], size);
+}
+
+void sha512_multi_done(struct sha512_multi_ctx *ctx, struct sha512 res[])
+{
+	size_t i;
+
+	for (i = 0; i < ctx->lanes; i++)
+		sha512_done(&ctx->ctx[i], &res[i]);
+}
 #else
 static uint64_t Ch(uint64_t x, uint64_t y, uint64_t z)
 {
@@ -193,6 +229,195 @@ static bool alignment_ok(const void *p UNUSED, size_t n UNUSED)
 #endif
 }
 
+static const uint64_t K512[80] = {
+	0x428a2f98d728ae22ull, 0x7137449123ef65cdull,
+	0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+	0x3956c25bf348b538ull, 0x59f111f1b605d019ull,
+	0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+	0xd807aa98a3030242ull, 0x12835b0145706fbeull,
+	0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+	0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull,
+	0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+	0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull,
+	0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+	0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull,
+	0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+	0x983e5152ee66dfabull, 0xa831c66d2db43210ull,
+	0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+	0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull,
+	0x06ca6351e003826full, 0x142929670a0e6e70ull,
+	0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull,
+	0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+	0x650a73548baf63deull, 0x766a0abb3c77b2a8ull,
+	0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+	0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull,
+	0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+	0xd192e819d6ef5218ull, 0xd69906245565a910ull,
+	0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+	0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull,
+	0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+	0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull,
+	0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+	0x748f82ee5defb2fcull, 0x78a5636f43172f60ull,
+	0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+	0x90befffa23631e28ull, 0xa4506cebde82bde9ull,
+	0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+	0xca273eceea26619cull, 0xd186b8c721c0c207ull,
+	0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+	0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull,
+	0x113f9804bef90daeull, 0x1b710b35131c471bull,
+	0x28db77f523047d84ull, 0x32caab7b40c72493ull,
+	0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+	0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull,
+	0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull
+};
+
+/* Process @blocks 128-byte chunks at @data (any alignment). */
+static void transform_generic(uint64_t *s, const unsigned char *data,
+			      size_t blocks)
+{
+	for (; blocks; blocks--, data += 128) {
+		if (alignment_ok(data, sizeof(uint64_t)))
+			Transform(s, (const uint64_t *)data);
+		else {
+			uint64_t chunk[16];
+			memcpy(chunk, data, sizeof(chunk));
+			Transform(s, chunk);
+		}
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA512_X86 1
+#include <ccan/cpuid/cpuid.h>
+#include <immintrin.h>
+
+/*
+ * The AVX2 version vectorizes the message schedule, four 64-bit words
+ * at a time, storing W[i] + K[i] so the scalar rounds only have a
+ * single add, and lets the compiler use BMI2's rorx for the rounds.
+ *
+ * There's no SHA512-NI version: our compilers don't have the
+ * intrinsics yet, and we have no hardware to test it on.
+ */
+static inline void rounds_wk(uint64_t *s, const uint64_t *wk)
+{
+	uint64_t a = s[0], b = s[1], c = s[2], d = s[3];
+	uint64_t e = s[4], f = s[5], g = s[6], h = s[7];
+	size_t i;
+
+	for (i = 0; i < 80; i += 8) {
+		Round(a, b, c, &d, e, f, g, &h, wk[i + 0], 0);
+		Round(h, a, b, &c, d, e, f, &g, wk[i + 1], 0);
+		Round(g, h, a, &b, c, d, e, &f, wk[i + 2], 0);
+		Round(f, g, h, &a, b, c, d, &e, wk[i + 3], 0);
+		Round(e, f, g, &h, a, b, c, &d, wk[i + 4], 0);
+		Round(d, e, f, &g, h, a, b, &c, wk[i + 5], 0);
+		Round(c, d, e, &f, g, h, a, &b, wk[i + 6], 0);
+		Round(b, c, d, &e, f, g, h, &a, wk[i + 7], 0);
+	}
+	s[0] += a;
+	s[1] += b;
+	s[2] += c;
+	s[3] += d;
+	s[4] += e;
+	s[5] += f;
+	s[6] += g;
+	s[7] += h;
+}
+
+/* Rotate right each 64-bit lane (AVX2 has no rotate instruction). */
+#define ROR256(x, n) \
+	_mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+#define SIGMA0_256(x) \
+	_mm256_xor_si256(_mm256_xor_si256(ROR256(x, 1), ROR256(x, 8)), \
+			 _mm256_srli_epi64((x), 7))
+#define SIGMA1_256(x) \
+	_mm256_xor_si256(_mm256_xor_si256(ROR256(x, 19), ROR256(x, 61)), \
+			 _mm256_srli_epi64((x), 6))
+/* A[1], A[2], A[3], B[0]: alignr only works within 128-bit halves. */
+#define ALIGN1_256(A, B) \
+	_mm256_alignr_epi8(_mm256_permute2x128_si256((A), (B), 0x21), (A), 8)
+
+/*
+ * W[t..t+3] from the previous 16 words in X0..X3.  sigma1 depends on
+ * W[t-2] and W[t-1], so lanes 2 and 3 need lanes 0 and 1 of the result:
+ * we do the low half first, then move it up and do the high half
+ * (sigma1(0) == 0, so the zeroed lanes add nothing).
+ */
+#define SCHED256(X0, X1, X2, X3, OUT)					\
+	do {								\
+		__m256i w15 = ALIGN1_256(X0, X1), w7 = ALIGN1_256(X2, X3), w2; \
+		OUT = _mm256_add_epi64(_mm256_add_epi64(X0, SIGMA0_256(w15)), w7); \
+		w2 = _mm256_permute2x128_si256(X3, X3, 0x81);		\
+		OUT = _mm256_add_epi64(OUT, SIGMA1_256(w2));		\
+		w2 = _mm256_permute2x128_si256(OUT, OUT, 0x08);		\
+		OUT = _mm256_add_epi64(OUT, SIGMA1_256(w2));		\
+	} while (0)
+
+__attribute__((target("avx2,bmi2")))
+static void transform_avx2(uint64_t *s, const unsigned char *data,
+			   size_t blocks)
+{
+	const __m256i bswap = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15,
+					      0, 1, 2, 3, 4, 5, 6, 7,
+					      8, 9, 10, 11, 12, 13, 14, 15,
+					      0, 1, 2, 3, 4, 5, 6, 7);
+	uint64_t wk[80];
+	__m256i x[4], next;
+	size_t i;
+
+	for (; blocks; blocks--, data += 128) {
+		for (i = 0; i < 4; i++) {
+			x[i] = _mm256_loadu_si256((const __m256i *)(data + i * 32));
+			x[i] = _mm256_shuffle_epi8(x[i], bswap);
+			_mm256_storeu_si256((__m256i *)(wk + i * 4),
+					    _mm256_add_epi64(x[i], _mm256_loadu_si256((const __m256i *)(K512 + i * 4))));
+		}
+		for (i = 16; i < 80; i += 4) {
+			SCHED256(x[0], x[1], x[2], x[3], next);
+			x[0] = x[1];
+			x[1] = x[2];
+			x[2] = x[3];
+			x[3] = next;
+			_mm256_storeu_si256((__m256i *)(wk + i),
+					    _mm256_add_epi64(next, _mm256_loadu_si256((const __m256i *)(K512 + i))));
+		}
+		rounds_wk(s, wk);
+	}
+}
+
+static void transform_dispatch(uint64_t *s, const unsigned char *data,
+			       size_t blocks);
+
+/* Replaced by the best transform on first use.  Threads may race to do
+ * so, but they all store the same pointer. */
+static void (*transform_impl)(uint64_t *s, const unsigned char *data,
+			      size_t blocks) = transform_dispatch;
+
+static void transform_dispatch(uint64_t *s, const unsigned char *data,
+			       size_t blocks)
+{
+	void (*impl)(uint64_t *, const unsigned char *, size_t);
+
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+	    && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+	    && cpuid_os_has_avx())
+		impl = transform_avx2;
+	else
+		impl = transform_generic;
+	__atomic_store_n(&transform_impl, impl, __ATOMIC_RELAXED);
+	impl(s, data, blocks);
+}
+
+static void transform(uint64_t *s, const unsigned char *data, size_t blocks)
+{
+	__atomic_load_n(&transform_impl, __ATOMIC_RELAXED)(s, data, blocks);
+}
+#else
+#define transform transform_generic
+#endif
+
 static void add(struct sha512_ctx *ctx, const void *p, size_t len)
 {
 	const unsigned char *data = p;
@@ -204,21 +429,18 @@ static void add(struct sha512_ctx *ctx, const void *p, size_t len)
 		ctx->bytes += 128 - bufsize;
 		data += 128 - bufsize;
 		len -= 128 - bufsize;
-		Transform(ctx->s, ctx->buf.u64);
+		transform(ctx->s, ctx->buf.u8, 1);
 		bufsize = 0;
 	}
 
-	while (len >= 128) {
+	if (len >= 128) {
 		/* Process full chunks directly from the source. */
-		if (alignment_ok(data, sizeof(uint64_t)))
-			Transform(ctx->s, (const uint64_t *)data);
-		else {
-			memcpy(ctx->buf.u8, data, sizeof(ctx->buf));
-			Transform(ctx->s, ctx->buf.u64);
-		}
-		ctx->bytes += 128;
-		data += 128;
-		len -= 128;
+		size_t blocks = len / 128;
+
+		transform(ctx->s, data, blocks);
+		ctx->bytes += blocks * 128;
+		data += blocks * 128;
+		len -= blocks * 128;
 	}
 
 	if (len) {
@@ -256,6 +478,289 @@ void sha512_done(struct sha512_ctx *ctx, struct sha512 *res)
 		res->u.u64[i] = cpu_to_be64(ctx->s[i]);
 	invalidate_sha512(ctx);
 }
+
+/*
+ * Multi-buffer hashing: the state of lane l is s[0..7][l], so the same
+ * word of every lane is adjacent and loads straight into a vector.  The
+ * SIMD kernels process one block in each of their lanes; anything left
+ * over goes through the single-message transform.
+ */
+typedef uint64_t sha512_lanes_t[8][SHA512_MULTI_LANES];
+
+/* Lanes [off, off + LANES) each get one block: blocks[i] for lane
+ * off + i. */
+typedef void (*sha512_lanes_fn)(sha512_lanes_t s, size_t off,
+				const unsigned char *const *blocks);
+
+#ifdef SHA512_X86
+#define SHA512_VEC_ROR(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define SHA512_VEC_ROUND(a, b, c, d, e, f, g, h, wk)			\
+	do {								\
+		VEC t1_ = h + (SHA512_VEC_ROR(e, 14) ^ SHA512_VEC_ROR(e, 18) \
+			       ^ SHA512_VEC_ROR(e, 41))			\
+			+ (g ^ (e & (f ^ g))) + (wk);			\
+		VEC t2_ = (SHA512_VEC_ROR(a, 28) ^ SHA512_VEC_ROR(a, 34) \
+			   ^ SHA512_VEC_ROR(a, 39))			\
+			+ ((a & b) | (c & (a | b)));			\
+		d += t1_;						\
+		h = t1_ + t2_;						\
+	} while (0)
+
+#define DEFINE_SHA512_LANES(NAME, LANES, ATTR)				\
+typedef uint64_t NAME##_vec __attribute__((vector_size((LANES) * 8)));	\
+ATTR static void NAME(sha512_lanes_t s, size_t off,			\
+		      const unsigned char *const *blocks)		\
+{									\
+	typedef NAME##_vec VEC;						\
+	VEC w[80], st[8], a, b, c, d, e, f, g, h;			\
+	size_t i, l;							\
+									\
+	/* The blocks may have any alignment. */			\
+	for (l = 0; l < (LANES); l++) {					\
+		beint64_t chunk[16];					\
+		memcpy(chunk, blocks[l], sizeof(chunk));		\
+		for (i = 0; i < 16; i++)				\
+			w[i][l] = be64_to_cpu(chunk[i]);		\
+	}								\
+	for (i = 16; i < 80; i++) {					\
+		VEC w15 = w[i - 15], w2 = w[i - 2];			\
+		w[i] = w[i - 16] + w[i - 7]				\
+			+ (SHA512_VEC_ROR(w15, 1)			\
+			   ^ SHA512_VEC_ROR(w15, 8) ^ (w15 >> 7))	\
+			+ (SHA512_VEC_ROR(w2, 19)			\
+			   ^ SHA512_VEC_ROR(w2, 61) ^ (w2 >> 6));	\
+	}								\
+	for (i = 0; i < 80; i++)					\
+		w[i] += K512[i];					\
+									\
+	for (i = 0; i < 8; i++)						\
+		memcpy(&st[i], &s[i][off], sizeof(VEC));		\
+	a = st[0]; b = st[1]; c = st[2]; d = st[3];			\
+	e = st[4]; f = st[5]; g = st[6]; h = st[7];			\
+	for (i = 0; i < 80; i += 8) {					\
+		SHA512_VEC_ROUND(a, b, c, d, e, f, g, h, w[i + 0]);	\
+		SHA512_VEC_ROUND(h, a, b, c, d, e, f, g, w[i + 1]);	\
+		SHA512_VEC_ROUND(g, h, a, b, c, d, e, f, w[i + 2]);	\
+		SHA512_VEC_ROUND(f, g, h, a, b, c, d, e, w[i + 3]);	\
+		SHA512_VEC_ROUND(e, f, g, h, a, b, c, d, w[i + 4]);	\
+		SHA512_VEC_ROUND(d, e, f, g, h, a, b, c, w[i + 5]);	\
+		SHA512_VEC_ROUND(c, d, e, f, g, h, a, b, w[i + 6]);	\
+		SHA512_VEC_ROUND(b, c, d, e, f, g, h, a, w[i + 7]);	\
+	}								\
+	st[0] += a; st[1] += b; st[2] += c; st[3] += d;			\
+	st[4] += e; st[5] += f; st[6] += g; st[7] += h;			\
+	for (i = 0; i < 8; i++)						\
+		memcpy(&s[i][off], &st[i], sizeof(VEC));		\
+}
+
+/* Without AVX2 there are too few 64-bit lanes to beat the scalar code. */
+DEFINE_SHA512_LANES(sha512_lanes4_avx2, 4, __attribute__((target("avx2"))))
+DEFINE_SHA512_LANES(sha512_lanes8_avx512, 8, __attribute__((target("avx512f"))))
+#endif
+
+/* A lanes kernel, or NULL to do one lane at a time, and its width. */
+struct sha512_lanes_impl {
+	sha512_lanes_fn fn;
+	size_t width;
+};
+
+static const struct sha512_lanes_impl lanes_one = { NULL, 1 };
+
+#ifdef SHA512_X86
+static const struct sha512_lanes_impl lanes_avx2 = { sha512_lanes4_avx2, 4 };
+static const struct sha512_lanes_impl lanes_avx512 = {
+	sha512_lanes8_avx512, 8
+};
+
+/* NULL until the first multi-buffer hash picks one. */
+static const struct sha512_lanes_impl *lanes_impl;
+
+/* Threads may race to pick, but they all pick the same. */
+static const struct sha512_lanes_impl *lanes_get(void)
+{
+	const struct sha512_lanes_impl *impl
+		= __atomic_load_n(&lanes_impl, __ATOMIC_RELAXED);
+
+	if (!impl) {
+		if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX512F)
+		    && cpuid_os_has_avx512())
+			impl = &lanes_avx512;
+		else if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+			 && cpuid_os_has_avx())
+			impl = &lanes_avx2;
+		else
+			impl = &lanes_one;
+		__atomic_store_n(&lanes_impl, impl, __ATOMIC_RELAXED);
+	}
+	return impl;
+}
+#else
+#define lanes_get() (&lanes_one)
+#endif
+
+/* One block for each of lanes [0, n). */
+static void lanes_blocks(sha512_lanes_t s, size_t n,
+			 const unsigned char *const *blocks)
+{
+	const struct sha512_lanes_impl *impl = lanes_get();
+	size_t off = 0, i;
+
+	if (impl->fn) {
+		for (; off + impl->width <= n; off += impl->width)
+			impl->fn(s, off, blocks + off);
+	}
+	for (; off < n; off++) {
+		uint64_t one[8];
+
+		for (i = 0; i < 8; i++)
+			one[i] = s[i][off];
+		transform(one, blocks[off], 1);
+		for (i = 0; i < 8; i++)
+			s[i][off] = one[i];
+	}
+}
+
+static void lanes_init(sha512_lanes_t s, size_t n)
+{
+	const struct sha512_ctx init = SHA512_INIT;
+	size_t i, l;
+
+	for (i = 0; i < 8; i++)
+		for (l = 0; l < n; l++)
+			s[i][l] = init.s[i];
+}
+
+static void lanes_result(const sha512_lanes_t s, size_t lane,
+			 struct sha512 *res)
+{
+	size_t i;
+
+	for (i = 0; i < 8; i++)
+		res->u.u64[i] = cpu_to_be64(s[i][lane]);
+}
+
+/* Message padding: the final one or two blocks of a message of @len
+ * bytes, whose last (len % 128) bytes are at @tail.  Returns blocks. */
+static size_t final_blocks(unsigned char buf[256], const void *tail,
+			   uint64_t len)
+{
+	size_t rem = len % 128, num = rem < 112 ? 1 : 2;
+	beint64_t bits = cpu_to_be64(len << 3);
+
+	memcpy(buf, tail, rem);
+	buf[rem] = 0x80;
+	/* The length is 128 bits, but the top 64 are always zero here. */
+	memset(buf + rem + 1, 0, num * 128 - rem - 1 - 8);
+	memcpy(buf + num * 128 - 8, &bits, 8);
+	return num;
+}
+
+void sha512_many(struct sha512 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n)
+{
+	sha512_lanes_t s;
+	unsigned char tails[SHA512_MULTI_LANES][256];
+
+	while (n) {
+		const unsigned char *blocks[SHA512_MULTI_LANES];
+		size_t nblocks[SHA512_MULTI_LANES], max = 0, b, i;
+		size_t num = n < SHA512_MULTI_LANES ? n : SHA512_MULTI_LANES;
+
+		for (i = 0; i < num; i++) {
+			nblocks[i] = lens[i] / 128
+				+ final_blocks(tails[i],
+					       (const char *)msgs[i]
+					       + lens[i] / 128 * 128, lens[i]);
+			if (nblocks[i] > max)
+				max = nblocks[i];
+		}
+
+		/* Lanes which have finished just hash their padding again:
+		 * we've already saved their result. */
+		lanes_init(s, num);
+		for (b = 0; b < max; b++) {
+			for (i = 0; i < num; i++) {
+				size_t full = lens[i] / 128;
+				size_t blk = b < nblocks[i] ? b : nblocks[i] - 1;
+
+				if (blk < full)
+					blocks[i] = (const unsigned char *)msgs[i]
+						+ blk * 128;
+				else
+					blocks[i] = tails[i] + (blk - full) * 128;
+			}
+			lanes_blocks(s, num, blocks);
+			for (i = 0; i < num; i++)
+				if (b + 1 == nblocks[i])
+					lanes_result(s, i, &hashes[i]);
+		}
+		hashes += num;
+		msgs += num;
+		lens += num;
+		n -= num;
+	}
+}
+
+void sha512_multi_init(struct sha512_multi_ctx *ctx, size_t lanes)
+{
+	assert(lanes <= SHA512_MULTI_LANES);
+	ctx->lanes = lanes;
+	ctx->bytes = 0;
+	lanes_init(ctx->s, lanes);
+}
+
+void sha512_multi_update(struct sha512_multi_ctx *ctx,
+			 const void *const p[], size_t size)
+{
+	const unsigned char *blocks[SHA512_MULTI_LANES];
+	size_t bufsize = ctx->bytes % 128, off = 0, i;
+
+	assert(ctx->bytes != (size_t)-1);
+	if (bufsize + size >= 128 && bufsize) {
+		/* Fill the buffers, and process them. */
+		off = 128 - bufsize;
+		for (i = 0; i < ctx->lanes; i++) {
+			memcpy(ctx->buf[i] + bufsize, p[i], off);
+			blocks[i] = ctx->buf[i];
+		}
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+		bufsize = 0;
+	}
+
+	/* Process full blocks directly from the source. */
+	for (; size - off >= 128 && bufsize == 0; off += 128) {
+		for (i = 0; i < ctx->lanes; i++)
+			blocks[i] = (const unsigned char *)p[i] + off;
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+	}
+
+	if (size > off) {
+		for (i = 0; i < ctx->lanes; i++)
+			memcpy(ctx->buf[i] + bufsize,
+			       (const unsigned char *)p[i] + off, size - off);
+	}
+	ctx->bytes += size;
+}
+
+void sha512_multi_done(struct sha512_multi_ctx *ctx, struct sha512 res[])
+{
+	unsigned char tails[SHA512_MULTI_LANES][256];
+	const unsigned char *blocks[SHA512_MULTI_LANES];
+	size_t num = 0, b, i;
+
+	assert(ctx->bytes != (size_t)-1);
+	for (i = 0; i < ctx->lanes; i++)
+		num = final_blocks(tails[i], ctx->buf[i], ctx->bytes);
+	for (b = 0; b < num; b++) {
+		for (i = 0; i < ctx->lanes; i++)
+			blocks[i] = tails[i] + b * 128;
+		lanes_blocks(ctx->s, ctx->lanes, blocks);
+	}
+	for (i = 0; i < ctx->lanes; i++)
+		lanes_result(ctx->s, i, &res[i]);
+	ctx->bytes = (size_t)-1;
+}
 #endif /* CCAN_CRYPTO_SHA512_USE_OPENSSL */
 
 void sha512(struct sha512 *sha, const void *p, size_t size)
@@ -131,4 +131,102 @@ void sha512_update(struct sha512_ctx *ctx, const void *p, size_t size);
  */
 void sha512_done(struct sha512_ctx *sha512, struct sha512 *res);
 
+/**
+ * sha512_many - SHA512 of many independent messages
+ * @hashes: array of @n hashes to fill in
+ * @msgs: array of @n pointers to the messages
+ * @lens: array of @n message lengths
+ * @n: the number of messages
+ *
+ * This sets hashes[i] to sha512() of @msgs[i], but hashes several
+ * messages at once in SIMD lanes (4 with AVX2, 8 with AVX-512), which is
+ * much faster than one-at-a-time on many short messages.  Messages are
+ * grouped in order, so it works best if neighbouring messages have
+ * similar lengths.
+ *
+ * Example:
+ *	#include <ccan/crypto/sha512/sha512.h>
+ *	#include <string.h>
+ *
+ *	static void hash_strings(struct sha512 *hashes, const char *strs[],
+ *				 size_t n)
+ *	{
+ *		size_t i, lens[n];
+ *
+ *		for (i = 0; i < n; i++)
+ *			lens[i] = strlen(strs[i]);
+ *		sha512_many(hashes, (const void *const *)strs, lens, n);
+ *	}
+ */
+void sha512_many(struct sha512 *hashes,
+		 const void *const msgs[], const size_t lens[], size_t n);
+
+/**
+ * SHA512_MULTI_LANES - maximum number of messages in a sha512_multi_ctx
+ */
+#define SHA512_MULTI_LANES 8
+
+/**
+ * struct sha512_multi_ctx - running context for several equal-length SHA512s
+ *
+ * This hashes up to SHA512_MULTI_LANES messages in parallel, as long as
+ * they are all fed the same number of bytes at a time.
+ */
+struct sha512_multi_ctx {
+#ifdef CCAN_CRYPTO_SHA512_USE_OPENSSL
+	struct sha512_ctx ctx[SHA512_MULTI_LANES];
+#else
+	uint64_t s[8][SHA512_MULTI_LANES];
+	unsigned char buf[SHA512_MULTI_LANES][128];
+	size_t bytes;
+#endif
+	size_t lanes;
+};
+
+/**
+ * sha512_multi_init - initialize a multi-lane SHA512 context
+ * @ctx: the sha512_multi_ctx to initialize
+ * @lanes: the number of messages, up to SHA512_MULTI_LANES.
+ *
+ * Example:
+ *	#include <ccan/crypto/sha512/sha512.h>
+ *
+ *	// Hash four equal-length streams at once.
+ *	static void hash4(const unsigned char *s[4], size_t len,
+ *			  struct sha512 res[4])
+ *	{
+ *		struct sha512_multi_ctx ctx;
+ *		const void *p[4];
+ *		size_t i, off;
+ *
+ *		sha512_multi_init(&ctx, 4);
+ *		for (off = 0; off < len; off += 100) {
+ *			size_t chunk = len - off < 100 ? len - off : 100;
+ *			for (i = 0; i < 4; i++)
+ *				p[i] = s[i] + off;
+ *			sha512_multi_update(&ctx, p, chunk);
+ *		}
+ *		sha512_multi_done(&ctx, res);
+ *	}
+ */
+void sha512_multi_init(struct sha512_multi_ctx *ctx, size_t lanes);
+
+/**
+ * sha512_multi_update - add the same length to each message
+ * @ctx: the sha512_multi_ctx to use
+ * @p: array of pointers, one for each lane
+ * @size: the number of bytes to add from each of @p
+ */
+void sha512_multi_update(struct sha512_multi_ctx *ctx,
+			 const void *const p[], size_t size);
+
+/**
+ * sha512_multi_done - finish all the SHA512s
+ * @ctx: the sha512_multi_ctx to complete
+ * @res: array of hashes to return, one per lane.
+ *
+ * As with sha512_done(), @ctx must be reinitialized after this.
+ */
+void sha512_multi_done(struct sha512_multi_ctx *ctx, struct sha512 res[]);
+
 #endif /* CCAN_CRYPTO_SHA512_H */
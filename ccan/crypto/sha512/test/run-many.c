@@ -0,0 +1,103 @@
+#include <ccan/crypto/sha512/sha512.h>
+/* Include the C files directly. */
+#include <ccan/crypto/sha512/sha512.c>
+#include <ccan/tap/tap.h>
+
+#define NUM 37
+
+static unsigned char data[NUM * 400];
+
+static bool check_many(void)
+{
+	struct sha512 h[NUM], expect;
+	const void *msgs[NUM];
+	size_t lens[NUM], i;
+
+	/* All sorts of lengths, including 111/112/128 padding edges. */
+	for (i = 0; i < NUM; i++) {
+		lens[i] = (i * 59) % 400;
+		msgs[i] = data + i * 7;
+	}
+	lens[0] = 111;
+	lens[1] = 112;
+	lens[2] = 128;
+	lens[3] = 0;
+	sha512_many(h, msgs, lens, NUM);
+	for (i = 0; i < NUM; i++) {
+		sha512(&expect, msgs[i], lens[i]);
+		if (memcmp(&h[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool check_multi(size_t lanes)
+{
+	struct sha512_multi_ctx mctx;
+	struct sha512 h[SHA512_MULTI_LANES], expect;
+	const void *p[SHA512_MULTI_LANES];
+	size_t total = 600, off = 0, chunk = 1, i;
+
+	sha512_multi_init(&mctx, lanes);
+	/* Growing chunks cover every buffering case. */
+	while (off < total) {
+		if (chunk > total - off)
+			chunk = total - off;
+		for (i = 0; i < lanes; i++)
+			p[i] = data + i * 200 + off;
+		sha512_multi_update(&mctx, p, chunk);
+		off += chunk;
+		chunk = chunk * 2 + 1;
+	}
+	sha512_multi_done(&mctx, h);
+	for (i = 0; i < lanes; i++) {
+		sha512(&expect, data + i * 200, total);
+		if (memcmp(&h[i], &expect, sizeof(expect)) != 0)
+			return false;
+	}
+	return true;
+}
+
+static bool check_all(void)
+{
+	return check_many()
+		&& check_multi(1) && check_multi(5)
+		&& check_multi(SHA512_MULTI_LANES);
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 11 + (i >> 8);
+
+	plan_tests(3);
+
+	/* Whatever the CPU gives us. */
+	ok1(check_all());
+
+#if !defined(CCAN_CRYPTO_SHA512_USE_OPENSSL)
+	/* Force one at a time. */
+#ifdef SHA512_X86
+	lanes_impl = &lanes_one;
+#endif
+	ok1(check_all());
+#else
+	pass("OpenSSL");
+#endif
+
+#ifdef SHA512_X86
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2) && cpuid_os_has_avx()) {
+		lanes_impl = &lanes_avx2;
+		ok1(check_all());
+	} else
+		pass("No AVX2");
+	/* AVX-512 is covered above when the CPU has it. */
+#else
+	pass("No AVX2");
+#endif
+
+	/* This exits depending on whether all tests passed */
+	return exit_status();
+}
@@ -0,0 +1,63 @@
+#include <ccan/crypto/sha512/sha512.h>
+/* Include the C files directly. */
+#include <ccan/crypto/sha512/sha512.c>
+#include <ccan/tap/tap.h>
+
+#if defined(SHA512_X86) && !defined(CCAN_CRYPTO_SHA512_USE_OPENSSL)
+/* Feed each length at various alignments and chunkings, compare. */
+static bool matches_generic(void (*fn)(uint64_t *, const unsigned char *,
+				       size_t))
+{
+	static unsigned char data[2048 + 8];
+	size_t len, off, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 13 + (i >> 7);
+
+	for (len = 0; len <= 2048; len++) {
+		for (off = 0; off < 8; off += 3) {
+			struct sha512_ctx ctx = SHA512_INIT;
+			uint64_t s[8];
+			struct sha512 h1, h2;
+
+			/* Raw blocks. */
+			memcpy(s, ctx.s, sizeof(s));
+			fn(s, data + off, len / 128);
+			transform_generic(ctx.s, data + off, len / 128);
+			if (memcmp(s, ctx.s, sizeof(s)) != 0)
+				return false;
+
+			/* Through the API, in two uneven pieces. */
+			transform_impl = fn;
+			sha512_init(&ctx);
+			sha512_update(&ctx, data + off, len / 3);
+			sha512_update(&ctx, data + off + len / 3, len - len / 3);
+			sha512_done(&ctx, &h1);
+			transform_impl = transform_generic;
+			sha512(&h2, data + off, len);
+			if (memcmp(&h1, &h2, sizeof(h1)) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+#endif
+
+int main(void)
+{
+	plan_tests(1);
+
+#if defined(SHA512_X86) && !defined(CCAN_CRYPTO_SHA512_USE_OPENSSL)
+	if (cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_AVX2)
+	    && cpuid_has_ebxfeature7(CPUID_FEAT7_EBX_BMI2)
+	    && cpuid_os_has_avx())
+		ok1(matches_generic(transform_avx2));
+	else
+		pass("No AVX2");
+#else
+	pass("No AVX2");
+#endif
+
+	/* This exits depending on whether all tests passed */
+	return exit_status();
+}
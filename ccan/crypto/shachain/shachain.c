@@ -66,6 +66,120 @@ void shachain_from_seed(const struct sha256 *seed, uint64_t index,
 	derive(0, index, seed, hash);
 }
 
+void shachain_cache_init(struct shachain_cache *cache)
+{
+	cache->valid = false;
+}
+
+/* Same as derive(), but reuses the levels which match the last call. */
+static void derive_cached(struct shachain_cache *cache,
+			  uint64_t from, uint64_t to,
+			  const struct sha256 *from_hash,
+			  struct sha256 *hash)
+{
+	uint64_t branches;
+	int i, top;
+
+	assert(can_derive(from, to));
+
+	if (cache->valid && cache->from == from
+	    && memcmp(&cache->path[SHACHAIN_BITS], from_hash,
+		      sizeof(*from_hash)) == 0) {
+		/* Everything above the highest changed bit is still valid. */
+		top = ilog64(cache->to ^ to);
+	} else {
+		cache->valid = true;
+		cache->from = from;
+		cache->path[SHACHAIN_BITS] = *from_hash;
+		top = SHACHAIN_BITS;
+	}
+
+	branches = from ^ to;
+	for (i = top - 1; i >= 0; i--) {
+		cache->path[i] = cache->path[i+1];
+		if (((branches >> i) & 1)) {
+			change_bit(cache->path[i].u.u8, i);
+			sha256(&cache->path[i], &cache->path[i],
+			       sizeof(cache->path[i]));
+		}
+	}
+	cache->to = to;
+	*hash = cache->path[0];
+}
+
+void shachain_from_seed_cached(struct shachain_cache *cache,
+			       const struct sha256 *seed, uint64_t index,
+			       struct sha256 *hash)
+{
+	derive_cached(cache, 0, index, seed, hash);
+}
+
+/* Bulk derivation expands aligned blocks of 2^RANGE_BITS at once. */
+#define RANGE_BITS (SHACHAIN_BITS < 8 ? SHACHAIN_BITS : 8)
+#define RANGE_BLOCK ((uint64_t)1 << RANGE_BITS)
+
+/* Fill hashes[0..RANGE_BLOCK-1] for base onwards, breadth first. */
+static void derive_block(struct shachain_cache *cache,
+			 const struct sha256 *seed, uint64_t base,
+			 struct sha256 *hashes)
+{
+	struct sha256 flipped[RANGE_BLOCK / 2], hashed[RANGE_BLOCK / 2];
+	const void *msgs[RANGE_BLOCK / 2];
+	size_t lens[RANGE_BLOCK / 2];
+	size_t j, n;
+	int i;
+
+	/* Value for base is the common parent of the whole block. */
+	derive_cached(cache, 0, base, seed, &hashes[0]);
+
+	/* Each level down doubles the entries: the left child is the
+	 * parent, the right is the hash of the parent with that bit
+	 * flipped.  All the right children of a level are independent. */
+	for (i = RANGE_BITS - 1, n = 1; i >= 0; i--, n *= 2) {
+		for (j = 0; j < n; j++) {
+			flipped[j] = hashes[j];
+			change_bit(flipped[j].u.u8, i);
+			msgs[j] = &flipped[j];
+			lens[j] = sizeof(flipped[j]);
+		}
+		sha256_many(hashed, msgs, lens, n);
+
+		/* Spread out in place, from the end. */
+		for (j = n; j > 0; j--) {
+			hashes[2*(j-1) + 1] = hashed[j-1];
+			hashes[2*(j-1)] = hashes[j-1];
+		}
+	}
+}
+
+void shachain_from_seed_range(const struct sha256 *seed,
+			      uint64_t first, size_t num,
+			      struct sha256 *hashes)
+{
+	struct shachain_cache cache;
+
+	assert(num == 0
+	       || (first + (num - 1) >= first
+		   && first + (num - 1) <= (UINT64_MAX >> (64 - SHACHAIN_BITS))));
+
+	shachain_cache_init(&cache);
+	while (num) {
+		if ((first & (RANGE_BLOCK - 1)) == 0 && num >= RANGE_BLOCK) {
+			derive_block(&cache, seed, first, hashes);
+			first += RANGE_BLOCK;
+			hashes += RANGE_BLOCK;
+			num -= RANGE_BLOCK;
+		} else {
+			/* Partial blocks at the ends: one at a time, but
+			 * consecutive indices still share the cache. */
+			derive_cached(&cache, 0, first, seed, hashes);
+			first++;
+			hashes++;
+			num--;
+		}
+	}
+}
+
 uint64_t shachain_next_index(const struct shachain *chain)
 {
 	return chain->min_index - 1;
@@ -124,3 +238,116 @@ bool shachain_get_hash(const struct shachain *chain,
 	}
 	return false;
 }
+
+bool shachain_get_hash_cached(const struct shachain *chain,
+			      struct shachain_cache *cache,
+			      uint64_t index, struct sha256 *hash)
+{
+	unsigned int i;
+
+	for (i = 0; i < chain->num_valid; i++) {
+		if (!can_derive(chain->known[i].index, index))
+			continue;
+
+		derive_cached(cache, chain->known[i].index, index,
+			      &chain->known[i].hash, hash);
+		return true;
+	}
+	return false;
+}
+
+/* Since hashes are added in decreasing order, known[pos] always holds the
+ * smallest index >= min_index with pos trailing zeroes (if any). */
+static bool known_index(uint64_t min_index, unsigned int pos, uint64_t *index)
+{
+	uint64_t bit, idx;
+
+	/* Only index 0 has SHACHAIN_BITS trailing zeroes. */
+	if (pos == SHACHAIN_BITS) {
+		*index = 0;
+		return min_index == 0;
+	}
+
+	bit = (uint64_t)1 << pos;
+	/* Round down to a multiple of 2*bit, add bit; (bit << 1) - 1 is
+	 * all ones for pos == 63, as we want. */
+	idx = (min_index & ~((bit << 1) - 1)) | bit;
+	if (idx < min_index) {
+		idx += bit << 1;
+		/* Wrapped (or pos == 63)? */
+		if (idx < min_index)
+			return false;
+	}
+	if (idx > (UINT64_MAX >> (64 - SHACHAIN_BITS)))
+		return false;
+	*index = idx;
+	return true;
+}
+
+size_t shachain_serialized_size(const struct shachain *chain)
+{
+	return 8 + 1 + chain->num_valid * sizeof(struct sha256);
+}
+
+size_t shachain_serialize(const struct shachain *chain, void *buf)
+{
+	unsigned char *p = buf;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		*(p++) = chain->min_index >> (i * 8);
+	*(p++) = chain->num_valid;
+	for (i = 0; i < chain->num_valid; i++) {
+		uint64_t idx;
+
+		assert(known_index(chain->min_index, i, &idx)
+		       && idx == chain->known[i].index);
+		memcpy(p, &chain->known[i].hash, sizeof(chain->known[i].hash));
+		p += sizeof(chain->known[i].hash);
+	}
+	return p - (unsigned char *)buf;
+}
+
+size_t shachain_deserialize(struct shachain *chain, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	unsigned int i;
+	uint64_t idx;
+
+	if (len < 8 + 1)
+		return 0;
+
+	shachain_init(chain);
+	chain->min_index = 0;
+	for (i = 0; i < 8; i++)
+		chain->min_index |= (uint64_t)*(p++) << (i * 8);
+	chain->num_valid = *(p++);
+
+	if (chain->num_valid > SHACHAIN_BITS + 1)
+		return 0;
+	if (len < shachain_serialized_size(chain))
+		return 0;
+
+	/* Empty chain must look exactly like shachain_init() made it. */
+	if (chain->num_valid == 0) {
+		struct shachain empty;
+
+		shachain_init(&empty);
+		if (chain->min_index != empty.min_index)
+			return 0;
+		return p - (const unsigned char *)buf;
+	}
+
+	/* Entries must be exactly those adding down to min_index gives. */
+	if (chain->num_valid <= SHACHAIN_BITS
+	    && known_index(chain->min_index, chain->num_valid, &idx))
+		return 0;
+
+	for (i = 0; i < chain->num_valid; i++) {
+		if (!known_index(chain->min_index, i, &chain->known[i].index))
+			return 0;
+		memcpy(&chain->known[i].hash, p, sizeof(chain->known[i].hash));
+		p += sizeof(chain->known[i].hash);
+	}
+	return p - (const unsigned char *)buf;
+}
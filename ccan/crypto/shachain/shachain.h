@@ -40,6 +40,87 @@
 void shachain_from_seed(const struct sha256 *seed, uint64_t index,
 			struct sha256 *hash);
 
+/**
+ * shachain_from_seed_range - Generate a contiguous run of values from a seed.
+ * @seed: (secret) seed value to use
+ * @first: index of the first value to generate
+ * @num: number of values to generate
+ * @hashes: array of @num values to fill in
+ *
+ * This is equivalent to calling shachain_from_seed() for every index
+ * from @first to @first + @num - 1 (which must not exceed the maximum
+ * index), setting @hashes[i] to the value for @first + i.
+ *
+ * It's much faster though: indices which share leading bits share
+ * the intermediate hashes, so it costs about one SHA256 per value
+ * rather than one per set bit, and whole aligned blocks are hashed
+ * using sha256_many().
+ *
+ * Example:
+ * // Pre-generate the next 1000 values to hand out (largest first).
+ * static void pregenerate(const struct sha256 *seed, uint64_t next,
+ *			   struct sha256 out[1000])
+ * {
+ *	shachain_from_seed_range(seed, next - 999, 1000, out);
+ * }
+ */
+void shachain_from_seed_range(const struct sha256 *seed,
+			      uint64_t first, size_t num,
+			      struct sha256 *hashes);
+
+/**
+ * struct shachain_cache - remembered intermediate values of a derivation
+ *
+ * Deriving value N from a known value walks down the tree, one level
+ * per bit.  This keeps the value at each level of the last walk, so
+ * deriving a nearby index (one sharing most leading bits) only redoes
+ * the levels below where they differ.
+ *
+ * It's filled in by shachain_from_seed_cached() and
+ * shachain_get_hash_cached().  Note that it contains secrets (enough
+ * to derive values from the seed or chain it was used with), so treat
+ * it with the same care.
+ */
+struct shachain_cache {
+	bool valid;
+	uint64_t from, to;
+	/* path[i]: value after handling all bits >= i.  path[SHACHAIN_BITS]
+	 * is the value at @from, path[0] the value at @to. */
+	struct sha256 path[SHACHAIN_BITS + 1];
+};
+
+/**
+ * shachain_cache_init - initialize (empty) a shachain_cache
+ * @cache: the cache to initialize
+ *
+ * Alternately, ensure that it's all zero.
+ */
+void shachain_cache_init(struct shachain_cache *cache);
+
+/**
+ * shachain_from_seed_cached - shachain_from_seed() using a cache
+ * @cache: the cache to use and update
+ * @seed: (secret) seed value to use
+ * @index: index of value to generate (0 == seed)
+ * @hash: value generated
+ *
+ * Gives the same result as shachain_from_seed(), but successive
+ * calls for nearby indices are much cheaper.  The cache notices if it
+ * was last used with a different seed.
+ *
+ * Example:
+ * static void next_hash_fast(const struct sha256 *seed, struct sha256 *hash)
+ * {
+ *	static uint64_t index = 0xFFFFFFFFFFFFFFFFULL;
+ *	static struct shachain_cache cache;
+ *
+ *	shachain_from_seed_cached(&cache, seed, index--, hash);
+ * }
+ */
+void shachain_from_seed_cached(struct shachain_cache *cache,
+			       const struct sha256 *seed, uint64_t index,
+			       struct sha256 *hash);
+
 /**
  * shachain - structure for recording/deriving decrementing chain members
  * @min_index: minimum index value successfully shachain_add_hash()ed.
@@ -133,4 +214,82 @@ bool shachain_add_hash(struct shachain *chain,
  */
 bool shachain_get_hash(const struct shachain *chain,
 		       uint64_t index, struct sha256 *hash);
+
+/**
+ * shachain_get_hash_cached - shachain_get_hash() using a cache
+ * @chain: the chain query
+ * @cache: the cache to use and update
+ * @index: the index of the hash to get
+ * @hash: the hash value.
+ *
+ * Gives the same result as shachain_get_hash(), but looking up nearby
+ * indices in turn reuses most of the work.  The cache is only reused
+ * while the chain entry it was derived from is unchanged, so it's
+ * safe to keep calling shachain_add_hash() on @chain.
+ */
+bool shachain_get_hash_cached(const struct shachain *chain,
+			      struct shachain_cache *cache,
+			      uint64_t index, struct sha256 *hash);
+
+/* Largest value shachain_serialized_size() can return. */
+#define SHACHAIN_SERIALIZED_MAX (8 + 1 + (SHACHAIN_BITS + 1) * 32)
+
+/**
+ * shachain_serialized_size - bytes needed to serialize a shachain
+ * @chain: the chain
+ *
+ * The serialized form only holds the valid hashes, and leaves out
+ * their indices (which follow from @chain->min_index), so it is
+ * usually a fraction of sizeof(struct shachain).
+ */
+size_t shachain_serialized_size(const struct shachain *chain);
+
+/**
+ * shachain_serialize - write a shachain in compact, portable form
+ * @chain: the chain
+ * @buf: the buffer to write shachain_serialized_size(@chain) bytes into
+ *
+ * The format is the 8-byte little-endian min_index, a byte giving the
+ * number of hashes, then the hashes themselves.  Returns the number of
+ * bytes written, so multiple chains can simply be concatenated.
+ *
+ * Example:
+ * static size_t save_chains(const struct shachain *chains, size_t n,
+ *			     unsigned char *buf)
+ * {
+ *	size_t i, len = 0;
+ *
+ *	for (i = 0; i < n; i++)
+ *		len += shachain_serialize(&chains[i], buf + len);
+ *	return len;
+ * }
+ */
+size_t shachain_serialize(const struct shachain *chain, void *buf);
+
+/**
+ * shachain_deserialize - read a shachain written by shachain_serialize()
+ * @chain: the chain to fill in
+ * @buf: the serialized form
+ * @len: the number of bytes available at @buf
+ *
+ * Returns the number of bytes consumed, or 0 if @buf is truncated or
+ * not a valid serialized shachain (in which case @chain is undefined).
+ *
+ * Example:
+ * static bool load_chains(struct shachain *chains, size_t n,
+ *			   const unsigned char *buf, size_t len)
+ * {
+ *	size_t i, used;
+ *
+ *	for (i = 0; i < n; i++) {
+ *		used = shachain_deserialize(&chains[i], buf, len);
+ *		if (!used)
+ *			return false;
+ *		buf += used;
+ *		len -= used;
+ *	}
+ *	return true;
+ * }
+ */
+size_t shachain_deserialize(struct shachain *chain, const void *buf, size_t len);
 #endif /* CCAN_CRYPTO_SHACHAIN_H */
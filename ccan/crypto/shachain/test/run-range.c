@@ -0,0 +1,119 @@
+#include <ccan/crypto/shachain/shachain.h>
+/* Include the C files directly. */
+#include <ccan/crypto/shachain/shachain.c>
+#include <ccan/tap/tap.h>
+
+#define NUM_HASHES 1000
+
+static bool range_matches(const struct sha256 *seed, uint64_t first, size_t num)
+{
+	struct sha256 *hashes = malloc(sizeof(*hashes) * num);
+	bool ok = true;
+	size_t i;
+
+	shachain_from_seed_range(seed, first, num, hashes);
+	for (i = 0; i < num; i++) {
+		struct sha256 expect;
+
+		shachain_from_seed(seed, first + i, &expect);
+		if (memcmp(&expect, &hashes[i], sizeof(expect)) != 0)
+			ok = false;
+	}
+	free(hashes);
+	return ok;
+}
+
+int main(void)
+{
+	struct sha256 seed, seed2, hash, expect;
+	struct shachain chain, chain2;
+	struct shachain_cache cache;
+	unsigned char buf[SHACHAIN_SERIALIZED_MAX];
+	uint64_t i;
+	size_t len;
+	bool ok;
+
+	/* This is how many tests you plan to run */
+	plan_tests(20);
+
+	memset(&seed, 1, sizeof(seed));
+	memset(&seed2, 2, sizeof(seed2));
+
+	/* Ranges: aligned, unaligned, tiny, at the very top. */
+	ok1(range_matches(&seed, 0, 256));
+	ok1(range_matches(&seed, 0x123456789ab0ULL, NUM_HASHES));
+	ok1(range_matches(&seed, 77, 1));
+	ok1(range_matches(&seed, 0xFFFFFFFFFFFFFFFFULL - NUM_HASHES + 1,
+			  NUM_HASHES));
+
+	/* Cached derivation, counting down, and jumping around. */
+	shachain_cache_init(&cache);
+	ok = true;
+	for (i = 0xFFFFFFFFFFFFFFFFULL; i > 0xFFFFFFFFFFFFFFFFULL - NUM_HASHES; i--) {
+		shachain_from_seed_cached(&cache, &seed, i, &hash);
+		shachain_from_seed(&seed, i, &expect);
+		if (memcmp(&hash, &expect, sizeof(hash)) != 0)
+			ok = false;
+	}
+	ok1(ok);
+	ok = true;
+	for (i = 0; i < NUM_HASHES; i++) {
+		uint64_t idx = i * 0x9E3779B97F4A7C15ULL;
+		shachain_from_seed_cached(&cache, &seed, idx, &hash);
+		shachain_from_seed(&seed, idx, &expect);
+		if (memcmp(&hash, &expect, sizeof(hash)) != 0)
+			ok = false;
+	}
+	ok1(ok);
+
+	/* Changing seed must not reuse stale values. */
+	shachain_from_seed_cached(&cache, &seed2, 12345, &hash);
+	shachain_from_seed(&seed2, 12345, &expect);
+	ok1(memcmp(&hash, &expect, sizeof(hash)) == 0);
+
+	/* Empty chain serializes to the minimum. */
+	shachain_init(&chain);
+	ok1(shachain_serialized_size(&chain) == 9);
+	ok1(shachain_serialize(&chain, buf) == 9);
+	ok1(shachain_deserialize(&chain2, buf, 9) == 9);
+	ok1(chain2.num_valid == 0 && chain2.min_index == chain.min_index);
+
+	/* Build up a chain, checking cached gets as we go. */
+	shachain_cache_init(&cache);
+	ok = true;
+	for (i = 0xFFFFFFFFFFFFFFFFULL; i > 0xFFFFFFFFFFFFFFFFULL - NUM_HASHES; i--) {
+		uint64_t j;
+
+		shachain_from_seed(&seed, i, &expect);
+		if (!shachain_add_hash(&chain, i, &expect))
+			ok = false;
+		for (j = i; j != 0 && j < i + 20; j++) {
+			struct sha256 h1, h2;
+			if (!shachain_get_hash(&chain, j, &h1)
+			    || !shachain_get_hash_cached(&chain, &cache, j, &h2)
+			    || memcmp(&h1, &h2, sizeof(h1)) != 0)
+				ok = false;
+		}
+	}
+	ok1(ok);
+	ok1(!shachain_get_hash_cached(&chain, &cache, i, &hash));
+
+	/* Round trip. */
+	len = shachain_serialized_size(&chain);
+	ok1(len == 9 + chain.num_valid * 32);
+	ok1(shachain_serialize(&chain, buf) == len);
+	ok1(shachain_deserialize(&chain2, buf, len) == len);
+	ok1(chain2.min_index == chain.min_index
+	    && chain2.num_valid == chain.num_valid
+	    && memcmp(chain2.known, chain.known,
+		      sizeof(chain.known[0]) * chain.num_valid) == 0);
+
+	/* Truncated, or wrong number of entries for min_index. */
+	ok1(shachain_deserialize(&chain2, buf, len - 1) == 0);
+	buf[8]--;
+	ok1(shachain_deserialize(&chain2, buf, len) == 0);
+	buf[8] += 2;
+	ok1(shachain_deserialize(&chain2, buf, sizeof(buf)) == 0);
+
+	return exit_status();
+}
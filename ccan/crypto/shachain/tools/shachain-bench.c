@@ -0,0 +1,87 @@
+/* Derivations per second: one at a time, cached, and bulk ranges, plus
+ * lookups in a stored chain.  Uses 48 bit indices, like lightning. */
+#include <ccan/crypto/shachain/shachain.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INDEX ((1ULL << SHACHAIN_BITS) - 1)
+
+static void report(const char *what, struct timeabs start, size_t n)
+{
+	double sec = time_to_nsec(time_between(time_now(), start)) / 1e9;
+
+	printf("%-32s %12.0f /sec\n", what, n / sec);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num = argv[1] ? atol(argv[1]) : 100000;
+	struct sha256 seed, *hashes = malloc(sizeof(*hashes) * num);
+	struct shachain chain;
+	struct shachain_cache cache;
+	struct timeabs start;
+	unsigned char buf[SHACHAIN_SERIALIZED_MAX];
+	unsigned char check = 0;
+	size_t i, j;
+
+	memset(&seed, 7, sizeof(seed));
+
+	start = time_now();
+	for (i = 0; i < num; i++)
+		shachain_from_seed(&seed, MAX_INDEX - i, &hashes[i]);
+	report("shachain_from_seed", start, num);
+
+	shachain_cache_init(&cache);
+	start = time_now();
+	for (i = 0; i < num; i++) {
+		struct sha256 h;
+		shachain_from_seed_cached(&cache, &seed, MAX_INDEX - i, &h);
+		check ^= h.u.u8[0];
+	}
+	report("shachain_from_seed_cached", start, num);
+
+	start = time_now();
+	shachain_from_seed_range(&seed, MAX_INDEX - num + 1, num, hashes);
+	report("shachain_from_seed_range", start, num);
+
+	/* hashes[] is ascending; add them in descending order. */
+	shachain_init(&chain);
+	for (i = num; i > 0; i--)
+		if (!shachain_add_hash(&chain, MAX_INDEX - num + i, &hashes[i-1]))
+			abort();
+
+	/* Look up every stored value, newest first. */
+	start = time_now();
+	for (i = 0; i < num; i++) {
+		struct sha256 h;
+		if (!shachain_get_hash(&chain, MAX_INDEX - num + 1 + i, &h))
+			abort();
+		check ^= h.u.u8[0];
+	}
+	report("shachain_get_hash", start, num);
+
+	shachain_cache_init(&cache);
+	start = time_now();
+	for (i = 0; i < num; i++) {
+		struct sha256 h;
+		if (!shachain_get_hash_cached(&chain, &cache,
+					      MAX_INDEX - num + 1 + i, &h))
+			abort();
+		check ^= h.u.u8[0];
+	}
+	report("shachain_get_hash_cached", start, num);
+
+	start = time_now();
+	for (i = 0; i < num; i++) {
+		j = shachain_serialize(&chain, buf);
+		if (!shachain_deserialize(&chain, buf, j))
+			abort();
+	}
+	report("serialize+deserialize", start, num);
+	printf("struct shachain: %zu bytes, serialized: %zu bytes\n",
+	       sizeof(chain), shachain_serialized_size(&chain));
+
+	return check == 0xFF && num == 0;
+}
@@ -0,0 +1,125 @@
+/* Keys per second for siphash24() through the incremental API (as it
+ * used to be done), the one-shot siphash24(), and each x86 vector
+ * implementation of siphash24_many(), for a few key sizes. */
+#include <ccan/crypto/siphash24/siphash24.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+#define NUM 4096
+
+static double mkeys_per_sec(struct timeabs start, size_t n)
+{
+	return n * 1000.0 / time_to_nsec(time_between(time_now(), start));
+}
+
+#ifdef SIPHASH_X86
+struct impl {
+	const char *name;
+	size_t (*fn)(const uint64_t init[4], const void *const ps[],
+		     const size_t sizes[], size_t n, uint64_t *hashes);
+	bool usable;
+};
+#endif
+
+static uint64_t incremental(const struct siphash_seed *seed,
+			    const void *p, size_t size)
+{
+	struct siphash24_ctx ctx;
+
+	siphash24_init(&ctx, seed);
+	siphash24_update(&ctx, p, size);
+	return siphash24_done(&ctx);
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t sizes[] = { 4, 8, 16, 24, 32, 64 };
+	size_t rounds = argv[1] ? atol(argv[1]) : 200;
+	unsigned char *data = malloc(NUM * 64 + 64);
+	const void *ps[NUM];
+	size_t lens[NUM];
+	uint64_t hashes[NUM], check = 0;
+	struct siphash_seed seed;
+	struct timeabs start;
+	uint64_t init[4];
+	size_t i, j, s, r;
+#ifdef SIPHASH_X86
+	struct impl impls[] = {
+		{ "many4-avx2", siphash_many4_avx2,
+		  __builtin_cpu_supports("avx2") },
+		{ "many8-avx512", siphash_many8_avx512,
+		  __builtin_cpu_supports("avx512f") },
+	};
+#endif
+
+	memset(&seed, 7, sizeof(seed));
+	seed_state(init, &seed);
+	for (i = 0; i < NUM * 64 + 64; i++)
+		data[i] = i * 7 + (i >> 8);
+
+	printf("%5s %12s %12s", "bytes", "incremental", "siphash24");
+#ifdef SIPHASH_X86
+	for (j = 0; j < sizeof(impls) / sizeof(impls[0]); j++)
+		printf(" %12s", impls[j].name);
+#endif
+	printf("   (Mkeys/sec)\n");
+
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (i = 0; i < NUM; i++) {
+			/* Odd offsets: keys are rarely aligned. */
+			ps[i] = data + i * sizes[s] + 1;
+			lens[i] = sizes[s];
+		}
+
+		printf("%5zu", sizes[s]);
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			for (i = 0; i < NUM; i++)
+				check += incremental(&seed, ps[i], lens[i]);
+		printf(" %12.1f", mkeys_per_sec(start, rounds * NUM));
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			for (i = 0; i < NUM; i++)
+				check += siphash24(&seed, ps[i], lens[i]);
+		printf(" %12.1f", mkeys_per_sec(start, rounds * NUM));
+
+#ifdef SIPHASH_X86
+		for (j = 0; j < sizeof(impls) / sizeof(impls[0]); j++) {
+			if (!impls[j].usable) {
+				printf(" %12s", "-");
+				continue;
+			}
+			start = time_now();
+			for (r = 0; r < rounds; r++) {
+				/* NUM is a multiple of the lanes: no leftovers. */
+				impls[j].fn(init, ps, lens, NUM, hashes);
+				check += hashes[r % NUM];
+			}
+			printf(" %12.1f", mkeys_per_sec(start, rounds * NUM));
+		}
+#endif
+		printf("\n");
+	}
+
+	/* Mixed lengths 1-32, the usual hash table case. */
+	for (i = 0; i < NUM; i++) {
+		ps[i] = data + i * 16;
+		lens[i] = 1 + (i * 7919) % 32;
+	}
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			check += siphash24(&seed, ps[i], lens[i]);
+	printf("mixed 1-32: siphash24 %.1f", mkeys_per_sec(start, rounds * NUM));
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		siphash24_many(&seed, ps, lens, NUM, hashes);
+		check += hashes[r % NUM];
+	}
+	printf(", siphash24_many %.1f Mkeys/sec\n",
+	       mkeys_per_sec(start, rounds * NUM));
+
+	free(data);
+	return check == 0;
+}
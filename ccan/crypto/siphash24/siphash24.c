@@ -13,25 +13,29 @@
 #define dROUNDS 4
 
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+/* Same, but without the cast, so it works on vectors too. */
+#define VROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
 
-#define SIPROUND(v)							\
+#define SIPROUND_ROT(v, ROT)						\
 	do {								\
 		v[0] += v[1];						\
-		v[1] = ROTL(v[1], 13);					\
+		v[1] = ROT(v[1], 13);					\
 		v[1] ^= v[0];						\
-		v[0] = ROTL(v[0], 32);					\
+		v[0] = ROT(v[0], 32);					\
 		v[2] += v[3];						\
-		v[3] = ROTL(v[3], 16);					\
+		v[3] = ROT(v[3], 16);					\
 		v[3] ^= v[2];						\
 		v[0] += v[3];						\
-		v[3] = ROTL(v[3], 21);					\
+		v[3] = ROT(v[3], 21);					\
 		v[3] ^= v[0];						\
 		v[2] += v[1];						\
-		v[1] = ROTL(v[1], 17);					\
+		v[1] = ROT(v[1], 17);					\
 		v[1] ^= v[2];						\
-		v[2] = ROTL(v[2], 32);					\
+		v[2] = ROT(v[2], 32);					\
 	} while (0)
 
+#define SIPROUND(v) SIPROUND_ROT(v, ROTL)
+
 static void invalidate_siphash24(struct siphash24_ctx *ctx)
 {
 	ctx->bytes = -1ULL;
@@ -161,13 +165,245 @@ uint64_t siphash24_done(struct siphash24_ctx *ctx)
 	return cpu_to_le64(b);
 }
 
+static void seed_state(uint64_t v[4], const struct siphash_seed *seed)
+{
+	struct siphash24_ctx init = SIPHASH24_INIT(0, 0);
+
+	v[0] = init.v[0] ^ seed->u.u64[0];
+	v[1] = init.v[1] ^ seed->u.u64[1];
+	v[2] = init.v[2] ^ seed->u.u64[0];
+	v[3] = init.v[3] ^ seed->u.u64[1];
+}
+
+static inline uint64_t load_le64(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le64_to_cpu(v);
+}
+
+/* The final word of @p: the last size % 8 bytes, and the length in the
+ * top byte. */
+static inline uint64_t last_word(const unsigned char *p, size_t size)
+{
+	uint64_t b = (uint64_t)size << 56;
+	size_t left = size % 8;
+
+	if (!left)
+		return b;
+
+	/* Common case: grab the whole last 8 bytes, and shift off the
+	 * ones we've already done. */
+	if (size >= 8)
+		return b | (load_le64(p + size - 8) >> (64 - left * 8));
+
+	p += size - left;
+	switch (left) {
+	case 7:
+		b |= ((uint64_t)p[6]) << 48;
+	case 6:
+		b |= ((uint64_t)p[5]) << 40;
+	case 5:
+		b |= ((uint64_t)p[4]) << 32;
+	case 4:
+		b |= ((uint64_t)p[3]) << 24;
+	case 3:
+		b |= ((uint64_t)p[2]) << 16;
+	case 2:
+		b |= ((uint64_t)p[1]) << 8;
+	case 1:
+		b |= ((uint64_t)p[0]);
+	}
+	return b;
+}
+
+/* The whole of init, update and done, without the buffering. */
+static inline uint64_t siphash24_oneshot(const uint64_t init[4],
+					 const unsigned char *p, size_t size)
+{
+	uint64_t v[4], m;
+	size_t off;
+	int i;
+
+	v[0] = init[0];
+	v[1] = init[1];
+	v[2] = init[2];
+	v[3] = init[3];
+
+	for (off = 0; off + 8 <= size; off += 8) {
+		m = load_le64(p + off);
+		v[3] ^= m;
+		for (i = 0; i < cROUNDS; ++i)
+			SIPROUND(v);
+		v[0] ^= m;
+	}
+
+	m = last_word(p, size);
+	v[3] ^= m;
+	for (i = 0; i < cROUNDS; ++i)
+		SIPROUND(v);
+	v[0] ^= m;
+
+	v[2] ^= 0xff;
+	for (i = 0; i < dROUNDS; ++i)
+		SIPROUND(v);
+
+	return cpu_to_le64(v[0] ^ v[1] ^ v[2] ^ v[3]);
+}
+
 uint64_t siphash24(const struct siphash_seed *seed, const void *p, size_t size)
 {
-	struct siphash24_ctx ctx;
+	uint64_t init[4];
+
+	seed_state(init, seed);
+	return siphash24_oneshot(init, p, size);
+}
 
-	siphash24_init(&ctx, seed);
-	siphash24_update(&ctx, p, size);
-	return siphash24_done(&ctx);
+/*
+ * Multi-lane SipHash: several messages at once, one per vector lane.
+ * SIPROUND() works unchanged on GCC vector types, so we only need to
+ * gather the message words into vectors.  Without AVX2 there are no
+ * fast 64-bit vector shifts to build rotates from, and the scalar code
+ * wins, so we only do this when we have AVX2 or AVX-512 at runtime.
+ *
+ * Messages can have different lengths: once a lane has compressed its
+ * final word, it keeps its state while the others finish.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIPHASH_X86 1
+
+/* Hashes the first n - n % LANES messages, returns how many that was. */
+#define DEFINE_SIPHASH_MANY(NAME, LANES, ATTR)				\
+typedef uint64_t NAME##_vec __attribute__((vector_size(LANES * 8)));	\
+ATTR static size_t NAME(const uint64_t init[4],				\
+			const void *const ps[], const size_t sizes[],	\
+			size_t n, uint64_t *hashes)			\
+{									\
+	size_t done;							\
+									\
+	for (done = 0; done + LANES <= n; done += LANES) {		\
+		NAME##_vec v[4], old[4], m, active;			\
+		size_t words[LANES], minw = SIZE_MAX, maxw = 0, w;	\
+		uint64_t last[LANES], mw[LANES], act[LANES];		\
+		unsigned int l;						\
+		int i;							\
+									\
+		for (l = 0; l < LANES; l++) {				\
+			const unsigned char *p = ps[done + l];		\
+			size_t size = sizes[done + l];			\
+			words[l] = size / 8;				\
+			last[l] = last_word(p, size);			\
+			if (words[l] < minw)				\
+				minw = words[l];			\
+			if (words[l] > maxw)				\
+				maxw = words[l];			\
+		}							\
+		for (i = 0; i < 4; i++)					\
+			v[i] = (NAME##_vec){ 0 } + init[i];		\
+									\
+		/* Words every lane has. */				\
+		for (w = 0; w < minw; w++) {				\
+			for (l = 0; l < LANES; l++)			\
+				mw[l] = load_le64((const unsigned char *) \
+						  ps[done + l] + w * 8); \
+			memcpy(&m, mw, sizeof(m));			\
+			v[3] ^= m;					\
+			for (i = 0; i < cROUNDS; ++i)			\
+				SIPROUND_ROT(v, VROTL);			\
+			v[0] ^= m;					\
+		}							\
+		/* Remaining words, including every lane's last one. */	\
+		for (; w <= maxw; w++) {				\
+			for (l = 0; l < LANES; l++) {			\
+				if (w < words[l])			\
+					mw[l] = load_le64((const unsigned char *) \
+							  ps[done + l] + w * 8); \
+				else					\
+					mw[l] = last[l];		\
+				act[l] = (w <= words[l]) ? -1ULL : 0;	\
+			}						\
+			memcpy(&m, mw, sizeof(m));			\
+			memcpy(&active, act, sizeof(active));		\
+			for (i = 0; i < 4; i++)				\
+				old[i] = v[i];				\
+			v[3] ^= m;					\
+			for (i = 0; i < cROUNDS; ++i)			\
+				SIPROUND_ROT(v, VROTL);			\
+			v[0] ^= m;					\
+			for (i = 0; i < 4; i++)				\
+				v[i] = (v[i] & active) | (old[i] & ~active); \
+		}							\
+									\
+		v[2] ^= 0xff;						\
+		for (i = 0; i < dROUNDS; ++i)				\
+			SIPROUND_ROT(v, VROTL);				\
+		m = v[0] ^ v[1] ^ v[2] ^ v[3];				\
+		memcpy(mw, &m, sizeof(m));				\
+		for (l = 0; l < LANES; l++)				\
+			hashes[done + l] = cpu_to_le64(mw[l]);		\
+	}								\
+	return done;							\
+}
+
+DEFINE_SIPHASH_MANY(siphash_many4_avx2, 4, __attribute__((target("avx2"))))
+DEFINE_SIPHASH_MANY(siphash_many8_avx512, 8,
+		    __attribute__((target("avx512f"))))
+
+/* Leaves everything to the scalar code. */
+static size_t siphash_many_none(const uint64_t init[4],
+				const void *const ps[], const size_t sizes[],
+				size_t n, uint64_t *hashes)
+{
+	return 0;
+}
+
+static size_t siphash_many_dispatch(const uint64_t init[4],
+				    const void *const ps[],
+				    const size_t sizes[],
+				    size_t n, uint64_t *hashes);
+
+/* Replaced by the best version on first use.  Threads may race to do so,
+ * but they all store the same pointer. */
+static size_t (*siphash_many)(const uint64_t init[4],
+			      const void *const ps[], const size_t sizes[],
+			      size_t n, uint64_t *hashes)
+	= siphash_many_dispatch;
+
+static size_t siphash_many_dispatch(const uint64_t init[4],
+				    const void *const ps[],
+				    const size_t sizes[],
+				    size_t n, uint64_t *hashes)
+{
+	size_t (*impl)(const uint64_t [4], const void *const [],
+		       const size_t [], size_t, uint64_t *);
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		impl = siphash_many8_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		impl = siphash_many4_avx2;
+	else
+		impl = siphash_many_none;
+	__atomic_store_n(&siphash_many, impl, __ATOMIC_RELAXED);
+	return impl(init, ps, sizes, n, hashes);
+}
+#endif /* SIPHASH_X86 */
+
+void siphash24_many(const struct siphash_seed *seed,
+		    const void *const ps[], const size_t sizes[], size_t n,
+		    uint64_t *hashes)
+{
+	uint64_t init[4];
+	size_t i = 0;
+
+	seed_state(init, seed);
+#ifdef SIPHASH_X86
+	i = __atomic_load_n(&siphash_many, __ATOMIC_RELAXED)(init, ps, sizes,
+							      n, hashes);
+#endif
+	for (; i < n; i++)
+		hashes[i] = siphash24_oneshot(init, ps[i], sizes[i]);
 }
 	
 void siphash24_u8(struct siphash24_ctx *ctx, uint8_t v)
@@ -0,0 +1,161 @@
+/* Test speed of edit_distance_bounded() and edit_distance_many() against
+ * edit_distance() with a threshold test: looking up misspelt words in a
+ * dictionary of random words, and comparing long arrays with a few edits.
+ * Every result is checked against edit_distance(). */
+#include <ccan/edit_distance/edit_distance.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUERIES 20
+
+static const char *names[] = { NULL, "LCS", "Levenshtein", "RDL" };
+
+/* Copies s with n random substitutions, insertions or deletions. */
+static unsigned int misspell(char *t, const char *s, unsigned int len,
+			     unsigned int n)
+{
+	memcpy(t, s, len);
+	while (n--) {
+		unsigned int at = random() % len;
+
+		switch (random() % 3) {
+		case 0:
+			t[at] = 'a' + random() % 26;
+			break;
+		case 1:
+			memmove(t + at + 1, t + at, len - at);
+			t[at] = 'a' + random() % 26;
+			len++;
+			break;
+		default:
+			memmove(t + at, t + at + 1, len - at - 1);
+			len--;
+			break;
+		}
+	}
+	return len;
+}
+
+static double msec_since(struct timeabs start)
+{
+	return time_to_nsec(time_between(time_now(), start)) / 1000000.0;
+}
+
+static void dictionary(size_t nwords, unsigned int max)
+{
+	char *text = malloc(nwords * 16);
+	const char **words = malloc(nwords * sizeof(*words));
+	ed_size *lens = malloc(nwords * sizeof(*lens));
+	ed_dist *dists = malloc(nwords * sizeof(*dists));
+	char query[32];
+	enum ed_measure m;
+	size_t i;
+
+	for (i = 0; i < nwords; i++) {
+		unsigned int j;
+
+		words[i] = text + i * 16;
+		lens[i] = 4 + random() % 11;
+		for (j = 0; j < lens[i]; j++)
+			text[i * 16 + j] = 'a' + random() % 26;
+	}
+
+	printf("%zu words, distance <= %u (ms per lookup):\n", nwords, max);
+	for (m = EDIT_DISTANCE_LCS; m <= EDIT_DISTANCE_RDL; m++) {
+		double full = 0, bounded = 0, many = 0;
+		unsigned int q;
+
+		for (q = 0; q < QUERIES; q++) {
+			size_t w = random() % nwords;
+			unsigned int qlen = misspell(query, words[w], lens[w],
+						     1 + random() % 2);
+			size_t nfull = 0, nbounded = 0, nmany;
+			struct timeabs start;
+
+			start = time_now();
+			for (i = 0; i < nwords; i++)
+				nfull += edit_distance(query, qlen, words[i],
+						       lens[i], m) <= max;
+			full += msec_since(start);
+
+			start = time_now();
+			for (i = 0; i < nwords; i++)
+				nbounded += edit_distance_bounded(query, qlen,
+							words[i], lens[i],
+							m, max) <= max;
+			bounded += msec_since(start);
+
+			start = time_now();
+			nmany = edit_distance_many(query, qlen, words, lens,
+						   nwords, m, max, dists, 0);
+			many += msec_since(start);
+
+			if (nbounded != nfull || nmany != nfull) {
+				printf("  %s: WRONG ANSWER\n", names[m]);
+				exit(1);
+			}
+		}
+		printf("  %s: %.1f -> bounded %.1f (%.1fx) -> many %.1f (%.1fx)\n",
+		       names[m], full / QUERIES, bounded / QUERIES,
+		       full / bounded, many / QUERIES, full / many);
+	}
+	free(text);
+	free(words);
+	free(lens);
+	free(dists);
+}
+
+static void long_arrays(unsigned int len, unsigned int edits, unsigned int max)
+{
+	char *s = malloc(len), *t = malloc(len + edits);
+	unsigned int tlen, i, runs = 200000000 / ((size_t)len * len) + 1;
+	enum ed_measure m;
+
+	for (i = 0; i < len; i++)
+		s[i] = 'a' + random() % 26;
+	tlen = misspell(t, s, len, edits);
+
+	printf("%u characters, %u edits, distance <= %u (us):\n",
+	       len, edits, max);
+	for (m = EDIT_DISTANCE_LCS; m <= EDIT_DISTANCE_RDL; m++) {
+		struct timeabs start;
+		ed_dist full = edit_distance(s, len, t, tlen, m);
+		ed_dist bounded = edit_distance_bounded(s, len, t, tlen, m, max);
+		double old, new;
+		unsigned long total = 0;
+
+		if (bounded != (full <= max ? full : max + 1)) {
+			printf("  %s: WRONG ANSWER\n", names[m]);
+			exit(1);
+		}
+
+		start = time_now();
+		for (i = 0; i < runs; i++)
+			total += edit_distance(s, len, t, tlen, m);
+		old = msec_since(start) * 1000 / runs;
+
+		start = time_now();
+		for (i = 0; i < runs; i++)
+			total += edit_distance_bounded(s, len, t, tlen, m, max);
+		new = msec_since(start) * 1000 / runs;
+
+		printf("  %s: %.1f -> %.1f (%.1fx)%s\n", names[m], old, new,
+		       old / new, total ? "" : " ");
+	}
+	free(s);
+	free(t);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t nwords = argv[1] ? atol(argv[1]) : 1000000;
+
+	dictionary(nwords, 1);
+	dictionary(nwords, 2);
+	long_arrays(1000, 5, 10);
+	long_arrays(4000, 10, 20);
+	long_arrays(4000, 10, 5);
+	return 0;
+}
@@ -0,0 +1,15 @@
+/* The edit_distance module again, with the bit-parallel algorithms disabled
+ * by a (non-default) element comparison, to compare against. */
+#define ED_ELEM_EQUAL(e, f) ((e) == (f))
+
+#define edit_distance edit_distance_dp
+#define edit_distance_lcs edit_distance_lcs_dp
+#define edit_distance_lev edit_distance_lev_dp
+#define edit_distance_rdl edit_distance_rdl_dp
+#define edit_distance_dl edit_distance_dl_dp
+
+#include <ccan/edit_distance/edit_distance.c>
+#include <ccan/edit_distance/edit_distance_dl.c>
+#include <ccan/edit_distance/edit_distance_lcs.c>
+#include <ccan/edit_distance/edit_distance_lev.c>
+#include <ccan/edit_distance/edit_distance_rdl.c>
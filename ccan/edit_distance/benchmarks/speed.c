@@ -0,0 +1,70 @@
+/* Test speed of edit_distance() against the Wagner-Fischer code it used for
+ * all measures, across string lengths.  Strings are random identifiers with
+ * about a quarter of characters changed between pairs, and every result is
+ * checked against the old code. */
+#include <ccan/edit_distance/edit_distance.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+ed_dist edit_distance_dp(const ed_elem *src, ed_size slen,
+			 const ed_elem *tgt, ed_size tlen,
+			 enum ed_measure measure);
+
+#define PAIRS 64
+
+static const char *names[] = { NULL, "LCS", "Levenshtein", "RDL" };
+
+int main(int argc, char *argv[])
+{
+	size_t cells = argv[1] ? atol(argv[1]) : 200000000;
+	unsigned int len, p, r, i;
+	static char s[PAIRS][4096], t[PAIRS][4096];
+	enum ed_measure m;
+	unsigned long total = 0;
+
+	for (len = 8; len <= 4096; len *= 2) {
+		/* Enough runs for about the same work at every length. */
+		unsigned int runs = cells / ((size_t)len * len * PAIRS) + 1;
+
+		for (p = 0; p < PAIRS; p++) {
+			for (i = 0; i < len; i++) {
+				s[p][i] = "abcdefghijklmnopqrstuvwxyz_0123"[random() % 31];
+				t[p][i] = random() % 4 ? s[p][i] : 'a' + random() % 26;
+			}
+		}
+
+		printf("%u characters:\n", len);
+		for (m = EDIT_DISTANCE_LCS; m <= EDIT_DISTANCE_RDL; m++) {
+			struct timeabs start;
+			double old, new;
+
+			for (p = 0; p < PAIRS; p++) {
+				if (edit_distance(s[p], len, t[p], len, m)
+				    != edit_distance_dp(s[p], len, t[p], len, m)) {
+					printf("  %s: WRONG ANSWER\n", names[m]);
+					return 1;
+				}
+			}
+
+			start = time_now();
+			for (r = 0; r < runs; r++)
+				for (p = 0; p < PAIRS; p++)
+					total += edit_distance_dp(s[p], len, t[p], len, m);
+			old = (double)time_to_nsec(time_between(time_now(), start))
+				/ (runs * PAIRS);
+
+			start = time_now();
+			for (r = 0; r < runs; r++)
+				for (p = 0; p < PAIRS; p++)
+					total += edit_distance(s[p], len, t[p], len, m);
+			new = (double)time_to_nsec(time_between(time_now(), start))
+				/ (runs * PAIRS);
+
+			printf("  %s: %.0fns -> %.0fns (%.1fx)\n",
+			       names[m], old, new, old / new);
+		}
+	}
+	printf("total = %lu\n", total);
+	return 0;
+}
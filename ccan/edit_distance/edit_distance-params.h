@@ -97,6 +97,8 @@
 #ifndef ED_ELEM_EQUAL
 /** Are two elements equal? */
 # define ED_ELEM_EQUAL(elem1, elem2) (elem1 == elem2)
+/** Defined if elements are compared with @c == . */
+# define ED_ELEM_EQUAL_DEFAULT
 #endif
 
 #if !defined(ED_HASH_ELEM) && !defined(ed_elem)
@@ -144,4 +146,16 @@
 # define ED_STACK_DIST_VALS 512
 #endif
 
+#ifndef ED_STACK_BP_WORDS
+/** Maximum number of 64-bit words per bit vector for which the bit-parallel
+ * algorithms keep their state on the stack.
+ *
+ * The bit-parallel algorithms (see #ED_BIT_PARALLEL) use one bit vector for
+ * each possible byte value plus two state vectors, each of
+ * @c ceil(min(slen,tlen)/64) words.  With the default of 4, that is about
+ * 8KB of stack and covers strings of up to 256 elements.
+ */
+# define ED_STACK_BP_WORDS 4
+#endif
+
 #endif
@@ -27,6 +27,180 @@
 /** Index of element in lower triangular matrix. */
 #define ED_TMAT_IND(r, c) (ED_TMAT_SIZE(r) + c)
 
+#if defined(ED_ELEM_EQUAL_DEFAULT) && \
+		defined(ED_DEL_COST_CONST) && \
+		defined(ED_INS_COST_CONST) && \
+		defined(ED_SUB_COST_CONST)
+/** Defined if the bit-parallel algorithms may be used.
+ *
+ * These compute unit-cost distances 64 cells of the distance matrix at a
+ * time, with one bit vector per byte value marking where it occurs in
+ * @p src.  They are used when elements are bytes (see #ED_BP_USABLE)
+ * compared with @c == and all costs are the defaults.  Otherwise the
+ * Wagner-Fischer code is used.
+ */
+# define ED_BIT_PARALLEL
+
+# include <limits.h>		/* UCHAR_MAX */
+# include <stdint.h>		/* uint64_t */
+# include <stdlib.h>		/* malloc */
+# include <string.h>		/* memset */
+
+/** Are elements bytes, so they can index the match vectors? */
+# define ED_BP_USABLE() (sizeof(ed_elem) == 1)
+
+/** Number of 64-bit words in a bit vector covering @p len elements. */
+# define ED_BP_WORDS(len) (((size_t)(len) + 63) / 64)
+
+/** Number of 64-bit words of state for bit vectors of @p words words:
+ * one match vector per byte value, then two state vectors. */
+# define ED_BP_MEM(words) ((words) * (UCHAR_MAX + 3))
+
+/**
+ * Sets up the match vectors for the bit-parallel algorithms.
+ * @private
+ * @param src Array whose elements are marked in the vectors.
+ * @param slen Number of elements in @p src (must be > 0).
+ * @param tgt Array which will be looked up in the vectors.
+ * @param tlen Number of elements in @p tgt.
+ * @param stackmem #ED_BP_MEM(#ED_STACK_BP_WORDS) words to use if large
+ * enough.
+ * @return #ED_BP_MEM(#ED_BP_WORDS(slen)) words where word @c w of the vector
+ * for byte @c c (at <code>c * words + w</code>) has bit @c i set if
+ * <code>src[64 * w + i] == c</code>.  Only vectors for bytes in @p tgt are
+ * initialized.  Must be freed if not @p stackmem.
+ */
+static inline uint64_t *ed_bp_init(const ed_elem *src, ed_size slen,
+				   const ed_elem *tgt, ed_size tlen,
+				   uint64_t *stackmem)
+{
+	size_t words = ED_BP_WORDS(slen);
+	uint64_t *peq = words <= ED_STACK_BP_WORDS ? stackmem :
+	    malloc(ED_BP_MEM(words) * sizeof(uint64_t));
+
+	if ((size_t)slen + tlen > UCHAR_MAX) {
+		memset(peq, 0, (UCHAR_MAX + 1) * words * sizeof(uint64_t));
+	} else {
+		for (ed_size j = 0; j < tlen; ++j) {
+			memset(peq + (unsigned char)tgt[j] * words, 0,
+			       words * sizeof(uint64_t));
+		}
+		for (ed_size i = 0; i < slen; ++i) {
+			memset(peq + (unsigned char)src[i] * words, 0,
+			       words * sizeof(uint64_t));
+		}
+	}
+
+	for (ed_size i = 0; i < slen; ++i) {
+		peq[(unsigned char)src[i] * words + i / 64] |=
+		    (uint64_t)1 << (i % 64);
+	}
+	return peq;
+}
+
+/**
+ * Calculates Levenshtein distance for @p slen <= 64 with the single-word
+ * bit-vector algorithm of Myers @cite Myers99 @cite Hyyro03.
+ * @private
+ * @param peq Match vectors of @p src (one word per byte value) covering the
+ * elements of @p tgt, as from ed_bp_init().
+ * @param slen Number of elements in @p src (must be 1 to 64).
+ * @param tgt Target array to calculate distance to.
+ * @param tlen Number of elements in @p tgt.
+ * @return Levenshtein distance from @p src to @p tgt.
+ */
+static inline ed_dist ed_bp_lev1(const uint64_t *peq, ed_size slen,
+				 const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t last = (uint64_t)1 << (slen - 1);
+	uint64_t pv = ~(uint64_t)0, mv = 0;
+	long dist = slen;
+
+	for (ed_size j = 0; j < tlen; ++j) {
+		uint64_t eq = peq[(unsigned char)tgt[j]];
+		uint64_t xv = eq | mv;
+		uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+		uint64_t ph = mv | ~(xh | pv);
+		uint64_t mh = pv & xh;
+
+		dist += (ph & last) != 0;
+		dist -= (mh & last) != 0;
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+	}
+	return (ed_dist)dist;
+}
+
+/**
+ * Calculates LCS distance for @p slen <= 64 with the single-word bit-vector
+ * algorithm of Allison and Dix @cite Allison86 @cite Hyyro04.
+ * @private
+ * @see ed_bp_lev1() for the parameters.
+ */
+static inline ed_dist ed_bp_lcs1(const uint64_t *peq, ed_size slen,
+				 const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t s = ~(uint64_t)0, x;
+	ed_size lcs = 0;
+
+	for (ed_size j = 0; j < tlen; ++j) {
+		uint64_t u = s & peq[(unsigned char)tgt[j]];
+
+		s = (s + u) | (s & ~u);
+	}
+
+	x = ~s;
+	if (slen < 64) {
+		x &= ((uint64_t)1 << slen) - 1;
+	}
+	for (; x; x &= x - 1) {
+		++lcs;
+	}
+	return (ed_dist)(slen + tlen - 2 * lcs);
+}
+
+# ifdef ED_TRA_COST_CONST
+/**
+ * Calculates Restricted Damerau-Levenshtein distance for @p slen <= 64 with
+ * the bit-vector algorithm of Hyyrö @cite Hyyro03.
+ * @private
+ * @see ed_bp_lev1() for the parameters.
+ *
+ * This is ed_bp_lev1() with an extra term which marks diagonal steps that
+ * complete a transposition, using the match vector of the previous element
+ * of @p tgt.
+ */
+static inline ed_dist ed_bp_rdl1(const uint64_t *peq, ed_size slen,
+				 const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t last = (uint64_t)1 << (slen - 1);
+	uint64_t pv = ~(uint64_t)0, mv = 0, d0 = 0, preveq = 0;
+	long dist = slen;
+
+	for (ed_size j = 0; j < tlen; ++j) {
+		uint64_t eq = peq[(unsigned char)tgt[j]];
+		uint64_t tr = (((~d0) & eq) << 1) & preveq;
+		uint64_t ph, mh;
+
+		d0 = (((eq & pv) + pv) ^ pv) | eq | mv | tr;
+		ph = mv | ~(d0 | pv);
+		mh = d0 & pv;
+
+		dist += (ph & last) != 0;
+		dist -= (mh & last) != 0;
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(d0 | ph);
+		mv = ph & d0;
+		preveq = eq;
+	}
+	return (ed_dist)dist;
+}
+# endif
+#endif
+
 /**
  * Calculates non-trivial LCS distance (for internal use).
  * @private
@@ -59,7 +59,11 @@ enum ed_measure {
 	 *
 	 * This implementation uses an iterative version of the Wagner-Fischer
 	 * algorithm @cite Wagner74 which requires <code>O(slen * tlen)</code>
-	 * time and <code>min(slen, tlen) + 1</code> space.
+	 * time and <code>min(slen, tlen) + 1</code> space.  For byte elements
+	 * with the default comparison and costs it uses the bit-vector
+	 * algorithm of Allison and Dix @cite Allison86 @cite Hyyro04 which
+	 * requires <code>O(min(slen, tlen) / 64 * max(slen, tlen))</code>
+	 * time.
 	 */
 	EDIT_DISTANCE_LCS = 1,
 	/**
@@ -72,7 +76,11 @@ enum ed_measure {
 	 *
 	 * This implementation uses a modified version of the Wagner-Fischer
 	 * algorithm @cite Wagner74 which requires <code>O(slen * tlen)</code>
-	 * time and only <code>min(slen, tlen) + 1</code> space.
+	 * time and only <code>min(slen, tlen) + 1</code> space.  For byte
+	 * elements with the default comparison and costs it uses the
+	 * bit-vector algorithm of Myers @cite Myers99 @cite Hyyro03 which
+	 * requires <code>O(min(slen, tlen) / 64 * max(slen, tlen))</code>
+	 * time.
 	 */
 	EDIT_DISTANCE_LEV,
 	/**
@@ -87,7 +95,10 @@ enum ed_measure {
 	 *
 	 * This implementation uses a modified version of the Wagner-Fischer
 	 * algorithm @cite Wagner74 which requires <code>O(slen * tlen)</code>
-	 * time and only <code>2 * min(slen, tlen) + 2</code> space.
+	 * time and only <code>2 * min(slen, tlen) + 2</code> space.  When the
+	 * shorter array has at most 64 byte elements with the default
+	 * comparison and costs, it uses the bit-vector algorithm of Hyyrö
+	 * @cite Hyyro03 which requires <code>O(max(slen, tlen))</code> time.
 	 */
 	EDIT_DISTANCE_RDL,
 	/**
@@ -128,4 +139,77 @@ enum ed_measure {
 ed_dist edit_distance(const ed_elem *src, ed_size slen,
 		      const ed_elem *tgt, ed_size tlen,
 		      enum ed_measure measure);
+/**
+ * edit_distance_bounded - Calculates the edit distance between two arrays, if
+ * it is at most a given bound.
+ *
+ * @param src Source array to calculate distance from.
+ * @param slen Number of elements in @p src to consider.
+ * @param tgt Target array to calculate distance to.
+ * @param tlen Number of elements in @p tgt to consider.
+ * @param measure Edit distance measure to calculate.
+ * @param max Largest distance of interest.  @p max + 1 must be representable
+ * as an ::ed_dist.
+ * @return Edit distance from @p src[0..slen-1] to @p tgt[0..tlen-1] if it is
+ * at most @p max, otherwise @p max + 1.
+ *
+ * Arrays whose lengths differ by more than @p max (weighted by the insert or
+ * delete cost, when constant) are rejected without examining them.
+ * Otherwise, only the diagonal band of the distance matrix which can hold
+ * values up to @p max is calculated, with the cut-off of Ukkonen
+ * @cite Ukkonen85, and calculation stops as soon as a row has no such value.
+ * With unit costs this takes <code>O(max * min(slen, tlen))</code> time.
+ * When the bit-parallel algorithms apply and the band would be wide, they are
+ * used instead.  ed_measure::EDIT_DISTANCE_DL is calculated in full, since
+ * its transpositions can skip rows.
+ *
+ * @code
+ * Example:
+ * const char *source = "kitten";
+ * const char *target = "sitting";
+ * assert(edit_distance_bounded(source, strlen(source),
+ *                              target, strlen(target),
+ *                              EDIT_DISTANCE_LEV, 2) == 3);
+ * Example_End: @endcode
+ */
+ed_dist edit_distance_bounded(const ed_elem *src, ed_size slen,
+			      const ed_elem *tgt, ed_size tlen,
+			      enum ed_measure measure, ed_dist max);
+
+/**
+ * edit_distance_many - Calculates bounded edit distances from one array to
+ * many others.
+ *
+ * @param src Source array to calculate distances from.
+ * @param slen Number of elements in @p src to consider.
+ * @param tgts Target arrays to calculate distances to.
+ * @param tlens Number of elements of each of @p tgts to consider.
+ * @param n Number of target arrays.
+ * @param measure Edit distance measure to calculate.
+ * @param max Largest distance of interest (see edit_distance_bounded()).
+ * @param dists Array of @p n distances to fill in, each as returned by
+ * edit_distance_bounded().
+ * @param threads The most threads to use, or 0 for the OpenMP default.
+ * @return Number of target arrays within distance @p max of @p src.
+ *
+ * This is intended for lookups of a word in a dictionary (e.g. spelling
+ * suggestions).  When the bit-parallel algorithms apply and @p src has at
+ * most 64 elements, its match vectors are calculated once and shared by all
+ * targets.  Targets are divided between threads if the module was compiled
+ * with OpenMP.
+ *
+ * @code
+ * Example:
+ * const char *words[] = { "sitting", "mitten", "knitting" };
+ * ed_size lens[] = { 7, 6, 8 };
+ * ed_dist dists[3];
+ * assert(edit_distance_many("kitten", 6, words, lens, 3,
+ *                           EDIT_DISTANCE_LEV, 2, dists, 1) == 1);
+ * assert(dists[1] == 1);
+ * Example_End: @endcode
+ */
+size_t edit_distance_many(const ed_elem *src, ed_size slen,
+			  const ed_elem *const *tgts, const ed_size *tlens,
+			  size_t n, enum ed_measure measure, ed_dist max,
+			  ed_dist *dists, unsigned int threads);
 #endif
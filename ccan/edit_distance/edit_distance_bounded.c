@@ -0,0 +1,335 @@
+/** @file
+ * Defines bounded edit distance functions.
+ *
+ * MIT license - see LICENSE file for details
+ */
+#include <stdlib.h>		/* free, malloc */
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "edit_distance.h"
+#include "edit_distance-params.h"
+#include "edit_distance-private.h"
+
+#ifndef ED_BAND_BP_RATIO
+/** Band width (in elements, per 64-bit word of @p src) above which the
+ * bit-parallel algorithms are used instead of the banded ones.
+ *
+ * A bit-parallel Levenshtein step calculates 64 elements of a column of the
+ * distance matrix in about the time a banded step calculates one.  The LCS
+ * step is about twice as fast again, so its ratio is halved.
+ */
+# define ED_BAND_BP_RATIO 1
+#endif
+
+#ifndef ED_MANY_MIN_PARALLEL
+/** Fewest targets for which edit_distance_many() starts threads. */
+# define ED_MANY_MIN_PARALLEL 1024
+#endif
+
+/**
+ * Calculates a lower bound of the cost to finish aligning @p a remaining
+ * elements of @p src with @p b remaining elements of @p tgt.
+ */
+#if defined(ED_DEL_COST_CONST) && defined(ED_INS_COST_CONST)
+# define ED_REST_COST(a, b) \
+	((a) > (b) ? (ed_dist)((a) - (b)) * ED_DEL_COST() : \
+	 (ed_dist)((b) - (a)) * ED_INS_COST())
+#else
+# define ED_REST_COST(a, b) 0
+#endif
+
+/**
+ * Calculates the LCS, Levenshtein, or Restricted Damerau-Levenshtein distance
+ * up to @p max using the cut-off of Ukkonen @cite Ukkonen85.
+ *
+ * Rows of the Wagner-Fischer matrix (one per element of @p tgt) are only
+ * calculated from the first to the last element which could lie on a path of
+ * cost at most @p max, as bounded by the previous row(s).  Every other element
+ * is treated as @p max + 1, which can only overestimate distances which are
+ * larger than @p max.  Each row is kept so that stale elements of the row it
+ * replaces can be reset.
+ *
+ * @return Distance if at most @p max, otherwise @p max + 1.
+ */
+static ed_dist edit_distance_banded(const ed_elem *src, ed_size slen,
+				    const ed_elem *tgt, ed_size tlen,
+				    enum ed_measure measure, ed_dist max)
+{
+	/* Optimization: Avoid malloc when required rows of distance matrix can
+	 * fit on the stack.
+	 */
+	ed_dist stackdist[ED_STACK_DIST_VALS];
+	const ed_dist inf = max + 1;
+	const unsigned int nrows = measure == EDIT_DISTANCE_RDL ? 3 : 2;
+	ed_dist *distmem = (size_t)(slen + 1) * nrows <= ED_STACK_DIST_VALS ?
+	    stackdist : malloc((size_t)(slen + 1) * nrows * sizeof(ed_dist));
+	ed_dist *rows[3];
+	/* Elements calculated in each row, and those which may be within max. */
+	ed_size calclo[3], calchi[3], lo[3], hi[3];
+	ed_dist result;
+
+	for (size_t i = 0; i < (size_t)(slen + 1) * nrows; ++i) {
+		distmem[i] = inf;
+	}
+	for (unsigned int r = 0; r < nrows; ++r) {
+		rows[r] = distmem + (size_t)(slen + 1) * r;
+		calclo[r] = lo[r] = 1;
+		calchi[r] = hi[r] = 0;
+	}
+
+	/* Initialize row with cost to delete src[0..i-1] */
+	rows[0][0] = 0;
+	lo[0] = hi[0] = 0;
+	for (ed_size i = 1; i <= slen && rows[0][i - 1] <= max; ++i) {
+		rows[0][i] = rows[0][i - 1] + ED_DEL_COST(src[i - 1]);
+		calchi[0] = i;
+		if (rows[0][i] + ED_REST_COST(slen - i, tlen) <= max) {
+			hi[0] = i;
+		}
+	}
+	calclo[0] = 0;
+
+	for (ed_size j = 1; j <= tlen; ++j) {
+		unsigned int cur = j % nrows, prev = (j - 1) % nrows;
+		unsigned int prev2 = (j + nrows - 2) % nrows;
+		ed_dist *dist = rows[cur];
+		const ed_dist *prevdist = rows[prev], *prevdist2 = rows[prev2];
+		ed_size start = lo[prev], end = hi[prev] + 1, i;
+		int found = 0;
+
+		for (i = calclo[cur]; i <= calchi[cur]; ++i) {
+			dist[i] = inf;
+		}
+
+		/* A transposition can also extend the band from two rows up. */
+		if (nrows == 3 && j > 1 && lo[prev2] <= hi[prev2]) {
+			if (lo[prev2] + 2 < start) {
+				start = lo[prev2] + 2;
+			}
+			if (hi[prev2] + 2 > end) {
+				end = hi[prev2] + 2;
+			}
+		}
+
+		/* Past end, only deletions from within the band remain. */
+		for (i = start;
+		     i <= slen && (i <= end || (found && hi[cur] == i - 1));
+		     ++i) {
+			if (i == 0) {
+				dist[0] = prevdist[0] + ED_INS_COST(tgt[j - 1]);
+			} else if (ED_ELEM_EQUAL(src[i - 1], tgt[j - 1])) {
+				/* Same as tgt upto j-2, src upto i-2. */
+				dist[i] = prevdist[i - 1];
+			} else {
+				/* Insertion is tgt upto j-2, src upto i-1
+				 * + insert tgt[j-1] */
+				ed_dist insdist =
+				    prevdist[i] + ED_INS_COST(tgt[j - 1]);
+
+				/* Deletion is tgt upto j-1, src upto i-2
+				 * + delete src[i-1] */
+				ed_dist deldist =
+				    dist[i - 1] + ED_DEL_COST(src[i - 1]);
+
+				if (measure == EDIT_DISTANCE_LCS) {
+					dist[i] = ED_MIN2(insdist, deldist);
+				} else {
+					/* Substitution is tgt upto j-2, src
+					 * upto i-2 + substitute tgt[j-1] for
+					 * src[i-1] */
+					ed_dist subdist = prevdist[i - 1] +
+					    ED_SUB_COST(src[i - 1], tgt[j - 1]);
+
+					dist[i] = ED_MIN3(insdist, deldist,
+							  subdist);
+				}
+
+				if (nrows == 3 && j > 1 && i > 1 &&
+				    ED_ELEM_EQUAL(src[i - 2], tgt[j - 1]) &&
+				    ED_ELEM_EQUAL(src[i - 1], tgt[j - 2])) {
+					ed_dist tradist = prevdist2[i - 2] +
+					    ED_TRA_COST(src[i - 2], src[i - 1]);
+					dist[i] = ED_MIN2(dist[i], tradist);
+				}
+			}
+
+			if (dist[i] + ED_REST_COST(slen - i, tlen - j) <= max) {
+				if (!found) {
+					lo[cur] = i;
+					found = 1;
+				}
+				hi[cur] = i;
+			}
+		}
+		calclo[cur] = start;
+		calchi[cur] = i - 1;
+
+		if (!found) {
+			/* Every path costs more than max. */
+			result = inf;
+			goto out;
+		}
+	}
+
+	result = rows[tlen % nrows][slen];
+	if (result > max) {
+		result = inf;
+	}
+
+out:
+	if (distmem != stackdist) {
+		free(distmem);
+	}
+	return result;
+}
+
+ed_dist edit_distance_bounded(const ed_elem *src, ed_size slen,
+			      const ed_elem *tgt, ed_size tlen,
+			      enum ed_measure measure, ed_dist max)
+{
+	ed_dist result;
+
+	/* Remove common prefix. */
+	while (slen > 0 && tlen > 0 && ED_ELEM_EQUAL(src[0], tgt[0])) {
+		++src;
+		++tgt;
+		--slen;
+		--tlen;
+	}
+
+	/* Remove common suffix. */
+	while (slen > 0 && tlen > 0 &&
+	       ED_ELEM_EQUAL(src[slen - 1], tgt[tlen - 1])) {
+		--slen;
+		--tlen;
+	}
+
+#if defined(ED_COST_IS_SYMMETRIC)
+	/* Use smaller array for src. */
+	if (slen > tlen) {
+		ED_SWAP(src, tgt, const ed_elem *);
+		ED_SWAP(slen, tlen, ed_size);
+	}
+#endif
+
+	/* Every element of the longer array beyond the length of the shorter
+	 * one must be inserted or deleted. */
+	if (ED_REST_COST(slen, tlen) > max) {
+		return max + 1;
+	}
+
+	if (slen == 0 || tlen == 0 || measure == EDIT_DISTANCE_DL) {
+		result = edit_distance(src, slen, tgt, tlen, measure);
+		return result <= max ? result : max + 1;
+	}
+
+#ifdef ED_BIT_PARALLEL
+	/* The bit-parallel algorithms are quicker unless the band is narrow. */
+# ifdef ED_TRA_COST_CONST
+	if (ED_BP_USABLE() && (measure != EDIT_DISTANCE_RDL || slen <= 64)) {
+# else
+	if (ED_BP_USABLE() && measure != EDIT_DISTANCE_RDL) {
+# endif
+		size_t words = ED_BP_WORDS(slen);
+		size_t band = (size_t)max * 2 + 1;
+
+		if (measure == EDIT_DISTANCE_LCS) {
+			band *= 2;
+		}
+		if (words == 1 || band > words * ED_BAND_BP_RATIO) {
+			result = edit_distance(src, slen, tgt, tlen, measure);
+			return result <= max ? result : max + 1;
+		}
+	}
+#endif
+
+	return edit_distance_banded(src, slen, tgt, tlen, measure, max);
+}
+
+#if defined(ED_BIT_PARALLEL) && defined(ED_TRA_COST_CONST)
+/**
+ * Calculates bounded distance from @p src to @p tgt for edit_distance_many()
+ * with the match vectors of @p src already set up.
+ */
+static ed_dist edit_distance_bp_bounded(const uint64_t *peq, ed_size slen,
+					const ed_elem *tgt, ed_size tlen,
+					enum ed_measure measure, ed_dist max)
+{
+	ed_dist result;
+
+	if (ED_REST_COST(slen, tlen) > max) {
+		return max + 1;
+	}
+
+	if (tlen == 0) {
+		result = slen;
+	} else if (measure == EDIT_DISTANCE_LCS) {
+		result = ed_bp_lcs1(peq, slen, tgt, tlen);
+	} else if (measure == EDIT_DISTANCE_LEV) {
+		result = ed_bp_lev1(peq, slen, tgt, tlen);
+	} else {
+		result = ed_bp_rdl1(peq, slen, tgt, tlen);
+	}
+	return result <= max ? result : max + 1;
+}
+#endif
+
+#ifdef _OPENMP
+#define ED_MANY_FOR \
+	_Pragma("omp parallel for num_threads(threads) schedule(dynamic, 256)")
+#else
+#define ED_MANY_FOR
+#endif
+
+size_t edit_distance_many(const ed_elem *src, ed_size slen,
+			  const ed_elem *const *tgts, const ed_size *tlens,
+			  size_t n, enum ed_measure measure, ed_dist max,
+			  ed_dist *dists, unsigned int threads)
+{
+	size_t i, found = 0;
+
+#ifdef _OPENMP
+	if (threads == 0) {
+		threads = omp_get_max_threads();
+	}
+	if (n < ED_MANY_MIN_PARALLEL) {
+		threads = 1;
+	}
+#else
+	(void)threads;
+#endif
+
+#if defined(ED_BIT_PARALLEL) && defined(ED_TRA_COST_CONST)
+	if (ED_BP_USABLE() && slen > 0 && slen <= 64 &&
+	    measure != EDIT_DISTANCE_DL) {
+		uint64_t peq[UCHAR_MAX + 1] = { 0 };
+
+		for (ed_size k = 0; k < slen; ++k) {
+			peq[(unsigned char)src[k]] |= (uint64_t)1 << k;
+		}
+
+		ED_MANY_FOR
+		for (i = 0; i < n; ++i) {
+			dists[i] = edit_distance_bp_bounded(peq, slen, tgts[i],
+							    tlens[i], measure,
+							    max);
+		}
+	} else
+#endif
+	{
+		ED_MANY_FOR
+		for (i = 0; i < n; ++i) {
+			dists[i] = edit_distance_bounded(src, slen, tgts[i],
+							 tlens[i], measure,
+							 max);
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		found += dists[i] <= max;
+	}
+	return found;
+}
@@ -10,9 +10,80 @@
 #include "edit_distance-params.h"
 #include "edit_distance-private.h"
 
+#ifdef ED_BIT_PARALLEL
+/**
+ * Calculates LCS distance using the bit-vector algorithm of Allison and Dix
+ * @cite Allison86 with the simplification of Hyyrö @cite Hyyro04.
+ *
+ * The zero bits of @c s mark the positions in @p src where the length of the
+ * longest common subsequence with the @p tgt prefix seen so far increases.
+ * Each element of @p tgt updates @c s with one multi-word addition.
+ */
+static ed_dist edit_distance_lcs_bp(const ed_elem *src, ed_size slen,
+				    const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t stackmem[ED_BP_MEM(ED_STACK_BP_WORDS)];
+	uint64_t *peq = ed_bp_init(src, slen, tgt, tlen, stackmem);
+	size_t words = ED_BP_WORDS(slen);
+	uint64_t *s = peq + (UCHAR_MAX + 1) * words;
+	size_t lcs = 0;
+
+	if (words == 1) {
+		ed_dist dist = ed_bp_lcs1(peq, slen, tgt, tlen);
+
+		if (peq != stackmem) {
+			free(peq);
+		}
+		return dist;
+	}
+
+	for (size_t w = 0; w < words; ++w) {
+		s[w] = ~(uint64_t)0;
+	}
+
+	for (ed_size j = 0; j < tlen; ++j) {
+		const uint64_t *eqs = peq + (unsigned char)tgt[j] * words;
+		uint64_t carry = 0;
+
+		for (size_t w = 0; w < words; ++w) {
+			uint64_t u = s[w] & eqs[w];
+			uint64_t sum = s[w] + u;
+			uint64_t c = sum < u;
+
+			sum += carry;
+			carry = c | (sum < carry);
+			/* u is a subset of s, so s - u == s & ~u. */
+			s[w] = sum | (s[w] & ~u);
+		}
+	}
+
+	for (size_t w = 0; w < words; ++w) {
+		uint64_t x = ~s[w];
+
+		if (w == words - 1 && slen % 64) {
+			x &= ((uint64_t)1 << (slen % 64)) - 1;
+		}
+		for (; x; x &= x - 1) {
+			++lcs;
+		}
+	}
+
+	if (peq != stackmem) {
+		free(peq);
+	}
+	return (ed_dist)(slen + tlen - 2 * lcs);
+}
+#endif
+
 ed_dist edit_distance_lcs(const ed_elem *src, ed_size slen,
 			  const ed_elem *tgt, ed_size tlen)
 {
+#ifdef ED_BIT_PARALLEL
+	if (ED_BP_USABLE()) {
+		return edit_distance_lcs_bp(src, slen, tgt, tlen);
+	}
+#endif
+
 	/* Optimization: Avoid malloc when row of distance matrix can fit on
 	 * the stack.
 	 */
@@ -10,9 +10,82 @@
 #include "edit_distance-params.h"
 #include "edit_distance-private.h"
 
+#ifdef ED_BIT_PARALLEL
+/**
+ * Calculates Levenshtein distance using the bit-vector algorithm of Myers
+ * @cite Myers99 in the formulation of Hyyrö @cite Hyyro03.
+ *
+ * Each column of the distance matrix is represented by its vertical deltas
+ * (+1 in @c vp, -1 in @c vn, otherwise 0) as bit vectors over @p src, and
+ * computed from the previous column in <code>O(slen / 64)</code> word
+ * operations.  Longer sources use blocks of words, with the horizontal delta
+ * of the last row of each block carried into the next.
+ */
+static ed_dist edit_distance_lev_bp(const ed_elem *src, ed_size slen,
+				    const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t stackmem[ED_BP_MEM(ED_STACK_BP_WORDS)];
+	uint64_t *peq = ed_bp_init(src, slen, tgt, tlen, stackmem);
+	size_t words = ED_BP_WORDS(slen);
+	uint64_t *vp = peq + (UCHAR_MAX + 1) * words;
+	uint64_t *vn = vp + words;
+	uint64_t last = (uint64_t)1 << ((slen - 1) % 64);
+	long dist = slen;
+
+	if (words == 1) {
+		dist = ed_bp_lev1(peq, slen, tgt, tlen);
+	} else {
+		for (size_t w = 0; w < words; ++w) {
+			vp[w] = ~(uint64_t)0;
+			vn[w] = 0;
+		}
+
+		for (ed_size j = 0; j < tlen; ++j) {
+			const uint64_t *eqs = peq + (unsigned char)tgt[j] * words;
+			/* Distance along row 0 increases by one per column. */
+			int hin = 1;
+
+			for (size_t w = 0; w < words; ++w) {
+				uint64_t eq = eqs[w], pv = vp[w], mv = vn[w];
+				uint64_t xv = eq | mv;
+				uint64_t hbit = w == words - 1 ?
+				    last : (uint64_t)1 << 63;
+				uint64_t xh, ph, mh;
+				int hout;
+
+				/* An incoming -1 acts like a match on row 0. */
+				eq |= (uint64_t)(hin < 0);
+				xh = (((eq & pv) + pv) ^ pv) | eq;
+				ph = mv | ~(xh | pv);
+				mh = pv & xh;
+
+				hout = ((ph & hbit) != 0) - ((mh & hbit) != 0);
+				ph = (ph << 1) | (uint64_t)(hin > 0);
+				mh = (mh << 1) | (uint64_t)(hin < 0);
+				vp[w] = mh | ~(xv | ph);
+				vn[w] = ph & xv;
+				hin = hout;
+			}
+			dist += hin;
+		}
+	}
+
+	if (peq != stackmem) {
+		free(peq);
+	}
+	return (ed_dist)dist;
+}
+#endif
+
 ed_dist edit_distance_lev(const ed_elem *src, ed_size slen,
 			  const ed_elem *tgt, ed_size tlen)
 {
+#ifdef ED_BIT_PARALLEL
+	if (ED_BP_USABLE()) {
+		return edit_distance_lev_bp(src, slen, tgt, tlen);
+	}
+#endif
+
 	/* Optimization: Avoid malloc when row of distance matrix can fit on
 	 * the stack.
 	 */
@@ -10,9 +10,34 @@
 #include "edit_distance-params.h"
 #include "edit_distance-private.h"
 
+#if defined(ED_BIT_PARALLEL) && defined(ED_TRA_COST_CONST)
+/**
+ * Calculates Restricted Damerau-Levenshtein distance using the bit-vector
+ * algorithm of Hyyrö @cite Hyyro03 for sources of up to 64 elements.
+ */
+static ed_dist edit_distance_rdl_bp(const ed_elem *src, ed_size slen,
+				    const ed_elem *tgt, ed_size tlen)
+{
+	uint64_t stackmem[ED_BP_MEM(ED_STACK_BP_WORDS)];
+	uint64_t *peq = ed_bp_init(src, slen, tgt, tlen, stackmem);
+	ed_dist dist = ed_bp_rdl1(peq, slen, tgt, tlen);
+
+	if (peq != stackmem) {
+		free(peq);
+	}
+	return dist;
+}
+#endif
+
 ed_dist edit_distance_rdl(const ed_elem *src, ed_size slen,
 			  const ed_elem *tgt, ed_size tlen)
 {
+#if defined(ED_BIT_PARALLEL) && defined(ED_TRA_COST_CONST)
+	if (ED_BP_USABLE() && slen <= 64) {
+		return edit_distance_rdl_bp(src, slen, tgt, tlen);
+	}
+#endif
+
 	/* Optimization: Avoid malloc when required rows of distance matrix can
 	 * fit on the stack.
 	 */
@@ -0,0 +1,115 @@
+/** @file
+ * Runnable tests comparing the bit-parallel algorithms of the edit_distance
+ * module with the full distance matrix.
+ *
+ * MIT license - see LICENSE file for details
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <ccan/tap/tap.h>
+
+#include <ccan/edit_distance/edit_distance.c>
+#include <ccan/edit_distance/edit_distance_dl.c>
+#include <ccan/edit_distance/edit_distance_lcs.c>
+#include <ccan/edit_distance/edit_distance_lev.c>
+#include <ccan/edit_distance/edit_distance_rdl.c>
+
+#define MAXLEN 300
+
+/** Full-matrix distance: substitution and transposition costs of @p sub and
+ * @p tra (0 to disallow, giving LCS or Levenshtein). */
+static unsigned int ref_distance(const char *s, unsigned int slen,
+				 const char *t, unsigned int tlen,
+				 unsigned int sub, unsigned int tra)
+{
+	static unsigned int d[MAXLEN + 1][MAXLEN + 1];
+
+	for (unsigned int i = 0; i <= slen; ++i) {
+		d[i][0] = i;
+	}
+	for (unsigned int j = 0; j <= tlen; ++j) {
+		d[0][j] = j;
+	}
+	for (unsigned int i = 1; i <= slen; ++i) {
+		for (unsigned int j = 1; j <= tlen; ++j) {
+			unsigned int best = ED_MIN2(d[i - 1][j], d[i][j - 1]) + 1;
+
+			if (s[i - 1] == t[j - 1]) {
+				best = ED_MIN2(best, d[i - 1][j - 1]);
+			} else if (sub) {
+				best = ED_MIN2(best, d[i - 1][j - 1] + sub);
+			}
+			if (tra && i > 1 && j > 1 && s[i - 1] == t[j - 2] &&
+			    s[i - 2] == t[j - 1]) {
+				best = ED_MIN2(best, d[i - 2][j - 2] + tra);
+			}
+			d[i][j] = best;
+		}
+	}
+	return d[slen][tlen];
+}
+
+static void random_string(char *s, unsigned int len, unsigned int alphabet)
+{
+	for (unsigned int i = 0; i < len; ++i) {
+		/* Include bytes >= 128, which are negative if char is signed. */
+		s[i] = (char)(250 + random() % alphabet);
+	}
+}
+
+static bool check(enum ed_measure measure, unsigned int maxlen,
+		  unsigned int alphabet, unsigned int runs)
+{
+	char s[MAXLEN], t[MAXLEN];
+
+	for (unsigned int r = 0; r < runs; ++r) {
+		unsigned int slen = random() % (maxlen + 1);
+		unsigned int tlen = random() % (maxlen + 1);
+		unsigned int expect;
+
+		random_string(s, slen, alphabet);
+		random_string(t, tlen, alphabet);
+		switch (measure) {
+		case EDIT_DISTANCE_LCS:
+			expect = ref_distance(s, slen, t, tlen, 0, 0);
+			break;
+		case EDIT_DISTANCE_LEV:
+			expect = ref_distance(s, slen, t, tlen, 1, 0);
+			break;
+		default:
+			expect = ref_distance(s, slen, t, tlen, 1, 1);
+			break;
+		}
+		if (edit_distance(s, slen, t, tlen, measure) != expect) {
+			diag("%u vs %u elements: got %u, expected %u",
+			     slen, tlen,
+			     edit_distance(s, slen, t, tlen, measure), expect);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	plan_tests(9);
+
+	/* One word. */
+	ok1(check(EDIT_DISTANCE_LCS, 64, 4, 20000));
+	ok1(check(EDIT_DISTANCE_LEV, 64, 4, 20000));
+	ok1(check(EDIT_DISTANCE_RDL, 64, 3, 20000));
+
+	/* Several words, with carries between them. */
+	ok1(check(EDIT_DISTANCE_LCS, MAXLEN, 3, 1000));
+	ok1(check(EDIT_DISTANCE_LEV, MAXLEN, 3, 1000));
+	ok1(check(EDIT_DISTANCE_LEV, MAXLEN, 20, 1000));
+
+	/* Longer than ED_STACK_BP_WORDS words, and RDL's fallback. */
+	ok1(check(EDIT_DISTANCE_LCS, MAXLEN, 2, 200));
+	ok1(check(EDIT_DISTANCE_LEV, MAXLEN, 2, 200));
+	ok1(check(EDIT_DISTANCE_RDL, MAXLEN, 2, 200));
+
+	return exit_status();
+}
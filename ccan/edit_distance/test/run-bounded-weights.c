@@ -0,0 +1,79 @@
+/** @file
+ * Runnable tests comparing edit_distance_bounded() with edit_distance() using
+ * custom costs/weights.
+ *
+ * MIT license - see LICENSE file for details
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ccan/tap/tap.h>
+
+#define ED_DEL_COST(e) (e == 'a' ? 2 : 1)
+#define ED_INS_COST(e) (e == 'b' ? 2 : 1)
+#define ED_SUB_COST(e, f) (f == 'c' && e == 'd' ? 3 : 1)
+#define ED_TRA_COST(e, f) (e == 'e' && f == 'f' ? 3 : 1)
+
+#include <ccan/edit_distance/edit_distance.c>
+#include <ccan/edit_distance/edit_distance_bounded.c>
+#include <ccan/edit_distance/edit_distance_dl.c>
+#include <ccan/edit_distance/edit_distance_lcs.c>
+#include <ccan/edit_distance/edit_distance_lev.c>
+#include <ccan/edit_distance/edit_distance_rdl.c>
+
+#define MAXLEN 100
+
+static bool check(enum ed_measure measure, unsigned int runs)
+{
+	char s[MAXLEN], t[MAXLEN];
+
+	for (unsigned int r = 0; r < runs; ++r) {
+		unsigned int slen = random() % (MAXLEN + 1);
+		unsigned int tlen = slen, max = random() % 12;
+		unsigned int dist, expect;
+
+		for (unsigned int i = 0; i < slen; ++i) {
+			s[i] = 'a' + random() % 6;
+			t[i] = random() % 8 ? s[i] : 'a' + random() % 6;
+		}
+		/* Shift part of t to make some inserts and deletes. */
+		if (slen > 2 && random() % 2) {
+			unsigned int at = random() % (slen - 1);
+
+			memmove(t + at, t + at + 1, slen - at - 1);
+			--tlen;
+		}
+		expect = edit_distance(s, slen, t, tlen, measure);
+		if (expect > max) {
+			expect = max + 1;
+		}
+		dist = edit_distance_bounded(s, slen, t, tlen, measure, max);
+		if (dist != expect) {
+			diag("%u vs %u elements, max %u: got %u, expected %u",
+			     slen, tlen, max, dist, expect);
+			return false;
+		}
+		dist = edit_distance_bounded(t, tlen, s, slen, measure, max);
+		expect = edit_distance(t, tlen, s, slen, measure);
+		if (dist != (expect > max ? max + 1 : expect)) {
+			diag("%u vs %u elements, max %u: got %u, expected %u",
+			     tlen, slen, max, dist, expect);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	plan_tests(4);
+
+	ok1(check(EDIT_DISTANCE_LCS, 5000));
+	ok1(check(EDIT_DISTANCE_LEV, 5000));
+	ok1(check(EDIT_DISTANCE_RDL, 5000));
+	ok1(check(EDIT_DISTANCE_DL, 1000));
+
+	return exit_status();
+}
@@ -0,0 +1,158 @@
+/** @file
+ * Runnable tests comparing the bounded edit distance functions with
+ * edit_distance().
+ *
+ * MIT license - see LICENSE file for details
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ccan/array_size/array_size.h>
+#include <ccan/tap/tap.h>
+
+#include <ccan/edit_distance/edit_distance.c>
+#include <ccan/edit_distance/edit_distance_bounded.c>
+#include <ccan/edit_distance/edit_distance_dl.c>
+#include <ccan/edit_distance/edit_distance_lcs.c>
+#include <ccan/edit_distance/edit_distance_lev.c>
+#include <ccan/edit_distance/edit_distance_rdl.c>
+
+#define MAXLEN 300
+
+/** Makes @p t from @p s with about @p edits random edits, including
+ * transpositions. */
+static unsigned int mutate(char *t, const char *s, unsigned int slen,
+			   unsigned int edits)
+{
+	unsigned int i = 0, tlen = 0;
+
+	while (i < slen && tlen < MAXLEN) {
+		if (random() % (slen + 1) >= edits) {
+			t[tlen++] = s[i++];
+			continue;
+		}
+		switch (random() % 4) {
+		case 0:		/* Insert */
+			t[tlen++] = 'a' + random() % 4;
+			break;
+		case 1:		/* Delete */
+			++i;
+			break;
+		case 2:		/* Substitute */
+			t[tlen++] = 'a' + random() % 4;
+			++i;
+			break;
+		default:	/* Transpose */
+			if (i + 1 < slen && tlen + 1 < MAXLEN) {
+				t[tlen++] = s[i + 1];
+				t[tlen++] = s[i];
+				i += 2;
+			}
+			break;
+		}
+	}
+	return tlen;
+}
+
+static bool check(enum ed_measure measure, unsigned int maxlen,
+		  unsigned int edits, unsigned int runs)
+{
+	char s[MAXLEN], t[MAXLEN];
+
+	for (unsigned int r = 0; r < runs; ++r) {
+		unsigned int slen = random() % (maxlen + 1);
+		unsigned int tlen, max = random() % (2 * edits + 2);
+		unsigned int dist, expect;
+
+		for (unsigned int i = 0; i < slen; ++i) {
+			s[i] = 'a' + random() % 4;
+		}
+		tlen = mutate(t, s, slen, edits);
+		expect = edit_distance(s, slen, t, tlen, measure);
+		if (expect > max) {
+			expect = max + 1;
+		}
+		dist = edit_distance_bounded(s, slen, t, tlen, measure, max);
+		if (dist != expect) {
+			diag("%u vs %u elements, max %u: got %u, expected %u",
+			     slen, tlen, max, dist, expect);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool check_many(enum ed_measure measure, unsigned int maxlen,
+		       unsigned int threads)
+{
+	static char words[2000][MAXLEN];
+	const char *tgts[ARRAY_SIZE(words)];
+	ed_size tlens[ARRAY_SIZE(words)];
+	ed_dist dists[ARRAY_SIZE(words)];
+	char s[MAXLEN];
+	unsigned int slen = maxlen / 2 + random() % (maxlen / 2 + 1);
+	size_t found = 0, n;
+
+	for (unsigned int i = 0; i < slen; ++i) {
+		s[i] = 'a' + random() % 4;
+	}
+	for (size_t k = 0; k < ARRAY_SIZE(words); ++k) {
+		tgts[k] = words[k];
+		tlens[k] = mutate(words[k], s, slen, k % 8);
+	}
+
+	n = edit_distance_many(s, slen, tgts, tlens, ARRAY_SIZE(words),
+			       measure, 3, dists, threads);
+	for (size_t k = 0; k < ARRAY_SIZE(words); ++k) {
+		if (dists[k] != edit_distance_bounded(s, slen, tgts[k],
+						      tlens[k], measure, 3)) {
+			diag("word %zu: got %u", k, dists[k]);
+			return false;
+		}
+		found += dists[k] <= 3;
+	}
+	return n == found;
+}
+
+int main(void)
+{
+	const char *words[] = { "sitting", "mitten", "knitting", "" };
+	ed_size lens[] = { 7, 6, 8, 0 };
+	ed_dist dists[4];
+
+	plan_tests(17);
+
+	/* Trivial cases */
+	ok1(edit_distance_bounded("kitten", 6, "sitting", 7,
+				  EDIT_DISTANCE_LEV, 3) == 3);
+	ok1(edit_distance_bounded("kitten", 6, "sitting", 7,
+				  EDIT_DISTANCE_LEV, 2) == 3);
+	ok1(edit_distance_bounded("kitten", 6, "kitten", 6,
+				  EDIT_DISTANCE_LEV, 0) == 0);
+	ok1(edit_distance_bounded("", 0, "kitten", 6,
+				  EDIT_DISTANCE_LCS, 5) == 6);
+	ok1(edit_distance_many("kitten", 6, words, lens, 4,
+			       EDIT_DISTANCE_LEV, 3, dists, 1) == 3);
+	ok1(dists[0] == 3 && dists[1] == 1 && dists[2] == 3 && dists[3] == 4);
+
+	/* Short arrays, for the bit-parallel algorithms. */
+	ok1(check(EDIT_DISTANCE_LCS, 64, 4, 20000));
+	ok1(check(EDIT_DISTANCE_LEV, 64, 4, 20000));
+	ok1(check(EDIT_DISTANCE_RDL, 64, 4, 20000));
+	ok1(check(EDIT_DISTANCE_DL, 64, 4, 2000));
+
+	/* Long arrays with narrow bands. */
+	ok1(check(EDIT_DISTANCE_LCS, MAXLEN, 6, 2000));
+	ok1(check(EDIT_DISTANCE_LEV, MAXLEN, 6, 2000));
+	ok1(check(EDIT_DISTANCE_RDL, MAXLEN, 6, 2000));
+
+	/* One against many, with and without shared match vectors. */
+	ok1(check_many(EDIT_DISTANCE_LEV, 20, 1));
+	ok1(check_many(EDIT_DISTANCE_RDL, 20, 0));
+	ok1(check_many(EDIT_DISTANCE_LCS, MAXLEN, 0));
+	ok1(check_many(EDIT_DISTANCE_DL, 20, 0));
+
+	return exit_status();
+}
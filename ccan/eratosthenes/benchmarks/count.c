@@ -0,0 +1,57 @@
+/* Prime-counting throughput: the whole-table sieve against the segmented
+ * one, single-threaded and with all threads.
+ *
+ * Usage: count [limit [table-limit]]
+ * The table sieve needs limit/16 bytes, so it only runs up to table-limit
+ * (default 10^9); the segmented sieve runs to limit (default 10^10). */
+#include <ccan/eratosthenes/eratosthenes.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+static double secs_since(struct timeabs start)
+{
+	return time_to_nsec(time_between(time_now(), start)) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long limit = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000000UL;
+	unsigned long tlimit = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000000000UL;
+	struct eratosthenes s;
+	struct timeabs start;
+	unsigned long count, p;
+	double t;
+
+	if (tlimit > limit)
+		tlimit = limit;
+
+	start = time_now();
+	eratosthenes_init(&s);
+	eratosthenes_sieve(&s, tlimit);
+	count = 0;
+	for (p = 0; (p = eratosthenes_nextprime(&s, p)) != 0;)
+		count++;
+	eratosthenes_reset(&s);
+	t = secs_since(start);
+	printf("table sieve to %lu: %lu primes, %.2fs (%.0fM/s)\n",
+	       tlimit, count, t, tlimit / t / 1e6);
+
+	start = time_now();
+	count = eratosthenes_count(0, tlimit, 1);
+	t = secs_since(start);
+	printf("segmented to %lu, 1 thread: %lu primes, %.2fs (%.0fM/s)\n",
+	       tlimit, count, t, tlimit / t / 1e6);
+
+	start = time_now();
+	count = eratosthenes_count(0, limit, 1);
+	t = secs_since(start);
+	printf("segmented to %lu, 1 thread: %lu primes, %.2fs (%.0fM/s)\n",
+	       limit, count, t, limit / t / 1e6);
+
+	start = time_now();
+	count = eratosthenes_count(0, limit, 0);
+	t = secs_since(start);
+	printf("segmented to %lu, all threads: %lu primes, %.2fs (%.0fM/s)\n",
+	       limit, count, t, limit / t / 1e6);
+	return 0;
+}
@@ -4,6 +4,10 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define VAL_TO_BIT(v)		(((v) - 3) / 2)
 #define LIMIT_TO_NBITS(l)	((l > 2) ? ((l) - 2) / 2 : 0)
@@ -114,3 +118,330 @@ unsigned long eratosthenes_nextprime(const struct eratosthenes *s, unsigned long
 
 	return BIT_TO_VAL(i);
 }
+
+/*
+ * Segmented sieve over a 2*3*5 wheel: each byte covers 30 numbers, one
+ * bit for each of the 8 residues coprime to 30.  Segments are sized to
+ * stay in L1, and each sieving prime remembers its next multiple (and
+ * where the cofactor is on the wheel) from one segment to the next.
+ */
+#define SEGMENT_BYTES		(32 * 1024)
+#define SEGMENT_SPAN		(SEGMENT_BYTES * 30ULL)
+/* Segments per work item when counting with threads. */
+#define SEGMENTS_PER_TASK	32
+
+static const unsigned char wheel_res[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+static const unsigned char wheel_gap[8] = { 6, 4, 2, 4, 2, 4, 6, 2 };
+/* Bit for each residue mod 30 (only used for those coprime to 30). */
+static const unsigned char wheel_bit[30] = {
+	0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 3, 0,
+	0, 0, 4, 0, 5, 0, 0, 0, 6, 0, 0, 0, 0, 0, 7,
+};
+/* Index of the first residue coprime to 30 at or after each residue. */
+static const unsigned char wheel_up[30] = {
+	0, 0, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4,
+	4, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7,
+};
+
+struct eratosthenes_sieving_prime {
+	uint64_t p;
+	uint64_t next;		/* next multiple to cross off */
+	unsigned int qi;	/* wheel index of next / p */
+};
+
+static inline unsigned int weight(unsigned long w)
+{
+#if HAVE_BUILTIN_POPCOUNTL
+	return __builtin_popcountl(w);
+#else
+	unsigned int n;
+
+	for (n = 0; w; w &= w - 1)
+		n++;
+	return n;
+#endif
+}
+
+static inline unsigned int lowest_bit(unsigned int b)
+{
+#if HAVE_BUILTIN_CTZ
+	return __builtin_ctz(b);
+#else
+	unsigned int n;
+
+	for (n = 0; !(b & 1); b >>= 1)
+		n++;
+	return n;
+#endif
+}
+
+static uint64_t isqrt(uint64_t x)
+{
+	uint64_t r = x, y = x / 2 + 1;
+
+	if (x < 2)
+		return x;
+	while (y < r) {
+		r = y;
+		y = (r + x / r) / 2;
+	}
+	return r;
+}
+
+/* The sieving primes 7 <= p <= sqrt(hi - 1), from a plain sieve. */
+static struct eratosthenes_sieving_prime *sieving_primes(uint64_t hi,
+							 size_t *num)
+{
+	struct eratosthenes small;
+	struct eratosthenes_sieving_prime *sp;
+	unsigned long root = hi ? isqrt(hi - 1) : 0, p;
+	size_t n = 0;
+
+	eratosthenes_init(&small);
+	eratosthenes_sieve(&small, root + 2);
+	/* Fewer than a third of the numbers to root are prime. */
+	sp = malloc(sizeof(*sp) * (root / 3 + 1));
+	if (!sp)
+		abort();
+	for (p = eratosthenes_nextprime(&small, 6);
+	     p && p <= root;
+	     p = eratosthenes_nextprime(&small, p))
+		sp[n++].p = p;
+	eratosthenes_reset(&small);
+	*num = n;
+	return sp;
+}
+
+/* Point each prime at its first multiple p*q >= start, with q >= p and
+ * q coprime to 30 (any other multiple is crossed off by a smaller prime,
+ * or isn't on the wheel). */
+static void sieving_start(struct eratosthenes_sieving_prime *sp, size_t n,
+			  uint64_t start)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uint64_t p = sp[i].p, q = (start + p - 1) / p;
+		unsigned int qi;
+
+		if (q < p)
+			q = p;
+		qi = wheel_up[q % 30];
+		q = q - q % 30 + wheel_res[qi];
+		sp[i].qi = qi;
+		sp[i].next = p * q;
+	}
+}
+
+static void clear_outside(unsigned char *seg, size_t nbytes, uint64_t seg_lo,
+			  uint64_t lo, uint64_t hi)
+{
+	size_t i;
+
+	/* Only the ends are partial: the head below lo, the tail from hi. */
+	for (i = 0; i < nbytes; i++) {
+		uint64_t base = seg_lo + 30 * i;
+		unsigned int b;
+
+		if (base >= lo)
+			break;
+		for (b = 0; b < 8; b++)
+			if (base + wheel_res[b] < lo)
+				seg[i] &= ~(1U << b);
+	}
+	for (i = nbytes; i > 0; i--) {
+		uint64_t base = seg_lo + 30 * (i - 1);
+		unsigned int b;
+
+		if (base + 30 <= hi)
+			break;
+		for (b = 0; b < 8; b++)
+			if (base + wheel_res[b] >= hi)
+				seg[i - 1] &= ~(1U << b);
+	}
+}
+
+/* Sieve the segment starting at seg_lo (a multiple of 30), keeping only
+ * values in [lo, hi).  Returns the number of bytes used. */
+static size_t sieve_segment(unsigned char *seg, uint64_t seg_lo,
+			    uint64_t lo, uint64_t hi,
+			    struct eratosthenes_sieving_prime *sp, size_t n)
+{
+	uint64_t seg_hi = seg_lo + SEGMENT_SPAN;
+	size_t nbytes, i;
+
+	if (seg_hi > hi)
+		seg_hi = hi;
+	nbytes = (seg_hi - seg_lo + 29) / 30;
+	memset(seg, 0xff, nbytes);
+	/* 1 isn't prime, but is on the wheel. */
+	if (seg_lo == 0)
+		seg[0] &= ~1;
+
+	seg_hi = seg_lo + 30 * nbytes;
+	for (i = 0; i < n; i++) {
+		uint64_t next = sp[i].next, p = sp[i].p;
+		unsigned int qi = sp[i].qi;
+
+		while (next < seg_hi) {
+			uint64_t off = next - seg_lo;
+
+			seg[off / 30] &= ~(1U << wheel_bit[off % 30]);
+			next += p * wheel_gap[qi];
+			qi = (qi + 1) & 7;
+		}
+		sp[i].next = next;
+		sp[i].qi = qi;
+	}
+
+	if (seg_lo < lo || seg_hi > hi)
+		clear_outside(seg, nbytes, seg_lo, lo, hi);
+	return nbytes;
+}
+
+/* How many of 2, 3 and 5 are in [lo, hi). */
+static unsigned long count_small(unsigned long lo, unsigned long hi)
+{
+	static const unsigned long small[] = { 2, 3, 5 };
+	unsigned long i, count = 0;
+
+	for (i = 0; i < 3; i++)
+		if (small[i] >= lo && small[i] < hi)
+			count++;
+	return count;
+}
+
+static unsigned long count_span(const struct eratosthenes_sieving_prime *primes,
+				size_t n, uint64_t lo, uint64_t hi)
+{
+	struct eratosthenes_sieving_prime *sp;
+	unsigned char *seg;
+	uint64_t seg_lo;
+	unsigned long count = 0;
+
+	sp = malloc(sizeof(*sp) * (n ? n : 1));
+	seg = malloc(SEGMENT_BYTES);
+	if (!sp || !seg)
+		abort();
+	memcpy(sp, primes, sizeof(*sp) * n);
+
+	seg_lo = lo - lo % 30;
+	sieving_start(sp, n, seg_lo);
+	for (; seg_lo < hi; seg_lo += SEGMENT_SPAN) {
+		size_t nbytes = sieve_segment(seg, seg_lo, lo, hi, sp, n), i;
+		unsigned long w;
+
+		for (i = 0; i + sizeof(w) <= nbytes; i += sizeof(w)) {
+			memcpy(&w, seg + i, sizeof(w));
+			count += weight(w);
+		}
+		for (; i < nbytes; i++)
+			count += weight(seg[i]);
+	}
+	free(seg);
+	free(sp);
+	return count;
+}
+
+#ifdef _OPENMP
+#define ERATOSTHENES_PARALLEL_FOR \
+	_Pragma("omp parallel for schedule(dynamic) num_threads(threads) reduction(+:count)")
+#else
+#define ERATOSTHENES_PARALLEL_FOR
+#endif
+
+unsigned long eratosthenes_count(unsigned long lo, unsigned long hi,
+				 unsigned int threads)
+{
+	const uint64_t task_span = SEGMENT_SPAN * SEGMENTS_PER_TASK;
+	struct eratosthenes_sieving_prime *primes;
+	uint64_t first;
+	size_t n, ntasks, t;
+	unsigned long count;
+
+	if (lo >= hi)
+		return 0;
+
+	count = count_small(lo, hi);
+	primes = sieving_primes(hi, &n);
+
+	/* Tasks start on multiples of the task span, so only the first
+	 * and last are partial. */
+	first = lo - lo % task_span;
+	ntasks = (hi - first + task_span - 1) / task_span;
+#ifdef _OPENMP
+	if (threads == 0)
+		threads = omp_get_max_threads();
+	if (threads > ntasks)
+		threads = ntasks;
+#else
+	(void)threads;
+#endif
+
+	ERATOSTHENES_PARALLEL_FOR
+	for (t = 0; t < ntasks; t++) {
+		uint64_t tlo = first + t * task_span, thi = tlo + task_span;
+
+		count += count_span(primes, n, tlo < lo ? lo : tlo,
+				    thi > hi ? hi : thi);
+	}
+	free(primes);
+	return count;
+}
+
+void eratosthenes_range_init(struct eratosthenes_range *r,
+			     unsigned long lo, unsigned long hi)
+{
+	r->lo = lo;
+	r->hi = hi > lo ? hi : lo;
+	r->small = 0;
+	r->primes = sieving_primes(r->hi, &r->nprimes);
+	r->seg = malloc(SEGMENT_BYTES);
+	if (!r->seg)
+		abort();
+	/* Nothing sieved yet: the first call to next starts here. */
+	r->seg_lo = lo - lo % 30;
+	r->nbytes = 0;
+	r->pos = 0;
+	r->bits = 0;
+	sieving_start(r->primes, r->nprimes, r->seg_lo);
+}
+
+unsigned long eratosthenes_range_next(struct eratosthenes_range *r)
+{
+	static const unsigned long small[] = { 2, 3, 5 };
+	unsigned int b;
+
+	while (r->small < 3) {
+		unsigned long p = small[r->small++];
+
+		if (p >= r->lo && p < r->hi)
+			return p;
+	}
+
+	while (!r->bits) {
+		if (r->pos + 1 < r->nbytes) {
+			r->bits = r->seg[++r->pos];
+			continue;
+		}
+		/* Next segment (the first time, this is the first one). */
+		if (r->nbytes)
+			r->seg_lo += SEGMENT_SPAN;
+		if (r->seg_lo >= r->hi)
+			return 0;
+		r->nbytes = sieve_segment(r->seg, r->seg_lo, r->lo, r->hi,
+					  r->primes, r->nprimes);
+		r->pos = 0;
+		r->bits = r->seg[0];
+	}
+
+	b = lowest_bit(r->bits);
+	r->bits &= r->bits - 1;
+	return r->seg_lo + 30 * r->pos + wheel_res[b];
+}
+
+void eratosthenes_range_done(struct eratosthenes_range *r)
+{
+	free(r->primes);
+	free(r->seg);
+}
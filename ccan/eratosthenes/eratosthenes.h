@@ -5,6 +5,8 @@
 #include "config.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include <ccan/bitmap/bitmap.h>
 
@@ -24,4 +26,77 @@ bool eratosthenes_isprime(const struct eratosthenes *s, unsigned long n);
 unsigned long eratosthenes_nextprime(const struct eratosthenes *s,
 				     unsigned long n);
 
+/**
+ * eratosthenes_count - count the primes in [lo, hi)
+ * @lo: the first number to consider
+ * @hi: one past the last number to consider
+ * @threads: the most threads to use, or 0 for the OpenMP default.
+ *
+ * This uses a segmented sieve, so it only needs memory proportional to
+ * sqrt(hi) (per thread), rather than a table up to @hi.  Segments are
+ * divided between threads when compiled with OpenMP.
+ *
+ * Example:
+ *	// There are 50847534 primes below 10^9.
+ *	assert(eratosthenes_count(0, 1000000000, 0) == 50847534);
+ */
+unsigned long eratosthenes_count(unsigned long lo, unsigned long hi,
+				 unsigned int threads);
+
+struct eratosthenes_sieving_prime;
+
+/**
+ * struct eratosthenes_range - iterator over the primes in a range
+ *
+ * Unlike struct eratosthenes, this never holds more than one segment
+ * of the sieve (and the primes up to sqrt(hi) to sieve it with), so it
+ * can walk ranges far beyond what a whole table would fit in.
+ */
+struct eratosthenes_range {
+	unsigned long lo, hi;
+	/* The current segment, and where we are in it. */
+	uint64_t seg_lo;
+	unsigned char *seg;
+	size_t nbytes, pos;
+	unsigned int bits;
+	/* How many of the primes below 7 we've been through. */
+	unsigned int small;
+	struct eratosthenes_sieving_prime *primes;
+	size_t nprimes;
+};
+
+/**
+ * eratosthenes_range_init - start iterating over the primes in [lo, hi)
+ * @r: the iterator
+ * @lo: the first number to consider
+ * @hi: one past the last number to consider
+ *
+ * Call eratosthenes_range_done() once finished with @r.
+ *
+ * Example:
+ *	struct eratosthenes_range r;
+ *	unsigned long p;
+ *
+ *	eratosthenes_range_init(&r, 1000000000000UL, 1000000001000UL);
+ *	while ((p = eratosthenes_range_next(&r)) != 0)
+ *		printf("%lu\n", p);
+ *	eratosthenes_range_done(&r);
+ */
+void eratosthenes_range_init(struct eratosthenes_range *r,
+			     unsigned long lo, unsigned long hi);
+
+/**
+ * eratosthenes_range_next - the next prime in the range
+ * @r: the iterator
+ *
+ * Returns the primes in [lo, hi) in increasing order, then 0.
+ */
+unsigned long eratosthenes_range_next(struct eratosthenes_range *r);
+
+/**
+ * eratosthenes_range_done - free an iterator's resources
+ * @r: the iterator
+ */
+void eratosthenes_range_done(struct eratosthenes_range *r);
+
 #endif /* CCAN_ERATOSTHENES_H_ */
@@ -0,0 +1,62 @@
+#include <ccan/eratosthenes/eratosthenes.h>
+#include <ccan/tap/tap.h>
+
+#include <ccan/eratosthenes/eratosthenes.c>
+
+/* A little over two segments, so ranges can straddle them. */
+#define LIMIT	(2 * SEGMENT_SPAN + 1000)
+
+static struct eratosthenes table;
+
+static bool range_matches(unsigned long lo, unsigned long hi)
+{
+	struct eratosthenes_range r;
+	unsigned long n, p, count = 0;
+	bool ok = true;
+
+	eratosthenes_range_init(&r, lo, hi);
+	p = eratosthenes_range_next(&r);
+	for (n = lo; n < hi; n++) {
+		if (!eratosthenes_isprime(&table, n))
+			continue;
+		ok &= (p == n);
+		p = eratosthenes_range_next(&r);
+		count++;
+	}
+	ok &= (p == 0);
+	/* And it stays finished. */
+	ok &= (eratosthenes_range_next(&r) == 0);
+	eratosthenes_range_done(&r);
+
+	ok &= (eratosthenes_count(lo, hi, 1) == count);
+	ok &= (eratosthenes_count(lo, hi, 3) == count);
+	return ok;
+}
+
+int main(void)
+{
+	static const unsigned long bounds[] = {
+		0, 1, 2, 3, 5, 6, 7, 29, 30, 31, 49, 1000,
+		SEGMENT_SPAN - 1, SEGMENT_SPAN, SEGMENT_SPAN + 1,
+		2 * SEGMENT_SPAN + 7, LIMIT,
+	};
+	const size_t nb = sizeof(bounds) / sizeof(bounds[0]);
+	size_t i, j;
+	bool ok = true;
+
+	plan_tests(3);
+
+	eratosthenes_init(&table);
+	eratosthenes_sieve(&table, LIMIT + 1);
+	for (i = 0; i < nb; i++)
+		for (j = i; j < nb; j++)
+			ok &= range_matches(bounds[i], bounds[j]);
+	ok1(ok);
+	eratosthenes_reset(&table);
+
+	/* Known values of pi(x), with enough tasks to spread over threads. */
+	ok1(eratosthenes_count(0, 100000000, 0) == 5761455);
+	ok1(eratosthenes_count(100000000, 200000000, 0) == 11078937 - 5761455);
+
+	return exit_status();
+}
@@ -0,0 +1,75 @@
+/* SMHasher-style avalanche test: flip each bit of a random key, and
+ * count how often each output bit changes.  Ideally that's 50%; we
+ * report the worst deviation from that over all (input, output) pairs. */
+#include <ccan/hash/hash.c>
+#include <stdio.h>
+
+static uint64_t do_hash64(const void *p, size_t len)
+{
+	return hash64_any(p, len, 0);
+}
+
+static uint64_t do_hashw64(const void *p, size_t len)
+{
+	return hashw64_any(p, len, 0);
+}
+
+static uint64_t rng_state = 1;
+
+static uint64_t rng(void)
+{
+	return hashw_splitmix64(&rng_state);
+}
+
+static double avalanche(uint64_t (*fn)(const void *, size_t),
+			size_t len, unsigned int trials)
+{
+	unsigned int (*count)[64] = calloc(len * 8, sizeof(*count));
+	unsigned char key[256];
+	unsigned int t, i, o;
+	double worst = 0;
+
+	for (t = 0; t < trials; t++) {
+		uint64_t h;
+
+		for (i = 0; i < len; i++)
+			key[i] = rng();
+		h = fn(key, len);
+		for (i = 0; i < len * 8; i++) {
+			uint64_t diff;
+
+			key[i / 8] ^= 1 << (i % 8);
+			diff = fn(key, len) ^ h;
+			key[i / 8] ^= 1 << (i % 8);
+			for (o = 0; o < 64; o++)
+				count[i][o] += (diff >> o) & 1;
+		}
+	}
+
+	for (i = 0; i < len * 8; i++) {
+		for (o = 0; o < 64; o++) {
+			double bias = (double)count[i][o] / trials * 2 - 1;
+			if (bias < 0)
+				bias = -bias;
+			if (bias > worst)
+				worst = bias;
+		}
+	}
+	free(count);
+	return worst;
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t lens[] = { 1, 4, 8, 12, 16, 24, 32, 64, 128, 256 };
+	unsigned int trials = argv[1] ? atoi(argv[1]) : 100000;
+	unsigned int i;
+
+	printf("Worst-case bias over %u trials (lower is better):\n", trials);
+	printf("%-8s %10s %10s\n", "bytes", "hash64", "hashw64");
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+		printf("%-8zu %9.2f%% %9.2f%%\n", lens[i],
+		       avalanche(do_hash64, lens[i], trials) * 100,
+		       avalanche(do_hashw64, lens[i], trials) * 100);
+	return 0;
+}
@@ -0,0 +1,77 @@
+/* Compare one-at-a-time hashing of fixed-size keys with the batched
+ * versions. */
+#include <ccan/hash/hash.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+#define NUM_KEYS 4096
+
+static double nsec_per_key(struct timeabs start, size_t keys)
+{
+	return (double)time_to_nsec(time_between(time_now(), start)) / keys;
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t keylens[] = { 4, 8, 16, 32 };
+	size_t rounds = argv[1] ? atol(argv[1]) : 4000;
+	unsigned char *keys = malloc(NUM_KEYS * 32);
+	uint32_t h32[NUM_KEYS];
+	uint64_t h64[NUM_KEYS];
+	uint64_t total = 0;
+	struct timeabs start;
+	size_t i, r, k;
+
+	for (i = 0; i < NUM_KEYS * 32; i++)
+		keys[i] = i * 7 + (i >> 8);
+
+	printf("%-26s %9s %10s\n", "", "single", "batched");
+	for (k = 0; k < sizeof(keylens) / sizeof(keylens[0]); k++) {
+		size_t len = keylens[k];
+		double single, batched;
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			for (i = 0; i < NUM_KEYS; i++)
+				h64[i] = hash64_any(keys + i * len, len, r);
+		single = nsec_per_key(start, rounds * NUM_KEYS);
+		total += h64[r % NUM_KEYS];
+
+		start = time_now();
+		for (r = 0; r < rounds; r++)
+			hash64_many(keys, len, NUM_KEYS, r, h64);
+		batched = nsec_per_key(start, rounds * NUM_KEYS);
+		total += h64[r % NUM_KEYS];
+
+		printf("hash64_many %2zu bytes:     %7.2fns  %7.2fns\n",
+		       len, single, batched);
+	}
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM_KEYS; i++)
+			h32[i] = hash_u32((uint32_t *)keys + i, 1, r);
+	printf("hash_u32_many 1 word:     %7.2fns", nsec_per_key(start, rounds * NUM_KEYS));
+	total += h32[r % NUM_KEYS];
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		hash_u32_many((uint32_t *)keys, 1, NUM_KEYS, r, h32);
+	printf("  %7.2fns\n", nsec_per_key(start, rounds * NUM_KEYS));
+	total += h32[r % NUM_KEYS];
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM_KEYS; i++)
+			h64[i] = hash64_stable_64((uint64_t *)keys + i, 1, r);
+	printf("hash64_stable_64_many:    %7.2fns", nsec_per_key(start, rounds * NUM_KEYS));
+	total += h64[r % NUM_KEYS];
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		hash64_stable_64_many((uint64_t *)keys, NUM_KEYS, r, h64);
+	printf("  %7.2fns\n", nsec_per_key(start, rounds * NUM_KEYS));
+	total += h64[r % NUM_KEYS];
+
+	printf("total = %llx\n", (unsigned long long)total);
+	free(keys);
+	return 0;
+}
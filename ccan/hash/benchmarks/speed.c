@@ -0,0 +1,82 @@
+/* Compare the lookup3 hashes against hashw across key lengths. */
+#include <ccan/hash/hash.c>
+#include <ccan/time/time.h>
+#include <stdio.h>
+
+static uint64_t do_hash(const void *p, size_t len, uint64_t base)
+{
+	return hash_any(p, len, base);
+}
+
+static uint64_t do_hash64(const void *p, size_t len, uint64_t base)
+{
+	return hash64_any(p, len, base);
+}
+
+static uint64_t do_hashw(const void *p, size_t len, uint64_t base)
+{
+	return hashw_any(p, len, base);
+}
+
+static uint64_t do_hashw64(const void *p, size_t len, uint64_t base)
+{
+	return hashw64_any(p, len, base);
+}
+
+static struct hashw_seed seed;
+
+static uint64_t do_hashw64_seeded(const void *p, size_t len, uint64_t base)
+{
+	return hashw64_seeded(p, len, &seed) + base;
+}
+
+static const struct {
+	const char *name;
+	uint64_t (*fn)(const void *, size_t, uint64_t);
+} fns[] = {
+	{ "hash", do_hash },
+	{ "hash64", do_hash64 },
+	{ "hashw", do_hashw },
+	{ "hashw64", do_hashw64 },
+	{ "hashw64_seeded", do_hashw64_seeded },
+};
+
+int main(int argc, char *argv[])
+{
+	static const size_t lens[] = { 3, 8, 16, 24, 32, 64, 256, 4096, 65536 };
+	size_t total = argv[1] ? atol(argv[1]) : 256 * 1024 * 1024;
+	unsigned char *buf = malloc(65536);
+	unsigned int i, f;
+	uint64_t h = 0;
+
+	hashw_seed_init(&seed, 0x5eed);
+	for (i = 0; i < 65536; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	printf("%-8s", "bytes");
+	for (f = 0; f < sizeof(fns) / sizeof(fns[0]); f++)
+		printf(" %15s", fns[f].name);
+	printf("\n");
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		/* Small keys are dominated by per-call cost, so use fewer. */
+		size_t j, runs = total / (lens[i] < 64 ? 64 : lens[i]);
+
+		printf("%-8zu", lens[i]);
+		for (f = 0; f < sizeof(fns) / sizeof(fns[0]); f++) {
+			struct timeabs start = time_now();
+			struct timerel elapsed;
+
+			/* Feed the result back in, so calls can't overlap. */
+			for (j = 0; j < runs; j++)
+				h = fns[f].fn(buf + (h & 7), lens[i], h);
+			elapsed = time_between(time_now(), start);
+			printf(" %10.0f MB/s", (double)lens[i] * runs
+			       / time_to_usec(elapsed));
+		}
+		printf("\n");
+	}
+	printf("h = %llx\n", (unsigned long long)h);
+	free(buf);
+	return 0;
+}
@@ -68,6 +68,8 @@ on 1 byte), but shoehorning those bytes into integers efficiently is messy.
 #endif /* old hash.c headers. */
 
 #include "hash.h"
+#include <stdbool.h>
+#include <string.h>
 
 #if HAVE_LITTLE_ENDIAN
 #define HASH_LITTLE_ENDIAN 1
@@ -711,6 +713,391 @@ uint64_t hash64_any(const void *key, size_t length, uint64_t base)
 	return ((uint64_t)b32 << 32) | lower;
 }
 
+/*
+ * Batched hashing of fixed-size keys.
+ *
+ * lookup3 is all 32-bit adds, xors and rotates, so we can run it on
+ * several keys at once, one per vector lane.  The mix() and final()
+ * macros work unchanged on GCC vector types, so the same code becomes
+ * SSE2 or NEON by default, and AVX2 when we have it at runtime.
+ *
+ * Every key of a batch has the same length, so every lane takes the same
+ * path through the algorithm.  We only vectorize whole 32-bit words: on
+ * little-endian machines that's exactly what hashlittle() computes.
+ */
+#if defined(__GNUC__)
+#define HASH_VECTOR 1
+#define HASH_LANES 8
+typedef uint32_t hash_vec __attribute__((vector_size(HASH_LANES * 4)));
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HASH_AVX2 1
+#endif
+
+/* Word @j of each of the HASH_LANES keys, which are @stride bytes apart. */
+#define HASH_VEC_LOAD(keys, stride, j)					\
+	({								\
+		hash_vec v_;						\
+		unsigned int l_;					\
+		for (l_ = 0; l_ < HASH_LANES; l_++)			\
+			memcpy((uint32_t *)&v_ + l_,			\
+			       (keys) + l_ * (stride) + (j) * 4, 4);	\
+		v_;							\
+	})
+
+/* The body of hash_u32(), on HASH_LANES keys of @words words each.
+ * Writes c to @out32 if non-NULL, and (b << 32) | c to @out64 if non-NULL. */
+#define DEFINE_LOOKUP3_MANY(NAME, ATTR)					\
+ATTR static void NAME(const unsigned char *keys, size_t stride,		\
+		      size_t words, size_t n, uint32_t init,		\
+		      uint32_t *out32, uint64_t *out64)			\
+{									\
+	for (; n >= HASH_LANES; n -= HASH_LANES) {			\
+		hash_vec a, b, c;					\
+		size_t j = 0, left = words;				\
+		unsigned int l;						\
+									\
+		a = b = c = (hash_vec){ 0 } + init;			\
+		while (left > 3) {					\
+			a += HASH_VEC_LOAD(keys, stride, j);		\
+			b += HASH_VEC_LOAD(keys, stride, j + 1);	\
+			c += HASH_VEC_LOAD(keys, stride, j + 2);	\
+			mix(a,b,c);					\
+			left -= 3;					\
+			j += 3;						\
+		}							\
+		switch (left) {						\
+		case 3: c += HASH_VEC_LOAD(keys, stride, j + 2);	\
+		case 2: b += HASH_VEC_LOAD(keys, stride, j + 1);	\
+		case 1: a += HASH_VEC_LOAD(keys, stride, j);		\
+			final(a,b,c);					\
+		case 0:							\
+			break;						\
+		}							\
+		if (out32) {						\
+			memcpy(out32, &c, sizeof(c));			\
+			out32 += HASH_LANES;				\
+		}							\
+		if (out64) {						\
+			for (l = 0; l < HASH_LANES; l++)		\
+				out64[l] = ((uint64_t)b[l] << 32) | c[l]; \
+			out64 += HASH_LANES;				\
+		}							\
+		keys += HASH_LANES * stride;				\
+	}								\
+}
+
+DEFINE_LOOKUP3_MANY(lookup3_many_vec, )
+
+#ifdef HASH_AVX2
+DEFINE_LOOKUP3_MANY(lookup3_many_avx2, __attribute__((target("avx2"))))
+
+static void lookup3_many_dispatch(const unsigned char *keys, size_t stride,
+				  size_t words, size_t n, uint32_t init,
+				  uint32_t *out32, uint64_t *out64);
+
+typedef void (*lookup3_many_fn)(const unsigned char *, size_t, size_t, size_t,
+				uint32_t, uint32_t *, uint64_t *);
+
+/* Replaced by the best version on first use.  Threads may race to do so,
+ * but they all store the same pointer. */
+static lookup3_many_fn lookup3_many_impl = lookup3_many_dispatch;
+
+static void lookup3_many_dispatch(const unsigned char *keys, size_t stride,
+				  size_t words, size_t n, uint32_t init,
+				  uint32_t *out32, uint64_t *out64)
+{
+	lookup3_many_fn impl;
+
+	/* Not ccan/cpuid: it is BSD-MIT, and this module CC0. */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		impl = lookup3_many_avx2;
+	else
+		impl = lookup3_many_vec;
+	__atomic_store_n(&lookup3_many_impl, impl, __ATOMIC_RELAXED);
+	impl(keys, stride, words, n, init, out32, out64);
+}
+
+static void lookup3_many(const unsigned char *keys, size_t stride,
+			 size_t words, size_t n, uint32_t init,
+			 uint32_t *out32, uint64_t *out64)
+{
+	lookup3_many_fn impl = __atomic_load_n(&lookup3_many_impl,
+					       __ATOMIC_RELAXED);
+
+	impl(keys, stride, words, n, init, out32, out64);
+}
+#else
+#define lookup3_many lookup3_many_vec
+#endif
+#endif /* __GNUC__ */
+
+void hash_u32_many(const uint32_t *keys, size_t key_words, size_t n,
+		   uint32_t base, uint32_t *hashes)
+{
+	size_t i = 0;
+
+#ifdef HASH_VECTOR
+	i = n - n % HASH_LANES;
+	lookup3_many((const unsigned char *)keys, key_words * 4, key_words, i,
+		     0xdeadbeef + ((uint32_t)key_words << 2) + base,
+		     hashes, NULL);
+#endif
+	for (; i < n; i++)
+		hashes[i] = hash_u32(keys + i * key_words, key_words, base);
+}
+
+void hash_many(const void *keys, size_t keylen, size_t n,
+	       uint32_t base, uint32_t *hashes)
+{
+	size_t i = 0;
+
+#ifdef HASH_VECTOR
+	if (HASH_LITTLE_ENDIAN && keylen && keylen % 4 == 0) {
+		i = n - n % HASH_LANES;
+		lookup3_many(keys, keylen, keylen / 4, i,
+			     0xdeadbeef + (uint32_t)keylen + base,
+			     hashes, NULL);
+	}
+#endif
+	for (; i < n; i++)
+		hashes[i] = hash_any((const char *)keys + i * keylen,
+				     keylen, base);
+}
+
+void hash64_many(const void *keys, size_t keylen, size_t n,
+		 uint64_t base, uint64_t *hashes)
+{
+	size_t i = 0;
+
+#ifdef HASH_VECTOR
+	if (HASH_LITTLE_ENDIAN && keylen && keylen % 4 == 0) {
+		uint32_t b32 = base + (base >> 32);
+
+		i = n - n % HASH_LANES;
+		lookup3_many(keys, keylen, keylen / 4, i,
+			     0xdeadbeef + (uint32_t)keylen + b32,
+			     NULL, hashes);
+	}
+#endif
+	for (; i < n; i++)
+		hashes[i] = hash64_any((const char *)keys + i * keylen,
+				       keylen, base);
+}
+
+void hash64_stable_64_many(const uint64_t *keys, size_t n,
+			   uint64_t base, uint64_t *hashes)
+{
+	size_t i = 0;
+
+#ifdef HASH_VECTOR
+	/* Each key is two words, low half first. */
+	if (HASH_LITTLE_ENDIAN) {
+		i = n - n % HASH_LANES;
+		lookup3_many((const unsigned char *)keys, 8, 2, i,
+			     0xdeadbeef + 8 + (base >> 32) + base,
+			     NULL, hashes);
+	}
+#endif
+	for (; i < n; i++)
+		hashes[i] = hash64_stable_64(keys + i, 1, base);
+}
+
+/*
+ * hashw: a wide-multiply hash in the style of Wang Yi's wyhash.
+ *
+ * Each step folds 128 bits of input through a 64x64->128 bit multiply,
+ * then xors the halves of the product together.  On anything with a
+ * fast multiplier this is several times quicker than lookup3, and it
+ * passes the usual avalanche tests.  Short keys (<= 16 bytes) are read
+ * with overlapping loads so there is no per-byte tail loop at all.
+ */
+static const uint64_t hashw_default_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+static inline void hashw_mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 r = (unsigned __int128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+static inline uint64_t hashw_mix(uint64_t a, uint64_t b)
+{
+	hashw_mum(&a, &b);
+	return a ^ b;
+}
+
+static inline uint64_t hashw_swab64(uint64_t v)
+{
+	v = ((v & 0x00ff00ff00ff00ffULL) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffULL);
+	v = ((v & 0x0000ffff0000ffffULL) << 16) | ((v >> 16) & 0x0000ffff0000ffffULL);
+	return (v << 32) | (v >> 32);
+}
+
+/* Loads are native-endian for the internal hash, little-endian for the
+ * stable one.  On little-endian machines they're the same thing. */
+static inline uint64_t hashw_r8(const uint8_t *p, bool stable)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	if (HASH_BIG_ENDIAN && stable)
+		v = hashw_swab64(v);
+	return v;
+}
+
+static inline uint64_t hashw_r4(const uint8_t *p, bool stable)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	if (HASH_BIG_ENDIAN && stable)
+		v = (uint32_t)(hashw_swab64(v) >> 32);
+	return v;
+}
+
+static inline uint64_t hashw_r3(const uint8_t *p, size_t len)
+{
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8)
+		| p[len - 1];
+}
+
+static inline uint64_t hashw_core(const void *key, size_t len, uint64_t seed,
+				  const uint64_t secret[4], bool stable)
+{
+	const uint8_t *p = key;
+	uint64_t a, b;
+
+	seed ^= hashw_mix(seed ^ secret[0], secret[1]);
+	if (len <= 16) {
+		if (len >= 4) {
+			size_t off = (len >> 3) << 2;
+			a = (hashw_r4(p, stable) << 32)
+				| hashw_r4(p + off, stable);
+			b = (hashw_r4(p + len - 4, stable) << 32)
+				| hashw_r4(p + len - 4 - off, stable);
+		} else if (len > 0) {
+			a = hashw_r3(p, len);
+			b = 0;
+		} else
+			a = b = 0;
+	} else {
+		size_t i = len;
+
+		if (i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = hashw_mix(hashw_r8(p, stable) ^ secret[1],
+						 hashw_r8(p + 8, stable) ^ seed);
+				see1 = hashw_mix(hashw_r8(p + 16, stable) ^ secret[2],
+						 hashw_r8(p + 24, stable) ^ see1);
+				see2 = hashw_mix(hashw_r8(p + 32, stable) ^ secret[3],
+						 hashw_r8(p + 40, stable) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = hashw_mix(hashw_r8(p, stable) ^ secret[1],
+					 hashw_r8(p + 8, stable) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		/* Last 16 bytes, overlapping what we've done if necessary. */
+		a = hashw_r8(p + i - 16, stable);
+		b = hashw_r8(p + i - 8, stable);
+	}
+	a ^= secret[1];
+	b ^= seed;
+	hashw_mum(&a, &b);
+	return hashw_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+static inline uint32_t hashw_fold32(uint64_t h)
+{
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+uint64_t hashw64_any(const void *key, size_t length, uint64_t base)
+{
+	return hashw_core(key, length, base, hashw_default_secret, false);
+}
+
+uint32_t hashw_any(const void *key, size_t length, uint32_t base)
+{
+	return hashw_fold32(hashw_core(key, length, base,
+				       hashw_default_secret, false));
+}
+
+uint64_t hashw64_stable_8(const void *key, size_t n, uint64_t base)
+{
+	return hashw_core(key, n, base, hashw_default_secret, true);
+}
+
+uint32_t hashw_stable_8(const void *key, size_t n, uint32_t base)
+{
+	return hashw_fold32(hashw_core(key, n, base,
+				       hashw_default_secret, true));
+}
+
+static uint64_t hashw_splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static unsigned int hashw_popcount64(uint64_t v)
+{
+	unsigned int n;
+
+	for (n = 0; v; n++)
+		v &= v - 1;
+	return n;
+}
+
+void hashw_seed_init(struct hashw_seed *seed, uint64_t random)
+{
+	unsigned int i;
+
+	seed->seed = hashw_splitmix64(&random);
+	/* Multiplying by a secret with too few (or too many) bits set
+	 * mixes badly, so insist on odd words with exactly 32 bits set. */
+	for (i = 0; i < 4; i++) {
+		uint64_t s;
+		do {
+			s = hashw_splitmix64(&random) | 1;
+		} while (hashw_popcount64(s) != 32);
+		seed->secret[i] = s;
+	}
+}
+
+uint64_t hashw64_seeded(const void *key, size_t length,
+			const struct hashw_seed *seed)
+{
+	return hashw_core(key, length, seed->seed, seed->secret, false);
+}
+
 #ifdef SELF_TEST
 
 /* used for timings */
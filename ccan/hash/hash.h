@@ -4,6 +4,7 @@
 #include "config.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ccan/build_assert/build_assert.h>
 
 /* Stolen mostly from: lookup3.c, by Bob Jenkins, May 2006, Public Domain.
@@ -243,6 +244,195 @@ static inline uint32_t hash_string(const char *string)
 	(sizeof(long) == sizeof(uint64_t)				\
 	 ? hash64((p), (num), (base)) : hash((p), (num), (base))))
 
+/**
+ * hash_many - fast hash of many fixed-size keys for internal use
+ * @keys: the keys, packed one after another
+ * @keylen: the length of each key, in bytes
+ * @n: the number of keys
+ * @base: the base number to roll into each hash (usually 0)
+ * @hashes: the array of @n hashes to fill in
+ *
+ * This sets hashes[i] to hash_any(keys + i * @keylen, @keylen, @base),
+ * but works on several keys at once using vector instructions (AVX2 if
+ * the CPU has it, otherwise SSE2 or NEON).  The results are identical
+ * to the single-key version, so the two can be mixed freely.
+ *
+ * Keys whose length is a multiple of 4 bytes benefit most: other
+ * lengths (and big-endian machines) fall back to one key at a time.
+ *
+ * See also: hash64_many, hash_u32_many.
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *	#include <stdio.h>
+ *
+ *	int main(void)
+ *	{
+ *		struct id { unsigned char bytes[16]; } ids[100] = { { { 0 } } };
+ *		uint32_t hashes[100];
+ *
+ *		hash_many(ids, sizeof(ids[0]), 100, 0, hashes);
+ *		printf("First hash %u\n", hashes[0]);
+ *		return 0;
+ *	}
+ */
+void hash_many(const void *keys, size_t keylen, size_t n,
+	       uint32_t base, uint32_t *hashes);
+
+/**
+ * hash64_many - fast 64-bit hash of many fixed-size keys for internal use
+ * @keys: the keys, packed one after another
+ * @keylen: the length of each key, in bytes
+ * @n: the number of keys
+ * @base: the base number to roll into each hash (usually 0)
+ * @hashes: the array of @n hashes to fill in
+ *
+ * The 64-bit version of hash_many(): hashes[i] is identical to
+ * hash64_any(keys + i * @keylen, @keylen, @base).
+ */
+void hash64_many(const void *keys, size_t keylen, size_t n,
+		 uint64_t base, uint64_t *hashes);
+
+/**
+ * hash_u32_many - fast hash of many arrays of 32-bit values
+ * @keys: the keys, each @key_words uint32_t long, packed together
+ * @key_words: the number of uint32_t in each key
+ * @n: the number of keys
+ * @base: the base number to roll into each hash (usually 0)
+ * @hashes: the array of @n hashes to fill in
+ *
+ * hashes[i] is identical to hash_u32(keys + i * @key_words, @key_words,
+ * @base), but computed several keys at a time.
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *
+ *	// Hash each of an array of 32-bit values.
+ *	static void hash_all(const uint32_t *vals, size_t n, uint32_t *hashes)
+ *	{
+ *		hash_u32_many(vals, 1, n, 0, hashes);
+ *	}
+ */
+void hash_u32_many(const uint32_t *keys, size_t key_words, size_t n,
+		   uint32_t base, uint32_t *hashes);
+
+/**
+ * hash64_stable_64_many - stable hash of many 64-bit values
+ * @keys: the array of uint64_t values
+ * @n: the number of values
+ * @base: the base number to roll into each hash (usually 0)
+ * @hashes: the array of @n hashes to fill in
+ *
+ * hashes[i] is identical to hash64_stable(&keys[i], 1, @base), but
+ * computed several keys at a time.
+ */
+void hash64_stable_64_many(const uint64_t *keys, size_t n,
+			   uint64_t base, uint64_t *hashes);
+
+/**
+ * hashw - very fast hash of an array for internal use
+ * @p: the array or pointer to first element
+ * @num: the number of elements to hash
+ * @base: the base number to roll into the hash (usually 0)
+ *
+ * This is a drop-in alternative to hash() using a wide-multiply
+ * construction (in the style of wyhash) rather than lookup3.  It
+ * consumes 16 bytes per multiply, and handles keys of 16 bytes or less
+ * without any loop, so it is considerably faster on both short keys
+ * and long buffers wherever a 64x64->128 bit multiply is cheap.
+ *
+ * Like hash(), the result differs between big and little endian
+ * machines, so it is only useful for internal hashes.
+ *
+ * See also: hashw64, hashw_stable, hashw64_seeded.
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *	#include <stdio.h>
+ *	#include <string.h>
+ *
+ *	int main(int argc, char *argv[])
+ *	{
+ *		int i;
+ *
+ *		for (i = 1; i < argc; i++)
+ *			printf("%s: %u\n", argv[i],
+ *			       hashw(argv[i], strlen(argv[i]), 0));
+ *		return 0;
+ *	}
+ */
+#define hashw(p, num, base) hashw_any((p), (num)*sizeof(*(p)), (base))
+
+/**
+ * hashw64 - very fast 64-bit hash of an array for internal use
+ * @p: the array or pointer to first element
+ * @num: the number of elements to hash
+ * @base: the 64-bit base number to roll into the hash (usually 0)
+ *
+ * The 64-bit version of hashw(); hashw() is this value with the two
+ * halves xored together.
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *	#include <stdio.h>
+ *	#include <string.h>
+ *
+ *	int main(int argc, char *argv[])
+ *	{
+ *		if (argc != 2)
+ *			return 1;
+ *		printf("%llx\n", (unsigned long long)
+ *		       hashw64(argv[1], strlen(argv[1]), 0));
+ *		return 0;
+ *	}
+ */
+#define hashw64(p, num, base) hashw64_any((p), (num)*sizeof(*(p)), (base))
+
+/**
+ * hashw_stable - fast hash of a byte array for external use
+ * @p: the array of bytes (char, uint8_t, etc.)
+ * @num: the number of bytes to hash
+ * @base: the base number to roll into the hash (usually 0)
+ *
+ * This hash will have the same results on different machines, and the
+ * results will not change in future versions of this module.  Unlike
+ * hash_stable() it only accepts single-byte elements: hash multi-byte
+ * integers by serializing them in a fixed byte order first.
+ *
+ * On little-endian machines this gives the same result as hashw().
+ *
+ * See also: hashw64_stable.
+ */
+#define hashw_stable(p, num, base)					\
+	(BUILD_ASSERT_OR_ZERO(sizeof(*(p)) == 1)			\
+	 + hashw_stable_8((p), (num), (base)))
+
+/**
+ * hashw64_stable - fast 64-bit hash of a byte array for external use
+ * @p: the array of bytes (char, uint8_t, etc.)
+ * @num: the number of bytes to hash
+ * @base: the base number to roll into the hash (usually 0)
+ *
+ * The 64-bit version of hashw_stable().
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *	#include <stdio.h>
+ *	#include <string.h>
+ *
+ *	int main(int argc, char *argv[])
+ *	{
+ *		if (argc != 2)
+ *			return 1;
+ *		printf("Stable hash is %llx\n", (unsigned long long)
+ *		       hashw64_stable(argv[1], strlen(argv[1]), 0));
+ *		return 0;
+ *	}
+ */
+#define hashw64_stable(p, num, base)					\
+	(BUILD_ASSERT_OR_ZERO(sizeof(*(p)) == 1)			\
+	 + hashw64_stable_8((p), (num), (base)))
+
 /* Our underlying operations. */
 uint32_t hash_any(const void *key, size_t length, uint32_t base);
 uint32_t hash_stable_64(const void *key, size_t n, uint32_t base);
@@ -254,6 +444,10 @@ uint64_t hash64_stable_64(const void *key, size_t n, uint64_t base);
 uint64_t hash64_stable_32(const void *key, size_t n, uint64_t base);
 uint64_t hash64_stable_16(const void *key, size_t n, uint64_t base);
 uint64_t hash64_stable_8(const void *key, size_t n, uint64_t base);
+uint32_t hashw_any(const void *key, size_t length, uint32_t base);
+uint64_t hashw64_any(const void *key, size_t length, uint64_t base);
+uint32_t hashw_stable_8(const void *key, size_t n, uint32_t base);
+uint64_t hashw64_stable_8(const void *key, size_t n, uint64_t base);
 
 /**
  * hash_pointer - hash a pointer for internal use
@@ -310,4 +504,69 @@ static inline uint32_t hash_pointer(const void *p, uint32_t base)
 	} else
 		return hash(&p, 1, base);
 }
+
+/**
+ * struct hashw_seed - per-process secret for hashw64_seeded()
+ * @seed: the base value
+ * @secret: the multiplier words
+ *
+ * Initialize this with hashw_seed_init().
+ */
+struct hashw_seed {
+	uint64_t seed;
+	uint64_t secret[4];
+};
+
+/**
+ * hashw_seed_init - derive a hashw_seed from a random value
+ * @seed: the hashw_seed to initialize
+ * @random: a random 64-bit value, eg. from /dev/urandom
+ *
+ * The unkeyed hashes in this module are trivially predictable, so an
+ * attacker who controls the keys of a hash table can make them all
+ * collide.  If a table holds untrusted keys, use hashw64_seeded() with
+ * a secret seed instead: both the base value and the multipliers are
+ * derived from @random, so colliding keys can't be precomputed.
+ */
+void hashw_seed_init(struct hashw_seed *seed, uint64_t random);
+
+/**
+ * hashw64_seeded - fast 64-bit hash of memory with a secret seed
+ * @key: the memory to hash
+ * @length: the number of bytes
+ * @seed: the secret seed, from hashw_seed_init().
+ *
+ * Example:
+ *	#include <ccan/hash/hash.h>
+ *	#include <stdio.h>
+ *	#include <string.h>
+ *	#include <time.h>
+ *
+ *	int main(int argc, char *argv[])
+ *	{
+ *		struct hashw_seed seed;
+ *
+ *		// Use a real random source in practice!
+ *		hashw_seed_init(&seed, time(NULL));
+ *		if (argc == 2)
+ *			printf("%llx\n", (unsigned long long)
+ *			       hashw64_seeded(argv[1], strlen(argv[1]), &seed));
+ *		return 0;
+ *	}
+ */
+uint64_t hashw64_seeded(const void *key, size_t length,
+			const struct hashw_seed *seed);
+
+/**
+ * hashw_string - fast hash of a nul-terminated string for internal use
+ * @str: the string
+ *
+ * A convenient hashw() of a string, suitable as the hash function for
+ * HTABLE_DEFINE_TYPE() on string keys.  It's much stronger than
+ * hash_string(), and faster on all but the shortest strings.
+ */
+static inline size_t hashw_string(const char *str)
+{
+	return hashw64_any(str, strlen(str), 0);
+}
 #endif /* HASH_H */
@@ -0,0 +1,104 @@
+#include <ccan/hash/hash.h>
+#include <ccan/hash/hash.c>
+#include <ccan/tap/tap.h>
+#include <stdbool.h>
+#include <string.h>
+
+static const struct {
+	size_t len;
+	uint64_t h0, h1;
+} stable_vec[] = {
+	{ 0, 0x93228a4de0eec5a2ULL, 0x16d3b0a07d2cea83ULL },
+	{ 1, 0x09dc3b06afcfcdfaULL, 0x65275b779288e010ULL },
+	{ 3, 0x9d6f309864716719ULL, 0x2c04afd6958cce3fULL },
+	{ 4, 0xe8936f54388cdbf5ULL, 0x684be46dec087474ULL },
+	{ 8, 0xb8b8b0101a774b8bULL, 0x11ddff7d19858aeaULL },
+	{ 16, 0x43271ea04489ebc4ULL, 0x5acc90c733d2aa9dULL },
+	{ 17, 0xa55c3367b6b9a71cULL, 0x4a6ed437c4dd58c7ULL },
+	{ 48, 0xb4f07cd76c392405ULL, 0xe0b4358c2c549901ULL },
+	{ 49, 0x5e3a1f603be7896aULL, 0x3140dbc228bd254eULL },
+	{ 100, 0x798994485b60baf4ULL, 0x5ab68d938f625ecfULL },
+	{ 300, 0xd0f2ac6b8560b62dULL, 0x500f90af418a68ebULL },
+};
+
+#define NUM_VEC (sizeof(stable_vec) / sizeof(stable_vec[0]))
+
+int main(int argc, char *argv[])
+{
+	unsigned char buf[300], copy[300 + 8];
+	unsigned int i, j;
+	bool ok;
+	struct hashw_seed s1, s2;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7 + 3;
+
+	plan_tests(NUM_VEC * 2 + 10);
+
+	/* hashw_stable is API-guaranteed. */
+	for (i = 0; i < NUM_VEC; i++) {
+		ok1(hashw64_stable(buf, stable_vec[i].len, 0)
+		    == stable_vec[i].h0);
+		ok1(hashw64_stable(buf, stable_vec[i].len, 0x123456789abcdefULL)
+		    == stable_vec[i].h1);
+	}
+	ok1(hashw_stable(buf, 10, 1) == 0xb2ef6edb);
+
+	/* On little-endian, the internal hash is the stable one. */
+	ok = true;
+	for (i = 0; i <= sizeof(buf); i++) {
+		uint64_t h = hashw64(buf, i, i);
+		if (HAVE_LITTLE_ENDIAN && h != hashw64_stable(buf, i, i))
+			ok = false;
+		if ((uint32_t)(h ^ (h >> 32)) != hashw(buf, i, i))
+			ok = false;
+	}
+	ok1(ok);
+
+	/* Alignment doesn't matter. */
+	ok = true;
+	for (j = 1; j < 8; j++) {
+		memcpy(copy + j, buf, sizeof(buf));
+		for (i = 0; i <= sizeof(buf); i++)
+			if (hashw64(copy + j, i, 0) != hashw64(buf, i, 0))
+				ok = false;
+	}
+	ok1(ok);
+
+	/* Every length gives a different result, and so does every base. */
+	ok = true;
+	for (i = 0; i < sizeof(buf); i++) {
+		if (hashw64(buf, i, 0) == hashw64(buf, i + 1, 0))
+			ok = false;
+		if (hashw64(buf, i, 0) == hashw64(buf, i, 1))
+			ok = false;
+	}
+	ok1(ok);
+
+	/* Flipping any single input bit changes the hash. */
+	ok = true;
+	for (i = 0; i < 64 * 8; i++) {
+		memcpy(copy, buf, 64);
+		copy[i / 8] ^= (1 << (i % 8));
+		if (hashw64(copy, 64, 0) == hashw64(buf, 64, 0))
+			ok = false;
+	}
+	ok1(ok);
+
+	/* Seeding. */
+	hashw_seed_init(&s1, 1);
+	hashw_seed_init(&s2, 2);
+	ok1(hashw64_seeded(buf, 20, &s1) != hashw64_seeded(buf, 20, &s2));
+	ok1(hashw64_seeded(buf, 20, &s1) != hashw64(buf, 20, 0));
+	hashw_seed_init(&s2, 1);
+	ok1(hashw64_seeded(buf, 20, &s1) == hashw64_seeded(buf, 20, &s2));
+	ok = true;
+	for (i = 0; i < 4; i++)
+		if ((s1.secret[i] & 1) == 0 || hashw_popcount64(s1.secret[i]) != 32)
+			ok = false;
+	ok1(ok);
+
+	ok1(hashw_string("hello") == hashw64("hello", 5, 0));
+
+	return exit_status();
+}
@@ -0,0 +1,100 @@
+#include <ccan/hash/hash.h>
+#include <ccan/hash/hash.c>
+#include <ccan/tap/tap.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAX_KEYS 37
+#define MAX_KEYLEN 64
+
+static unsigned char keybuf[MAX_KEYS * MAX_KEYLEN + 1];
+
+static bool check_many(uint64_t base)
+{
+	uint32_t h32[MAX_KEYS];
+	uint64_t h64[MAX_KEYS];
+	size_t keylen, n, i;
+	/* Deliberately misaligned. */
+	const unsigned char *keys = keybuf + 1;
+
+	for (keylen = 0; keylen <= MAX_KEYLEN; keylen++) {
+		for (n = 0; n <= MAX_KEYS; n += 3) {
+			hash_many(keys, keylen, n, base, h32);
+			hash64_many(keys, keylen, n, base, h64);
+			for (i = 0; i < n; i++) {
+				const void *k = keys + i * keylen;
+				if (h32[i] != hash_any(k, keylen, base))
+					return false;
+				if (h64[i] != hash64_any(k, keylen, base))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool check_u32_many(uint32_t base)
+{
+	uint32_t keys[MAX_KEYS * 16], h32[MAX_KEYS];
+	size_t words, i;
+
+	memcpy(keys, keybuf, sizeof(keys));
+	for (words = 0; words <= 16; words++) {
+		hash_u32_many(keys, words, MAX_KEYS, base, h32);
+		for (i = 0; i < MAX_KEYS; i++)
+			if (h32[i] != hash_u32(keys + i * words, words, base))
+				return false;
+	}
+	return true;
+}
+
+static bool check_stable_64_many(uint64_t base)
+{
+	uint64_t keys[MAX_KEYS], h64[MAX_KEYS];
+	size_t i;
+
+	memcpy(keys, keybuf, sizeof(keys));
+	hash64_stable_64_many(keys, MAX_KEYS, base, h64);
+	for (i = 0; i < MAX_KEYS; i++)
+		if (h64[i] != hash64_stable(&keys[i], 1, base))
+			return false;
+	return true;
+}
+
+static bool check_all(void)
+{
+	return check_many(0) && check_many(0x123456789abcdefULL)
+		&& check_u32_many(0) && check_u32_many(0xdeadbeef)
+		&& check_stable_64_many(0)
+		&& check_stable_64_many(0xfedcba9876543210ULL);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(keybuf); i++)
+		keybuf[i] = i * 31 + (i >> 5);
+
+	plan_tests(3);
+
+	/* Whatever we pick at runtime. */
+	ok1(check_all());
+
+#ifdef HASH_AVX2
+	/* Plain vector version. */
+	lookup3_many_impl = lookup3_many_vec;
+	ok1(check_all());
+
+	if (__builtin_cpu_supports("avx2")) {
+		lookup3_many_impl = lookup3_many_avx2;
+		ok1(check_all());
+	} else
+		pass("No AVX2");
+#else
+	pass("No runtime selection");
+	pass("No AVX2");
+#endif
+
+	return exit_status();
+}
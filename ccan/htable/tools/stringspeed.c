@@ -6,6 +6,7 @@
 #include <ccan/tal/tal.h>
 #include <ccan/hash/hash.h>
 #include <ccan/time/time.h>
+#include <err.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,10 +21,23 @@ static const char *strkey(const char *str)
 	return str;
 }
 
+static size_t hash_lookup3(const char *key)
+{
+	return hash(key, strlen(key), 0);
+}
+
+static size_t hash_wide(const char *key)
+{
+	return hashw_string(key);
+}
+
+/* Which string hash to use: "lookup3" (default) or "hashw". */
+static size_t (*str_hashfn)(const char *key) = hash_lookup3;
+
 static size_t hash_str(const char *key)
 {
 	hashcount++;
-	return hash(key, strlen(key), 0);
+	return str_hashfn(key);
 }
 
 static bool cmp(const char *obj, const char *key)
@@ -48,6 +62,14 @@ int main(int argc, char *argv[])
 	struct htable_str ht;
 	char **words, **misswords;
 
+	if (argc > 2) {
+		if (strcmp(argv[2], "hashw") == 0)
+			str_hashfn = hash_wide;
+		else if (strcmp(argv[2], "lookup3") != 0)
+			errx(1, "Usage: %s [<wordfile> [lookup3|hashw]]",
+			     argv[0]);
+	}
+
 	words = tal_strsplit(NULL, grab_file(NULL,
 					     argv[1] ? argv[1] : "/usr/share/dict/words"), "\n",
 			     STR_NO_EMPTY);
@@ -0,0 +1,136 @@
+/* Values per second from the one-at-a-time and bulk ISAAC interfaces, and
+ * from the multi-stream generator with each of its implementations. */
+#include <ccan/isaac/isaac64.c>
+#include <ccan/isaac/isaac.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM 4096
+
+struct multi_impl {
+	const char *name;
+	void (*fn)(isaac64_multi_ctx *ctx);
+	bool usable;
+};
+
+static void report(const char *what, struct timeabs start, size_t n)
+{
+	uint64_t ns = time_to_nsec(time_between(time_now(), start));
+
+	printf("%s: %.0f M/s\n", what, (double)n * 1000 / ns);
+}
+
+int main(int argc, char *argv[])
+{
+	struct multi_impl impls[] = {
+		{ "generic", isaac64_multi_update_generic, true },
+#if defined(ISAAC64_X86)
+		{ "avx2", isaac64_multi_update_avx2,
+		  __builtin_cpu_supports("avx2") },
+		{ "avx512", isaac64_multi_update_avx512,
+		  __builtin_cpu_supports("avx512f") },
+#endif
+	};
+	size_t rounds = argc > 1 ? atol(argv[1]) : 2000;
+	/* Not a constant, so next_uint() can't turn its % into a multiply. */
+	uint64_t bound = argc > 2 ? atol(argv[2]) : 1000;
+	static uint64_t u64[NUM * ISAAC64_MULTI_LANES];
+	static uint32_t u32[NUM];
+	static double dbl[NUM];
+	isaac64_multi_ctx *multi = malloc(sizeof(*multi));
+	unsigned char seeds[ISAAC64_MULTI_LANES * 8];
+	isaac64_ctx ctx;
+	isaac_ctx ctx32;
+	struct timeabs start;
+	size_t i, r;
+	uint64_t sum = 0;
+	double dsum = 0;
+
+	for (i = 0; i < sizeof(seeds); i++)
+		seeds[i] = i;
+	isaac64_init(&ctx, seeds, 8);
+	isaac_init(&ctx32, seeds, 8);
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			sum += isaac64_next_uint64(&ctx);
+	report("isaac64_next_uint64", start, rounds * NUM);
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		isaac64_fill_uint64(&ctx, u64, NUM);
+		sum += u64[r % NUM];
+	}
+	report("isaac64_fill_uint64", start, rounds * NUM);
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			dsum += isaac64_next_double(&ctx);
+	report("isaac64_next_double", start, rounds * NUM);
+#if defined(ISAAC64_X86)
+	isaac64_doubles_best = isaac64_doubles_generic;
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		isaac64_fill_double(&ctx, dbl, NUM);
+		dsum += dbl[r % NUM];
+	}
+	report("isaac64_fill_double (generic)", start, rounds * NUM);
+	isaac64_doubles_best = isaac64_doubles_dispatch;
+#endif
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		isaac64_fill_double(&ctx, dbl, NUM);
+		dsum += dbl[r % NUM];
+	}
+	report("isaac64_fill_double", start, rounds * NUM);
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			sum += isaac64_next_uint(&ctx, bound);
+	report("isaac64_next_uint", start, rounds * NUM);
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		isaac64_fill_uint(&ctx, u64, NUM, bound);
+		sum += u64[r % NUM];
+	}
+	report("isaac64_fill_uint", start, rounds * NUM);
+
+	start = time_now();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < NUM; i++)
+			sum += isaac_next_uint32(&ctx32);
+	report("isaac_next_uint32", start, rounds * NUM);
+	start = time_now();
+	for (r = 0; r < rounds; r++) {
+		isaac_fill_uint32(&ctx32, u32, NUM);
+		sum += u32[r % NUM];
+	}
+	report("isaac_fill_uint32", start, rounds * NUM);
+
+	isaac64_multi_init(multi, seeds, 8);
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		char name[64];
+
+		if (!impls[i].usable) {
+			printf("multi %s: unsupported on this CPU\n",
+			       impls[i].name);
+			continue;
+		}
+		isaac64_multi_update_best = impls[i].fn;
+		sprintf(name, "isaac64_multi_fill_uint64 (%s)", impls[i].name);
+		start = time_now();
+		for (r = 0; r < rounds; r++) {
+			isaac64_multi_fill_uint64(multi, u64, NUM);
+			sum += u64[r % NUM];
+		}
+		report(name, start, rounds * NUM * ISAAC64_MULTI_LANES);
+	}
+
+	/* Make sure nothing was optimized away. */
+	printf("(%llu %g)\n", (unsigned long long)sum, dsum);
+	free(multi);
+	return 0;
+}
@@ -3,6 +3,7 @@
   Based on the public domain implementation by Robert J. Jenkins Jr.*/
 #include <float.h>
 #include <math.h>
+#include <stddef.h>
 #include <string.h>
 #include <ccan/ilog/ilog.h>
 #include "isaac.h"
@@ -22,56 +23,62 @@ static inline uint32_t upper_bits(uint32_t y)
 	return (y >> (ISAAC_SZ_LOG+2)) & (ISAAC_SZ-1);
 }
 
-static void isaac_update(isaac_ctx *_ctx){
+/*Runs one round of ISAAC, storing output i in _r[i*_stride].
+  isaac_update() stores into the context, and isaac_fill_uint32() stores whole
+   rounds straight into the caller's buffer, in the order isaac_next_uint32()
+   would have returned them.*/
+static inline void isaac_round(isaac_ctx *_ctx,uint32_t *_r,ptrdiff_t _stride){
   uint32_t *m;
-  uint32_t *r;
   uint32_t  a;
   uint32_t  b;
   uint32_t  x;
   uint32_t  y;
   int       i;
   m=_ctx->m;
-  r=_ctx->r;
   a=_ctx->a;
   b=_ctx->b+(++_ctx->c);
   for(i=0;i<ISAAC_SZ/2;i++){
     x=m[i];
     a=(a^a<<13)+m[i+ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>6)+m[i+ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a<<2)+m[i+ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>16)+m[i+ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
   }
   for(i=ISAAC_SZ/2;i<ISAAC_SZ;i++){
     x=m[i];
     a=(a^a<<13)+m[i-ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>6)+m[i-ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a<<2)+m[i-ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>16)+m[i-ISAAC_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
   }
   _ctx->b=b;
   _ctx->a=a;
+}
+
+static void isaac_update(isaac_ctx *_ctx){
+  isaac_round(_ctx,_ctx->r,1);
   _ctx->n=ISAAC_SZ;
 }
 
@@ -149,6 +156,48 @@ uint32_t isaac_next_uint(isaac_ctx *_ctx,uint32_t _n){
   return v;
 }
 
+void isaac_fill_uint32(isaac_ctx *_ctx,uint32_t *_out,size_t _nout){
+  size_t i;
+  /*Use up what is left of the current round first.*/
+  while(_nout>0&&_ctx->n>0){
+    *_out++=_ctx->r[--_ctx->n];
+    _nout--;
+  }
+  if(_nout>=ISAAC_SZ){
+    do{
+      isaac_round(_ctx,_out+ISAAC_SZ-1,-1);
+      _out+=ISAAC_SZ;
+      _nout-=ISAAC_SZ;
+    }
+    while(_nout>=ISAAC_SZ);
+    /*Leave r[] as it would have been had the values been taken one at a
+       time, since isaac_reseed() mixes it back in.*/
+    for(i=0;i<ISAAC_SZ;i++)_ctx->r[i]=_out[-1-(ptrdiff_t)i];
+  }
+  while(_nout-->0)*_out++=isaac_next_uint32(_ctx);
+}
+
+/*Bounded values use Lemire's multiply-and-reject method: the high half of
+   r*_n is uniform on [0,_n) once the few products whose low half falls below
+   2**32%_n are rejected, and the division to find that threshold is only
+   needed when the low half is small enough for it to matter.*/
+void isaac_fill_uint(isaac_ctx *_ctx,uint32_t *_out,size_t _nout,
+ uint32_t _n){
+  uint32_t thresh;
+  size_t   i;
+  isaac_fill_uint32(_ctx,_out,_nout);
+  thresh=0;
+  for(i=0;i<_nout;i++){
+    uint64_t p;
+    p=(uint64_t)_out[i]*_n;
+    if((uint32_t)p<_n){
+      if(!thresh)thresh=-_n%_n;
+      while((uint32_t)p<thresh)p=(uint64_t)isaac_next_uint32(_ctx)*_n;
+    }
+    _out[i]=(uint32_t)(p>>32);
+  }
+}
+
 /*Returns a uniform random float.
   The expected value is within FLT_MIN (e.g., 1E-37) of 0.5.
   _bits: An initial set of random bits.
@@ -1,6 +1,7 @@
 /* CC0 (Public domain) - see LICENSE file for details */
 #if !defined(_isaac_H)
 # define _isaac_H (1)
+# include <stddef.h>
 # include <stdint.h>
 
 
@@ -75,6 +76,31 @@ uint32_t isaac_next_uint32(isaac_ctx *_ctx);
  * Return: An integer uniformly distributed between 0 and _n-1 (inclusive).
  */
 uint32_t isaac_next_uint(isaac_ctx *_ctx,uint32_t _n);
+/**
+ * isaac_fill_uint32 - Fill a buffer with random 32-bit values.
+ * @_ctx:  The ISAAC instance to generate the values with.
+ * @_out:  The buffer to fill.
+ * @_nout: The number of values to generate.
+ * The values are exactly those that _nout calls to isaac_next_uint32() would
+ *  have returned, but whole rounds of the generator are written straight into
+ *  _out rather than being copied out one at a time.
+ */
+void isaac_fill_uint32(isaac_ctx *_ctx,uint32_t *_out,size_t _nout);
+/**
+ * isaac_fill_uint - Fill a buffer with uniform random integers less than the
+ *  given value.
+ * @_ctx:  The ISAAC instance to generate the values with.
+ * @_out:  The buffer to fill.
+ * @_nout: The number of values to generate.
+ * @_n:    The upper bound on the range of numbers returned (not inclusive).
+ *         This must be greater than zero.
+ * Each value is uniformly distributed between 0 and _n-1 (inclusive), with
+ *  no modulo bias.
+ * This uses a multiply rather than a division per value, so it does not
+ *  return the same values as repeated calls to isaac_next_uint().
+ */
+void isaac_fill_uint(isaac_ctx *_ctx,uint32_t *_out,size_t _nout,
+ uint32_t _n);
 /**
  * isaac_next_float - Uniform random float in the range [0,1).
  * @_ctx: The ISAAC instance to generate the value with.
@@ -3,6 +3,7 @@
   Based on the public domain ISAAC implementation by Robert J. Jenkins Jr.*/
 #include <float.h>
 #include <math.h>
+#include <stddef.h>
 #include <string.h>
 #include <ccan/ilog/ilog.h>
 #include "isaac64.h"
@@ -22,56 +23,63 @@ static inline uint32_t upper_bits(uint32_t y)
 	return (y >> (ISAAC64_SZ_LOG+3)) & (ISAAC64_SZ-1);
 }
 
-static void isaac64_update(isaac64_ctx *_ctx){
+/*Runs one round of ISAAC64, storing output i in _r[i*_stride].
+  isaac64_update() stores into the context, and isaac64_fill_uint64() stores
+   whole rounds straight into the caller's buffer, in the order
+   isaac64_next_uint64() would have returned them.*/
+static inline void isaac64_round(isaac64_ctx *_ctx,uint64_t *_r,
+ ptrdiff_t _stride){
   uint64_t *m;
-  uint64_t *r;
   uint64_t  a;
   uint64_t  b;
   uint64_t  x;
   uint64_t  y;
   int       i;
   m=_ctx->m;
-  r=_ctx->r;
   a=_ctx->a;
   b=_ctx->b+(++_ctx->c);
   for(i=0;i<ISAAC64_SZ/2;i++){
     x=m[i];
     a=~(a^a<<21)+m[i+ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>5)+m[i+ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a<<12)+m[i+ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>33)+m[i+ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
   }
   for(i=ISAAC64_SZ/2;i<ISAAC64_SZ;i++){
     x=m[i];
     a=~(a^a<<21)+m[i-ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>5)+m[i-ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a<<12)+m[i-ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
     x=m[++i];
     a=(a^a>>33)+m[i-ISAAC64_SZ/2];
     m[i]=y=m[lower_bits(x)]+a+b;
-    r[i]=b=m[upper_bits(y)]+x;
+    _r[i*_stride]=b=m[upper_bits(y)]+x;
   }
   _ctx->b=b;
   _ctx->a=a;
+}
+
+static void isaac64_update(isaac64_ctx *_ctx){
+  isaac64_round(_ctx,_ctx->r,1);
   _ctx->n=ISAAC64_SZ;
 }
 
@@ -253,3 +261,344 @@ double isaac64_next_signed_double(isaac64_ctx *_ctx){
   bits=isaac64_next_uint64(_ctx);
   return (1|-((int)bits&1))*isaac64_double_bits(_ctx,bits>>1,-63);
 }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# define ISAAC64_X86 (1)
+# include <immintrin.h>
+#endif
+
+void isaac64_fill_uint64(isaac64_ctx *_ctx,uint64_t *_out,size_t _nout){
+  size_t i;
+  /*Use up what is left of the current round first.*/
+  while(_nout>0&&_ctx->n>0){
+    *_out++=_ctx->r[--_ctx->n];
+    _nout--;
+  }
+  if(_nout>=ISAAC64_SZ){
+    do{
+      isaac64_round(_ctx,_out+ISAAC64_SZ-1,-1);
+      _out+=ISAAC64_SZ;
+      _nout-=ISAAC64_SZ;
+    }
+    while(_nout>=ISAAC64_SZ);
+    /*Leave r[] as it would have been had the values been taken one at a
+       time, since isaac64_reseed() mixes it back in.*/
+    for(i=0;i<ISAAC64_SZ;i++)_ctx->r[i]=_out[-1-(ptrdiff_t)i];
+  }
+  while(_nout-->0)*_out++=isaac64_next_uint64(_ctx);
+}
+
+/*The high 64 bits of the 128-bit product _a*_b.*/
+static inline uint64_t isaac64_mulhi(uint64_t _a,uint64_t _b,uint64_t *_lo){
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 p;
+  p=(unsigned __int128)_a*_b;
+  *_lo=(uint64_t)p;
+  return (uint64_t)(p>>64);
+#else
+  uint64_t al;
+  uint64_t ah;
+  uint64_t bl;
+  uint64_t bh;
+  uint64_t t;
+  uint64_t u;
+  al=_a&0xFFFFFFFFU;
+  ah=_a>>32;
+  bl=_b&0xFFFFFFFFU;
+  bh=_b>>32;
+  t=al*bl;
+  u=ah*bl+(t>>32);
+  t=al*bh+(u&0xFFFFFFFFU);
+  *_lo=_a*_b;
+  return ah*bh+(u>>32)+(t>>32);
+#endif
+}
+
+/*Bounded values use Lemire's multiply-and-reject method: the high half of
+   r*_n is uniform on [0,_n) once the few products whose low half falls below
+   2**64%_n are rejected, and the division to find that threshold is only
+   needed when the low half is small enough for it to matter.*/
+void isaac64_fill_uint(isaac64_ctx *_ctx,uint64_t *_out,size_t _nout,
+ uint64_t _n){
+  uint64_t thresh;
+  size_t   i;
+  isaac64_fill_uint64(_ctx,_out,_nout);
+  thresh=0;
+  for(i=0;i<_nout;i++){
+    uint64_t lo;
+    uint64_t v;
+    v=isaac64_mulhi(_out[i],_n,&lo);
+    if(lo<_n){
+      if(!thresh)thresh=-_n%_n;
+      while(lo<thresh)v=isaac64_mulhi(isaac64_next_uint64(_ctx),_n,&lo);
+    }
+    _out[i]=v;
+  }
+}
+
+#if DBL_MANT_DIG==53&&FLT_RADIX==2
+/*isaac64_double_bits() only needs a second value when the first is less
+   than 2**52; otherwise it keeps the top 53 significant bits of the first,
+   which is just a shift, an exact conversion and a scale by a power of two.
+  Each of these converts values from _r[0],_r[-1],... while that holds, and
+   returns how many it converted.*/
+static size_t isaac64_doubles_generic(double *_out,const uint64_t *_r,
+ size_t _nout){
+  static const double SCALE[12]={
+    0x1P-64,0x1P-63,0x1P-62,0x1P-61,0x1P-60,0x1P-59,
+    0x1P-58,0x1P-57,0x1P-56,0x1P-55,0x1P-54,0x1P-53
+  };
+  size_t i;
+  for(i=0;i<_nout;i++){
+    uint64_t x;
+    int      shift;
+    x=_r[-(ptrdiff_t)i];
+    if(x<(uint64_t)1<<52)break;
+    shift=ilog64_nz(x)-53;
+    /*The shifted value fits in 53 bits, so the signed conversion is exact
+       (and cheaper than an unsigned one).*/
+    _out[i]=(double)(int64_t)(x>>shift)*SCALE[shift];
+  }
+  return i;
+}
+
+# if defined(ISAAC64_X86)
+__attribute__((target("avx512f,avx512cd,avx512dq")))
+static size_t isaac64_doubles_avx512(double *_out,const uint64_t *_r,
+ size_t _nout){
+  const __m512i rev=_mm512_set_epi64(0,1,2,3,4,5,6,7);
+  const __m512i small=_mm512_set1_epi64((uint64_t)1<<52);
+  const __m512i ones=_mm512_set1_epi64(-1);
+  const __m512i eleven=_mm512_set1_epi64(11);
+  const __m512d scale=_mm512_set1_pd(0x1P-64);
+  size_t i;
+  for(i=0;i+8<=_nout;i+=8){
+    __m512i x;
+    x=_mm512_permutexvar_epi64(rev,
+     _mm512_loadu_si512(_r-(ptrdiff_t)i-7));
+    if(_mm512_cmplt_epu64_mask(x,small))break;
+    x=_mm512_and_si512(x,_mm512_sllv_epi64(ones,
+     _mm512_sub_epi64(eleven,_mm512_lzcnt_epi64(x))));
+    _mm512_storeu_pd(_out+i,_mm512_mul_pd(_mm512_cvtepu64_pd(x),scale));
+  }
+  return i+isaac64_doubles_generic(_out+i,_r-(ptrdiff_t)i,_nout-i);
+}
+
+static size_t isaac64_doubles_dispatch(double *_out,const uint64_t *_r,
+ size_t _nout);
+/*Replaced by the best version on first use.
+  Threads may race to do so, but they all store the same pointer.*/
+static size_t (*isaac64_doubles_best)(double *_out,const uint64_t *_r,
+ size_t _nout)=isaac64_doubles_dispatch;
+
+static size_t isaac64_doubles_dispatch(double *_out,const uint64_t *_r,
+ size_t _nout){
+  size_t (*impl)(double *,const uint64_t *,size_t);
+  if(__builtin_cpu_supports("avx512f")&&__builtin_cpu_supports("avx512cd")
+   &&__builtin_cpu_supports("avx512dq")){
+    impl=isaac64_doubles_avx512;
+  }
+  else impl=isaac64_doubles_generic;
+  __atomic_store_n(&isaac64_doubles_best,impl,__ATOMIC_RELAXED);
+  return impl(_out,_r,_nout);
+}
+
+static size_t isaac64_doubles(double *_out,const uint64_t *_r,size_t _nout){
+  return __atomic_load_n(&isaac64_doubles_best,__ATOMIC_RELAXED)(_out,_r,
+   _nout);
+}
+# else
+#  define isaac64_doubles isaac64_doubles_generic
+# endif
+
+void isaac64_fill_double(isaac64_ctx *_ctx,double *_out,size_t _nout){
+  while(_nout>0){
+    size_t navail;
+    size_t ndone;
+    if(!_ctx->n)isaac64_update(_ctx);
+    navail=_nout<_ctx->n?_nout:_ctx->n;
+    ndone=isaac64_doubles(_out,_ctx->r+_ctx->n-1,navail);
+    _ctx->n-=ndone;
+    _out+=ndone;
+    _nout-=ndone;
+    /*The rare small value takes the slow path.*/
+    if(ndone<navail){
+      *_out++=isaac64_next_double(_ctx);
+      _nout--;
+    }
+  }
+}
+#else
+void isaac64_fill_double(isaac64_ctx *_ctx,double *_out,size_t _nout){
+  while(_nout-->0)*_out++=isaac64_next_double(_ctx);
+}
+#endif
+
+/*The multi-stream generator runs the same round as isaac64_round() on every
+   lane at once.
+  The state is interleaved, so each step's sequential loads and stores are
+   vectors, and the two table lookups become gathers.*/
+#define ISAAC64_MULTI_STEP(_mix) \
+  do{ \
+    for(l=0;l<ISAAC64_MULTI_LANES;l++){ \
+      uint64_t x; \
+      uint64_t y; \
+      x=m[i][l]; \
+      a[l]=(_mix)+m[(i+ISAAC64_SZ/2)&(ISAAC64_SZ-1)][l]; \
+      m[i][l]=y=m[lower_bits(x)][l]+a[l]+b[l]; \
+      r[i][l]=b[l]=m[upper_bits(y)][l]+x; \
+    } \
+    i++; \
+  } \
+  while(0)
+
+static void isaac64_multi_update_generic(isaac64_multi_ctx *_ctx){
+  uint64_t (*m)[ISAAC64_MULTI_LANES];
+  uint64_t (*r)[ISAAC64_MULTI_LANES];
+  uint64_t  a[ISAAC64_MULTI_LANES];
+  uint64_t  b[ISAAC64_MULTI_LANES];
+  int       i;
+  int       l;
+  m=_ctx->m;
+  r=_ctx->r;
+  ++_ctx->c;
+  for(l=0;l<ISAAC64_MULTI_LANES;l++){
+    a[l]=_ctx->a[l];
+    b[l]=_ctx->b[l]+_ctx->c;
+  }
+  for(i=0;i<ISAAC64_SZ;){
+    ISAAC64_MULTI_STEP(~(a[l]^a[l]<<21));
+    ISAAC64_MULTI_STEP(a[l]^a[l]>>5);
+    ISAAC64_MULTI_STEP(a[l]^a[l]<<12);
+    ISAAC64_MULTI_STEP(a[l]^a[l]>>33);
+  }
+  memcpy(_ctx->a,a,sizeof(a));
+  memcpy(_ctx->b,b,sizeof(b));
+}
+
+#if defined(ISAAC64_X86)
+/*One step of the multi-stream round, _W/64 lanes at a time.
+  _v is the intrinsic prefix (_mm256 or _mm512) and _W its register width;
+   _set1 broadcasts a 64-bit value and _GATHER(idx) loads m[idx] as 64-bit
+   elements of the flattened state.
+  Since ISAAC64_MULTI_LANES is 8, element (j,l) of m[][] is at j<<3|l.*/
+# define ISAAC64_VEC_STEP(_v,_W,_GATHER,_mix) \
+  do{ \
+    for(h=0;h<ISAAC64_MULTI_LANES/(_W/64);h++){ \
+      __m##_W##i x; \
+      __m##_W##i y; \
+      __m##_W##i idx; \
+      x=_v##_loadu_si##_W((const void *)(_ctx->m[i]+h*(_W/64))); \
+      a[h]=_v##_add_epi64(_mix,_v##_loadu_si##_W((const void *) \
+       (_ctx->m[(i+ISAAC64_SZ/2)&(ISAAC64_SZ-1)]+h*(_W/64)))); \
+      idx=_v##_and_si##_W(_v##_srli_epi64(x,3),mask); \
+      idx=_v##_add_epi64(_v##_slli_epi64(idx,3),lane[h]); \
+      y=_v##_add_epi64(_GATHER(idx),_v##_add_epi64(a[h],b[h])); \
+      _v##_storeu_si##_W((void *)(_ctx->m[i]+h*(_W/64)),y); \
+      idx=_v##_and_si##_W(_v##_srli_epi64(y,ISAAC64_SZ_LOG+3),mask); \
+      idx=_v##_add_epi64(_v##_slli_epi64(idx,3),lane[h]); \
+      b[h]=_v##_add_epi64(_GATHER(idx),x); \
+      _v##_storeu_si##_W((void *)(_ctx->r[i]+h*(_W/64)),b[h]); \
+    } \
+    i++; \
+  } \
+  while(0)
+
+# define DEFINE_ISAAC64_MULTI_UPDATE(_name,_v,_W,_set1,_GATHER,_attr) \
+_attr static void _name(isaac64_multi_ctx *_ctx){ \
+  const long long *m; \
+  __m##_W##i       a[ISAAC64_MULTI_LANES/(_W/64)]; \
+  __m##_W##i       b[ISAAC64_MULTI_LANES/(_W/64)]; \
+  __m##_W##i       lane[ISAAC64_MULTI_LANES/(_W/64)]; \
+  __m##_W##i       mask; \
+  __m##_W##i       ones; \
+  int              i; \
+  int              h; \
+  long long        lanes[ISAAC64_MULTI_LANES]; \
+  m=(const long long *)_ctx->m; \
+  ++_ctx->c; \
+  mask=_set1(ISAAC64_SZ-1); \
+  ones=_set1(-1); \
+  for(i=0;i<ISAAC64_MULTI_LANES;i++)lanes[i]=i; \
+  for(h=0;h<ISAAC64_MULTI_LANES/(_W/64);h++){ \
+    a[h]=_v##_loadu_si##_W((const void *)(_ctx->a+h*(_W/64))); \
+    b[h]=_v##_add_epi64(_v##_loadu_si##_W((const void *)(_ctx->b+h*(_W/64))), \
+     _set1(_ctx->c)); \
+    lane[h]=_v##_loadu_si##_W((const void *)(lanes+h*(_W/64))); \
+  } \
+  for(i=0;i<ISAAC64_SZ;){ \
+    ISAAC64_VEC_STEP(_v,_W,_GATHER,_v##_xor_si##_W(ones, \
+     _v##_xor_si##_W(a[h],_v##_slli_epi64(a[h],21)))); \
+    ISAAC64_VEC_STEP(_v,_W,_GATHER, \
+     _v##_xor_si##_W(a[h],_v##_srli_epi64(a[h],5))); \
+    ISAAC64_VEC_STEP(_v,_W,_GATHER, \
+     _v##_xor_si##_W(a[h],_v##_slli_epi64(a[h],12))); \
+    ISAAC64_VEC_STEP(_v,_W,_GATHER, \
+     _v##_xor_si##_W(a[h],_v##_srli_epi64(a[h],33))); \
+  } \
+  for(h=0;h<ISAAC64_MULTI_LANES/(_W/64);h++){ \
+    _v##_storeu_si##_W((void *)(_ctx->a+h*(_W/64)),a[h]); \
+    _v##_storeu_si##_W((void *)(_ctx->b+h*(_W/64)),b[h]); \
+  } \
+}
+
+# define ISAAC64_GATHER256(_idx) _mm256_i64gather_epi64(m,_idx,8)
+# define ISAAC64_GATHER512(_idx) _mm512_i64gather_epi64(_idx,m,8)
+
+DEFINE_ISAAC64_MULTI_UPDATE(isaac64_multi_update_avx2,_mm256,256,
+ _mm256_set1_epi64x,ISAAC64_GATHER256,__attribute__((target("avx2"))))
+DEFINE_ISAAC64_MULTI_UPDATE(isaac64_multi_update_avx512,_mm512,512,
+ _mm512_set1_epi64,ISAAC64_GATHER512,__attribute__((target("avx512f"))))
+
+static void isaac64_multi_update_dispatch(isaac64_multi_ctx *_ctx);
+/*As isaac64_doubles_best.*/
+static void (*isaac64_multi_update_best)(isaac64_multi_ctx *_ctx)=
+ isaac64_multi_update_dispatch;
+
+static void isaac64_multi_update_dispatch(isaac64_multi_ctx *_ctx){
+  void (*impl)(isaac64_multi_ctx *);
+  if(__builtin_cpu_supports("avx512f"))impl=isaac64_multi_update_avx512;
+  else if(__builtin_cpu_supports("avx2"))impl=isaac64_multi_update_avx2;
+  else impl=isaac64_multi_update_generic;
+  __atomic_store_n(&isaac64_multi_update_best,impl,__ATOMIC_RELAXED);
+  impl(_ctx);
+}
+
+static void isaac64_multi_update_impl(isaac64_multi_ctx *_ctx){
+  __atomic_load_n(&isaac64_multi_update_best,__ATOMIC_RELAXED)(_ctx);
+}
+#else
+# define isaac64_multi_update_impl isaac64_multi_update_generic
+#endif
+
+static void isaac64_multi_update(isaac64_multi_ctx *_ctx){
+  isaac64_multi_update_impl(_ctx);
+  _ctx->n=ISAAC64_SZ;
+}
+
+void isaac64_multi_init(isaac64_multi_ctx *_ctx,const unsigned char *_seeds,
+ int _nseed){
+  isaac64_ctx one;
+  int         i;
+  int         l;
+  for(l=0;l<ISAAC64_MULTI_LANES;l++){
+    isaac64_init(&one,_nseed>0?_seeds+(size_t)l*_nseed:NULL,_nseed);
+    for(i=0;i<ISAAC64_SZ;i++){
+      _ctx->m[i][l]=one.m[i];
+      _ctx->r[i][l]=one.r[i];
+    }
+    _ctx->a[l]=one.a;
+    _ctx->b[l]=one.b;
+  }
+  _ctx->c=one.c;
+  _ctx->n=one.n;
+}
+
+void isaac64_multi_fill_uint64(isaac64_multi_ctx *_ctx,uint64_t *_out,
+ size_t _nout){
+  while(_nout-->0){
+    if(!_ctx->n)isaac64_multi_update(_ctx);
+    memcpy(_out,_ctx->r[--_ctx->n],sizeof(_ctx->r[0]));
+    _out+=ISAAC64_MULTI_LANES;
+  }
+}
@@ -1,17 +1,21 @@
 /* CC0 (Public domain) - see LICENSE file for details */
 #if !defined(_isaac64_H)
 # define _isaac64_H (1)
+# include <stddef.h>
 # include <stdint.h>
 
 
 
-typedef struct isaac64_ctx isaac64_ctx;
+typedef struct isaac64_ctx       isaac64_ctx;
+typedef struct isaac64_multi_ctx isaac64_multi_ctx;
 
 
 
 #define ISAAC64_SZ_LOG      (8)
 #define ISAAC64_SZ          (1<<ISAAC64_SZ_LOG)
 #define ISAAC64_SEED_SZ_MAX (ISAAC64_SZ<<3)
+/*The number of independent generators in an isaac64_multi_ctx.*/
+#define ISAAC64_MULTI_LANES (8)
 
 
 
@@ -35,6 +39,17 @@ struct isaac64_ctx{
   uint64_t c;
 };
 
+/*ISAAC64_MULTI_LANES independent ISAAC64 generators, with their state
+   interleaved so that they can all be stepped at once.*/
+struct isaac64_multi_ctx{
+  unsigned n;
+  uint64_t r[ISAAC64_SZ][ISAAC64_MULTI_LANES];
+  uint64_t m[ISAAC64_SZ][ISAAC64_MULTI_LANES];
+  uint64_t a[ISAAC64_MULTI_LANES];
+  uint64_t b[ISAAC64_MULTI_LANES];
+  uint64_t c;
+};
+
 
 /**
  * isaac64_init - Initialize an instance of the ISAAC64 random number generator.
@@ -128,4 +143,69 @@ double isaac64_next_double(isaac64_ctx *_ctx);
  */
 double isaac64_next_signed_double(isaac64_ctx *_ctx);
 
+/**
+ * isaac64_fill_uint64 - Fill a buffer with random 64-bit values.
+ * @_ctx:  The ISAAC64 instance to generate the values with.
+ * @_out:  The buffer to fill.
+ * @_nout: The number of values to generate.
+ * The values are exactly those that _nout calls to isaac64_next_uint64()
+ *  would have returned, but whole rounds of the generator are written
+ *  straight into _out rather than being copied out one at a time.
+ */
+void isaac64_fill_uint64(isaac64_ctx *_ctx,uint64_t *_out,size_t _nout);
+/**
+ * isaac64_fill_uint - Fill a buffer with uniform random integers less than
+ *  the given value.
+ * @_ctx:  The ISAAC64 instance to generate the values with.
+ * @_out:  The buffer to fill.
+ * @_nout: The number of values to generate.
+ * @_n:    The upper bound on the range of numbers returned (not inclusive).
+ *         This must be greater than zero.
+ * Each value is uniformly distributed between 0 and _n-1 (inclusive), with
+ *  no modulo bias.
+ * This uses a multiply rather than a division per value, so it does not
+ *  return the same values as repeated calls to isaac64_next_uint().
+ */
+void isaac64_fill_uint(isaac64_ctx *_ctx,uint64_t *_out,size_t _nout,
+ uint64_t _n);
+/**
+ * isaac64_fill_double - Fill a buffer with uniform random doubles in the
+ *  range [0,1).
+ * @_ctx:  The ISAAC64 instance to generate the values with.
+ * @_out:  The buffer to fill.
+ * @_nout: The number of values to generate.
+ * The values are exactly those that _nout calls to isaac64_next_double()
+ *  would have returned, with the same guarantees, but the common case is
+ *  converted without calling ldexp(), and with AVX-512 several at a time.
+ */
+void isaac64_fill_double(isaac64_ctx *_ctx,double *_out,size_t _nout);
+
+/**
+ * isaac64_multi_init - Initialize ISAAC64_MULTI_LANES independent generators.
+ * @_ctx:   The instance to initialize.
+ * @_seeds: ISAAC64_MULTI_LANES seeds of _nseed bytes each, one after the
+ *           other.
+ *          This may be NULL if _nseed is less than or equal to zero (but
+ *           then every lane produces the same values).
+ * @_nseed: The number of bytes in each seed.
+ *          If this is greater than ISAAC64_SEED_SZ_MAX, the extra bytes of
+ *           each seed are ignored.
+ * Lane i generates the same values as an isaac64_ctx initialized with
+ *  isaac64_init(ctx,_seeds+i*_nseed,_nseed).
+ */
+void isaac64_multi_init(isaac64_multi_ctx *_ctx,const unsigned char *_seeds,
+ int _nseed);
+/**
+ * isaac64_multi_fill_uint64 - Generate random 64-bit values from every lane.
+ * @_ctx:  The instance to generate the values with.
+ * @_out:  The buffer to fill, with room for _nout*ISAAC64_MULTI_LANES values.
+ * @_nout: The number of values to generate from each lane.
+ * _out[j*ISAAC64_MULTI_LANES+i] receives the j'th value from lane i.
+ * The lanes are stepped together, using AVX2 or AVX-512 gathers where the
+ *  CPU has them, which gives much better throughput than running the same
+ *  number of isaac64_ctx generators one after another.
+ */
+void isaac64_multi_fill_uint64(isaac64_multi_ctx *_ctx,uint64_t *_out,
+ size_t _nout);
+
 #endif
@@ -0,0 +1,51 @@
+#include <ccan/isaac/isaac.h>
+#include <ccan/isaac/isaac.c>
+#include <ccan/tap/tap.h>
+#include <stdlib.h>
+
+#define NVALS (100000)
+
+static const unsigned char SEED[]="Monte Carlo";
+
+/*Chunk sizes which straddle rounds in various ways.*/
+static const size_t CHUNKS[]={1,3,ISAAC_SZ-1,ISAAC_SZ,ISAAC_SZ+1,1000,7,512};
+
+int main(int _argc,const char *_argv[]){
+  isaac_ctx  bulk;
+  isaac_ctx  one;
+  uint32_t  *buf;
+  size_t     counts[3]={0,0,0};
+  size_t     i;
+  size_t     c;
+  int        ok;
+  (void)_argc;
+  (void)_argv;
+  plan_tests(3);
+  buf=malloc(NVALS*sizeof(*buf));
+  isaac_init(&bulk,SEED,sizeof(SEED));
+  isaac_init(&one,SEED,sizeof(SEED));
+  for(i=c=0;i<NVALS;i+=CHUNKS[c++%8]){
+    size_t n;
+    n=CHUNKS[c%8]<NVALS-i?CHUNKS[c%8]:NVALS-i;
+    isaac_fill_uint32(&bulk,buf+i,n);
+  }
+  ok=1;
+  for(i=0;i<NVALS;i++)ok&=buf[i]==isaac_next_uint32(&one);
+  ok1(ok);
+  /*Reseeding must see the same state, too.*/
+  isaac_reseed(&bulk,SEED,sizeof(SEED));
+  isaac_reseed(&one,SEED,sizeof(SEED));
+  ok=1;
+  for(i=0;i<10;i++)ok&=isaac_next_uint32(&bulk)==isaac_next_uint32(&one);
+  ok1(ok);
+  isaac_fill_uint(&bulk,buf,NVALS,3);
+  ok=1;
+  for(i=0;i<NVALS;i++){
+    ok&=buf[i]<3;
+    if(ok)counts[buf[i]]++;
+  }
+  for(i=0;i<3;i++)ok&=counts[i]>NVALS/3*9/10;
+  ok1(ok);
+  free(buf);
+  return exit_status();
+}
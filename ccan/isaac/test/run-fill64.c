@@ -0,0 +1,153 @@
+#include <ccan/isaac/isaac64.h>
+#include <ccan/isaac/isaac64.c>
+#include <ccan/tap/tap.h>
+#include <stdlib.h>
+
+#define NVALS (100000)
+
+static const unsigned char SEED[]="Monte Carlo";
+
+/*Chunk sizes which straddle rounds in various ways.*/
+static const size_t CHUNKS[]={1,3,255,256,257,1000,7,512};
+
+static int fill_uint64_ok(void){
+  isaac64_ctx  bulk;
+  isaac64_ctx  one;
+  uint64_t    *buf;
+  size_t       i;
+  size_t       j;
+  size_t       c;
+  int          ok;
+  buf=malloc(NVALS*sizeof(*buf));
+  isaac64_init(&bulk,SEED,sizeof(SEED));
+  isaac64_init(&one,SEED,sizeof(SEED));
+  ok=1;
+  for(i=c=0;i<NVALS;i+=CHUNKS[c++%8]){
+    size_t n;
+    n=CHUNKS[c%8]<NVALS-i?CHUNKS[c%8]:NVALS-i;
+    isaac64_fill_uint64(&bulk,buf+i,n);
+  }
+  for(i=0;i<NVALS;i++)ok&=buf[i]==isaac64_next_uint64(&one);
+  /*Reseeding must see the same state, too.*/
+  isaac64_reseed(&bulk,SEED,sizeof(SEED));
+  isaac64_reseed(&one,SEED,sizeof(SEED));
+  for(j=0;j<10;j++)ok&=isaac64_next_uint64(&bulk)==isaac64_next_uint64(&one);
+  free(buf);
+  return ok;
+}
+
+static int fill_double_ok(void){
+  isaac64_ctx  bulk;
+  isaac64_ctx  one;
+  double      *buf;
+  size_t       i;
+  size_t       c;
+  int          ok;
+  buf=malloc(NVALS*sizeof(*buf));
+  isaac64_init(&bulk,SEED,sizeof(SEED));
+  isaac64_init(&one,SEED,sizeof(SEED));
+  ok=1;
+  for(i=c=0;i<NVALS;i+=CHUNKS[c++%8]){
+    size_t n;
+    n=CHUNKS[c%8]<NVALS-i?CHUNKS[c%8]:NVALS-i;
+    isaac64_fill_double(&bulk,buf+i,n);
+  }
+  for(i=0;i<NVALS;i++){
+    ok&=buf[i]==isaac64_next_double(&one);
+    ok&=buf[i]>=0&&buf[i]<1;
+  }
+  ok&=isaac64_next_uint64(&bulk)==isaac64_next_uint64(&one);
+  free(buf);
+  return ok;
+}
+
+static int fill_uint_ok(uint64_t _n){
+  isaac64_ctx  isaac;
+  uint64_t    *buf;
+  size_t       counts[3]={0,0,0};
+  size_t       nbuckets;
+  size_t       i;
+  int          ok;
+  buf=malloc(NVALS*sizeof(*buf));
+  isaac64_init(&isaac,SEED,sizeof(SEED));
+  isaac64_fill_uint(&isaac,buf,NVALS,_n);
+  ok=1;
+  /*For huge bounds, check neither half of the range is neglected.*/
+  nbuckets=_n<=3?_n:2;
+  for(i=0;i<NVALS;i++){
+    ok&=buf[i]<_n;
+    if(ok)counts[_n<=3?buf[i]:buf[i]>=_n/2]++;
+  }
+  for(i=0;i<nbuckets;i++)ok&=counts[i]>NVALS/nbuckets*9/10;
+  free(buf);
+  return ok;
+}
+
+int main(int _argc,const char *_argv[]){
+  isaac64_multi_ctx *multi;
+  isaac64_ctx        one[ISAAC64_MULTI_LANES];
+  unsigned char      seeds[ISAAC64_MULTI_LANES][sizeof(SEED)];
+  uint64_t          *buf;
+  size_t             i;
+  int                l;
+  int                ok;
+  (void)_argc;
+  (void)_argv;
+  plan_tests(9);
+  ok1(fill_uint64_ok());
+  ok1(fill_double_ok());
+#if defined(ISAAC64_X86)
+  isaac64_doubles_best=isaac64_doubles_generic;
+  ok1(fill_double_ok());
+#else
+  pass("no vector double conversion");
+#endif
+  ok1(fill_uint_ok(1));
+  ok1(fill_uint_ok(3));
+  ok1(fill_uint_ok(((uint64_t)1<<63)+1));
+  /*Every lane of the multi-stream generator is an ordinary ISAAC64.*/
+  multi=malloc(sizeof(*multi));
+  buf=malloc(NVALS*sizeof(*buf));
+  for(l=0;l<ISAAC64_MULTI_LANES;l++){
+    memcpy(seeds[l],SEED,sizeof(SEED));
+    seeds[l][0]+=l;
+    isaac64_init(one+l,seeds[l],sizeof(SEED));
+  }
+  isaac64_multi_init(multi,seeds[0],sizeof(SEED));
+  isaac64_multi_fill_uint64(multi,buf,NVALS/ISAAC64_MULTI_LANES);
+  ok=1;
+  for(i=0;i<NVALS/ISAAC64_MULTI_LANES;i++){
+    for(l=0;l<ISAAC64_MULTI_LANES;l++){
+      ok&=buf[i*ISAAC64_MULTI_LANES+l]==isaac64_next_uint64(one+l);
+    }
+  }
+  ok1(ok);
+#if defined(ISAAC64_X86)
+  if(__builtin_cpu_supports("avx2")){
+    isaac64_multi_update_best=isaac64_multi_update_avx2;
+    isaac64_multi_fill_uint64(multi,buf,NVALS/ISAAC64_MULTI_LANES);
+    ok=1;
+    for(i=0;i<NVALS/ISAAC64_MULTI_LANES;i++){
+      for(l=0;l<ISAAC64_MULTI_LANES;l++){
+        ok&=buf[i*ISAAC64_MULTI_LANES+l]==isaac64_next_uint64(one+l);
+      }
+    }
+    ok1(ok);
+  }
+  else pass("no AVX2");
+  isaac64_multi_update_best=isaac64_multi_update_generic;
+#else
+  pass("no AVX2");
+#endif
+  isaac64_multi_fill_uint64(multi,buf,NVALS/ISAAC64_MULTI_LANES);
+  ok=1;
+  for(i=0;i<NVALS/ISAAC64_MULTI_LANES;i++){
+    for(l=0;l<ISAAC64_MULTI_LANES;l++){
+      ok&=buf[i*ISAAC64_MULTI_LANES+l]==isaac64_next_uint64(one+l);
+    }
+  }
+  ok1(ok);
+  free(buf);
+  free(multi);
+  return exit_status();
+}
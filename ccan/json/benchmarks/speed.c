@@ -0,0 +1,105 @@
+/* Test speed of encoding and decoding arrays of numbers. */
+#include <ccan/json/json.h>
+#include <ccan/time/time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rand64(void)
+{
+	rand_state ^= rand_state >> 12;
+	rand_state ^= rand_state << 25;
+	rand_state ^= rand_state >> 27;
+	return rand_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double make_number(int kind)
+{
+	switch (kind) {
+	case 0:
+		/* Counters and IDs. */
+		return (double)(int64_t)(rand64() % 100000000) - 50000000;
+	case 1:
+		/* Telemetry with a few decimal places. */
+		return (double)(rand64() % 10000000) / 1000;
+	default:
+		/* Full-precision measurements. */
+		return (double)(rand64() >> 11) / (1ULL << 53) * 1e6;
+	}
+}
+
+static void bench(const char *name, int kind, size_t n, int runs)
+{
+	JsonNode *array = json_mkarray();
+	struct timeabs start;
+	struct timerel encode, decode, old_encode, old_decode;
+	char *str, *p;
+	size_t i, len;
+	double total = 0;
+	int r;
+
+	for (i = 0; i < n; i++)
+		json_append_element(array, json_mknumber(make_number(kind)));
+
+	start = time_now();
+	for (r = 0; r < runs; r++)
+		free(json_encode(array));
+	encode = time_divide(time_between(time_now(), start), runs);
+
+	str = json_encode(array);
+	len = strlen(str);
+
+	start = time_now();
+	for (r = 0; r < runs; r++)
+		json_delete(json_decode(str));
+	decode = time_divide(time_between(time_now(), start), runs);
+
+	/* What the old sprintf()/strtod() conversions cost on the same data. */
+	start = time_now();
+	for (r = 0; r < runs; r++) {
+		JsonNode *node;
+		char buf[64];
+
+		json_foreach(node, array)
+			total += sprintf(buf, "%.17g", node->number_);
+	}
+	old_encode = time_divide(time_between(time_now(), start), runs);
+
+	start = time_now();
+	for (r = 0; r < runs; r++) {
+		for (p = str + 1; *p; p++) {
+			total += strtod(p, &p);
+			if (*p != ',')
+				break;
+		}
+	}
+	old_decode = time_divide(time_between(time_now(), start), runs);
+
+	printf("%s: %zu numbers, %zu bytes\n", name, n, len);
+	printf("  json_encode: %.1f MB/s, %zu ns/number (sprintf: %zu ns/number)\n",
+	       len / 1e6 / (time_to_nsec(encode) / 1e9),
+	       (size_t)(time_to_nsec(encode) / n),
+	       (size_t)(time_to_nsec(old_encode) / n));
+	printf("  json_decode: %.1f MB/s, %zu ns/number (strtod: %zu ns/number)\n",
+	       len / 1e6 / (time_to_nsec(decode) / 1e9),
+	       (size_t)(time_to_nsec(decode) / n),
+	       (size_t)(time_to_nsec(old_decode) / n));
+
+	if (total == 0.5)
+		printf("Unlikely total\n");
+	free(str);
+	json_delete(array);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argv[1] ? atol(argv[1]) : 1000000;
+
+	bench("integers", 0, n, 10);
+	bench("3 decimal places", 1, n, 10);
+	bench("full precision", 2, n, 10);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/* Check that numbers are printed and parsed exactly, and round-trip bit for bit. */
+
+#include <ccan/json/json.c>
+#include <ccan/tap/tap.h>
+
+#include <float.h>
+
+static uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rand64(void)
+{
+	/* xorshift64* */
+	rand_state ^= rand_state >> 12;
+	rand_state ^= rand_state << 25;
+	rand_state ^= rand_state >> 27;
+	return rand_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void test_format(double num, const char *expected)
+{
+	char buf[32];
+	int len = number_to_string(buf, num);
+
+	ok(strcmp(buf, expected) == 0 && len == (int)strlen(expected),
+	   "%.17g formats as %s (got %s)", num, expected, buf);
+}
+
+static bool parses_as(const char *str, double expected)
+{
+	const char *s = str;
+	double num;
+
+	if (!parse_number(&s, &num) || *s != '\0')
+		return false;
+	return double_to_bits(num) == double_to_bits(expected);
+}
+
+static void test_parse(const char *str)
+{
+	ok(parses_as(str, strtod(str, NULL)), "%s parses like strtod", str);
+}
+
+/* Random finite doubles print, and read back, exactly. */
+static void test_round_trip(int count)
+{
+	int i, bad = 0;
+
+	for (i = 0; i < count; i++) {
+		double num = bits_to_double(rand64());
+		char buf[32];
+
+		if (num != num || num - num != 0)
+			continue;
+		if (number_to_string(buf, num) > 24
+		    || !parses_as(buf, num)
+		    || double_to_bits(strtod(buf, NULL)) != double_to_bits(num))
+			bad++;
+	}
+	ok(bad == 0, "%d random doubles round-trip (%d bad)", count, bad);
+}
+
+/* Random decimal strings, including long and out-of-range ones, match strtod. */
+static void test_random_decimals(int count)
+{
+	int i, bad = 0;
+
+	for (i = 0; i < count; i++) {
+		char buf[64], *p = buf;
+		int ndigits = 1 + rand64() % 25;
+		int point = rand64() % (ndigits + 1);
+		int j;
+
+		if (rand64() & 1)
+			*p++ = '-';
+		*p++ = '1' + rand64() % 9;
+		for (j = 1; j < ndigits; j++) {
+			if (j == point)
+				*p++ = '.';
+			*p++ = '0' + rand64() % 10;
+		}
+		sprintf(p, "e%d", (int)(rand64() % 700) - 350);
+
+		if (!parses_as(buf, strtod(buf, NULL)))
+			bad++;
+	}
+	ok(bad == 0, "%d random decimal strings parse like strtod (%d bad)",
+	   count, bad);
+}
+
+int main(void)
+{
+	plan_tests(38);
+
+	test_format(0.0, "0");
+	test_format(-0.0, "-0");
+	test_format(1.0, "1");
+	test_format(-1234.0, "-1234");
+	test_format(9007199254740993.0, "9007199254740992");
+	test_format(1e16, "1e+16");
+	test_format(0.1, "0.1");
+	test_format(0.1 + 0.2, "0.30000000000000004");
+	test_format(1.0 / 3, "0.3333333333333333");
+	test_format(123.456, "123.456");
+	test_format(0.0001, "0.0001");
+	test_format(0.00001, "1e-05");
+	test_format(1e21, "1e+21");
+	test_format(1.23456e+144, "1.23456e+144");
+	test_format(DBL_MAX, "1.7976931348623157e+308");
+	test_format(DBL_MIN, "2.2250738585072014e-308");
+	test_format(4.9406564584124654e-324, "5e-324");
+
+	test_parse("0");
+	test_parse("-0");
+	test_parse("0.3");
+	test_parse("123456789012345678");
+	test_parse("18446744073709551615");
+	test_parse("9007199254740993");
+	test_parse("1.00000000000000011102230246251565404236316680908203125");
+	test_parse("1.00000000000000011102230246251565404236316680908203126");
+	test_parse("2.2250738585072011e-308");
+	test_parse("4.9406564584124654e-324");
+	test_parse("2.4703282292062327e-324");
+	test_parse("1.7976931348623157e308");
+	test_parse("1.7976931348623159e308");
+	test_parse("1e400");
+	test_parse("1e-400");
+	test_parse("0.000000000000000000000000000000000000000000001e45");
+	test_parse("7.2057594037927933e16");
+	test_parse("1e99999999999999999999");
+
+	test_round_trip(1000000);
+	test_random_decimals(1000000);
+
+	ok1(json_decode("[1e400]") != NULL);
+
+	return exit_status();
+}
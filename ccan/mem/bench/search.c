@@ -0,0 +1,192 @@
+/* Test speed of memmem, mempbrkm, memcchr and memeqzero against the
+ * original byte-at-a-time versions (and the C library's memmem), on
+ * typical and adversarial inputs. */
+#include "config.h"
+
+/* Use our memmem() even where the C library has one. */
+#undef HAVE_MEMMEM
+#define HAVE_MEMMEM 0
+#define memmem ccan_memmem
+#include <ccan/mem/mem.c>
+#undef memmem
+
+/* The C library's, whose declaration the rename above swallowed. */
+void *memmem(const void *haystack, size_t haystacklen,
+	     const void *needle, size_t needlelen);
+
+#include <ccan/time/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define SIZE (1 << 20)
+
+static void *old_memmem(const void *haystack, size_t haystacklen,
+			const void *needle, size_t needlelen)
+{
+	const char *p;
+
+	if (needlelen > haystacklen)
+		return NULL;
+	for (p = haystack;
+	     (p + needlelen) <= ((const char *)haystack + haystacklen);
+	     p++)
+		if (memcmp(p, needle, needlelen) == 0)
+			return (void *)p;
+	return NULL;
+}
+
+static void *old_mempbrkm(const void *data_, size_t len,
+			  const void *accept_, size_t accept_len)
+{
+	const char *data = data_, *accept = accept_;
+	size_t i, j;
+
+	for (i = 0; i < len; i++)
+		for (j = 0; j < accept_len; j++)
+			if (accept[j] == data[i])
+				return (void *)&data[i];
+	return NULL;
+}
+
+static void *old_memcchr(void const *data, int c, size_t data_len)
+{
+	char const *p = data;
+	size_t i;
+
+	for (i = 0; i < data_len; i++)
+		if (p[i] != c)
+			return (void *)&p[i];
+	return NULL;
+}
+
+static bool old_memeqzero(const void *data, size_t length)
+{
+	const unsigned char *p = data;
+	size_t len;
+
+	for (len = 0; len < 16; len++) {
+		if (!length)
+			return true;
+		if (*p)
+			return false;
+		p++;
+		length--;
+	}
+	return memcmp(data, p, length) == 0;
+}
+
+static double gbps(struct timeabs start, size_t bytes)
+{
+	return (double)bytes / time_to_nsec(time_between(time_now(), start));
+}
+
+typedef void *(*memmem_fn)(const void *, size_t, const void *, size_t);
+
+static void bench_memmem(const char *what, const char *h, size_t n,
+			 const char *needle, size_t m, size_t runs)
+{
+	const struct {
+		const char *name;
+		memmem_fn fn;
+	} fns[] = {
+		{ "old", old_memmem },
+		{ "ccan", ccan_memmem },
+		{ "libc", memmem },
+	};
+	void *expect = old_memmem(h, n, needle, m);
+	size_t i, r;
+
+	printf("memmem %s, %zu byte needle:", what, m);
+	for (i = 0; i < sizeof(fns) / sizeof(fns[0]); i++) {
+		struct timeabs start;
+		size_t fnruns = runs;
+
+		if (fns[i].fn(h, n, needle, m) != expect) {
+			printf(" %s: WRONG ANSWER\n", fns[i].name);
+			exit(1);
+		}
+		/* The old one is quadratic here: don't wait all day. */
+		if (fns[i].fn == old_memmem && m > 16)
+			fnruns = 1;
+		start = time_now();
+		for (r = 0; r < fnruns; r++)
+			fns[i].fn(h, n, needle, m);
+		printf(" %s %.2f GB/s", fns[i].name, gbps(start, n * fnruns));
+	}
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	size_t runs = argv[1] ? atol(argv[1]) : 100, i, r, m;
+	char *h = malloc(SIZE), *needle = malloc(1024);
+	struct timeabs start;
+	size_t total = 0;
+
+	/* Typical: log-ish text; the needle only appears at the end. */
+	for (i = 0; i < SIZE; i++)
+		h[i] = " etaoinshrdlu0123:\n"[(i * 2654435761u >> 7) % 19];
+	for (m = 4; m <= 256; m *= 4) {
+		for (i = 0; i < m; i++)
+			needle[i] = 'A' + i % 26;
+		memcpy(h + SIZE - m, needle, m);
+		bench_memmem("text", h, SIZE, needle, m, runs);
+	}
+
+	/* Adversarial: aaaa...  looking for aaa...ab. */
+	memset(h, 'a', SIZE);
+	for (m = 4; m <= 256; m *= 4) {
+		memset(needle, 'a', m);
+		needle[m - 1] = 'b';
+		bench_memmem("a*", h, SIZE, needle, m, runs);
+	}
+
+	/* mempbrkm: looking for separators that aren't there. */
+	for (i = 0; i < SIZE; i++)
+		h[i] = 'a' + i % 26;
+	for (m = 2; m <= 16; m *= 2) {
+		void *(*fns[2])(const void *, size_t, const void *, size_t)
+			= { old_mempbrkm, mempbrkm };
+
+		printf("mempbrkm, %zu bytes:", m);
+		for (i = 0; i < 2; i++) {
+			start = time_now();
+			for (r = 0; r < runs; r++)
+				total += fns[i](h, SIZE, ",;:=&|!?{}[]()<>", m) != NULL;
+			printf(" %s %.2f GB/s", i ? "ccan" : "old",
+			       gbps(start, (size_t)SIZE * runs));
+		}
+		printf("\n");
+	}
+
+	memset(h, ' ', SIZE);
+	printf("memcchr:");
+	start = time_now();
+	for (r = 0; r < runs; r++)
+		total += old_memcchr(h, ' ', SIZE) != NULL;
+	printf(" old %.2f GB/s", gbps(start, (size_t)SIZE * runs));
+	start = time_now();
+	for (r = 0; r < runs; r++)
+		total += memcchr(h, ' ', SIZE) != NULL;
+	printf(" ccan %.2f GB/s\n", gbps(start, (size_t)SIZE * runs));
+
+	memset(h, 0, SIZE);
+	for (m = 16; m <= SIZE; m *= 16) {
+		size_t n = runs * (SIZE / m);
+
+		printf("memeqzero, %zu bytes:", m);
+		start = time_now();
+		for (r = 0; r < n; r++)
+			total += old_memeqzero(h + r % 7, m - r % 7);
+		printf(" old %.2f GB/s", gbps(start, m * n));
+		start = time_now();
+		for (r = 0; r < n; r++)
+			total += memeqzero(h + r % 7, m - r % 7);
+		printf(" ccan %.2f GB/s\n", gbps(start, m * n));
+	}
+
+	printf("total = %zu\n", total);
+	free(h);
+	free(needle);
+	return 0;
+}
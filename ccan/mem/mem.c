@@ -3,29 +3,230 @@
 #include "config.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <ccan/mem/mem.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEM_X86 1
+#include <immintrin.h>
+#endif
+
 #if !HAVE_MEMMEM
-void *memmem(const void *haystack, size_t haystacklen,
-	     const void *needle, size_t needlelen)
+/*
+ * Crochemore-Perrin critical factorization: returns the start of the
+ * needle's right half, and its period in *period.  This is the
+ * maximal suffix computation run for both byte orderings, keeping
+ * the longer.
+ */
+static size_t critical_factorization(const unsigned char *n, size_t m,
+				     size_t *period)
 {
-	const char *p;
+	size_t ms[2], p[2], j, k;
+	int rev;
 
-	if (needlelen > haystacklen)
-		return NULL;
+	for (rev = 0; rev < 2; rev++) {
+		ms[rev] = SIZE_MAX;
+		j = 0;
+		k = p[rev] = 1;
+		while (j + k < m) {
+			unsigned char a = n[j + k], b = n[ms[rev] + k];
 
-	p = haystack;
+			if (rev ? b < a : a < b) {
+				j += k;
+				k = 1;
+				p[rev] = j - ms[rev];
+			} else if (a == b) {
+				if (k != p[rev])
+					k++;
+				else {
+					j += p[rev];
+					k = 1;
+				}
+			} else {
+				ms[rev] = j++;
+				k = p[rev] = 1;
+			}
+		}
+	}
 
-	for (p = haystack;
-	     (p + needlelen) <= ((const char *)haystack + haystacklen);
-	     p++)
-		if (memcmp(p, needle, needlelen) == 0)
-			return (void *)p;
+	/* ms[] are one before the suffix, and may be SIZE_MAX. */
+	if (ms[1] + 1 < ms[0] + 1) {
+		*period = p[0];
+		return ms[0] + 1;
+	}
+	*period = p[1];
+	return ms[1] + 1;
+}
 
+/*
+ * Two-way string matching: O(n + m) time, O(1) space.  As in glibc, a
+ * table of shifts for the byte under the window's last position skips
+ * most windows without comparing anything else.
+ */
+static void *memmem_twoway(const unsigned char *h, size_t n,
+			   const unsigned char *needle, size_t m)
+{
+	size_t suffix, period, shift[256], i, j = 0;
+
+	suffix = critical_factorization(needle, m, &period);
+
+	for (i = 0; i < 256; i++)
+		shift[i] = m;
+	for (i = 0; i < m; i++)
+		shift[needle[i]] = m - 1 - i;
+
+	if (memcmp(needle, needle + period, suffix) == 0) {
+		/* Periodic needle: remember how much of the left half matched. */
+		size_t memory = 0;
+
+		while (j <= n - m) {
+			size_t s = shift[h[j + m - 1]];
+
+			if (s) {
+				if (memory && s < period)
+					s = m - period;
+				memory = 0;
+				j += s;
+				continue;
+			}
+			i = suffix > memory ? suffix : memory;
+			while (i < m - 1 && needle[i] == h[i + j])
+				i++;
+			if (i < m - 1) {
+				j += i - suffix + 1;
+				memory = 0;
+				continue;
+			}
+			i = suffix;
+			while (i > memory && needle[i - 1] == h[i - 1 + j])
+				i--;
+			if (i <= memory)
+				return (void *)(h + j);
+			j += period;
+			memory = m - period;
+		}
+	} else {
+		/* Otherwise any mismatch in the left half shifts a long way. */
+		period = (suffix > m - suffix ? suffix : m - suffix) + 1;
+		while (j <= n - m) {
+			size_t s = shift[h[j + m - 1]];
+
+			if (s) {
+				j += s;
+				continue;
+			}
+			i = suffix;
+			while (i < m - 1 && needle[i] == h[i + j])
+				i++;
+			if (i < m - 1) {
+				j += i - suffix + 1;
+				continue;
+			}
+			i = suffix;
+			while (i > 0 && needle[i - 1] == h[i - 1 + j])
+				i--;
+			if (i == 0)
+				return (void *)(h + j);
+			j += period;
+		}
+	}
 	return NULL;
 }
+
+#ifdef MEM_X86
+/*
+ * For short needles, compare the first and last needle bytes against
+ * a vector's worth of haystack positions at once, and only check the
+ * middle where both match.  Checking costs at most MEMMEM_SHORT_MAX
+ * per position, so this stays linear even on adversarial input.
+ */
+#define MEMMEM_SHORT_MAX 32
+
+#define DEFINE_MEMMEM_FILTER(_name, _attr, _vec, _w, _set1, _load,	\
+			     _cmpeq, _and, _movemask)			\
+_attr static void *_name(const unsigned char *h, size_t n,		\
+			 const unsigned char *needle, size_t m)		\
+{									\
+	const _vec first = _set1((char)needle[0]);			\
+	const _vec last = _set1((char)needle[m - 1]);			\
+	size_t i;							\
+									\
+	for (i = 0; i + m - 1 + _w <= n; i += _w) {			\
+		_vec f = _cmpeq(first, _load((const void *)(h + i)));	\
+		_vec l = _cmpeq(last, _load((const void *)(h + i + m - 1))); \
+		uint32_t mask = _movemask(_and(f, l));			\
+									\
+		while (mask) {						\
+			size_t pos = i + __builtin_ctz(mask);		\
+									\
+			if (memcmp(h + pos + 1, needle + 1, m - 2) == 0) \
+				return (void *)(h + pos);		\
+			mask &= mask - 1;				\
+		}							\
+	}								\
+	if (i > n - m)							\
+		return NULL;						\
+	return memmem_twoway(h + i, n - i, needle, m);			\
+}
+
+DEFINE_MEMMEM_FILTER(memmem_sse2, __attribute__((target("sse2"))),
+		     __m128i, 16, _mm_set1_epi8, _mm_loadu_si128,
+		     _mm_cmpeq_epi8, _mm_and_si128, _mm_movemask_epi8)
+DEFINE_MEMMEM_FILTER(memmem_avx2, __attribute__((target("avx2"))),
+		     __m256i, 32, _mm256_set1_epi8, _mm256_loadu_si256,
+		     _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_movemask_epi8)
+
+static void *memmem_short_dispatch(const unsigned char *h, size_t n,
+				   const unsigned char *needle, size_t m);
+/* Replaced by the best version on first use.  Threads may race to do so,
+ * but they all store the same pointer. */
+static void *(*memmem_short_best)(const unsigned char *, size_t,
+				  const unsigned char *, size_t)
+	= memmem_short_dispatch;
+
+static void *memmem_short_dispatch(const unsigned char *h, size_t n,
+				   const unsigned char *needle, size_t m)
+{
+	void *(*impl)(const unsigned char *, size_t,
+		      const unsigned char *, size_t);
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		impl = memmem_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		impl = memmem_sse2;
+	else
+		impl = memmem_twoway;
+	__atomic_store_n(&memmem_short_best, impl, __ATOMIC_RELAXED);
+	return impl(h, n, needle, m);
+}
+
+static void *memmem_short(const unsigned char *h, size_t n,
+			  const unsigned char *needle, size_t m)
+{
+	return __atomic_load_n(&memmem_short_best, __ATOMIC_RELAXED)(h, n,
+								     needle, m);
+}
+#endif /* MEM_X86 */
+
+void *memmem(const void *haystack, size_t haystacklen,
+	     const void *needle, size_t needlelen)
+{
+	if (needlelen > haystacklen)
+		return NULL;
+	if (needlelen == 0)
+		return (void *)haystack;
+	if (needlelen == 1)
+		return memchr(haystack, *(const unsigned char *)needle,
+			      haystacklen);
+#ifdef MEM_X86
+	if (needlelen <= MEMMEM_SHORT_MAX)
+		return memmem_short(haystack, haystacklen, needle, needlelen);
 #endif
+	return memmem_twoway(haystack, haystacklen, needle, needlelen);
+}
+#endif /* !HAVE_MEMMEM */
 
 #if !HAVE_MEMRCHR
 void *memrchr(const void *s, int c, size_t n)
@@ -42,26 +243,187 @@ void *memrchr(const void *s, int c, size_t n)
 }
 #endif
 
-void *mempbrkm(const void *data_, size_t len, const void *accept_, size_t accept_len)
+/* One bit per byte value. */
+struct byteset {
+	uint64_t bits[4];
+};
+
+static void byteset_init(struct byteset *set, const unsigned char *accept,
+			 size_t accept_len)
+{
+	memset(set, 0, sizeof(*set));
+	while (accept_len--) {
+		set->bits[*accept / 64] |= (uint64_t)1 << (*accept % 64);
+		accept++;
+	}
+}
+
+static bool byteset_has(const struct byteset *set, unsigned char c)
 {
-	const char *data = data_, *accept = accept_;
-	size_t i, j;
+	return set->bits[c / 64] & ((uint64_t)1 << (c % 64));
+}
 
-	for (i = 0; i < len; i++)
-		for (j = 0; j < accept_len; j++)
-			if (accept[j] == data[i])
-				return (void *)&data[i];
+static const unsigned char *mempbrkm_generic(const unsigned char *data,
+					     size_t len,
+					     const struct byteset *set)
+{
+	for (; len; data++, len--)
+		if (byteset_has(set, *data))
+			return data;
 	return NULL;
 }
 
+#ifdef MEM_X86
+/*
+ * The "shufti" nibble-table test: byte c is in the set iff
+ * lo[c & 15] & hi[c >> 4] is non-zero.  Each lo entry is a bitmap of
+ * high nibbles, which takes two tables (high nibbles 0-7 and 8-15) to
+ * be exact.
+ */
+struct nibble_tables {
+	unsigned char lo[2][16], hi[2][16];
+};
+
+static void nibble_tables_init(struct nibble_tables *t,
+			       const struct byteset *set)
+{
+	unsigned int c;
+
+	memset(t, 0, sizeof(*t));
+	for (c = 0; c < 256; c++) {
+		if (byteset_has(set, c))
+			t->lo[c >> 7][c & 15] |= 1 << ((c >> 4) & 7);
+	}
+	for (c = 0; c < 16; c++)
+		t->hi[c >> 3][c] = 1 << (c & 7);
+}
+
+#define DEFINE_MEMPBRKM_SHUFTI(_name, _attr, _vec, _w, _bcast, _set1,	\
+			       _load, _and, _or, _srli, _shuffle,	\
+			       _cmpeq, _zero, _movemask, _all)		\
+_attr static const unsigned char *_name(const unsigned char *data,	\
+					size_t len,			\
+					const struct byteset *set)	\
+{									\
+	struct nibble_tables t;						\
+	_vec lo0, lo1, hi0, hi1, mask;					\
+	size_t i;							\
+									\
+	nibble_tables_init(&t, set);					\
+	lo0 = _bcast(t.lo[0]);						\
+	lo1 = _bcast(t.lo[1]);						\
+	hi0 = _bcast(t.hi[0]);						\
+	hi1 = _bcast(t.hi[1]);						\
+	mask = _set1(0x0f);						\
+									\
+	for (i = 0; i + _w <= len; i += _w) {				\
+		_vec c = _load((const void *)(data + i));		\
+		_vec lo = _and(c, mask);				\
+		_vec hi = _and(_srli(c, 4), mask);			\
+		_vec m = _or(_and(_shuffle(lo0, lo), _shuffle(hi0, hi)), \
+			     _and(_shuffle(lo1, lo), _shuffle(hi1, hi))); \
+		uint32_t found = _movemask(_cmpeq(m, _zero())) ^ _all;	\
+									\
+		if (found)						\
+			return data + i + __builtin_ctz(found);		\
+	}								\
+	return mempbrkm_generic(data + i, len - i, set);		\
+}
+
+#define BCAST128(_t) _mm_loadu_si128((const void *)(_t))
+#define BCAST256(_t) _mm256_broadcastsi128_si256(BCAST128(_t))
+
+DEFINE_MEMPBRKM_SHUFTI(mempbrkm_ssse3, __attribute__((target("ssse3"))),
+		       __m128i, 16, BCAST128, _mm_set1_epi8, _mm_loadu_si128,
+		       _mm_and_si128, _mm_or_si128, _mm_srli_epi16,
+		       _mm_shuffle_epi8, _mm_cmpeq_epi8, _mm_setzero_si128,
+		       _mm_movemask_epi8, 0xffff)
+DEFINE_MEMPBRKM_SHUFTI(mempbrkm_avx2, __attribute__((target("avx2"))),
+		       __m256i, 32, BCAST256, _mm256_set1_epi8,
+		       _mm256_loadu_si256, _mm256_and_si256, _mm256_or_si256,
+		       _mm256_srli_epi16, _mm256_shuffle_epi8,
+		       _mm256_cmpeq_epi8, _mm256_setzero_si256,
+		       _mm256_movemask_epi8, 0xffffffff)
+
+static const unsigned char *mempbrkm_dispatch(const unsigned char *data,
+					      size_t len,
+					      const struct byteset *set);
+/* As memmem_short_best. */
+static const unsigned char *(*mempbrkm_best)(const unsigned char *, size_t,
+					     const struct byteset *)
+	= mempbrkm_dispatch;
+
+static const unsigned char *mempbrkm_dispatch(const unsigned char *data,
+					      size_t len,
+					      const struct byteset *set)
+{
+	const unsigned char *(*impl)(const unsigned char *, size_t,
+				     const struct byteset *);
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		impl = mempbrkm_avx2;
+	else if (__builtin_cpu_supports("ssse3"))
+		impl = mempbrkm_ssse3;
+	else
+		impl = mempbrkm_generic;
+	__atomic_store_n(&mempbrkm_best, impl, __ATOMIC_RELAXED);
+	return impl(data, len, set);
+}
+
+static const unsigned char *mempbrkm_impl(const unsigned char *data,
+					  size_t len,
+					  const struct byteset *set)
+{
+	return __atomic_load_n(&mempbrkm_best, __ATOMIC_RELAXED)(data, len,
+								 set);
+}
+#else
+#define mempbrkm_impl mempbrkm_generic
+#endif /* MEM_X86 */
+
+void *mempbrkm(const void *data_, size_t len, const void *accept_, size_t accept_len)
+{
+	const unsigned char *data = data_, *accept = accept_;
+	struct byteset set;
+
+	if (accept_len == 0)
+		return NULL;
+	if (accept_len == 1)
+		return memchr(data, accept[0], len);
+
+	byteset_init(&set, accept, accept_len);
+	return (void *)mempbrkm_impl(data, len, &set);
+}
+
 void *memcchr(void const *data, int c, size_t data_len)
 {
-	char const *p = data;
-	size_t i;
+	const unsigned char *p = data;
+	const uint64_t rep = 0x0101010101010101ULL * (unsigned char)c;
 
-	for (i = 0; i < data_len; i++)
-		if (p[i] != c)
-			return (void *)&p[i];
+	/* Skip whole words of c, four at a time then one at a time. */
+	while (data_len >= 32) {
+		uint64_t w[4];
+
+		memcpy(w, p, sizeof(w));
+		if ((w[0] ^ rep) | (w[1] ^ rep) | (w[2] ^ rep) | (w[3] ^ rep))
+			break;
+		p += 32;
+		data_len -= 32;
+	}
+	while (data_len >= 8) {
+		uint64_t w;
+
+		memcpy(&w, p, sizeof(w));
+		if (w != rep)
+			break;
+		p += 8;
+		data_len -= 8;
+	}
+
+	for (; data_len; p++, data_len--)
+		if (*p != (unsigned char)c)
+			return (void *)p;
 
 	return NULL;
 }
@@ -92,20 +454,35 @@ void memswap(void *a, void *b, size_t n)
 bool memeqzero(const void *data, size_t length)
 {
 	const unsigned char *p = data;
-	size_t len;
-
-	/* Check first 16 bytes manually */
-	for (len = 0; len < 16; len++) {
-		if (!length)
-			return true;
-		if (*p)
-			return false;
-		p++;
-		length--;
+	uint64_t w[8], acc = 0;
+	size_t i;
+
+	/* Small ones a byte at a time: no point setting up. */
+	if (length < sizeof(w[0])) {
+		while (length--)
+			if (*p++)
+				return false;
+		return true;
+	}
+
+	/* Up to 64 bytes a word at a time; the last word may overlap. */
+	if (length <= sizeof(w)) {
+		for (i = 0; i + sizeof(w[0]) <= length; i += sizeof(w[0])) {
+			memcpy(w, p + i, sizeof(w[0]));
+			acc |= w[0];
+		}
+		memcpy(w, p + length - sizeof(w[0]), sizeof(w[0]));
+		return (acc | w[0]) == 0;
 	}
 
-	/* Now we know that's zero, memcmp with self. */
-	return memcmp(data, p, length) == 0;
+	/* Check the first 64 bytes, then the rest is zero iff it's
+	 * equal to itself shifted by 64, which memcmp does fast. */
+	memcpy(w, p, sizeof(w));
+	for (i = 0; i < 8; i++)
+		acc |= w[i];
+	if (acc)
+		return false;
+	return memcmp(data, p + sizeof(w), length - sizeof(w)) == 0;
 }
 
 void memtaint(void *data, size_t len)
@@ -0,0 +1,102 @@
+#include "config.h"
+
+/* Use our memmem() even where the C library has one. */
+#undef HAVE_MEMMEM
+#define HAVE_MEMMEM 0
+#define memmem ccan_memmem
+#include <ccan/mem/mem.c>
+#undef memmem
+
+#include <stdlib.h>
+#include <ccan/tap/tap.h>
+
+/* The original: memcmp at every offset. */
+static const void *naive_memmem(const void *haystack, size_t haystacklen,
+				const void *needle, size_t needlelen)
+{
+	const char *p;
+
+	if (needlelen > haystacklen)
+		return NULL;
+	for (p = haystack;
+	     p + needlelen <= (const char *)haystack + haystacklen;
+	     p++)
+		if (memcmp(p, needle, needlelen) == 0)
+			return p;
+	return NULL;
+}
+
+/* Random strings over a small alphabet, so there are lots of near-misses. */
+static bool check_random(unsigned int alphabet, size_t maxn, size_t maxm,
+			 size_t runs)
+{
+	unsigned char h[1000], nd[200];
+	const void *expect;
+	size_t r, i, n, m;
+
+	for (r = 0; r < runs; r++) {
+		n = random() % maxn;
+		m = random() % maxm + 1;
+		for (i = 0; i < n; i++)
+			h[i] = 'a' + random() % alphabet;
+		/* Half the time, the needle is taken from the haystack. */
+		if (m <= n && random() % 2)
+			memcpy(nd, h + random() % (n - m + 1), m);
+		else
+			for (i = 0; i < m; i++)
+				nd[i] = 'a' + random() % alphabet;
+		expect = naive_memmem(h, n, nd, m);
+		if (ccan_memmem(h, n, nd, m) != expect)
+			return false;
+		/* And the pieces it's made of, whatever this CPU has. */
+		if (m < 2 || m > n)
+			continue;
+		if (memmem_twoway(h, n, nd, m) != expect)
+			return false;
+#ifdef MEM_X86
+		if (m <= MEMMEM_SHORT_MAX && memmem_sse2(h, n, nd, m) != expect)
+			return false;
+#endif
+	}
+	return true;
+}
+
+int main(void)
+{
+	const char *abc = "abc";
+	char *big;
+	size_t i;
+
+	plan_tests(12);
+
+	ok1(ccan_memmem(abc, 3, "", 0) == abc);
+	ok1(ccan_memmem(abc, 3, "abcd", 4) == NULL);
+
+	/* Short needles (vector filter), long ones (two-way only). */
+	ok1(check_random(2, 100, 40, 20000));
+	ok1(check_random(2, 1000, 200, 5000));
+	ok1(check_random(4, 1000, 8, 5000));
+	ok1(check_random(26, 1000, 64, 5000));
+
+	/* Periodic needles, near-matches everywhere. */
+	big = malloc(100000);
+	memset(big, 'a', 100000);
+	big[99999] = 'b';
+	ok1(ccan_memmem(big, 100000, big + 99990, 10) == big + 99990);
+	ok1(ccan_memmem(big, 100000, big + 99900, 100) == big + 99900);
+	ok1(ccan_memmem(big, 99999, big + 99900, 100) == NULL);
+	ok1(ccan_memmem(big, 100000, big + 99000, 1000) == big + 99000);
+
+	/* Every implementation, including the non-vector two-way on its own. */
+	for (i = 0; i < 100000; i++)
+		big[i] = "ab"[(i * 7 / 3) % 2];
+	ok1(memmem_twoway((unsigned char *)big, 100000,
+			  (unsigned char *)big + 5000, 300)
+	    == naive_memmem(big, 100000, big + 5000, 300));
+	ok1(memmem_twoway((unsigned char *)big, 100000,
+			  (unsigned char *)"abababaabb", 10)
+	    == naive_memmem(big, 100000, "abababaabb", 10));
+	free(big);
+
+	return exit_status();
+}
@@ -0,0 +1,121 @@
+#include <ccan/mem/mem.c>
+
+#include <stdlib.h>
+#include <ccan/tap/tap.h>
+
+#define LEN 300
+
+static const unsigned char *naive_mempbrkm(const unsigned char *data,
+					   size_t len,
+					   const unsigned char *accept,
+					   size_t accept_len)
+{
+	size_t i, j;
+
+	for (i = 0; i < len; i++)
+		for (j = 0; j < accept_len; j++)
+			if (accept[j] == data[i])
+				return data + i;
+	return NULL;
+}
+
+static const unsigned char *naive_memcchr(const unsigned char *data, int c,
+					  size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (data[i] != (unsigned char)c)
+			return data + i;
+	return NULL;
+}
+
+static bool check_mempbrkm(void)
+{
+	unsigned char data[LEN], accept[20];
+	struct byteset set;
+	size_t r, i, off, len, alen;
+
+	for (r = 0; r < 20000; r++) {
+		const unsigned char *expect;
+
+		alen = random() % 20;
+		for (i = 0; i < alen; i++)
+			accept[i] = random();
+		/* Mostly misses, so the match is somewhere far along. */
+		for (i = 0; i < LEN; i++) {
+			data[i] = random();
+			if (alen && random() % 64 == 0)
+				data[i] = accept[random() % alen];
+		}
+		off = random() % 16;
+		len = random() % (LEN - off);
+
+		expect = naive_mempbrkm(data + off, len, accept, alen);
+		if (mempbrkm(data + off, len, accept, alen) != expect)
+			return false;
+		if (!alen)
+			continue;
+		byteset_init(&set, accept, alen);
+		if (mempbrkm_generic(data + off, len, &set) != expect)
+			return false;
+#ifdef MEM_X86
+		if (__builtin_cpu_supports("ssse3")
+		    && mempbrkm_ssse3(data + off, len, &set) != expect)
+			return false;
+#endif
+	}
+	return true;
+}
+
+static bool check_memcchr(void)
+{
+	unsigned char data[LEN];
+	size_t r, off, len;
+
+	for (r = 0; r < 20000; r++) {
+		int c = random() % 256;
+
+		memset(data, c, LEN);
+		if (random() % 4)
+			data[random() % LEN] = c + 1 + random() % 255;
+		off = random() % 16;
+		len = random() % (LEN - off);
+		if (memcchr(data + off, c, len) != naive_memcchr(data + off, c, len))
+			return false;
+	}
+	return true;
+}
+
+static bool check_memeqzero(void)
+{
+	unsigned char data[LEN] = { 0 };
+	size_t off, len, i;
+
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len < LEN - off; len++) {
+			if (!memeqzero(data + off, len))
+				return false;
+			/* Any single set byte, inside or just outside. */
+			for (i = 0; i < LEN; i++) {
+				data[i] = 0x10;
+				if (memeqzero(data + off, len)
+				    != (i < off || i >= off + len))
+					return false;
+				data[i] = 0;
+			}
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	plan_tests(3);
+
+	ok1(check_mempbrkm());
+	ok1(check_memcchr());
+	ok1(check_memeqzero());
+
+	return exit_status();
+}
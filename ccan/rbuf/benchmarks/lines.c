@@ -0,0 +1,92 @@
+/* Time reading the lines of a large log: copying with rbuf_read_str(),
+ * in place with rbuf_next_record(), and from rbuf_map().  The arguments
+ * are the log (default: a generated one of the given number of MB,
+ * default 256) and the buffer size for reading (default 65536).
+ */
+#include <ccan/rbuf/rbuf.h>
+#include <ccan/time/time.h>
+#include <ccan/err/err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *gen_log(size_t mb)
+{
+	static char name[] = "/tmp/rbuf-lines.XXXXXX";
+	FILE *f;
+	int fd = mkstemp(name);
+	size_t len = 0;
+
+	if (fd < 0 || !(f = fdopen(fd, "w")))
+		err(1, "Creating %s", name);
+	while (len < mb << 20)
+		len += fprintf(f, "2024-01-01T00:00:%02u.%06u host%u app[%u]: %.*s\n",
+			       (unsigned)(random() % 60),
+			       (unsigned)(random() % 1000000),
+			       (unsigned)(random() % 100),
+			       (unsigned)(random() % 65536),
+			       (int)(random() % 150),
+			       "request handled in some number of milliseconds "
+			       "for some user from some address with some "
+			       "status and some bytes and some referrer and a "
+			       "user agent");
+	if (fclose(f) != 0)
+		err(1, "Writing %s", name);
+	return name;
+}
+
+static void report(const char *what, struct timeabs start,
+		   size_t lines, size_t bytes)
+{
+	double secs = time_to_nsec(time_between(time_now(), start)) / 1e9;
+
+	printf("%s: %.1fM lines/s, %.0fMB/s\n",
+	       what, lines / secs / 1e6, bytes / secs / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = argc > 1 ? argv[1] : NULL;
+	size_t bufsize = argc > 2 ? strtoul(argv[2], NULL, 0) : 65536;
+	size_t lines, bytes, len;
+	struct timeabs start;
+	struct rbuf in;
+	char *p;
+
+	if (!name || atoi(name))
+		name = gen_log(name ? atoi(name) : 256);
+
+	if (!rbuf_open(&in, name, malloc(bufsize), bufsize))
+		err(1, "Opening %s", name);
+	start = time_now();
+	for (lines = bytes = 0; (p = rbuf_read_str(&in, '\n', realloc)); lines++)
+		bytes += strlen(p) + 1;
+	report("rbuf_read_str", start, lines, bytes);
+	close(in.fd);
+	free(in.buf);
+
+	if (!rbuf_open(&in, name, malloc(bufsize), bufsize))
+		err(1, "Opening %s", name);
+	start = time_now();
+	for (lines = bytes = 0;
+	     rbuf_next_record(&in, '\n', &len, realloc);
+	     lines++)
+		bytes += len + 1;
+	report("rbuf_next_record", start, lines, bytes);
+	close(in.fd);
+	free(in.buf);
+
+	start = time_now();
+	if (!rbuf_map(&in, name))
+		err(1, "Mapping %s", name);
+	for (lines = bytes = 0; rbuf_next_record(&in, '\n', &len, NULL); lines++)
+		bytes += len + 1;
+	rbuf_unmap(&in);
+	report("rbuf_map + rbuf_next_record", start, lines, bytes);
+
+	if (argc < 2 || atoi(argv[1]))
+		unlink(name);
+	return 0;
+}
@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 bool rbuf_open(struct rbuf *rbuf, const char *name, char *buf, size_t buf_max)
 {
@@ -17,6 +18,38 @@ bool rbuf_open(struct rbuf *rbuf, const char *name, char *buf, size_t buf_max)
 	return false;
 }
 
+bool rbuf_map(struct rbuf *rbuf, const char *name)
+{
+	struct stat st;
+	void *map = NULL;
+	int fd = open(name, O_RDONLY);
+
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) != 0)
+		goto fail;
+	/* mmap refuses empty mappings. */
+	if (st.st_size) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
+			goto fail;
+	}
+	close(fd);
+	rbuf_init(rbuf, -1, map, st.st_size);
+	rbuf->len = st.st_size;
+	return true;
+
+fail:
+	close(fd);
+	return false;
+}
+
+void rbuf_unmap(struct rbuf *rbuf)
+{
+	if (rbuf->buf)
+		munmap(rbuf->buf, rbuf->buf_end - rbuf->buf);
+}
+
 static size_t rem(const struct rbuf *buf)
 {
 	return buf->buf_end - (buf->start + buf->len);
@@ -53,10 +86,21 @@ static bool enlarge_buf(struct rbuf *buf, size_t len,
 static ssize_t get_more(struct rbuf *rbuf,
 			void *(*resize)(void *buf, size_t len))
 {
-	size_t r;
+	ssize_t r;
+
+	/* Nothing to read into an already-full buffer (eg. rbuf_map). */
+	if (rbuf->fd < 0)
+		return 0;
 
 	if (rbuf->start + rbuf->len == rbuf->buf_end) {
-		if (!enlarge_buf(rbuf, (rbuf->buf_end - rbuf->buf) * 2, resize))
+		/* Slide what's left back down if that frees as much as
+		 * it keeps (or is all we can do), otherwise grow. */
+		if (rbuf->start != rbuf->buf
+		    && (rbuf->start - rbuf->buf >= rbuf->len || !resize)) {
+			memmove(rbuf->buf, rbuf->start, rbuf->len);
+			rbuf->start = rbuf->buf;
+		} else if (!enlarge_buf(rbuf, (rbuf->buf_end - rbuf->buf) * 2,
+					resize))
 			return -1;
 	}
 
@@ -92,39 +136,101 @@ void *rbuf_fill(struct rbuf *rbuf, void *(*resize)(void *buf, size_t len))
 	return rbuf->start;
 }
 
-char *rbuf_read_str(struct rbuf *rbuf, char term,
-		    void *(*resize)(void *buf, size_t len))
+/* memmem, where we know there's more than one byte in delim. */
+static char *find_mem(char *p, size_t len, const char *delim, size_t dlen)
 {
-	char *p, *ret;
-	ssize_t r = 0;
+	char *end = p + len;
+
+	while ((size_t)(end - p) >= dlen) {
+		p = memchr(p, delim[0], end - p - dlen + 1);
+		if (!p)
+			return NULL;
+		if (memcmp(p + 1, delim + 1, dlen - 1) == 0)
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+/* Find the next delimiter, reading more as needed.  Returns NULL with
+ * errno 0 if we hit EOF first. */
+static char *find_delim(struct rbuf *rbuf, const char *delim, size_t dlen,
+			void *(*resize)(void *buf, size_t len))
+{
+	char *p;
+	ssize_t r;
 	size_t prev = 0;
 
 	/* Move back to start of buffer if we're empty. */
 	if (!rbuf->len)
 		rbuf->start = rbuf->buf;
 
-	while (!(p = memchr(rbuf->start + prev, term, rbuf->len - prev))) {
-		prev += r;
+	for (;;) {
+		if (dlen == 1)
+			p = memchr(rbuf->start + prev, *delim, rbuf->len - prev);
+		else
+			p = find_mem(rbuf->start + prev, rbuf->len - prev,
+				     delim, dlen);
+		if (p)
+			return p;
+
+		/* Don't search it all again: only a delimiter which
+		 * straddles what we read next. */
+		if (rbuf->len >= dlen)
+			prev = rbuf->len - dlen + 1;
 		r = get_more(rbuf, resize);
 		if (r < 0)
 			return NULL;
-		/* EOF with no term. */
 		if (r == 0) {
-			/* Nothing read at all? */
-			if (!rbuf->len && term) {
-				errno = 0;
-				return NULL;
-			}
-			/* Put term after input (get_more made room). */
-			assert(rbuf->start + rbuf->len < rbuf->buf_end);
-			rbuf->start[rbuf->len] = '\0';
-			ret = rbuf->start;
-			rbuf_consume(rbuf, rbuf->len);
-			return ret;
+			errno = 0;
+			return NULL;
 		}
 	}
+}
+
+char *rbuf_read_str(struct rbuf *rbuf, char term,
+		    void *(*resize)(void *buf, size_t len))
+{
+	char *p, *ret;
+
+	p = find_delim(rbuf, &term, 1, resize);
+	if (!p) {
+		if (errno)
+			return NULL;
+		/* Nothing read at all? */
+		if (!rbuf->len && term)
+			return NULL;
+		/* Put term after input (get_more made room). */
+		assert(rbuf->start + rbuf->len < rbuf->buf_end);
+		rbuf->start[rbuf->len] = '\0';
+		ret = rbuf->start;
+		rbuf_consume(rbuf, rbuf->len);
+		return ret;
+	}
 	*p = '\0';
 	ret = rbuf->start;
 	rbuf_consume(rbuf, p + 1 - ret);
 	return ret;
 }
+
+char *rbuf_next_record_delim(struct rbuf *rbuf,
+			     const char *delim, size_t delimlen, size_t *len,
+			     void *(*resize)(void *buf, size_t len))
+{
+	char *p, *ret;
+
+	assert(delimlen);
+	p = find_delim(rbuf, delim, delimlen, resize);
+	if (!p) {
+		/* Error, or nothing left at all? */
+		if (errno || !rbuf->len)
+			return NULL;
+		/* Last record, with no delimiter. */
+		p = rbuf->start + rbuf->len;
+		delimlen = 0;
+	}
+	ret = rbuf->start;
+	*len = p - ret;
+	rbuf_consume(rbuf, *len + delimlen);
+	return ret;
+}
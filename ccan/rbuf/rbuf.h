@@ -24,6 +24,8 @@ struct rbuf {
  * @fd: the file descriptor.
  * @buf: the buffer to use.
  * @buf_max: the size of the buffer.
+ *
+ * An @fd of -1 means there is nothing more to read (see rbuf_map()).
  */
 static inline void rbuf_init(struct rbuf *buf,
 			     int fd, char *buffer, size_t buf_max)
@@ -52,6 +54,33 @@ static inline void rbuf_init(struct rbuf *buf,
  */
 bool rbuf_open(struct rbuf *rbuf, const char *name, char *buf, size_t buf_max);
 
+/**
+ * rbuf_map - set up a buffer by mapping an entire file.
+ * @buf: the struct rbuf.
+ * @filename: the filename
+ *
+ * Returns false if the open or mmap fails.  Otherwise the whole file is
+ * in the buffer, read-only, and there is nothing more to read: the
+ * records can be walked with rbuf_next_record() without copying them.
+ * rbuf_read_str() writes to the buffer, so can't be used.
+ *
+ * Example:
+ *	size_t len, lines = 0;
+ *
+ *	if (!rbuf_map(&in, "foo"))
+ *		err(1, "Could not map foo");
+ *	while (rbuf_next_record(&in, '\n', &len, NULL))
+ *		lines++;
+ *	rbuf_unmap(&in);
+ */
+bool rbuf_map(struct rbuf *rbuf, const char *name);
+
+/**
+ * rbuf_unmap - release a buffer set up by rbuf_map.
+ * @buf: the struct rbuf.
+ */
+void rbuf_unmap(struct rbuf *rbuf);
+
 /**
  * rbuf_good_size - get a good buffer size for this fd.
  * @fd: the file descriptor.
@@ -128,7 +157,8 @@ void *rbuf_fill_all(struct rbuf *rbuf, void *(*resize)(void *buf, size_t len));
  * replaces the terminator @term (if any) with NUL, otherwise NUL
  * is placed after EOF.  If you need to, you can tell this has happened
  * because the nul terminator will be at @buf->start (normally it will
- * be at @buf->start - 1).
+ * be at @buf->start - 1).  The string is only valid until the next read
+ * from @buf, which may move what's in the buffer.
  *
  * If there is nothing remaining to be read, NULL is returned with
  * errno set to 0, unless @term is NUL, in which case it returns the
@@ -153,4 +183,60 @@ void *rbuf_fill_all(struct rbuf *rbuf, void *(*resize)(void *buf, size_t len));
 char *rbuf_read_str(struct rbuf *rbuf, char term,
 		    void *(*resize)(void *buf, size_t len));
 
+/**
+ * rbuf_next_record_delim - fill into a buffer up to a delimiter, and consume.
+ * @buf: the struct rbuf
+ * @delim: the bytes which end a record.
+ * @delimlen: the number of bytes in @delim (non-zero).
+ * @len: set to the length of the record.
+ * @resize: the call to resize the buffer.
+ *
+ * Like rbuf_read_str(), but doesn't touch the buffer: it returns a
+ * pointer to the next record and sets @len to its length, not including
+ * @delim.  The record is only valid until the next read from @buf.  The
+ * last record need not end with @delim.
+ *
+ * If @resize is needed and is NULL, or returns false, NULL is returned
+ * with errno set to ENOMEM.  If a read fails, NULL is also returned.  If
+ * there is nothing remaining to be read, NULL is returned with errno
+ * set to 0.
+ *
+ * Example:
+ *	const char *field;
+ *	size_t flen;
+ *
+ *	while ((field = rbuf_next_record_delim(&in, "\r\n", 2, &flen,
+ *					       realloc)) != NULL)
+ *		printf("Field: %.*s\n", (int)flen, field);
+ *	if (errno)
+ *		err(1, "reading foo");
+ */
+char *rbuf_next_record_delim(struct rbuf *rbuf,
+			     const char *delim, size_t delimlen, size_t *len,
+			     void *(*resize)(void *buf, size_t len));
+
+/**
+ * rbuf_next_record - fill into a buffer up to a terminator, and consume.
+ * @buf: the struct rbuf
+ * @term: the character which ends a record.
+ * @len: set to the length of the record.
+ * @resize: the call to resize the buffer.
+ *
+ * rbuf_next_record_delim() with a single-character delimiter.
+ *
+ * Example:
+ *	const char *rec;
+ *	size_t rlen;
+ *
+ *	while ((rec = rbuf_next_record(&in, '\n', &rlen, realloc)) != NULL)
+ *		printf("Line: %.*s\n", (int)rlen, rec);
+ *	if (errno)
+ *		err(1, "reading foo");
+ */
+static inline char *rbuf_next_record(struct rbuf *rbuf, char term, size_t *len,
+				     void *(*resize)(void *buf, size_t len))
+{
+	return rbuf_next_record_delim(rbuf, &term, 1, len, resize);
+}
+
 #endif /* CCAN_RBUF_H */
@@ -0,0 +1,108 @@
+#include <ccan/rbuf/rbuf.h>
+#include <unistd.h>
+
+static ssize_t partial_read(int fd, void *buf, size_t count)
+{
+	return read(fd, buf, count > 3 ? 3 : count);
+}
+#define read partial_read
+
+/* Include the C files directly. */
+#include <ccan/rbuf/rbuf.c>
+#include <ccan/tap/tap.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+static int write_file(const char *contents)
+{
+	int fd = open("run-next-record.txt", O_RDWR|O_CREAT|O_TRUNC, 0600);
+
+	write(fd, contents, strlen(contents));
+	lseek(fd, 0, SEEK_SET);
+	unlink("run-next-record.txt");
+	return fd;
+}
+
+/* Is the next record delimited by delim equal to expect? */
+static bool next_is(struct rbuf *in, const char *delim, const char *expect,
+		    void *(*resize)(void *buf, size_t len))
+{
+	size_t len;
+	const char *p = rbuf_next_record_delim(in, delim, strlen(delim), &len,
+					       resize);
+
+	return p && len == strlen(expect) && memcmp(p, expect, len) == 0;
+}
+
+int main(void)
+{
+	struct rbuf in;
+	char *p;
+	size_t len;
+	int i, fd;
+
+	/* This is how many tests you plan to run */
+	plan_tests(5 + 6 + 5 + 4);
+
+	/* Single terminator: buffer isn't touched, empty records work. */
+	fd = write_file("first\n\nthird line\nlast");
+	rbuf_init(&in, fd, malloc(8), 8);
+	p = rbuf_next_record(&in, '\n', &len, realloc);
+	ok1(p && len == 5 && memcmp(p, "first\n", 6) == 0);
+	ok1(next_is(&in, "\n", "", realloc));
+	ok1(next_is(&in, "\n", "third line", realloc));
+	ok1(next_is(&in, "\n", "last", realloc));
+	ok1(!rbuf_next_record(&in, '\n', &len, realloc) && errno == 0);
+	free(in.buf);
+	close(fd);
+
+	/* Delimiters split across reads, and partial delimiters. */
+	fd = write_file("a\r\nbb\rb\r\r\n\r\nlong record here\r\n");
+	rbuf_init(&in, fd, malloc(8), 8);
+	ok1(next_is(&in, "\r\n", "a", realloc));
+	ok1(next_is(&in, "\r\n", "bb\rb\r", realloc));
+	ok1(next_is(&in, "\r\n", "", realloc));
+	ok1(next_is(&in, "\r\n", "long record here", realloc));
+	ok1(!rbuf_next_record_delim(&in, "\r\n", 2, &len, realloc)
+	    && errno == 0);
+	free(in.buf);
+	close(fd);
+
+	/* The buffer is reused, not grown to hold everything. */
+	fd = open("run-next-record.txt", O_RDWR|O_CREAT|O_TRUNC, 0600);
+	unlink("run-next-record.txt");
+	for (i = 0; i < 1000; i++)
+		write(fd, "line\n", 5);
+	lseek(fd, 0, SEEK_SET);
+	rbuf_init(&in, fd, malloc(8), 8);
+	for (i = 0; next_is(&in, "\n", "line", realloc); i++);
+	ok1(i == 1000 && errno == 0 && in.buf_end - in.buf == 8);
+	free(in.buf);
+	close(fd);
+
+	/* Without resize, records have to fit (once the start's freed). */
+	fd = write_file("12345\n1234567\n123456789\n");
+	rbuf_init(&in, fd, malloc(8), 8);
+	ok1(next_is(&in, "\n", "12345", NULL));
+	ok1(next_is(&in, "\n", "1234567", NULL));
+	ok1(!rbuf_next_record(&in, '\n', &len, NULL) && errno == ENOMEM);
+	ok1(next_is(&in, "\n", "123456789", realloc));
+	ok1(!rbuf_next_record(&in, '\n', &len, NULL) && errno == 0);
+	free(in.buf);
+	close(fd);
+
+	/* A mapped file needs no reads at all. */
+	fd = open("run-next-record.txt", O_RDWR|O_CREAT|O_TRUNC, 0600);
+	write(fd, "one::two::", 10);
+	close(fd);
+	ok1(rbuf_map(&in, "run-next-record.txt"));
+	unlink("run-next-record.txt");
+	ok1(next_is(&in, "::", "one", NULL));
+	ok1(next_is(&in, "::", "two", NULL));
+	ok1(!rbuf_next_record_delim(&in, "::", 2, &len, NULL) && errno == 0);
+	rbuf_unmap(&in);
+
+	return exit_status();
+}
@@ -0,0 +1,78 @@
+/* Time the comparison of input strings with group keys: strgrp built to
+ * score every group (see scale-scan) clusters synthetic log lines of about
+ * the given length (default 60), and the time is divided by the number of
+ * input/key comparisons made.  Most pairs pass the length and character
+ * distribution filters, so this is dominated by LCS.
+ */
+#include <ccan/strgrp/strgrp.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRINGS 5000
+#define TEMPLATES 1000
+
+static void make_line(char *buf, int len, unsigned long t, unsigned long r)
+{
+	unsigned long seed = t * 2654435761UL + 1;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		if ((seed >> 33) % 7 == 0) {
+			buf[i] = ' ';
+		} else if ((seed >> 33) % 5 == 0) {
+			r = r * 6364136223846793005UL + 1;
+			buf[i] = '0' + (r >> 40) % 10;
+		} else {
+			buf[i] = 'a' + (seed >> 40) % 26;
+		}
+	}
+	buf[len] = '\0';
+}
+
+/* New groups hold only the string just added. */
+static int is_new(const struct strgrp_grp *grp)
+{
+	struct strgrp_grp_iter *iter = strgrp_grp_iter_new(grp);
+	int single;
+
+	strgrp_grp_iter_next(iter);
+	single = !strgrp_grp_iter_next(iter);
+	strgrp_grp_iter_free(iter);
+	return single;
+}
+
+int main(int argc, char *argv[])
+{
+	int len = argc > 1 ? atoi(argv[1]) : 60;
+	struct strgrp *ctx = strgrp_new(0.85);
+	unsigned long i, grps = 0, cmps = 0;
+	struct timeabs start;
+	double nsecs;
+	char *buf = malloc(len * 2 + 1);
+
+	start = time_now();
+	for (i = 0; i < STRINGS; i++) {
+		const struct strgrp_grp *grp;
+
+		make_line(buf, len + random() % (len / 10 + 1),
+			  random() % TEMPLATES, random());
+		cmps += grps;
+		grp = strgrp_add(ctx, buf, NULL);
+		if (!grp) {
+			printf("Failed to add %s\n", buf);
+			return 1;
+		}
+		grps += is_new(grp);
+	}
+	nsecs = time_to_nsec(time_between(time_now(), start));
+	strgrp_free(ctx);
+	free(buf);
+
+	printf("%lu strings of length %d, %lu groups: %lu comparisons in %.2fs"
+	       " (%.1fns/comparison)\n", (unsigned long)STRINGS, len, grps,
+	       cmps, nsecs / 1e9, nsecs / cmps);
+	return 0;
+}
@@ -0,0 +1,90 @@
+/* Time clustering of synthetic log lines with strgrp, at sizes from 10k
+ * strings up to the given maximum (default 1M).  There is one message
+ * template per 100 lines, built from a shared vocabulary, and lines fill
+ * the template's fields with random numbers.
+ *
+ * "scale" uses the candidate index; "scale-scan" is the same source built to
+ * score every group, giving the old behaviour for comparison.  Give a
+ * second argument to stop once a size takes longer than that many seconds.
+ */
+#include <ccan/strgrp/strgrp.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VOCAB 2000
+
+static char vocab[VOCAB][12];
+
+static void make_vocab(void)
+{
+	int i, j, len;
+
+	for (i = 0; i < VOCAB; i++) {
+		len = 3 + random() % 8;
+		for (j = 0; j < len; j++)
+			vocab[i][j] = 'a' + random() % 26;
+		vocab[i][len] = '\0';
+	}
+}
+
+/* Line of template t, with fields filled from r. */
+static void make_line(char *buf, unsigned long t, unsigned long r)
+{
+	unsigned long seed = t * 2654435761UL + 1;
+	int words, i;
+
+	words = 5 + seed % 8;
+	buf[0] = '\0';
+	for (i = 0; i < words; i++) {
+		seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+		if (i)
+			strcat(buf, " ");
+		if ((seed >> 33) % 4 == 0) {
+			r = r * 6364136223846793005UL + 1;
+			sprintf(buf + strlen(buf), "%lu", (r >> 40) % 10000);
+		} else {
+			strcat(buf, vocab[(seed >> 33) % VOCAB]);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long max = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	double limit = argc > 2 ? atof(argv[2]) : 0;
+	unsigned long n, i;
+	char buf[256];
+
+	make_vocab();
+	for (n = 10000; n <= max; n *= 10) {
+		struct strgrp *ctx = strgrp_new(0.85);
+		struct strgrp_iter *iter;
+		struct timeabs start = time_now();
+		unsigned long grps = 0;
+		double secs;
+
+		for (i = 0; i < n; i++) {
+			make_line(buf, random() % (n / 100), random());
+			if (!strgrp_add(ctx, buf, NULL)) {
+				printf("Failed to add %s\n", buf);
+				return 1;
+			}
+		}
+		secs = time_to_nsec(time_between(time_now(), start)) / 1e9;
+
+		iter = strgrp_iter_new(ctx);
+		while (strgrp_iter_next(iter))
+			grps++;
+		strgrp_iter_free(iter);
+		strgrp_free(ctx);
+
+		printf("%lu strings, %lu groups: %.2fs (%.1fus/string)\n",
+		       n, grps, secs, secs * 1e6 / n);
+		fflush(stdout);
+		if (limit && secs > limit)
+			break;
+	}
+	return 0;
+}
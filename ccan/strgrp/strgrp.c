@@ -30,8 +30,21 @@
 #include "strgrp.h"
 #include "config.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRGRP_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #define CHAR_N_VALUES (1 << CHAR_BIT)
 
+/* Lengths of the q-grams indexed, see the candidate index below */
+#define Q_MIN 2
+#define Q_MAX 3
+
 typedef darray(struct strgrp_grp *) darray_grp;
 typedef darray(struct strgrp_item *) darray_item;
 
@@ -44,13 +57,57 @@ struct grp_score {
 
 typedef darray(struct grp_score *) darray_score;
 
+typedef darray(int32_t) darray_int32;
+
+struct posting {
+    int32_t grp;
+    int32_t pos;
+};
+
+typedef darray(struct posting) darray_posting;
+
+struct qgram {
+    uint32_t bucket;
+    uint32_t n_postings;
+    int32_t pos;
+};
+
+typedef darray(struct qgram) darray_qgram;
+
+struct grp_count {
+    uint32_t mark;
+    int32_t shared;
+    int32_t counted;
+};
+
+typedef darray(struct grp_count) darray_count;
+
+typedef int32_t (*strpopdot_fn)(const int16_t *a, const int16_t *b);
+
 struct strgrp {
     double threshold;
+    double cos_lo, cos_hi;
+    // The fastest strpopdot_*() the CPU supports
+    strpopdot_fn strpopdot;
     stringmap_grp known;
     unsigned int n_grps;
     darray_grp grps;
     struct grp_score *scores;
+    // The input string being grouped, see grp_for()
+    size_t len;
     int16_t pop[CHAR_N_VALUES];
+    int32_t pop_norm;
+    uint8_t peq_slot[CHAR_N_VALUES];
+    size_t peq_words;
+    uint64_t *peq;
+    // Each thread's LCS bit vector, lcs_stride words apart
+    uint64_t *lcs_v;
+    size_t lcs_stride;
+    darray_posting *index[Q_MAX - Q_MIN + 1];
+    darray_int32 cands;
+    darray_qgram qgrams;
+    darray_count counts;
+    uint32_t mark;
 };
 
 struct strgrp_iter {
@@ -64,6 +121,7 @@ struct strgrp_grp {
     darray_item items;
     int32_t n_items;
     int16_t pop[CHAR_N_VALUES];
+    int32_t pop_norm;
 };
 
 struct strgrp_grp_iter {
@@ -92,18 +150,78 @@ strpopcnt(const char *const str, int16_t pop[CHAR_N_VALUES]) {
     }
 }
 
-static inline double
-strcossim(const int16_t ref[CHAR_N_VALUES], const int16_t key[CHAR_N_VALUES]) {
-    int32_t saibi = 0;
-    int32_t sai2 = 0;
-    int32_t sbi2 = 0;
+// The squared norms are the dot products of each vector with itself, and are
+// kept with the vectors so only the cross term is calculated per comparison.
+// The vector versions are picked by strgrp_new() for the CPU it runs on.
+static int32_t
+strpopdot_scalar(const int16_t a[CHAR_N_VALUES],
+        const int16_t b[CHAR_N_VALUES]) {
+    int32_t dot = 0;
     size_t i;
     for (i = 0; i < CHAR_N_VALUES; i++) {
-        saibi += ref[i] * key[i];
-        sai2 += ref[i] * ref[i];
-        sbi2 += key[i] * key[i];
+        dot += a[i] * b[i];
+    }
+    return dot;
+}
+
+#ifdef STRGRP_X86
+__attribute__((target("sse2"))) static int32_t
+strpopdot_sse2(const int16_t a[CHAR_N_VALUES], const int16_t b[CHAR_N_VALUES]) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i;
+    for (i = 0; i < CHAR_N_VALUES; i += 8) {
+        const __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+        const __m128i vb = _mm_loadu_si128((const __m128i *)&b[i]);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+}
+
+__attribute__((target("avx2"))) static int32_t
+strpopdot_avx2(const int16_t a[CHAR_N_VALUES], const int16_t b[CHAR_N_VALUES]) {
+    __m256i acc = _mm256_setzero_si256();
+    __m128i sum;
+    size_t i;
+    for (i = 0; i < CHAR_N_VALUES; i += 16) {
+        const __m256i va = _mm256_loadu_si256((const __m256i *)&a[i]);
+        const __m256i vb = _mm256_loadu_si256((const __m256i *)&b[i]);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
     }
-    return 1.0 - (2 * acos(saibi / sqrt(sai2 * sbi2)) / M_PI);
+    sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+            _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+static strpopdot_fn
+strpopdot_select(void) {
+#ifdef STRGRP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return strpopdot_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return strpopdot_sse2;
+    }
+#endif
+    return strpopdot_scalar;
+}
+
+static inline double
+strcos(const struct strgrp *const ctx,
+        const int16_t ref[CHAR_N_VALUES], const int32_t ref_norm,
+        const int16_t key[CHAR_N_VALUES], const int32_t key_norm) {
+    const int32_t saibi = ctx->strpopdot(ref, key);
+    return saibi / sqrt((double)ref_norm * key_norm);
+}
+
+static inline double
+strcossim(const double c) {
+    return 1.0 - (2 * acos(c) / M_PI);
 }
 
 /* Low-cost filter functions */
@@ -114,10 +232,34 @@ cossim_correction(const double s)
     return -((s - 0.5) * (s - 0.5)) + 0.33;
 }
 
+// The corrected similarity increases with the cosine, so the cosine at which
+// it reaches the threshold decides the filter without acos() unless they are
+// too close to call. Thresholds it can't reach at all are left to acos().
+static void
+cos_bounds(struct strgrp *const ctx) {
+    const double margin = 1e-9;
+    ctx->cos_lo = -INFINITY;
+    ctx->cos_hi = INFINITY;
+    // s + cossim_correction(s) == -s^2 + 2s + 0.08
+    if (ctx->threshold > 0.08 + margin && ctx->threshold < 1.08 - margin) {
+        const double s = 1 - sqrt(1.08 - ctx->threshold);
+        const double cos_t = cos((1 - s) * M_PI / 2);
+        ctx->cos_lo = cos_t - margin;
+        ctx->cos_hi = cos_t + margin;
+    }
+}
+
 static inline bool
 should_grp_score_cos(const struct strgrp *const ctx,
         struct strgrp_grp *const grp, const char *const str) {
-    const double s1 = strcossim(ctx->pop, grp->pop);
+    const double c = strcos(ctx, ctx->pop, ctx->pop_norm, grp->pop, grp->pop_norm);
+    if (c < ctx->cos_lo) {
+        return false;
+    }
+    if (c > ctx->cos_hi) {
+        return true;
+    }
+    const double s1 = strcossim(c);
     const double s2 = s1 + cossim_correction(s1);
     return ctx->threshold <= s2;
 }
@@ -125,7 +267,7 @@ should_grp_score_cos(const struct strgrp *const ctx,
 static inline bool
 should_grp_score_len(const struct strgrp *const ctx,
         const struct strgrp_grp *const grp, const char *const str) {
-    const double lstr = (double) strlen(str);
+    const double lstr = (double) ctx->len;
     const double lkey = (double) grp->key_len;
     const double lmin = (lstr > lkey) ? lkey : lstr;
     const double s = sqrt((2 * lmin * lmin) / (1.0 * lstr * lstr + lkey * lkey));
@@ -133,60 +275,382 @@ should_grp_score_len(const struct strgrp *const ctx,
 }
 
 /* Scoring - Longest Common Subsequence[2]
+ *
+ * LCS is calculated with the bit-vector algorithm of Allison and Dix as
+ * simplified by Hyyrö[4]. A bit per character of the input string records
+ * whether the LCS of the key so far and the input up to that character is
+ * longer than up to the previous one (as a zero). Each character of the key
+ * updates all of the bits at once with an addition, taking O(ceil(m / 64) * n)
+ * word operations rather than O(m * n) table updates, and no table is
+ * allocated.
+ *
+ * The bits of the input string where each character occurs (its match vector)
+ * are set up once per input by lcs_prepare() rather than per group. Only
+ * characters which occur in the input get a vector, and the others share a
+ * zeroed one. Each thread's bit vector is allocated alongside, rather than
+ * on stacks which may be small and the input long.
  *
  * [2] https://en.wikipedia.org/wiki/Longest_common_subsequence_problem
+ *
+ * [4] L. Allison and T. I. Dix, "A bit-string longest-common-subsequence
+ *     algorithm", https://doi.org/10.1016/0020-0190(86)90091-8 and H. Hyyrö,
+ *     "Bit-parallel LCS-length computation revisited", AWOCA 2004
  */
-#define ROWS 2
-
-static inline int cmi(int i, int j) {
-    return ROWS * j + i;
-}
-
-static inline int16_t
-lcs(const char *const a, const char *const b) {
-    const int lb = strlen(b);
-    const int lbp1 = lb + 1;
-    int16_t *const lookup = calloc(ROWS * lbp1, sizeof(int16_t));
-    if (!lookup) {
-        return -1;
-    }
-    int ia, ib;
-    for (ia = (strlen(a) - 1); ia >= 0; ia--) {
-        const char iav = a[ia];
-        const int ial = (ia + 1) & 1; // ia last
-        for (ib = lb - 1; ib >= 0; ib--) {
-            const char ibv = b[ib];
-            const int iac = ia & 1; // ia current
-            const int ibl = ib + 1; // ib last
-            // don't need separate "ib current" as it's just ib
-            if (iav == ibv) {
-                lookup[cmi(iac, ib)] = 1 + lookup[cmi(ial, ibl)];
-            } else {
-                const int16_t valb = lookup[cmi(ial, ib)];
-                const int16_t vabl = lookup[cmi(iac, ibl)];
-                lookup[cmi(iac, ib)] = (valb > vabl) ? valb : vabl;
-            }
+
+static inline int
+popcount64(uint64_t x) {
+#if HAVE_BUILTIN_POPCOUNTL && ULONG_MAX >= UINT64_MAX
+    return __builtin_popcountl(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) {
+        n++;
+    }
+    return n;
+#endif
+}
+
+static inline size_t
+lcs_threads(void) {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+static inline size_t
+lcs_thread(void) {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+static bool
+lcs_prepare(struct strgrp *const ctx, const char *const str) {
+    const size_t words = (ctx->len + 63) / 64;
+    size_t n_slots = 1;
+    size_t i, n_v;
+    memset(ctx->peq_slot, 0, sizeof(ctx->peq_slot));
+    for (i = 0; i < CHAR_N_VALUES; i++) {
+        if (ctx->pop[i]) {
+            ctx->peq_slot[i] = n_slots++;
         }
     }
-    int16_t result = lookup[0];
-    free(lookup);
-    return result;
+    if (!ctx->peq) {
+        ctx->peq = tal_arr(ctx, uint64_t, n_slots * words);
+    } else if (tal_count(ctx->peq) < n_slots * words
+            && !tal_resize(&ctx->peq, n_slots * words)) {
+        return false;
+    }
+    if (!ctx->peq) {
+        return false;
+    }
+    memset(ctx->peq, 0, n_slots * words * sizeof(*ctx->peq));
+    for (i = 0; i < ctx->len; i++) {
+        const size_t slot = ctx->peq_slot[(unsigned char)str[i]];
+        ctx->peq[slot * words + i / 64] |= (uint64_t)1 << (i % 64);
+    }
+    ctx->peq_words = words;
+    // Whole cache lines apart, so threads don't share them
+    ctx->lcs_stride = (words + 7) & ~(size_t)7;
+    n_v = lcs_threads() * ctx->lcs_stride;
+    if (!ctx->lcs_v) {
+        ctx->lcs_v = tal_arr(ctx, uint64_t, n_v);
+    } else if (tal_count(ctx->lcs_v) < n_v && !tal_resize(&ctx->lcs_v, n_v)) {
+        return false;
+    }
+    return ctx->lcs_v != NULL;
 }
 
-#undef ROWS
+static inline int
+lcs(const struct strgrp *const ctx, const char *const key, size_t key_len) {
+    const size_t words = ctx->peq_words;
+    uint64_t *const v = &ctx->lcs_v[lcs_thread() * ctx->lcs_stride];
+    size_t i, w;
+    int result = 0;
+    for (w = 0; w < words; w++) {
+        v[w] = ~(uint64_t)0;
+    }
+    for (i = 0; i < key_len; i++) {
+        const uint64_t *const peq =
+            &ctx->peq[ctx->peq_slot[(unsigned char)key[i]] * words];
+        uint64_t carry = 0;
+        for (w = 0; w < words; w++) {
+            const uint64_t u = v[w] & peq[w];
+            const uint64_t t = v[w] + u;
+            const uint64_t sum = t + carry;
+            carry = (t < u) | (sum < t);
+            v[w] = sum | (v[w] - u);
+        }
+    }
+    // Bits past the end of the input are ignored
+    for (w = 0; w < words; w++) {
+        uint64_t zeros = ~v[w];
+        if (w == words - 1 && ctx->len % 64) {
+            zeros &= ((uint64_t)1 << (ctx->len % 64)) - 1;
+        }
+        result += popcount64(zeros);
+    }
+    return result;
+}
 
 static inline double
-nlcs(const char *const a, const char *const b) {
-    const double lcss = lcs(a, b);
-    const double la = (double) strlen(a);
-    const double lb = (double) strlen(b);
+nlcs(const struct strgrp *const ctx, const char *const key, size_t key_len) {
+    const double lcss = lcs(ctx, key, key_len);
+    const double la = (double) key_len;
+    const double lb = (double) ctx->len;
     const double s = sqrt((2 * lcss * lcss) / (la * la + lb * lb));
     return s;
 }
 
 static inline double
-grp_score(const struct strgrp_grp *const grp, const char *const str) {
-    return nlcs(grp->key, str);
+grp_score(const struct strgrp *const ctx,
+        const struct strgrp_grp *const grp) {
+    return nlcs(ctx, grp->key, grp->key_len);
+}
+
+/* Candidate index - q-gram filtering[3]
+ *
+ * Group keys are indexed by their q-grams (substrings of length q), hashed
+ * into INDEX_SIZE buckets which each list, in order, the groups whose keys
+ * contain a q-gram of the bucket and where. An input string which reaches the
+ * threshold against a key has a long common subsequence with it, and the
+ * q-grams the subsequence preserves are bounded below by its length, as are
+ * the distances they can move. If they must share at least T of the input's n
+ * q-grams, every such group is in the bucket of at least one of any n - T + 1
+ * of them, so only the buckets of the n - T + 1 rarest are probed for
+ * candidates. The buckets of the others are then counted, and candidates
+ * with fewer than T (for the length of their key) are dropped. Other groups
+ * can't reach the threshold, so the group picked is the same as when scoring
+ * all of them.
+ *
+ * Longer q-grams are more selective but give a useful bound only for higher
+ * thresholds and longer strings, so trigrams are tried before bigrams. When
+ * neither gives a bound every group is scored as before.
+ *
+ * [3] https://doi.org/10.1016/0304-3975(92)90143-4
+ */
+#define INDEX_BITS 16
+#define INDEX_SIZE (1 << INDEX_BITS)
+
+/* Below this many groups, scoring all of them is cheaper than the index */
+#ifndef STRGRP_INDEX_MIN_GRPS
+#define STRGRP_INDEX_MIN_GRPS 64
+#endif
+
+struct qgram_bound {
+    // The fewest q-grams shared, or 0 if there may be none
+    long shared;
+    // Range of key position minus input position of a shared q-gram
+    long shift_min;
+    long shift_max;
+};
+
+static inline uint32_t
+qgram_bucket(const char *const str, const int q) {
+    uint32_t g = 0;
+    int i;
+    for (i = 0; i < q; i++) {
+        g = (g << 8) | (unsigned char)str[i];
+    }
+    return (g * 2654435761U) >> (32 - INDEX_BITS);
+}
+
+/* The length of common subsequence an input of length la needs with a key of
+ * length lb for nlcs() to reach the threshold */
+static inline long
+min_lcs(const double threshold, const long la, const long lb) {
+    // nlcs() needs l >= t * sqrt((la^2 + lb^2) / 2)
+    return (long)ceil(threshold * sqrt((la * la + lb * lb) / 2.0) - 1e-9);
+}
+
+/* The fewest q-grams an input of length la shares with a key of length lb,
+ * given they have a common subsequence of length l.
+ *
+ * The subsequence leaves la - l characters of the input and lb - l of the key
+ * unmatched. Each unmatched input character breaks at most q of the input's
+ * q-grams, and each unmatched key character at most q - 1 more (and vice
+ * versa). */
+static inline long
+shared_qgrams(const long la, const long lb, const long l, const int q) {
+    const long ta = (la - q + 1) - q * (la - l) - (q - 1) * (lb - l);
+    const long tb = (lb - q + 1) - q * (lb - l) - (q - 1) * (la - l);
+    return (ta > tb) ? ta : tb;
+}
+
+/* Bounds the q-grams an input of length la shares with any key for which
+ * nlcs() reaches the threshold. Preserved q-grams move by at most the number
+ * of unmatched characters of the key (forward) or the input (backward). */
+static struct qgram_bound
+qgram_bound(const double threshold, const long la, const int q) {
+    struct qgram_bound b = { la - q + 1, 0, 0 };
+    long lb, lb_max;
+    if (threshold <= 0 || threshold > 1 || b.shared <= 0) {
+        b.shared = 0;
+        return b;
+    }
+    // Longer keys can't reach the threshold
+    lb_max = (long)(la * sqrt(2 / (threshold * threshold) - 1)) + 1;
+    for (lb = 1; lb <= lb_max; lb++) {
+        const long l = min_lcs(threshold, la, lb);
+        long t;
+        if (l > la || l > lb) {
+            continue;
+        }
+        t = shared_qgrams(la, lb, l, q);
+        if (t <= 0) {
+            b.shared = 0;
+            return b;
+        }
+        if (t < b.shared) {
+            b.shared = t;
+        }
+        if (l - la < b.shift_min) {
+            b.shift_min = l - la;
+        }
+        if (lb - l > b.shift_max) {
+            b.shift_max = lb - l;
+        }
+    }
+    return b;
+}
+
+static void
+index_grp(darray_posting *const index, const int q,
+        const struct strgrp_grp *const grp, const int32_t i) {
+    size_t j;
+    for (j = 0; j + q <= grp->key_len; j++) {
+        struct posting p = { i, j };
+        darray_push(index[qgram_bucket(&grp->key[j], q)], p);
+    }
+}
+
+static darray_posting *
+build_index(struct strgrp *const ctx, const int q) {
+    darray_posting *index = tal_arrz(ctx, darray_posting, INDEX_SIZE);
+    int32_t i;
+    if (!index) {
+        return NULL;
+    }
+    for (i = 0; i < ctx->n_grps; i++) {
+        index_grp(index, q, darray_item(ctx->grps, i), i);
+    }
+    ctx->index[q - Q_MIN] = index;
+    return index;
+}
+
+static void
+free_index(struct strgrp *const ctx) {
+    int q;
+    size_t i;
+    for (q = Q_MIN; q <= Q_MAX; q++) {
+        darray_posting *index = ctx->index[q - Q_MIN];
+        if (index) {
+            for (i = 0; i < INDEX_SIZE; i++) {
+                darray_free(index[i]);
+            }
+        }
+    }
+    darray_free(ctx->cands);
+    darray_free(ctx->qgrams);
+    darray_free(ctx->counts);
+}
+
+static int
+qgram_cmp(const void *a, const void *b) {
+    const struct qgram *qa = a, *qb = b;
+    if (qa->n_postings != qb->n_postings) {
+        return (qa->n_postings < qb->n_postings) ? -1 : 1;
+    }
+    return (qa->pos > qb->pos) - (qa->pos < qb->pos);
+}
+
+/* Finds the groups which may share enough of the input's q-grams: those in
+ * the buckets of its rarest q-grams, then counting the buckets of the rest */
+static void
+index_candidates(struct strgrp *const ctx, const darray_posting *const index,
+        const int q, const struct qgram_bound *const bound,
+        const char *const str, const size_t len) {
+    const size_t n = len - q + 1;
+    const size_t probe = n - bound->shared + 1;
+    size_t i, j;
+    darray_resize(ctx->qgrams, n);
+    for (i = 0; i < n; i++) {
+        struct qgram *g = &darray_item(ctx->qgrams, i);
+        g->bucket = qgram_bucket(&str[i], q);
+        g->n_postings = darray_size(index[g->bucket]);
+        g->pos = i;
+    }
+    qsort(ctx->qgrams.item, n, sizeof(struct qgram), qgram_cmp);
+    // Counts are kept apart from the groups to stay in cache
+    darray_resize0(ctx->counts, ctx->n_grps);
+    if (!++ctx->mark) {
+        struct grp_count *c;
+        darray_foreach(c, ctx->counts) {
+            c->mark = 0;
+        }
+        ctx->mark++;
+    }
+    darray_resize(ctx->cands, 0);
+    for (i = 0; i < n; i++) {
+        const struct qgram *g = &darray_item(ctx->qgrams, i);
+        const struct posting *p;
+        darray_foreach(p, index[g->bucket]) {
+            struct grp_count *c;
+            if (p->pos - g->pos < bound->shift_min
+                    || p->pos - g->pos > bound->shift_max) {
+                continue;
+            }
+            c = &darray_item(ctx->counts, p->grp);
+            if (c->mark == ctx->mark) {
+                // Count each of the input's q-grams once per group
+                if (c->counted != i) {
+                    c->counted = i;
+                    c->shared++;
+                }
+            } else if (i < probe) {
+                c->mark = ctx->mark;
+                c->counted = i;
+                c->shared = 1;
+                darray_push(ctx->cands, p->grp);
+            }
+        }
+    }
+    for (i = j = 0; i < darray_size(ctx->cands); i++) {
+        const int32_t g = darray_item(ctx->cands, i);
+        const struct strgrp_grp *grp = darray_item(ctx->grps, g);
+        const long l = min_lcs(ctx->threshold, len, grp->key_len);
+        if (l <= (long)len && l <= (long)grp->key_len
+                && darray_item(ctx->counts, g).shared
+                    >= shared_qgrams(len, grp->key_len, l, q)) {
+            darray_item(ctx->cands, j++) = g;
+        }
+    }
+    darray_resize(ctx->cands, j);
+}
+
+/* Fills ctx->cands with the groups worth scoring against str */
+static void
+candidates(struct strgrp *const ctx, const char *const str) {
+    const size_t len = ctx->len;
+    int q, i;
+    if (ctx->n_grps >= STRGRP_INDEX_MIN_GRPS) {
+        for (q = Q_MAX; q >= Q_MIN; q--) {
+            const struct qgram_bound b = qgram_bound(ctx->threshold, len, q);
+            darray_posting *index = ctx->index[q - Q_MIN];
+            if (b.shared > 0 && (index || (index = build_index(ctx, q)))) {
+                index_candidates(ctx, index, q, &b, str, len);
+                return;
+            }
+        }
+    }
+    darray_resize(ctx->cands, ctx->n_grps);
+    for (i = 0; i < ctx->n_grps; i++) {
+        darray_item(ctx->cands, i) = i;
+    }
 }
 
 /* Structure management */
@@ -240,12 +704,19 @@ static struct strgrp_grp *
 add_grp(struct strgrp *const ctx, const char *const str,
         void *const data) {
     struct strgrp_grp *b = new_grp(ctx, str, data);
+    int q;
     if (!b) {
         return NULL;
     }
     memcpy(b->pop, ctx->pop, sizeof(ctx->pop));
+    b->pop_norm = ctx->pop_norm;
     darray_push(ctx->grps, b);
     ctx->n_grps++;
+    for (q = Q_MIN; q <= Q_MAX; q++) {
+        if (ctx->index[q - Q_MIN]) {
+            index_grp(ctx->index[q - Q_MIN], q, b, ctx->n_grps - 1);
+        }
+    }
     if (ctx->scores) {
         if (!tal_resize(&ctx->scores, ctx->n_grps)) {
             return NULL;
@@ -263,9 +734,14 @@ struct strgrp *
 strgrp_new(const double threshold) {
     struct strgrp *ctx = talz(NULL, struct strgrp);
     ctx->threshold = threshold;
+    cos_bounds(ctx);
+    ctx->strpopdot = strpopdot_select();
     stringmap_init(ctx->known, NULL);
     // n threads compare strings
     darray_init(ctx->grps);
+    darray_init(ctx->cands);
+    darray_init(ctx->qgrams);
+    darray_init(ctx->counts);
     return ctx;
 }
 
@@ -276,11 +752,15 @@ cache(struct strgrp *const ctx, struct strgrp_grp *const grp,
 }
 
 static struct strgrp_grp *
-grp_for(struct strgrp *const ctx, const char *const str) {
+grp_for(struct strgrp *const ctx, const char *const str, bool *const failed) {
     // Ensure ctx->pop is always populated. Returning null here indicates a new
     // group should be created, at which point add_grp() copies ctx->pop into
-    // the new group's struct.
+    // the new group's struct, unless *failed is set because we ran out of
+    // memory.
+    *failed = false;
+    ctx->len = strlen(str);
     strpopcnt(str, ctx->pop);
+    ctx->pop_norm = ctx->strpopdot(ctx->pop, ctx->pop);
     if (!ctx->n_grps) {
         return NULL;
     }
@@ -290,25 +770,37 @@ grp_for(struct strgrp *const ctx, const char *const str) {
             return *grp;
         }
     }
-    int i;
+    int i, n;
+    candidates(ctx, str);
+    n = darray_size(ctx->cands);
+    if (n && !lcs_prepare(ctx, str)) {
+        *failed = true;
+        return NULL;
+    }
 // Keep ccanlint happy in reduced feature mode
 #if HAVE_OPENMP
     #pragma omp parallel for schedule(dynamic)
 #endif
-    for (i = 0; i < ctx->n_grps; i++) {
-        struct strgrp_grp *grp = darray_item(ctx->grps, i);
+    for (i = 0; i < n; i++) {
+        struct strgrp_grp *grp =
+            darray_item(ctx->grps, darray_item(ctx->cands, i));
         ctx->scores[i].grp = grp;
         ctx->scores[i].score = 0;
         if (should_grp_score_len(ctx, grp, str)) {
             if (should_grp_score_cos(ctx, grp, str)) {
-                ctx->scores[i].score = grp_score(grp, str);
+                ctx->scores[i].score = grp_score(ctx, grp);
             }
         }
     }
+    // Candidates may be out of order, so break ties on the earliest group
     struct grp_score *max = NULL;
-    for (i = 0; i < ctx->n_grps; i++) {
-        if (!max || ctx->scores[i].score > max->score) {
+    int32_t max_i = 0;
+    for (i = 0; i < n; i++) {
+        const int32_t gi = darray_item(ctx->cands, i);
+        if (!max || ctx->scores[i].score > max->score
+                || (ctx->scores[i].score == max->score && gi < max_i)) {
             max = &(ctx->scores[i]);
+            max_i = gi;
         }
     }
     return (max && max->score >= ctx->threshold) ? max->grp : NULL;
@@ -316,7 +808,8 @@ grp_for(struct strgrp *const ctx, const char *const str) {
 
 const struct strgrp_grp *
 strgrp_grp_for(struct strgrp *const ctx, const char *const str) {
-    return grp_for(ctx, str);
+    bool failed;
+    return grp_for(ctx, str, &failed);
 }
 
 const struct strgrp_grp *
@@ -326,17 +819,22 @@ strgrp_add(struct strgrp *const ctx, const char *const str,
     // grp_for() populates the ctx->pop memory. add_grp() copies this memory
     // into the strgrp_grp that it creates. It's assumed the ctx->pop memory
     // has not been modified between the grp_for() and add_grp() calls.
-    struct strgrp_grp *pick = grp_for(ctx, str);
+    bool failed;
+    struct strgrp_grp *pick = grp_for(ctx, str, &failed);
+    if (failed) {
+        return NULL;
+    }
     if (pick) {
         inserted = add_item(pick, str, data);
     } else {
         pick = add_grp(ctx, str, data);
         inserted = (NULL != pick);
     }
-    if (inserted) {
-        assert(NULL != pick);
-        cache(ctx, pick, str);
+    if (!inserted) {
+        return NULL;
     }
+    assert(NULL != pick);
+    cache(ctx, pick, str);
     return pick;
 }
 
@@ -401,6 +899,7 @@ strgrp_item_value(const struct strgrp_item *const item) {
 
 void
 strgrp_free(struct strgrp *const ctx) {
+    free_index(ctx);
     darray_free(ctx->grps);
     stringmap_free(ctx->known);
     tal_free(ctx);
@@ -30,9 +30,9 @@ strgrp_new(double threshold);
  * The returned group is the group providing the maximum score that is equal to
  * or above the configured threshold.
  *
- * @return A matched group, or NULL if no reasonable group is found. Ownership
- * of the returned pointer resides with the strgrp instance and it becomes
- * invalid if the strgrp instance is freed.
+ * @return A matched group, or NULL if no reasonable group is found or memory
+ * could not be allocated. Ownership of the returned pointer resides with the
+ * strgrp instance and it becomes invalid if the strgrp instance is freed.
  */
 const struct strgrp_grp *
 strgrp_grp_for(struct strgrp *ctx, const char *str);
@@ -48,9 +48,9 @@ strgrp_grp_for(struct strgrp *ctx, const char *str);
  *     ownership of the pointer, but for correctness its lifetime should be at
  *     least equal to the lifetime of the strgrp instance.
  *
- * Returns the group to which the item was added. Ownership of the returned
- * pointer resides with the strgrp instance and it becomes invalid if the
- * strgrp instance is freed.
+ * Returns the group to which the item was added, or NULL if memory could not
+ * be allocated. Ownership of the returned pointer resides with the strgrp
+ * instance and it becomes invalid if the strgrp instance is freed.
  */
 const struct strgrp_grp *
 strgrp_add(struct strgrp *ctx, const char *str, void *data);
@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include "ccan/tal/tal.h"
+#include "../test/helpers.h"
+
+// Fail the next allocation only
+static bool fail_next;
+
+static void *
+alloc(size_t size) {
+    if (fail_next) {
+        fail_next = false;
+        return NULL;
+    }
+    return malloc(size);
+}
+
+static void *
+resize(void *p, size_t size) {
+    if (fail_next) {
+        fail_next = false;
+        return NULL;
+    }
+    return realloc(p, size);
+}
+
+static void
+ignore(const char *msg) {
+    (void)msg;
+}
+
+int main(void) {
+    struct strgrp *ctx;
+    const struct strgrp_grp *grp;
+    plan_tests(3);
+    tal_set_backend(alloc, resize, NULL, ignore);
+    create(ctx, DEFAULT_SIMILARITY);
+    grp = strgrp_add(ctx, "aaaaaaaaaa", NULL);
+    ok1(grp);
+    // Scoring against the existing group needs memory, and failing to get it
+    // mustn't look like a new group
+    fail_next = true;
+    ok1(!strgrp_add(ctx, "aaaaaaaaab", NULL));
+    ok1(strgrp_add(ctx, "aaaaaaaaab", NULL) == grp);
+    strgrp_free(ctx);
+    return exit_status();
+}
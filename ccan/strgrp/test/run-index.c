@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include "../strgrp.c"
+#include "../test/helpers.h"
+
+#define N_TEMPLATES 300
+#define N_STRINGS 1500
+#define MAX_LEN 80
+
+/* LCS by dynamic programming, as before bit-parallel scoring */
+static int
+ref_lcs(const char *const a, const char *const b) {
+    const int la = strlen(a), lb = strlen(b);
+    int *const row = calloc(lb + 1, sizeof(int));
+    int ia, ib, result;
+    for (ia = 0; ia < la; ia++) {
+        int diag = 0;
+        for (ib = 1; ib <= lb; ib++) {
+            const int up = row[ib];
+            row[ib] = (a[ia] == b[ib - 1]) ? diag + 1
+                : (up > row[ib - 1] ? up : row[ib - 1]);
+            diag = up;
+        }
+    }
+    result = row[lb];
+    free(row);
+    return result;
+}
+
+static double
+ref_score(const struct strgrp_grp *const grp, const char *const str) {
+    const double lcss = ref_lcs(grp->key, str);
+    const double la = (double) strlen(grp->key);
+    const double lb = (double) strlen(str);
+    return sqrt((2 * lcss * lcss) / (la * la + lb * lb));
+}
+
+static bool
+ref_score_cos(const struct strgrp *const ctx,
+        const struct strgrp_grp *const grp) {
+    int32_t saibi = 0, sai2 = 0, sbi2 = 0;
+    double s1;
+    int i;
+    for (i = 0; i < CHAR_N_VALUES; i++) {
+        saibi += ctx->pop[i] * grp->pop[i];
+        sai2 += ctx->pop[i] * ctx->pop[i];
+        sbi2 += grp->pop[i] * grp->pop[i];
+    }
+    s1 = 1.0 - (2 * acos(saibi / sqrt(sai2 * sbi2)) / M_PI);
+    return ctx->threshold <= s1 + cossim_correction(s1);
+}
+
+/* The group grp_for() picked before the index, scored as it was then: the
+ * best of all of them */
+static struct strgrp_grp *
+scan_grp_for(struct strgrp *const ctx, const char *const str) {
+    struct strgrp_grp *best = NULL;
+    double best_score = 0;
+    int i;
+    ctx->len = strlen(str);
+    strpopcnt(str, ctx->pop);
+    if (!ctx->n_grps) {
+        return NULL;
+    }
+    {
+        struct strgrp_grp **const grp = stringmap_lookup(ctx->known, str);
+        if (grp) {
+            return *grp;
+        }
+    }
+    for (i = 0; i < ctx->n_grps; i++) {
+        struct strgrp_grp *grp = darray_item(ctx->grps, i);
+        double score = 0;
+        if (should_grp_score_len(ctx, grp, str)
+                && ref_score_cos(ctx, grp)) {
+            score = ref_score(grp, str);
+        }
+        if (!best || score > best_score) {
+            best = grp;
+            best_score = score;
+        }
+    }
+    return (best_score >= ctx->threshold) ? best : NULL;
+}
+
+static void
+random_string(char *str, int len) {
+    int i;
+    for (i = 0; i < len; i++) {
+        str[i] = (random() % 6) ? 'a' + random() % 26 : ' ';
+    }
+    str[len] = '\0';
+}
+
+/* Checks grouping is the same as scan_grp_for()'s, using q-grams of length q
+ * (or none) for the index */
+static bool
+same_groups(const double threshold, const int q) {
+    static char templates[N_TEMPLATES][MAX_LEN + 1];
+    char str[MAX_LEN + 1];
+    struct strgrp *ctx = strgrp_new(threshold);
+    bool same = true;
+    int i, j;
+
+    for (i = 0; i < N_TEMPLATES; i++) {
+        random_string(templates[i], 10 + random() % (MAX_LEN - 10));
+    }
+    for (i = 0; i < N_STRINGS && same; i++) {
+        const struct strgrp_grp *expect, *pick;
+        int n_grps = ctx->n_grps;
+        strcpy(str, templates[random() % N_TEMPLATES]);
+        // Change up to about a fifth of the characters
+        for (j = random() % (strlen(str) / 5 + 1); j > 0; j--) {
+            str[random() % strlen(str)] = 'a' + random() % 26;
+        }
+        expect = scan_grp_for(ctx, str);
+        pick = strgrp_add(ctx, str, NULL);
+        if (expect) {
+            same = (pick == expect);
+        } else {
+            same = (ctx->n_grps == n_grps + 1);
+        }
+    }
+    if (q) {
+        same = same && ctx->index[q - Q_MIN];
+    } else {
+        same = same && !ctx->index[0] && !ctx->index[1];
+    }
+    strgrp_free(ctx);
+    return same;
+}
+
+int main(void) {
+    plan_tests(3);
+    ok1(same_groups(0.9, 3));
+    ok1(same_groups(0.75, 2));
+    // Too low a threshold to bound shared q-grams
+    ok1(same_groups(0.5, 0));
+    return exit_status();
+}
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include "../strgrp.c"
+#include "../test/helpers.h"
+
+#define N_PAIRS 500
+#define MAX_LEN 300
+
+static int
+ref_lcs(const char *const a, const char *const b) {
+    const int la = strlen(a), lb = strlen(b);
+    int *const row = calloc(lb + 1, sizeof(int));
+    int ia, ib, result;
+    for (ia = 0; ia < la; ia++) {
+        int diag = 0;
+        for (ib = 1; ib <= lb; ib++) {
+            const int up = row[ib];
+            row[ib] = (a[ia] == b[ib - 1]) ? diag + 1
+                : (up > row[ib - 1] ? up : row[ib - 1]);
+            diag = up;
+        }
+    }
+    result = row[lb];
+    free(row);
+    return result;
+}
+
+static int32_t
+ref_dot(const int16_t a[CHAR_N_VALUES], const int16_t b[CHAR_N_VALUES]) {
+    int32_t dot = 0;
+    int i;
+    for (i = 0; i < CHAR_N_VALUES; i++) {
+        dot += a[i] * b[i];
+    }
+    return dot;
+}
+
+static bool
+ref_score_cos(const double threshold, const int16_t a[CHAR_N_VALUES],
+        const int16_t b[CHAR_N_VALUES]) {
+    const int32_t saibi = ref_dot(a, b), sai2 = ref_dot(a, a),
+          sbi2 = ref_dot(b, b);
+    const double s1 = 1.0 - (2 * acos(saibi / sqrt(sai2 * sbi2)) / M_PI);
+    return threshold <= s1 + cossim_correction(s1);
+}
+
+static void
+random_string(char *str, int len, int alphabet) {
+    int i;
+    for (i = 0; i < len; i++) {
+        str[i] = 'a' + random() % alphabet;
+    }
+    str[len] = '\0';
+}
+
+/* Whether each strpopdot_*() the CPU supports gives the plain dot product */
+static bool
+same_dots(const int16_t a[CHAR_N_VALUES], const int16_t b[CHAR_N_VALUES]) {
+    const int32_t dot = ref_dot(a, b);
+    if (strpopdot_scalar(a, b) != dot) {
+        return false;
+    }
+#ifdef STRGRP_X86
+    if (__builtin_cpu_supports("sse2") && strpopdot_sse2(a, b) != dot) {
+        return false;
+    }
+    if (__builtin_cpu_supports("avx2") && strpopdot_avx2(a, b) != dot) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/* Compares lcs() and the strpopdot_*() against the plain calculations for
+ * random strings over small and large alphabets, across word boundaries */
+static bool
+same_scores(void) {
+    static char a[MAX_LEN + 1], b[MAX_LEN + 1];
+    struct strgrp *ctx = strgrp_new(0.5);
+    int16_t pop[CHAR_N_VALUES];
+    bool same = true;
+    int i;
+
+    for (i = 0; i < N_PAIRS && same; i++) {
+        const int alphabet = (i % 2) ? 26 : 2 + i % 4;
+        random_string(a, random() % (MAX_LEN + 1), alphabet);
+        random_string(b, random() % (MAX_LEN + 1), alphabet);
+        ctx->len = strlen(a);
+        strpopcnt(a, ctx->pop);
+        strpopcnt(b, pop);
+        same = lcs_prepare(ctx, a)
+            && lcs(ctx, b, strlen(b)) == ref_lcs(a, b)
+            && same_dots(ctx->pop, pop);
+    }
+    strgrp_free(ctx);
+    return same;
+}
+
+/* Compares the cosine filter with the plain calculation, at thresholds on and
+ * about the similarity of pairs of strings */
+static bool
+same_filter(void) {
+    static char a[MAX_LEN + 1], b[MAX_LEN + 1];
+    struct strgrp_grp grp;
+    int16_t pop[CHAR_N_VALUES];
+    bool same = true;
+    int i;
+
+    for (i = 0; i < N_PAIRS * 10 && same; i++) {
+        double s1, threshold;
+        struct strgrp *ctx;
+        random_string(a, 1 + random() % 40, 4 + i % 20);
+        random_string(b, 1 + random() % 40, 4 + i % 20);
+        strpopcnt(a, pop);
+        strpopcnt(b, grp.pop);
+        grp.pop_norm = ref_dot(grp.pop, grp.pop);
+        s1 = 1.0 - (2 * acos(ref_dot(pop, grp.pop)
+                    / sqrt(ref_dot(pop, pop) * grp.pop_norm)) / M_PI);
+        threshold = s1 + cossim_correction(s1);
+        if (i % 3 == 1) {
+            threshold += 1e-3;
+        } else if (i % 3 == 2) {
+            threshold = (random() % 1000) / 1000.0;
+        }
+        ctx = strgrp_new(threshold);
+        ctx->len = strlen(a);
+        strpopcnt(a, ctx->pop);
+        ctx->pop_norm = ctx->strpopdot(ctx->pop, ctx->pop);
+        same = should_grp_score_cos(ctx, &grp, a)
+            == ref_score_cos(threshold, ctx->pop, grp.pop);
+        strgrp_free(ctx);
+    }
+    return same;
+}
+
+int main(void) {
+    plan_tests(2);
+    ok1(same_scores());
+    ok1(same_filter());
+    return exit_status();
+}
@@ -0,0 +1,115 @@
+/* Time threads adding latency-like values: to one tally behind a lock, and
+ * to a sharded tally with a shard per thread.  Thread counts double from 1
+ * to the given maximum (default 64), and each thread adds the given number
+ * of values (default 10M).  A reporting thread takes a snapshot with reset
+ * every 100ms, as a server would.
+ */
+#include <ccan/tally/tally.h>
+#include <ccan/time/time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define VALS (1 << 16)
+
+static ssize_t vals[VALS];
+static unsigned long num;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tally *locked;
+static struct tally_sharded *sharded;
+static volatile bool done;
+
+static void *add_locked(void *arg)
+{
+	unsigned long i;
+
+	for (i = 0; i < num; i++) {
+		pthread_mutex_lock(&lock);
+		tally_add(locked, vals[i % VALS]);
+		pthread_mutex_unlock(&lock);
+	}
+	return NULL;
+}
+
+static void *add_sharded(void *arg)
+{
+	unsigned int shard = (unsigned long)arg;
+	unsigned long i;
+
+	for (i = 0; i < num; i++)
+		tally_sharded_add(sharded, shard, vals[i % VALS]);
+	return NULL;
+}
+
+static void *report(void *arg)
+{
+	size_t total = 0;
+
+	while (!done) {
+		struct tally *t;
+
+		usleep(100000);
+		pthread_mutex_lock(&lock);
+		if (sharded) {
+			pthread_mutex_unlock(&lock);
+			t = tally_sharded_snapshot(sharded, true);
+		} else {
+			t = tally_new_loglinear(3, 0);
+			tally_merge(t, locked);
+			pthread_mutex_unlock(&lock);
+		}
+		total += tally_num(t);
+		free(t);
+	}
+	return (void *)total;
+}
+
+/* Adds per second with n threads running fn. */
+static double run(unsigned int n, void *(*fn)(void *))
+{
+	pthread_t threads[n], reporter;
+	struct timeabs start;
+	unsigned long i;
+
+	done = false;
+	pthread_create(&reporter, NULL, report, NULL);
+	start = time_now();
+	for (i = 0; i < n; i++)
+		pthread_create(&threads[i], NULL, fn, (void *)i);
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	done = true;
+	pthread_join(reporter, NULL);
+	return num * n * 1e9 / time_to_nsec(time_between(time_now(), start));
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int max = argc > 1 ? atoi(argv[1]) : 64;
+	unsigned int n, i;
+
+	num = argc > 2 ? strtoul(argv[2], NULL, 0) : 10000000;
+	for (i = 0; i < VALS; i++)
+		vals[i] = (ssize_t)(random() % 1000 + 1) << random() % 20;
+
+	printf("threads  locked (M/s)  sharded (M/s)\n");
+	for (n = 1; n <= max; n *= 2) {
+		double l, s;
+
+		locked = tally_new_loglinear(3, 0);
+		sharded = NULL;
+		l = run(n, add_locked);
+		free(locked);
+
+		sharded = tally_sharded_new(n, 3, 0);
+		s = run(n, add_sharded);
+		tally_sharded_free(sharded);
+
+		printf("%7u  %12.1f  %13.1f\n", n, l / 1e6, s / 1e6);
+		fflush(stdout);
+	}
+	return 0;
+}
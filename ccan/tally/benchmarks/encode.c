@@ -0,0 +1,78 @@
+/* Time encoding per-minute latency tallies, as a fleet of workers would, and
+ * merging them centrally: from the encodings, and by decoding them first.
+ * The arguments are the number of tallies (default 1000), values per
+ * tally (default 10000) and significant digits (default 3).
+ */
+#include <ccan/tally/tally.h>
+#include <ccan/time/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double secs_since(struct timeabs start)
+{
+	return time_to_nsec(time_between(time_now(), start)) / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int n = argc > 1 ? atoi(argv[1]) : 1000;
+	unsigned long vals = argc > 2 ? strtoul(argv[2], NULL, 0) : 10000;
+	unsigned int digits = argc > 3 ? atoi(argv[3]) : 3;
+	struct tally **tallies = malloc(sizeof(*tallies) * n);
+	void **bufs = malloc(sizeof(*bufs) * n);
+	size_t *lens = malloc(sizeof(*lens) * n), bytes = 0;
+	struct tally *merged;
+	struct timeabs start;
+	unsigned int i;
+	unsigned long j;
+	double secs;
+
+	for (i = 0; i < n; i++) {
+		tallies[i] = tally_new_loglinear(digits, 0);
+		/* Around 1ms, with a long tail. */
+		for (j = 0; j < vals; j++)
+			tally_add(tallies[i], 500000 + random() % 1000000
+				  + (random() % 100 == 0 ? random() % 1000000000
+				     : 0));
+	}
+
+	start = time_now();
+	for (i = 0; i < n; i++) {
+		bufs[i] = tally_encode(tallies[i], &lens[i]);
+		bytes += lens[i];
+	}
+	secs = secs_since(start);
+	printf("encode: %.1fus/tally, %zu bytes/tally, %.0fMB/s\n",
+	       secs * 1e6 / n, bytes / n, bytes / secs / 1e6);
+
+	merged = tally_new_loglinear(digits, 0);
+	start = time_now();
+	for (i = 0; i < n; i++)
+		tally_merge_encoded(merged, bufs[i], lens[i]);
+	secs = secs_since(start);
+	printf("merge encoded: %.1fus/tally, %.0fMB/s\n",
+	       secs * 1e6 / n, bytes / secs / 1e6);
+	free(merged);
+
+	merged = tally_new_loglinear(digits, 0);
+	start = time_now();
+	for (i = 0; i < n; i++) {
+		struct tally *t = tally_decode(bufs[i], lens[i]);
+
+		tally_merge(merged, t);
+		free(t);
+	}
+	secs = secs_since(start);
+	printf("decode and merge: %.1fus/tally, %.0fMB/s\n",
+	       secs * 1e6 / n, bytes / secs / 1e6);
+	free(merged);
+
+	for (i = 0; i < n; i++) {
+		free(tallies[i]);
+		free(bufs[i]);
+	}
+	free(tallies);
+	free(bufs);
+	free(lens);
+	return 0;
+}
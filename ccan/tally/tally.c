@@ -2,6 +2,7 @@
 #include <ccan/tally/tally.h>
 #include <ccan/build_assert/build_assert.h>
 #include <ccan/likely/likely.h>
+#include <ccan/rszshm/rszshm.h>
 #include <stdint.h>
 #include <limits.h>
 #include <string.h>
@@ -10,13 +11,23 @@
 #include <stdlib.h>
 
 #define SIZET_BITS (sizeof(size_t)*CHAR_BIT)
-
-/* We use power of 2 steps.  I tried being tricky, but it got buggy. */
+#define SSIZET_MAX ((ssize_t)~((size_t)1 << (SIZET_BITS - 1)))
+
+/* We use power of 2 steps.  I tried being tricky, but it got buggy.
+ *
+ * Log-linear tallies (sub_bits != 0) instead have fixed buckets like HDR
+ * histograms: values of the same magnitude (highest set bit) share
+ * 1 << (sub_bits - 1) buckets, so bucket widths grow with their values.
+ * Negative values mirror positive ones, and bucket order is value order. */
 struct tally {
 	ssize_t min, max;
 	size_t total[2];
+	size_t num;
 	/* This allows limited frequency analysis. */
 	unsigned buckets, step_bits;
+	/* Log-linear tallies only: magnitudes above range share a bucket. */
+	unsigned sub_bits;
+	size_t range;
 	size_t counts[1 /* Actually: [buckets] */ ];
 };
 
@@ -43,12 +54,157 @@ struct tally *tally_new(unsigned buckets)
 	tally->max = ((size_t)1 << (SIZET_BITS - 1));
 	tally->min = ~tally->max;
 	tally->total[0] = tally->total[1] = 0;
+	tally->num = 0;
 	tally->buckets = buckets;
 	tally->step_bits = 0;
+	tally->sub_bits = 0;
+	tally->range = 0;
 	memset(tally->counts, 0, sizeof(tally->counts[0])*buckets);
 	return tally;
 }
 
+/* FIXME: Own ccan module please! */
+static unsigned fls64(uint64_t val)
+{
+#if HAVE_BUILTIN_CLZL
+	if (val <= ULONG_MAX) {
+		/* This is significantly faster! */
+		return val ? sizeof(long) * CHAR_BIT - __builtin_clzl(val) : 0;
+	} else {
+#endif
+	uint64_t r = 64;
+
+	if (!val) {
+		return 0;
+	}
+	if (!(val & 0xffffffff00000000ull)) {
+		val <<= 32;
+		r -= 32;
+	}
+	if (!(val & 0xffff000000000000ull)) {
+		val <<= 16;
+		r -= 16;
+	}
+	if (!(val & 0xff00000000000000ull)) {
+		val <<= 8;
+		r -= 8;
+	}
+	if (!(val & 0xf000000000000000ull)) {
+		val <<= 4;
+		r -= 4;
+	}
+	if (!(val & 0xc000000000000000ull)) {
+		val <<= 2;
+		r -= 2;
+	}
+	if (!(val & 0x8000000000000000ull)) {
+		val <<= 1;
+		r -= 1;
+	}
+	return r;
+#if HAVE_BUILTIN_CLZL
+	}
+#endif
+}
+
+/* Index among the magnitude buckets of a log-linear tally. */
+static unsigned loglin_index(unsigned sub_bits, size_t mag)
+{
+	unsigned b = fls64(mag | (((size_t)1 << sub_bits) - 1)) - sub_bits;
+
+	return ((size_t)b << (sub_bits - 1)) + (mag >> b);
+}
+
+/* Return the lowest and highest magnitude in magnitude bucket i. */
+static void loglin_range(unsigned sub_bits, unsigned i,
+			 size_t *lo, size_t *hi)
+{
+	unsigned b;
+
+	if (i < (1U << sub_bits)) {
+		*lo = *hi = i;
+		return;
+	}
+	b = (i >> (sub_bits - 1)) - 1;
+	*lo = (size_t)(i - (b << (sub_bits - 1))) << b;
+	*hi = *lo + (((size_t)1 << b) - 1);
+}
+
+/* Bucket of val among 2 * half log-linear buckets: negatives first, largest
+ * first. */
+static unsigned loglin_bucket_of(unsigned sub_bits, size_t range,
+				 unsigned half, ssize_t val)
+{
+	size_t mag;
+
+	if (val >= 0) {
+		mag = likely((size_t)val <= range) ? (size_t)val : range;
+		return half + loglin_index(sub_bits, mag);
+	}
+	/* Magnitude less one, so the most negative value fits. */
+	mag = -(val + 1);
+	if (unlikely(mag > range)) {
+		mag = range;
+	}
+	return half - 1 - loglin_index(sub_bits, mag);
+}
+
+static unsigned loglin_bucket(const struct tally *tally, ssize_t val)
+{
+	return loglin_bucket_of(tally->sub_bits, tally->range,
+				tally->buckets / 2, val);
+}
+
+/* Number of buckets of a log-linear tally. */
+static unsigned loglin_buckets(unsigned sub_bits, size_t range)
+{
+	return (loglin_index(sub_bits, range) + 1) * 2;
+}
+
+/* Set up the bucket layout of a log-linear tally. */
+static void loglin_layout(unsigned digits, size_t range,
+			  unsigned *sub_bits, size_t *range_out)
+{
+	unsigned i;
+	size_t resolution = 2;
+
+	/* Half the buckets of a magnitude must tell apart 1 in 10^digits. */
+	for (i = 0; i < digits; i++) {
+		resolution *= 10;
+	}
+	for (*sub_bits = 1; ((size_t)1 << *sub_bits) < resolution;
+	     (*sub_bits)++);
+
+	if (range == 0 || range > (size_t)SSIZET_MAX) {
+		range = SSIZET_MAX;
+	}
+	*range_out = range;
+}
+
+static struct tally *loglin_new(unsigned sub_bits, size_t range)
+{
+	struct tally *tally;
+
+	tally = tally_new(loglin_buckets(sub_bits, range));
+	if (tally == NULL) {
+		return NULL;
+	}
+	tally->sub_bits = sub_bits;
+	tally->range = range;
+	return tally;
+}
+
+struct tally *tally_new_loglinear(unsigned digits, size_t range)
+{
+	unsigned sub_bits;
+
+	if (digits > TALLY_MAX_DIGITS) {
+		return NULL;
+	}
+	loglin_layout(digits, range, &sub_bits, &range);
+	return loglin_new(sub_bits, range);
+}
+
 static unsigned bucket_of(ssize_t min, unsigned step_bits, ssize_t val)
 {
 	/* Don't over-shift. */
@@ -125,6 +281,18 @@ update:
 	tally->max = new_max;
 }
 
+static void add_total(struct tally *tally, ssize_t val)
+{
+	/* 128-bit arithmetic!  If we didn't want exact mean, we could just
+	 * pull it out of counts. */
+	if (val > 0 && tally->total[0] + val < tally->total[0]) {
+		tally->total[1]++;
+	} else if (val < 0 && tally->total[0] + val > tally->total[0]) {
+		tally->total[1]--;
+	}
+	tally->total[0] += val;
+}
+
 void tally_add(struct tally *tally, ssize_t val)
 {
 	ssize_t new_min = tally->min, new_max = tally->max;
@@ -139,27 +307,26 @@ void tally_add(struct tally *tally, ssize_t val)
 		need_renormalize = true;
 	}
 	if (need_renormalize) {
-		renormalize(tally, new_min, new_max);
+		if (tally->sub_bits) {
+			tally->min = new_min;
+			tally->max = new_max;
+		} else {
+			renormalize(tally, new_min, new_max);
+		}
 	}
 
-	/* 128-bit arithmetic!  If we didn't want exact mean, we could just
-	 * pull it out of counts. */
-	if (val > 0 && tally->total[0] + val < tally->total[0]) {
-		tally->total[1]++;
-	} else if (val < 0 && tally->total[0] + val > tally->total[0]) {
-		tally->total[1]--;
+	add_total(tally, val);
+	tally->num++;
+	if (tally->sub_bits) {
+		tally->counts[loglin_bucket(tally, val)]++;
+	} else {
+		tally->counts[bucket_of(tally->min, tally->step_bits, val)]++;
 	}
-	tally->total[0] += val;
-	tally->counts[bucket_of(tally->min, tally->step_bits, val)]++;
 }
 
 size_t tally_num(const struct tally *tally)
 {
-	size_t i, num = 0;
-	for (i = 0; i < tally->buckets; i++) {
-		num += tally->counts[i];
-	}
-	return num;
+	return tally->num;
 }
 
 ssize_t tally_min(const struct tally *tally)
@@ -172,50 +339,6 @@ ssize_t tally_max(const struct tally *tally)
 	return tally->max;
 }
 
-/* FIXME: Own ccan module please! */
-static unsigned fls64(uint64_t val)
-{
-#if HAVE_BUILTIN_CLZL
-	if (val <= ULONG_MAX) {
-		/* This is significantly faster! */
-		return val ? sizeof(long) * CHAR_BIT - __builtin_clzl(val) : 0;
-	} else {
-#endif
-	uint64_t r = 64;
-
-	if (!val) {
-		return 0;
-	}
-	if (!(val & 0xffffffff00000000ull)) {
-		val <<= 32;
-		r -= 32;
-	}
-	if (!(val & 0xffff000000000000ull)) {
-		val <<= 16;
-		r -= 16;
-	}
-	if (!(val & 0xff00000000000000ull)) {
-		val <<= 8;
-		r -= 8;
-	}
-	if (!(val & 0xf000000000000000ull)) {
-		val <<= 4;
-		r -= 4;
-	}
-	if (!(val & 0xc000000000000000ull)) {
-		val <<= 2;
-		r -= 2;
-	}
-	if (!(val & 0x8000000000000000ull)) {
-		val <<= 1;
-		r -= 1;
-	}
-	return r;
-#if HAVE_BUILTIN_CLZL
-	}
-#endif
-}
-
 /* This is stolen straight from Hacker's Delight. */
 static uint64_t divlu64(uint64_t u1, uint64_t u0, uint64_t v)
 {
@@ -362,15 +485,45 @@ ssize_t tally_total(const struct tally *tally, ssize_t *overflow)
 	return tally->total[0];
 }
 
+/* Return the min and max values in bucket b of a log-linear tally. */
+static void loglin_bucket_range(const struct tally *tally, unsigned b,
+				ssize_t *min, ssize_t *max)
+{
+	unsigned half = tally->buckets / 2;
+	size_t lo, hi;
+
+	if (b >= half) {
+		loglin_range(tally->sub_bits, b - half, &lo, &hi);
+		*min = lo;
+		*max = hi > (size_t)SSIZET_MAX ? SSIZET_MAX : (ssize_t)hi;
+	} else {
+		loglin_range(tally->sub_bits, half - 1 - b, &lo, &hi);
+		*min = -(ssize_t)hi - 1;
+		*max = -(ssize_t)lo - 1;
+	}
+
+	/* The end buckets also hold values beyond range. */
+	if (b == 0 || *min < tally->min) {
+		*min = tally->min;
+	}
+	if (b == tally->buckets - 1 || *max > tally->max) {
+		*max = tally->max;
+	}
+}
+
 static ssize_t bucket_range(const struct tally *tally, unsigned b, size_t *err)
 {
 	ssize_t min, max;
 
-	min = bucket_min(tally->min, tally->step_bits, b);
-	if (b == tally->buckets - 1) {
-		max = tally->max;
+	if (tally->sub_bits) {
+		loglin_bucket_range(tally, b, &min, &max);
 	} else {
-		max = bucket_min(tally->min, tally->step_bits, b+1) - 1;
+		min = bucket_min(tally->min, tally->step_bits, b);
+		if (b == tally->buckets - 1) {
+			max = tally->max;
+		} else {
+			max = bucket_min(tally->min, tally->step_bits, b+1) - 1;
+		}
 	}
 
 	/* FIXME: Think harder about cumulative error; is this enough?. */
@@ -379,6 +532,32 @@ static ssize_t bucket_range(const struct tally *tally, unsigned b, size_t *err)
 	return min + (max - min) / 2;
 }
 
+ssize_t tally_percentile(const struct tally *tally, double p, size_t *err)
+{
+	size_t count = tally_num(tally), total = 0, rank;
+	unsigned int i;
+
+	/* The value with rank p of count, counting from 1. */
+	if (!(p > 0)) {
+		rank = 1;
+	} else if (p >= 1) {
+		rank = count;
+	} else {
+		rank = (size_t)(p * count);
+		if (rank < p * count || rank == 0) {
+			rank++;
+		}
+	}
+
+	for (i = 0; i < tally->buckets - 1; i++) {
+		total += tally->counts[i];
+		if (total >= rank) {
+			break;
+		}
+	}
+	return bucket_range(tally, i, err);
+}
+
 ssize_t tally_approx_median(const struct tally *tally, size_t *err)
 {
 	size_t count = tally_num(tally), total = 0;
@@ -430,6 +609,39 @@ static unsigned get_max_bucket(const struct tally *tally)
 	return i;
 }
 
+/* Draw a log-linear tally at linear scale, from the middle of its buckets. */
+static char *loglin_histogram(const struct tally *tally,
+			      unsigned width, unsigned height)
+{
+	struct tally *tmp;
+	unsigned int i;
+	size_t err;
+	char *graph;
+
+	tmp = tally_new(height);
+	if (!tmp) {
+		return NULL;
+	}
+	if (tally->num) {
+		tmp->min = tmp->max = tally->min;
+		renormalize(tmp, tally->min, tally->max);
+		for (i = 0; i < tally->buckets; i++) {
+			ssize_t mid;
+
+			if (!tally->counts[i]) {
+				continue;
+			}
+			mid = bucket_range(tally, i, &err);
+			tmp->counts[bucket_of(tmp->min, tmp->step_bits, mid)]
+				+= tally->counts[i];
+		}
+		tmp->num = tally->num;
+	}
+	graph = tally_histogram(tmp, width, height);
+	free(tmp);
+	return graph;
+}
+
 char *tally_histogram(const struct tally *tally,
 		      unsigned width, unsigned height)
 {
@@ -440,6 +652,10 @@ char *tally_histogram(const struct tally *tally,
 	assert(width >= TALLY_MIN_HISTO_WIDTH);
 	assert(height >= TALLY_MIN_HISTO_HEIGHT);
 
+	if (tally->sub_bits) {
+		return loglin_histogram(tally, width, height);
+	}
+
 	/* Ignore unused buckets. */
 	max_bucket = get_max_bucket(tally);
 
@@ -519,3 +735,543 @@ char *tally_histogram(const struct tally *tally,
 	free(tmp);
 	return graph;
 }
+
+/* Can src, of which only the header need be filled in, be merged? */
+static bool merge_compatible(const struct tally *tally,
+			     const struct tally *src)
+{
+	return tally->sub_bits == src->sub_bits
+		&& (!tally->sub_bits || (tally->range == src->range
+					 && tally->buckets == src->buckets));
+}
+
+/* Widen tally to take the values of src, before merge_bucket()s. */
+static void merge_range(struct tally *tally, const struct tally *src)
+{
+	/* Uninitialized?  Start from src's range. */
+	if (!tally->num) {
+		tally->min = tally->max = src->min;
+	}
+
+	if (tally->sub_bits) {
+		if (src->min < tally->min) {
+			tally->min = src->min;
+		}
+		if (src->max > tally->max) {
+			tally->max = src->max;
+		}
+	} else {
+		renormalize(tally,
+			    src->min < tally->min ? src->min : tally->min,
+			    src->max > tally->max ? src->max : tally->max);
+	}
+}
+
+/* Add count values from bucket b of src. */
+static void merge_bucket(struct tally *tally, const struct tally *src,
+			 unsigned b, size_t count)
+{
+	if (tally->sub_bits) {
+		tally->counts[b] += count;
+	} else {
+		/* Buckets may not line up, so this is approximate. */
+		ssize_t val = bucket_min(src->min, src->step_bits, b);
+
+		tally->counts[bucket_of(tally->min, tally->step_bits, val)]
+			+= count;
+	}
+}
+
+/* Add the total and number of values of src. */
+static void merge_totals(struct tally *tally, const struct tally *src)
+{
+	/* 128-bit addition. */
+	tally->total[1] += src->total[1];
+	if (tally->total[0] + src->total[0] < tally->total[0]) {
+		tally->total[1]++;
+	}
+	tally->total[0] += src->total[0];
+	tally->num += src->num;
+}
+
+bool tally_merge(struct tally *tally, const struct tally *src)
+{
+	unsigned int i;
+
+	if (!merge_compatible(tally, src)) {
+		return false;
+	}
+	if (!src->num) {
+		return true;
+	}
+
+	merge_range(tally, src);
+	for (i = 0; i < src->buckets; i++) {
+		if (src->counts[i]) {
+			merge_bucket(tally, src, i, src->counts[i]);
+		}
+	}
+	merge_totals(tally, src);
+	return true;
+}
+
+/* Encoded tallies are a header then run-length encoded bucket counts, all
+ * as LEB128 varints (signed values zigzag encoded):
+ *
+ *	'T' 'L' 'Y' version
+ *	sub_bits buckets (step_bits | range) num min max total[0] total[1]
+ *	runs (zeros nonzeros count...)*runs
+ *
+ * Trailing empty buckets are left out.  Decoding checks the counts add up
+ * to num, so truncated or corrupt tallies are refused.
+ */
+#define ENCODE_VERSION 1
+#define VARINT_MAX 10
+
+static unsigned char *put_varint(unsigned char *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*(p++) = v | 0x80;
+		v >>= 7;
+	}
+	*(p++) = v;
+	return p;
+}
+
+static bool get_varint(const unsigned char **p, const unsigned char *end,
+		       uint64_t *v)
+{
+	unsigned int shift;
+
+	*v = 0;
+	for (shift = 0; shift < 64 && *p < end; shift += 7) {
+		unsigned char c = *((*p)++);
+
+		*v |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint64_t zigzag(ssize_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(int64_t)(v >> (SIZET_BITS - 1));
+}
+
+static ssize_t unzigzag(uint64_t v)
+{
+	return (ssize_t)((v >> 1) ^ -(v & 1));
+}
+
+void *tally_encode(const struct tally *tally, size_t *len)
+{
+	unsigned char *buf, *p;
+	unsigned int i, end, runs = 0, used = 0;
+
+	/* Ignore unused buckets. */
+	end = get_max_bucket(tally);
+	for (i = 0; i < end; runs++) {
+		while (!tally->counts[i]) {
+			i++;
+		}
+		while (i < end && tally->counts[i]) {
+			i++;
+			used++;
+		}
+	}
+
+	p = buf = malloc(4 + VARINT_MAX * (9 + 1 + 2 * runs + used));
+	if (!buf) {
+		return NULL;
+	}
+	*(p++) = 'T';
+	*(p++) = 'L';
+	*(p++) = 'Y';
+	*(p++) = ENCODE_VERSION;
+	p = put_varint(p, tally->sub_bits);
+	p = put_varint(p, tally->buckets);
+	p = put_varint(p, tally->sub_bits ? tally->range : tally->step_bits);
+	p = put_varint(p, tally->num);
+	p = put_varint(p, zigzag(tally->min));
+	p = put_varint(p, zigzag(tally->max));
+	p = put_varint(p, tally->total[0]);
+	p = put_varint(p, tally->total[1]);
+	p = put_varint(p, runs);
+	for (i = 0; i < end;) {
+		unsigned int start = i;
+
+		while (!tally->counts[i]) {
+			i++;
+		}
+		p = put_varint(p, i - start);
+		start = i;
+		while (i < end && tally->counts[i]) {
+			i++;
+		}
+		p = put_varint(p, i - start);
+		for (; start < i; start++) {
+			p = put_varint(p, tally->counts[start]);
+		}
+	}
+	*len = p - buf;
+	return buf;
+}
+
+/* Read the header of an encoded tally into hdr (without counts), leaving
+ * *p at the number of runs. */
+static bool decode_header(struct tally *hdr, const unsigned char **p,
+			  const unsigned char *end)
+{
+	uint64_t v[8];
+	unsigned int i, max_sub_bits;
+	size_t max_range;
+
+	if (end - *p < 4 || memcmp(*p, "TLY", 3) != 0
+	    || (*p)[3] != ENCODE_VERSION) {
+		return false;
+	}
+	*p += 4;
+	for (i = 0; i < 8; i++) {
+		if (!get_varint(p, end, &v[i])) {
+			return false;
+		}
+	}
+
+	hdr->sub_bits = v[0];
+	hdr->buckets = v[1];
+	if (hdr->sub_bits != v[0] || hdr->buckets != v[1]
+	    || hdr->buckets == 0) {
+		return false;
+	}
+	if (hdr->sub_bits) {
+		/* Only layouts which tally_new_loglinear() makes: anything
+		 * finer would be a huge allocation for a small input. */
+		loglin_layout(TALLY_MAX_DIGITS, 0, &max_sub_bits, &max_range);
+		if (hdr->sub_bits > max_sub_bits || v[2] == 0
+		    || v[2] > (uint64_t)SSIZET_MAX
+		    || hdr->buckets != loglin_buckets(hdr->sub_bits, v[2])) {
+			return false;
+		}
+		hdr->range = v[2];
+		hdr->step_bits = 0;
+	} else {
+		if (v[2] > SIZET_BITS) {
+			return false;
+		}
+		hdr->step_bits = v[2];
+		hdr->range = 0;
+	}
+	hdr->num = v[3];
+	hdr->min = unzigzag(v[4]);
+	hdr->max = unzigzag(v[5]);
+	hdr->total[0] = v[6];
+	hdr->total[1] = v[7];
+	return true;
+}
+
+/* Walk the runs of an encoded tally, adding counts to tally if non-NULL.
+ * Returns false if they don't fit the header. */
+static bool decode_runs(struct tally *tally, const struct tally *hdr,
+			const unsigned char *p, const unsigned char *end)
+{
+	uint64_t runs, zeros, nonzeros, count, num = 0, b = 0;
+	uint64_t last = hdr->buckets - 1;
+
+	if (!get_varint(&p, end, &runs)) {
+		return false;
+	}
+	if (hdr->num && hdr->min > hdr->max) {
+		return false;
+	}
+	/* Linear buckets past max would be merged out of range. */
+	if (!hdr->sub_bits && hdr->num) {
+		last = bucket_of(hdr->min, hdr->step_bits, hdr->max);
+		if (last >= hdr->buckets) {
+			return false;
+		}
+	}
+	while (runs--) {
+		if (!get_varint(&p, end, &zeros)
+		    || !get_varint(&p, end, &nonzeros)
+		    || zeros > last + 1 - b
+		    || nonzeros > last + 1 - b - zeros) {
+			return false;
+		}
+		for (b += zeros; nonzeros--; b++) {
+			if (!get_varint(&p, end, &count)
+			    || num + count < num) {
+				return false;
+			}
+			num += count;
+			if (tally) {
+				merge_bucket(tally, hdr, b, count);
+			}
+		}
+	}
+	return p == end && num == hdr->num;
+}
+
+struct tally *tally_decode(const void *buf, size_t len)
+{
+	const unsigned char *p = buf, *end = p + len;
+	struct tally hdr, *tally;
+
+	if (!decode_header(&hdr, &p, end) || !decode_runs(NULL, &hdr, p, end)) {
+		return NULL;
+	}
+
+	if (hdr.sub_bits) {
+		tally = loglin_new(hdr.sub_bits, hdr.range);
+	} else {
+		tally = tally_new(hdr.buckets);
+	}
+	if (!tally) {
+		return NULL;
+	}
+	tally->min = hdr.min;
+	tally->max = hdr.max;
+	tally->step_bits = hdr.step_bits;
+	tally->total[0] = hdr.total[0];
+	tally->total[1] = hdr.total[1];
+	tally->num = hdr.num;
+
+	/* Buckets line up exactly, so this just copies counts. */
+	decode_runs(tally, &hdr, p, end);
+	return tally;
+}
+
+bool tally_merge_encoded(struct tally *tally, const void *buf, size_t len)
+{
+	const unsigned char *p = buf, *end = p + len;
+	struct tally hdr;
+
+	if (!decode_header(&hdr, &p, end) || !merge_compatible(tally, &hdr)
+	    || !decode_runs(NULL, &hdr, p, end)) {
+		return false;
+	}
+	if (!hdr.num) {
+		return true;
+	}
+
+	merge_range(tally, &hdr);
+	decode_runs(tally, &hdr, p, end);
+	merge_totals(tally, &hdr);
+	return true;
+}
+
+/* Each shard starts on its own cache line, as do its counts, so threads
+ * adding to different shards never write to the same line. */
+#define CACHE_LINE 64
+
+struct tally_shard {
+	/* Only written by the thread adding to the shard. */
+	size_t *counts;
+	uint64_t sum;
+	char pad[CACHE_LINE - sizeof(size_t *) - sizeof(uint64_t)];
+	/* Counts and sum at the last reset, only used by snapshots (on
+	 * their own line, so resetting doesn't disturb the adder). */
+	size_t *base;
+	uint64_t base_sum;
+};
+
+union tally_shard_line {
+	struct tally_shard shard;
+	char pad[CACHE_LINE * ((sizeof(struct tally_shard) + CACHE_LINE - 1)
+			       / CACHE_LINE)];
+};
+
+/* Everything is in one block, header first, so it can be shared by
+ * processes which map it at the same address. */
+struct tally_sharded {
+	unsigned int n_shards, sub_bits, buckets;
+	size_t range;
+	union tally_shard_line *shards;
+	/* malloc()ed block, or NULL if in shared memory. */
+	void *mem;
+};
+
+#define HDR_LINES ((sizeof(struct tally_sharded) + CACHE_LINE - 1) / CACHE_LINE)
+
+/* Counts per shard, rounded up to whole lines. */
+static size_t shard_counts(unsigned buckets)
+{
+	size_t line_counts = CACHE_LINE / sizeof(size_t);
+
+	return (buckets + line_counts - 1) / line_counts * line_counts;
+}
+
+static size_t sharded_size(unsigned shards, unsigned buckets)
+{
+	return CACHE_LINE * HDR_LINES
+		+ sizeof(union tally_shard_line) * shards
+		+ sizeof(size_t) * shard_counts(buckets) * 2 * shards;
+}
+
+/* Round up to the start of a cache line. */
+static char *line_align(void *p)
+{
+	return (char *)p + (CACHE_LINE - 1
+			    - ((uintptr_t)p + CACHE_LINE - 1) % CACHE_LINE);
+}
+
+/* Lay out a sharded tally in zeroed, line-aligned memory. */
+static struct tally_sharded *sharded_init(char *mem, unsigned shards,
+					  unsigned sub_bits, size_t range)
+{
+	struct tally_sharded *ts = (struct tally_sharded *)mem;
+	size_t *counts;
+	unsigned int i;
+
+	ts->n_shards = shards;
+	ts->sub_bits = sub_bits;
+	ts->range = range;
+	ts->buckets = loglin_buckets(sub_bits, range);
+	ts->shards = (union tally_shard_line *)(mem + CACHE_LINE * HDR_LINES);
+
+	/* Counts, then the counts at the last reset, each whole lines. */
+	counts = (size_t *)(ts->shards + shards);
+	for (i = 0; i < shards; i++) {
+		struct tally_shard *shard = &ts->shards[i].shard;
+
+		shard->counts = counts;
+		shard->base = counts + shard_counts(ts->buckets);
+		counts = shard->base + shard_counts(ts->buckets);
+	}
+	return ts;
+}
+
+static bool sharded_layout(unsigned shards, unsigned digits, size_t range,
+			   unsigned *sub_bits, size_t *range_out)
+{
+	if (shards == 0 || digits > TALLY_MAX_DIGITS) {
+		return false;
+	}
+	loglin_layout(digits, range, sub_bits, range_out);
+	return true;
+}
+
+struct tally_sharded *tally_sharded_new(unsigned shards, unsigned digits,
+					size_t range)
+{
+	struct tally_sharded *ts;
+	unsigned sub_bits;
+	size_t size;
+	char *mem;
+
+	if (!sharded_layout(shards, digits, range, &sub_bits, &range)) {
+		return NULL;
+	}
+
+	size = sharded_size(shards, loglin_buckets(sub_bits, range));
+	mem = calloc(size + CACHE_LINE - 1, 1);
+	if (!mem) {
+		return NULL;
+	}
+	ts = sharded_init(line_align(mem), shards, sub_bits, range);
+	ts->mem = mem;
+	return ts;
+}
+
+struct tally_sharded *tally_sharded_new_shm(struct rszshm *r,
+					    const char *fname,
+					    unsigned shards, unsigned digits,
+					    size_t range)
+{
+	struct tally_sharded *ts;
+	unsigned sub_bits;
+
+	if (!sharded_layout(shards, digits, range, &sub_bits, &range)) {
+		return NULL;
+	}
+
+	/* The file starts zeroed, and is mapped at the same address by
+	 * every process, so pointers into it can be shared. */
+	if (!rszshm_mk(r, sharded_size(shards, loglin_buckets(sub_bits, range))
+		       + CACHE_LINE - 1, fname)) {
+		return NULL;
+	}
+	ts = sharded_init(line_align(r->dat), shards, sub_bits, range);
+	ts->mem = NULL;
+	return ts;
+}
+
+struct tally_sharded *tally_sharded_attach_shm(struct rszshm *r,
+					       const char *fname)
+{
+	if (!rszshm_at(r, fname)) {
+		return NULL;
+	}
+	return (struct tally_sharded *)line_align(r->dat);
+}
+
+void tally_sharded_add(struct tally_sharded *ts, unsigned shard, ssize_t val)
+{
+	struct tally_shard *s = &ts->shards[shard].shard;
+	size_t *count = &s->counts[loglin_bucket_of(ts->sub_bits, ts->range,
+						    ts->buckets / 2, val)];
+
+	/* Only we write these, but snapshots read them as we go: relaxed
+	 * atomics are plain loads and stores on most machines, but can't
+	 * be torn. */
+	__atomic_store_n(count, __atomic_load_n(count, __ATOMIC_RELAXED) + 1,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&s->sum,
+			 __atomic_load_n(&s->sum, __ATOMIC_RELAXED) + val,
+			 __ATOMIC_RELAXED);
+}
+
+struct tally *tally_sharded_snapshot(struct tally_sharded *ts, bool reset)
+{
+	struct tally *tally;
+	unsigned int i, b;
+
+	tally = loglin_new(ts->sub_bits, ts->range);
+	if (!tally) {
+		return NULL;
+	}
+
+	/* Shards are added to as we read them, so we read each word once
+	 * (atomically, see tally_sharded_add) and count what we read. */
+	for (i = 0; i < ts->n_shards; i++) {
+		struct tally_shard *s = &ts->shards[i].shard;
+		uint64_t sum = __atomic_load_n(&s->sum, __ATOMIC_RELAXED);
+
+		for (b = 0; b < ts->buckets; b++) {
+			size_t count = __atomic_load_n(&s->counts[b],
+						       __ATOMIC_RELAXED);
+
+			tally->counts[b] += count - s->base[b];
+			tally->num += count - s->base[b];
+			if (reset) {
+				s->base[b] = count;
+			}
+		}
+		/* Sums wrap, but each shard's since the reset fits. */
+		add_total(tally, (ssize_t)(int64_t)(sum - s->base_sum));
+		if (reset) {
+			s->base_sum = sum;
+		}
+	}
+
+	/* Only the buckets of the extremes are known. */
+	if (tally->num) {
+		ssize_t lo, hi;
+
+		tally->min = ~SSIZET_MAX;
+		tally->max = SSIZET_MAX;
+		for (b = 0; !tally->counts[b]; b++);
+		loglin_bucket_range(tally, b, &lo, &hi);
+		tally->min = lo;
+		for (b = tally->buckets - 1; !tally->counts[b]; b--);
+		loglin_bucket_range(tally, b, &lo, &hi);
+		tally->max = hi;
+	}
+	return tally;
+}
+
+void tally_sharded_free(struct tally_sharded *ts)
+{
+	free(ts->mem);
+}
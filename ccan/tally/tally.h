@@ -2,6 +2,7 @@
 #ifndef CCAN_TALLY_H
 #define CCAN_TALLY_H
 #include "config.h"
+#include <stdbool.h>
 #include <sys/types.h>
 
 struct tally;
@@ -18,6 +19,33 @@ struct tally;
  */
 struct tally *tally_new(unsigned int buckets);
 
+#define TALLY_MAX_DIGITS 5
+
+/**
+ * tally_new_loglinear - allocate a tally with log-linear buckets.
+ * @digits: the significant decimal digits to keep (<= TALLY_MAX_DIGITS).
+ * @range: the largest magnitude to tell apart (0 for any ssize_t).
+ *
+ * This allocates a tally structure using malloc(), which keeps every value
+ * to within 1 part in 10^@digits (like an HDR histogram), rather than to a
+ * fixed fraction of the range seen so far.  This suits values spanning many
+ * orders of magnitude, such as latencies.  Values larger in magnitude than
+ * @range are counted together, but tally_min() and tally_max() are exact.
+ *
+ * Memory used grows with log2(@range) and 10^@digits: 3 digits of
+ * nanoseconds up to an hour take about 540k, 2 digits about 70k.
+ * tally_add() takes constant time.  Returns NULL if @digits is too large or
+ * on out of memory.
+ *
+ * Example:
+ *	// Nanosecond latencies up to 1 hour, to 3 significant digits.
+ *	static struct tally *new_latency_tally(void)
+ *	{
+ *		return tally_new_loglinear(3, 3600000000000ULL);
+ *	}
+ */
+struct tally *tally_new_loglinear(unsigned int digits, size_t range);
+
 /**
  * tally_add - add a value.
  * @tally: the tally structure.
@@ -77,6 +105,19 @@ ssize_t tally_total(const struct tally *tally, ssize_t *overflow);
  */
 ssize_t tally_approx_median(const struct tally *tally, size_t *err);
 
+/**
+ * tally_percentile - the approximate value at a percentile.
+ * @tally: the tally structure.
+ * @p: the fraction of values at or below the result (eg. 0.999).
+ * @err: the error in the returned value (ie. real value is +/- @err).
+ *
+ * Undefined if tally_num() == 0, but will not crash.  For a tally from
+ * tally_new_loglinear(), @err is at most 1 part in 2 * 10^digits of the
+ * returned value (for magnitudes within its range).  A @p of 0.5 gives
+ * the same as tally_approx_median().
+ */
+ssize_t tally_percentile(const struct tally *tally, double p, size_t *err);
+
 /**
  * tally_approx_mode - the approximate mode value passed to tally_add.
  * @tally: the tally structure.
@@ -88,6 +129,79 @@ ssize_t tally_approx_median(const struct tally *tally, size_t *err);
  */
 ssize_t tally_approx_mode(const struct tally *tally, size_t *err);
 
+/**
+ * tally_merge - add the values of one tally to another.
+ * @tally: the tally structure to add to.
+ * @src: the tally structure to add from.
+ *
+ * Afterwards @tally is as if every value passed to tally_add() for @src had
+ * also been passed to it.  Both must be from tally_new(), or from
+ * tally_new_loglinear() with the same arguments, otherwise this returns false
+ * and leaves @tally unchanged.  Tallies from tally_new_loglinear() merge
+ * exactly; for those from tally_new() the buckets of @src are moved whole,
+ * which adds to the error of the median, mode and percentiles.
+ *
+ * Example:
+ *	static struct tally *per_minute[60];
+ *
+ *	static struct tally *last_hour(unsigned digits)
+ *	{
+ *		struct tally *t = tally_new_loglinear(digits, 0);
+ *		unsigned i;
+ *
+ *		for (i = 0; t && i < 60; i++)
+ *			if (per_minute[i])
+ *				tally_merge(t, per_minute[i]);
+ *		return t;
+ *	}
+ */
+bool tally_merge(struct tally *tally, const struct tally *src);
+
+/**
+ * tally_encode - encode a tally to send or store.
+ * @tally: the tally structure.
+ * @len: set to the length of the encoding.
+ *
+ * Returns a malloc()ed encoding of @tally, or NULL on out of memory.  This
+ * can be read with tally_decode() or tally_merge_encoded() on any machine.
+ * Counts are stored as variable length integers and runs of empty buckets
+ * are skipped, so encodings are typically much smaller than the tally.
+ *
+ * Example:
+ *	static bool save(const struct tally *t, FILE *f)
+ *	{
+ *		size_t len;
+ *		void *buf = tally_encode(t, &len);
+ *		bool ok = buf && fwrite(buf, len, 1, f) == 1;
+ *
+ *		free(buf);
+ *		return ok;
+ *	}
+ */
+void *tally_encode(const struct tally *tally, size_t *len);
+
+/**
+ * tally_decode - create a tally from its encoding.
+ * @buf: the encoding from tally_encode().
+ * @len: the length of the encoding.
+ *
+ * Returns a malloc()ed tally, or NULL if @buf is not a complete encoding of
+ * a tally or on out of memory.
+ */
+struct tally *tally_decode(const void *buf, size_t len);
+
+/**
+ * tally_merge_encoded - tally_merge() straight from an encoding.
+ * @tally: the tally structure to add to.
+ * @buf: the encoding from tally_encode().
+ * @len: the length of the encoding.
+ *
+ * This is tally_merge(@tally, tally_decode(@buf, @len)) without creating
+ * the decoded tally.  Returns false and leaves @tally unchanged if @buf is
+ * not a complete encoding of a tally, or if tally_merge() would.
+ */
+bool tally_merge_encoded(struct tally *tally, const void *buf, size_t len);
+
 #define TALLY_MIN_HISTO_WIDTH 8
 #define TALLY_MIN_HISTO_HEIGHT 3
 
@@ -102,4 +216,115 @@ ssize_t tally_approx_mode(const struct tally *tally, size_t *err);
  */
 char *tally_histogram(const struct tally *tally,
 		      unsigned width, unsigned height);
+
+/**
+ * struct tally_sharded - a tally added to by many threads at once.
+ *
+ * Each thread adds to its own shard, so there are no locks or atomic
+ * operations when adding, and no cache lines are shared between threads.
+ * The values are read out by tally_sharded_snapshot().
+ */
+struct tally_sharded;
+
+/**
+ * tally_sharded_new - allocate a sharded tally.
+ * @shards: the number of shards (eg. one per thread).
+ * @digits: the significant decimal digits, as for tally_new_loglinear().
+ * @range: the largest magnitude, as for tally_new_loglinear().
+ *
+ * This allocates the shards using malloc(), each of about the size of a
+ * tally_new_loglinear() tally, twice over.  Returns NULL if @shards is 0,
+ * @digits is too large or on out of memory.
+ */
+struct tally_sharded *tally_sharded_new(unsigned int shards,
+					unsigned int digits, size_t range);
+
+struct rszshm;
+
+/**
+ * tally_sharded_new_shm - create a sharded tally in shared memory.
+ * @r: the rszshm handle to fill in.
+ * @fname: the file to create, as for rszshm_mk().
+ * @shards: the number of shards (eg. one per process).
+ * @digits: the significant decimal digits, as for tally_new_loglinear().
+ * @range: the largest magnitude, as for tally_new_loglinear().
+ *
+ * This is tally_sharded_new() in a shared memory file made with
+ * rszshm_mk(), so other processes can add to shards of it (or snapshot it)
+ * after tally_sharded_attach_shm(), or by being fork()ed.  Pass @r to
+ * rszshm_dt() and rszshm_unlink() when done, rather than calling
+ * tally_sharded_free().  Returns NULL on error.
+ *
+ * Example:
+ *	static struct tally_sharded *for_workers(struct rszshm *r,
+ *						  unsigned workers)
+ *	{
+ *		return tally_sharded_new_shm(r, NULL, workers, 3, 0);
+ *	}
+ */
+struct tally_sharded *tally_sharded_new_shm(struct rszshm *r,
+					    const char *fname,
+					    unsigned int shards,
+					    unsigned int digits, size_t range);
+
+/**
+ * tally_sharded_attach_shm - use a sharded tally from another process.
+ * @r: the rszshm handle to fill in.
+ * @fname: the file made by tally_sharded_new_shm() (see @r->fname).
+ *
+ * Maps the shared memory file with rszshm_at(); pass @r to rszshm_dt() when
+ * done.  Returns NULL on error.
+ */
+struct tally_sharded *tally_sharded_attach_shm(struct rszshm *r,
+					       const char *fname);
+
+/**
+ * tally_sharded_add - add a value to a shard.
+ * @ts: the sharded tally.
+ * @shard: the shard to add to (less than @shards).
+ * @val: the value to add.
+ *
+ * Only one thread (or process) may add to each shard at a time, but
+ * different shards can be added to at once, and while a snapshot is taken.
+ */
+void tally_sharded_add(struct tally_sharded *ts, unsigned int shard,
+		       ssize_t val);
+
+/**
+ * tally_sharded_snapshot - read out the values of a sharded tally.
+ * @ts: the sharded tally.
+ * @reset: whether to start counting again from now.
+ *
+ * Returns a tally_new_loglinear() tally of the values added to every shard
+ * since the last reset (or since tally_sharded_new()), which must be free()d
+ * by the caller, or NULL on out of memory.  If @reset, the values returned
+ * won't be returned by later snapshots, so periodic snapshots with @reset
+ * can be reported (or tally_merge()d) separately without losing any values.
+ *
+ * Values added during a snapshot may or may not be returned by it.
+ * tally_min() and tally_max() are the bounds of their buckets, rather than
+ * exact.  Only one thread may take a snapshot at a time.
+ *
+ * Example:
+ *	static void report(struct tally_sharded *ts)
+ *	{
+ *		struct tally *t = tally_sharded_snapshot(ts, true);
+ *		size_t err;
+ *
+ *		if (t && tally_num(t))
+ *			printf("%zu requests, p99 %zi (+/- %zu)\n",
+ *			       tally_num(t), tally_percentile(t, 0.99, &err),
+ *			       err);
+ *		free(t);
+ *	}
+ */
+struct tally *tally_sharded_snapshot(struct tally_sharded *ts, bool reset);
+
+/**
+ * tally_sharded_free - free a sharded tally.
+ * @ts: the sharded tally.
+ *
+ * This does nothing for tallies in shared memory.
+ */
+void tally_sharded_free(struct tally_sharded *ts);
 #endif /* CCAN_TALLY_H */
@@ -0,0 +1,157 @@
+#include <ccan/tally/tally.c>
+#include <ccan/tap/tap.h>
+
+/* Do a and b hold the same values in the same buckets? */
+static bool same_tally(const struct tally *a, const struct tally *b)
+{
+	ssize_t ao, bo;
+
+	return a->sub_bits == b->sub_bits && a->range == b->range
+		&& a->buckets == b->buckets && a->step_bits == b->step_bits
+		&& tally_num(a) == tally_num(b)
+		&& tally_min(a) == tally_min(b) && tally_max(a) == tally_max(b)
+		&& tally_total(a, &ao) == tally_total(b, &bo) && ao == bo
+		&& !memcmp(a->counts, b->counts,
+			   sizeof(a->counts[0]) * a->buckets);
+}
+
+/* Does t survive encoding, and is every truncation refused? */
+static bool round_trip(const struct tally *t)
+{
+	struct tally *d;
+	size_t len, i;
+	unsigned char *buf = tally_encode(t, &len);
+	bool ok;
+
+	if (!buf)
+		return false;
+	d = tally_decode(buf, len);
+	ok = d && same_tally(t, d);
+	free(d);
+	for (i = 0; ok && i < len; i++) {
+		d = tally_decode(buf, i);
+		ok = !d;
+		free(d);
+	}
+	free(buf);
+	return ok;
+}
+
+int main(void)
+{
+	struct tally *a, *b, *merged;
+	unsigned char *buf;
+	size_t len;
+	unsigned int i;
+
+	plan_tests(3 + 3 + 4 + 4 + 3 + 2);
+
+	/* Empty tallies. */
+	a = tally_new_loglinear(3, 0);
+	ok1(round_trip(a));
+	free(a);
+	a = tally_new(10);
+	ok1(round_trip(a));
+	free(a);
+
+	/* Mostly empty buckets take little space. */
+	a = tally_new_loglinear(3, 0);
+	for (i = 0; i < 10000; i++)
+		tally_add(a, (ssize_t)(random() % 1000 + 1) << random() % 20);
+	tally_add(a, -5);
+	buf = tally_encode(a, &len);
+	ok1(buf && len < a->buckets * sizeof(a->counts[0]) / 20);
+	free(buf);
+
+	/* Log-linear and linear tallies, with big totals. */
+	ok1(round_trip(a));
+	b = tally_new(100);
+	for (i = 0; i < 10000; i++)
+		tally_add(b, (ssize_t)random() * (i % 2 ? 1 : -1000));
+	tally_add(b, (ssize_t)~(1ULL << (sizeof(ssize_t)*CHAR_BIT - 1)));
+	ok1(round_trip(b));
+	free(b);
+	b = tally_new(1);
+	tally_add(b, 7);
+	ok1(round_trip(b));
+	free(b);
+
+	/* Merging encoded is the same as merging decoded. */
+	b = tally_new_loglinear(3, 0);
+	merged = tally_new_loglinear(3, 0);
+	for (i = 0; i < 1000; i++)
+		tally_add(b, (ssize_t)random() % 100000 - 50000);
+	tally_merge(merged, a);
+	tally_merge(merged, b);
+	buf = tally_encode(b, &len);
+	ok1(tally_merge_encoded(a, buf, len));
+	ok1(same_tally(a, merged));
+	/* Bad encodings leave the tally alone. */
+	buf[3]++;
+	ok1(!tally_merge_encoded(a, buf, len) && same_tally(a, merged));
+	buf[3]--;
+	ok1(!tally_merge_encoded(a, buf, len - 1) && same_tally(a, merged));
+	free(buf);
+	free(merged);
+	free(b);
+
+	/* So are linear ones, and incompatible tallies are refused. */
+	b = tally_new(50);
+	merged = tally_new(50);
+	for (i = 0; i < 1000; i++) {
+		tally_add(b, i * 3);
+		tally_add(merged, -(ssize_t)i);
+	}
+	buf = tally_encode(b, &len);
+	ok1(!tally_merge_encoded(a, buf, len));
+	tally_merge(b, merged);
+	ok1(tally_merge_encoded(merged, buf, len));
+	ok1(tally_num(merged) == tally_num(b) && tally_min(merged) == -999
+	    && tally_max(merged) == 2997 && tally_mean(merged) == tally_mean(b));
+	ok1(tally_merge_encoded(b, buf, len) && tally_num(b) == 3000);
+	free(buf);
+	free(merged);
+	free(b);
+
+	/* Corrupt counts and layouts are refused. */
+	buf = tally_encode(a, &len);
+	buf[len - 1] ^= 1;
+	ok1(!tally_decode(buf, len));
+	buf[len - 1] ^= 1;
+	buf[5]++;
+	ok1(!tally_decode(buf, len));
+	buf[5]--;
+	b = tally_decode(buf, len);
+	ok1(b && same_tally(a, b));
+	free(b);
+	free(buf);
+	free(a);
+
+	/* A small header claiming a huge layout is refused, not allocated. */
+	a = tally_new_loglinear(TALLY_MAX_DIGITS, 0);
+	buf = tally_encode(a, &len);
+	ok1(buf && tally_decode(buf, len) != NULL);
+	free(buf);
+	free(a);
+	{
+		unsigned char crafted[64], *p = crafted;
+		unsigned sub_bits = 25;
+
+		*(p++) = 'T';
+		*(p++) = 'L';
+		*(p++) = 'Y';
+		*(p++) = ENCODE_VERSION;
+		p = put_varint(p, sub_bits);
+		p = put_varint(p, loglin_buckets(sub_bits, SSIZET_MAX));
+		p = put_varint(p, SSIZET_MAX);
+		for (i = 0; i < 6; i++) {
+			p = put_varint(p, 0);
+		}
+		merged = tally_new_loglinear(3, 0);
+		ok1(!tally_decode(crafted, p - crafted)
+		    && !tally_merge_encoded(merged, crafted, p - crafted));
+		free(merged);
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,80 @@
+#include <ccan/tally/tally.c>
+#include <ccan/tap/tap.h>
+
+int main(void)
+{
+	struct tally *a, *b, *all;
+	unsigned int i;
+	ssize_t total, overflow, val;
+	size_t err;
+
+	plan_tests(4 + 6 + 6 + 2);
+
+	/* Log-linear tallies merge exactly. */
+	a = tally_new_loglinear(3, 0);
+	b = tally_new_loglinear(3, 0);
+	all = tally_new_loglinear(3, 0);
+	for (i = 0; i < 10000; i++) {
+		ssize_t v = ((ssize_t)random() % 100000 - 20000) << random() % 20;
+
+		tally_add(i % 3 ? a : b, v);
+		tally_add(all, v);
+	}
+	ok1(tally_merge(a, b));
+	ok1(tally_num(a) == tally_num(all)
+	    && tally_min(a) == tally_min(all) && tally_max(a) == tally_max(all)
+	    && tally_mean(a) == tally_mean(all));
+	ok1(memcmp(a->counts, all->counts,
+		   sizeof(a->counts[0]) * a->buckets) == 0);
+	/* Merging an empty tally changes nothing, into one copies. */
+	free(b);
+	b = tally_new_loglinear(3, 0);
+	ok1(tally_merge(a, b) && tally_merge(b, a)
+	    && tally_num(b) == tally_num(all) && tally_min(b) == tally_min(all)
+	    && tally_max(b) == tally_max(all));
+	free(a);
+	free(b);
+
+	/* Different kinds of tally don't. */
+	a = tally_new_loglinear(2, 0);
+	b = tally_new_loglinear(2, 1000);
+	tally_add(b, 1);
+	ok1(!tally_merge(a, b));
+	ok1(!tally_merge(all, b));
+	ok1(!tally_merge(all, a));
+	free(a);
+	a = tally_new(100);
+	ok1(!tally_merge(a, b));
+	ok1(!tally_merge(b, a));
+	ok1(tally_num(a) == 0 && tally_num(b) == 1);
+	free(a);
+	free(b);
+	free(all);
+
+	/* Linear tallies merge approximately, and totals carry. */
+	a = tally_new(100);
+	b = tally_new(50);
+	for (i = 0; i < 1000; i++) {
+		tally_add(a, i);
+		tally_add(b, -(ssize_t)i);
+	}
+	ok1(tally_merge(a, b));
+	ok1(tally_num(a) == 2000);
+	ok1(tally_min(a) == -999 && tally_max(a) == 999);
+	ok1(tally_mean(a) == 0);
+	val = tally_approx_median(a, &err);
+	ok1(val - (ssize_t)err <= 0 && val + (ssize_t)err >= 0 && err <= 40);
+	free(b);
+	b = tally_new(10);
+	total = (ssize_t)~(1ULL << (sizeof(total)*CHAR_BIT - 1));
+	tally_add(b, total);
+	tally_add(b, total);
+	ok1(tally_merge(a, b));
+	total = tally_total(a, &overflow);
+	ok1(overflow == 0 && (size_t)total == (size_t)-2);
+	ok1(tally_num(a) == 2002);
+	free(a);
+	free(b);
+
+	return exit_status();
+}
@@ -0,0 +1,175 @@
+#include <ccan/tally/tally.c>
+#include <ccan/tap/tap.h>
+
+#define NUM 100000
+
+static int cmp_ssize(const void *a, const void *b)
+{
+	ssize_t x = *(const ssize_t *)a, y = *(const ssize_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Is the value at each percentile of (sorted) vals within err of the
+ * answer, and err within 1 part in 2 * 10^digits of it? */
+static bool percentiles_ok(const struct tally *tally, const ssize_t *vals,
+			   size_t n, unsigned digits)
+{
+	const double ps[] = { 0, 0.001, 0.25, 0.5, 0.9, 0.99, 0.999, 0.9999,
+			      1 };
+	double limit = 0.5;
+	unsigned int i;
+
+	for (i = 0; i < digits; i++) {
+		limit /= 10;
+	}
+
+	for (i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+		size_t rank = ps[i] * n, err;
+		ssize_t val, expect;
+
+		if (rank < ps[i] * n || rank == 0) {
+			rank++;
+		}
+		expect = vals[rank - 1];
+		val = tally_percentile(tally, ps[i], &err);
+		if (expect < val - (ssize_t)err || expect > val + (ssize_t)err) {
+			diag("p%g: %zi not %zi +/- %zu", ps[i] * 100, expect,
+			     val, err);
+			return false;
+		}
+		if (err > (val < 0 ? -(double)val : val) * limit) {
+			diag("p%g: %zi +/- %zu", ps[i] * 100, val, err);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(void)
+{
+	static ssize_t vals[NUM];
+	struct tally *tally;
+	unsigned int i, digits;
+	ssize_t min, max, total, val;
+	size_t err, err2;
+	char *graph;
+
+	max = (ssize_t)~(1ULL << (sizeof(max)*CHAR_BIT - 1));
+	min = (ssize_t)(1ULL << (sizeof(max)*CHAR_BIT - 1));
+
+	plan_tests(4 + 2 * 3 + 5 + 4 + 4 + 2);
+
+	ok1(tally_new_loglinear(TALLY_MAX_DIGITS + 1, 0) == NULL);
+
+	/* Buckets of extreme and power of 2 values hold them. */
+	tally = tally_new_loglinear(2, 0);
+	for (i = 0; i < 2 * SIZET_BITS; i++) {
+		ssize_t v = i < SIZET_BITS ? (ssize_t)((size_t)1 << i >> 1)
+			: -(ssize_t)((size_t)1 << (i - SIZET_BITS) >> 1);
+		ssize_t vs[] = { v - 1, v, v + 1 };
+		unsigned int j;
+
+		for (j = 0; j < 3; j++) {
+			ssize_t lo, hi;
+
+			if ((v > 0 && vs[j] < 0) || (v < 0 && vs[j] > 0)) {
+				continue;
+			}
+			tally_add(tally, vs[j]);
+			loglin_bucket_range(tally,
+					    loglin_bucket(tally, vs[j]),
+					    &lo, &hi);
+			if (lo > vs[j] || hi < vs[j]) {
+				break;
+			}
+		}
+		if (j != 3) {
+			break;
+		}
+	}
+	ok1(i == 2 * SIZET_BITS);
+	tally_add(tally, min);
+	tally_add(tally, max);
+	ok1(loglin_bucket(tally, min) == 0);
+	ok1(loglin_bucket(tally, max) == tally->buckets - 1);
+	free(tally);
+
+	/* Latencies over 12 orders of magnitude. */
+	for (digits = 1; digits <= 3; digits++) {
+		tally = tally_new_loglinear(digits, 0);
+		total = 0;
+		for (i = 0; i < NUM; i++) {
+			vals[i] = (ssize_t)(random() % 1000 + 1) << random() % 30;
+			total += vals[i];
+			tally_add(tally, vals[i]);
+		}
+		qsort(vals, NUM, sizeof(vals[0]), cmp_ssize);
+		ok1(percentiles_ok(tally, vals, NUM, digits));
+		ok1(tally_num(tally) == NUM && tally_mean(tally) == total / NUM);
+		free(tally);
+	}
+
+	/* Negative values too, with the API of other tallies. */
+	tally = tally_new_loglinear(3, 0);
+	for (i = 0; i < NUM; i++) {
+		vals[i] = (ssize_t)(random() % 1000 + 1) << random() % 40;
+		if (i % 3) {
+			vals[i] = -vals[i];
+		}
+		tally_add(tally, vals[i]);
+	}
+	qsort(vals, NUM, sizeof(vals[0]), cmp_ssize);
+	ok1(percentiles_ok(tally, vals, NUM, 3));
+	ok1(tally_min(tally) == vals[0]);
+	ok1(tally_max(tally) == vals[NUM - 1]);
+	val = tally_approx_median(tally, &err);
+	ok1(val == tally_percentile(tally, 0.5, &err2) && err == err2);
+	tally_approx_mode(tally, &err);
+	ok1(err <= (size_t)max / 1000);
+	free(tally);
+
+	/* Beyond range, values are only bounded by min and max. */
+	tally = tally_new_loglinear(2, 1000);
+	for (i = 0; i < 100; i++) {
+		tally_add(tally, i * 100);
+	}
+	val = tally_percentile(tally, 0.5, &err);
+	ok1(val - (ssize_t)err <= 4900 && val + (ssize_t)err >= 4900);
+	val = tally_percentile(tally, 1, &err);
+	ok1(val - (ssize_t)err <= 9900 && val + (ssize_t)err >= 9900);
+	tally_add(tally, min);
+	val = tally_percentile(tally, 0, &err);
+	ok1(val >= min && (size_t)(val - min) <= err);
+	graph = tally_histogram(tally, 20, 10);
+	ok1(graph);
+	free(graph);
+	free(tally);
+
+	/* Linear tallies have percentiles too. */
+	tally = tally_new(100);
+	for (i = 0; i < 1000; i++) {
+		tally_add(tally, i);
+	}
+	for (i = 0; i < 4; i++) {
+		double p = 0.25 * (i + 1);
+
+		val = tally_percentile(tally, p, &err);
+		ok1(val - (ssize_t)err <= 1000 * p - 1
+		    && val + (ssize_t)err >= 1000 * p - 1 && err <= 8);
+	}
+	free(tally);
+
+	/* An empty log-linear tally draws nothing. */
+	tally = tally_new_loglinear(3, 1000000);
+	graph = tally_histogram(tally, 20, 10);
+	ok1(graph && !*graph);
+	free(graph);
+	tally_add(tally, 10);
+	graph = tally_histogram(tally, 20, 10);
+	ok1(graph && *graph);
+	free(graph);
+	free(tally);
+
+	return exit_status();
+}
@@ -0,0 +1,76 @@
+#include <ccan/tally/tally.c>
+#include <ccan/tap/tap.h>
+
+#define SHARDS 7
+
+/* Are a and b the same values, with b's min and max from buckets? */
+static bool same_tally(const struct tally *a, const struct tally *b)
+{
+	ssize_t lo, hi;
+
+	if (tally_num(a) != tally_num(b) || tally_mean(a) != tally_mean(b)
+	    || memcmp(a->counts, b->counts, sizeof(a->counts[0]) * a->buckets))
+		return false;
+	if (!tally_num(a))
+		return true;
+	loglin_bucket_range(b, loglin_bucket(b, tally_min(a)), &lo, &hi);
+	if (tally_min(b) != lo)
+		return false;
+	loglin_bucket_range(b, loglin_bucket(b, tally_max(a)), &lo, &hi);
+	return tally_max(b) == hi;
+}
+
+int main(void)
+{
+	struct tally_sharded *ts;
+	struct tally *all, *since, *snap, *merged;
+	unsigned int i, round;
+
+	plan_tests(3 + 3 * 3 + 2);
+
+	ok1(tally_sharded_new(0, 3, 0) == NULL);
+	ok1(tally_sharded_new(1, TALLY_MAX_DIGITS + 1, 0) == NULL);
+
+	ts = tally_sharded_new(SHARDS, 3, 1000000);
+	all = tally_new_loglinear(3, 1000000);
+	merged = tally_new_loglinear(3, 1000000);
+	snap = tally_sharded_snapshot(ts, false);
+	ok1(snap && tally_num(snap) == 0);
+	free(snap);
+
+	for (round = 0; round < 3; round++) {
+		since = tally_new_loglinear(3, 1000000);
+		for (i = 0; i < 10000; i++) {
+			ssize_t v = (ssize_t)random() % 3000000 - 1000000;
+
+			tally_sharded_add(ts, i % SHARDS, v);
+			tally_add(all, v);
+			tally_add(since, v);
+		}
+		/* Without reset, the next snapshot gets them again. */
+		snap = tally_sharded_snapshot(ts, false);
+		ok1(same_tally(since, snap));
+		free(snap);
+		/* With reset, only what was added since the last. */
+		snap = tally_sharded_snapshot(ts, true);
+		ok1(same_tally(since, snap));
+		ok1(tally_merge(merged, snap));
+		free(snap);
+		free(since);
+	}
+
+	/* The resets lost nothing. */
+	ok1(tally_num(merged) == tally_num(all)
+	    && tally_mean(merged) == tally_mean(all)
+	    && !memcmp(merged->counts, all->counts,
+		       sizeof(all->counts[0]) * all->buckets));
+	snap = tally_sharded_snapshot(ts, true);
+	ok1(snap && tally_num(snap) == 0);
+	free(snap);
+
+	free(merged);
+	free(all);
+	tally_sharded_free(ts);
+
+	return exit_status();
+}
@@ -0,0 +1,78 @@
+#include <ccan/tally/tally.c>
+#include <ccan/rszshm/rszshm.h>
+#include <ccan/tap/tap.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define WORKERS 4
+#define NUM 10000
+
+static void work(struct tally_sharded *ts, unsigned int shard)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM; i++)
+		tally_sharded_add(ts, shard, i * (shard + 1));
+}
+
+int main(void)
+{
+	struct rszshm r;
+	struct tally_sharded *ts;
+	struct tally *t;
+	unsigned int i;
+	int status, ok = 0;
+
+	plan_tests(7);
+
+	ts = tally_sharded_new_shm(&r, NULL, WORKERS + 1, 3, 1000000);
+	ok1(ts);
+	if (!ts)
+		return exit_status();
+
+	/* Separate processes add to their own shards. */
+	for (i = 0; i < WORKERS; i++) {
+		if (fork() == 0) {
+			work(ts, i);
+			_exit(0);
+		}
+	}
+	for (i = 0; i < WORKERS; i++)
+		ok += wait(&status) > 0 && WIFEXITED(status)
+			&& WEXITSTATUS(status) == 0;
+	ok1(ok == WORKERS);
+
+	/* A process attaching by name (once it's unmapped what it inherited)
+	 * gets it at the same address, and adds its own. */
+	if (fork() == 0) {
+		struct rszshm r2;
+		char fname[RSZSHM_PATH_MAX];
+
+		strcpy(fname, r.fname);
+		if (rszshm_dt(&r) != 0
+		    || tally_sharded_attach_shm(&r2, fname) != ts)
+			_exit(1);
+		work(ts, WORKERS);
+		rszshm_dt(&r2);
+		_exit(0);
+	}
+	ok1(wait(&status) > 0 && WIFEXITED(status)
+	    && WEXITSTATUS(status) == 0);
+
+	t = tally_sharded_snapshot(ts, true);
+	ok1(t && tally_num(t) == (WORKERS + 1) * NUM);
+	/* Sum of i * (shard + 1) for each shard. */
+	ok1(t && tally_mean(t) == (ssize_t)((NUM - 1) / 2.0
+					    * (WORKERS + 1) * (WORKERS + 2) / 2
+					    / (WORKERS + 1)));
+	free(t);
+	t = tally_sharded_snapshot(ts, false);
+	ok1(t && tally_num(t) == 0);
+	free(t);
+
+	tally_sharded_free(ts);
+	ok1(rszshm_unlink(&r) == 0 && rszshm_rmdir(&r) == 0
+	    && rszshm_dt(&r) == 0);
+
+	return exit_status();
+}